@@ -0,0 +1,681 @@
+#include "zlx/aio.h"
+#include "zlx/atomic.h"
+#include "zlx/fdfile.h"
+#include "zlx/stdarray.h"
+
+#if __linux__ && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_URING 1
+#endif
+#endif
+
+#if HAVE_URING
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+/* longest transfer of one request; the rest is a short transfer */
+#define MAX_XFER 0x7FFFF000
+
+/* finish_req ***************************************************************/
+static void finish_req
+(
+    zlx_aio_req_t * req
+)
+{
+    if (req->result < 0)
+        zlx_future_set_error(&req->future, (int) -req->result);
+    else zlx_future_set_value(&req->future, req);
+}
+
+/* run_req ******************************************************************/
+static void run_req
+(
+    zlx_aio_req_t * req
+)
+{
+    req->result = req->op == ZLX_AIO_READ
+        ? zlx_pread(req->file, req->iov.data, req->iov.size, req->offset)
+        : zlx_pwrite(req->file, req->iov.data, req->iov.size, req->offset);
+}
+
+/* complete_list ************************************************************/
+/**
+ *  Completes a list of requests.
+ *  @returns the number of requests
+ */
+static size_t complete_list
+(
+    zlx_aio_req_t * req
+)
+{
+    zlx_aio_req_t * next;
+    size_t n;
+
+    for (n = 0; req; req = next, ++n)
+    {
+        /* the continuation may reuse the request */
+        next = req->next;
+        finish_req(req);
+    }
+    return n;
+}
+
+#if HAVE_URING
+
+/* uring_enter **************************************************************/
+static int uring_enter
+(
+    zlx_aio_t * aio,
+    uint32_t to_submit,
+    uint32_t min_complete
+)
+{
+    long r;
+    do
+    {
+        r = syscall(__NR_io_uring_enter, aio->ring_fd, to_submit, min_complete,
+                    min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    }
+    while (r < 0 && errno == EINTR);
+    return r < 0 ? -(int) zlx_fd_file_status(errno) : (int) r;
+}
+
+/* uring_submit *************************************************************/
+static int uring_submit
+(
+    zlx_aio_t * aio,
+    uint32_t min_complete
+)
+{
+    int r;
+
+    if (!aio->to_submit && !min_complete) return 0;
+    r = uring_enter(aio, aio->to_submit, min_complete);
+    if (r > 0)
+    {
+        aio->to_submit -= r;
+        aio->in_flight += r;
+    }
+    return r;
+}
+
+/* uring_queue **************************************************************/
+static zlx_file_status_t uring_queue
+(
+    zlx_aio_t * aio,
+    zlx_aio_req_t * req,
+    intptr_t fd
+)
+{
+    struct io_uring_sqe * sqe;
+    uint32_t head, tail, idx;
+
+    tail = *aio->sq_tail;
+    head = zlx_atomic_load_u32(aio->sq_head);
+    if (tail - head >= aio->sq_entries)
+    {
+        if (uring_submit(aio, 0) < 0) return ZLXF_WOULD_BLOCK;
+        head = zlx_atomic_load_u32(aio->sq_head);
+        if (tail - head >= aio->sq_entries) return ZLXF_WOULD_BLOCK;
+    }
+    idx = tail & *aio->sq_mask;
+    sqe = (struct io_uring_sqe *) aio->sqes + idx;
+    zlx_u8a_set((uint8_t *) sqe, sizeof(*sqe), 0);
+    if (req->buf_index >= 0)
+    {
+        sqe->opcode = req->op == ZLX_AIO_READ
+            ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        sqe->addr = (uintptr_t) req->iov.data;
+        sqe->len = (uint32_t) req->iov.size;
+        sqe->buf_index = (uint16_t) req->buf_index;
+    }
+    else
+    {
+        sqe->opcode = req->op == ZLX_AIO_READ
+            ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->addr = (uintptr_t) &req->iov;
+        sqe->len = 1;
+    }
+    if (req->file_index >= 0)
+    {
+        sqe->fd = req->file_index;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+    else sqe->fd = (int) fd;
+    sqe->off = req->offset;
+    sqe->user_data = (uintptr_t) req;
+    aio->sq_array[idx] = idx;
+    /* publishes the entry */
+    zlx_atomic_store_u32(aio->sq_tail, tail + 1);
+    ++aio->to_submit;
+    return ZLXF_OK;
+}
+
+/* uring_reap ***************************************************************/
+/**
+ *  Completes the available CQEs.
+ *  @returns the number of completed requests
+ */
+static size_t uring_reap
+(
+    zlx_aio_t * aio
+)
+{
+    struct io_uring_cqe * cqe;
+    zlx_aio_req_t * list;
+    zlx_aio_req_t * * tail_p;
+    zlx_aio_req_t * req;
+    uint32_t head, tail;
+    size_t n;
+
+    head = *aio->cq_head;
+    tail = zlx_atomic_load_u32(aio->cq_tail);
+    for (list = NULL, tail_p = &list; head != tail; ++head)
+    {
+        cqe = (struct io_uring_cqe *) aio->cqes + (head & *aio->cq_mask);
+        req = (zlx_aio_req_t *) (uintptr_t) cqe->user_data;
+        req->result = cqe->res < 0
+            ? -(ptrdiff_t) zlx_fd_file_status(-cqe->res) : cqe->res;
+        *tail_p = req;
+        tail_p = &req->next;
+    }
+    *tail_p = NULL;
+    /* release the CQEs before running continuations that may queue more */
+    zlx_atomic_store_u32(aio->cq_head, head);
+    n = complete_list(list);
+    aio->in_flight -= (uint32_t) n;
+    return n;
+}
+
+/* uring_init ***************************************************************/
+static int uring_init
+(
+    zlx_aio_t * aio,
+    uint32_t depth
+)
+{
+    struct io_uring_params p;
+    uint8_t * sq;
+    uint8_t * cq;
+    long fd;
+
+    zlx_u8a_set((uint8_t *) &p, sizeof(p), 0);
+    fd = syscall(__NR_io_uring_setup, depth, &p);
+    if (fd < 0) return 1;
+    aio->ring_fd = (int) fd;
+    aio->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    aio->cq_map_size = p.cq_off.cqes
+        + p.cq_entries * sizeof(struct io_uring_cqe);
+    if ((p.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        if (aio->sq_map_size < aio->cq_map_size)
+            aio->sq_map_size = aio->cq_map_size;
+        aio->cq_map_size = 0;
+    }
+    aio->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    aio->sq_map = mmap(NULL, aio->sq_map_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, aio->ring_fd,
+                       IORING_OFF_SQ_RING);
+    if (aio->sq_map == MAP_FAILED) aio->sq_map = NULL;
+    aio->cq_map = aio->sq_map;
+    if (aio->cq_map_size)
+    {
+        aio->cq_map = mmap(NULL, aio->cq_map_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, aio->ring_fd,
+                           IORING_OFF_CQ_RING);
+        if (aio->cq_map == MAP_FAILED) aio->cq_map = NULL;
+    }
+    aio->sqes = mmap(NULL, aio->sqes_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, aio->ring_fd, IORING_OFF_SQES);
+    if (aio->sqes == MAP_FAILED) aio->sqes = NULL;
+    if (!aio->sq_map || !aio->cq_map || !aio->sqes) return 1;
+
+    sq = aio->sq_map;
+    cq = aio->cq_map;
+    aio->sq_entries = p.sq_entries;
+    aio->sq_head = (uint32_t *) (sq + p.sq_off.head);
+    aio->sq_tail = (uint32_t *) (sq + p.sq_off.tail);
+    aio->sq_mask = (uint32_t *) (sq + p.sq_off.ring_mask);
+    aio->sq_array = (uint32_t *) (sq + p.sq_off.array);
+    aio->cq_head = (uint32_t *) (cq + p.cq_off.head);
+    aio->cq_tail = (uint32_t *) (cq + p.cq_off.tail);
+    aio->cq_mask = (uint32_t *) (cq + p.cq_off.ring_mask);
+    aio->cqes = cq + p.cq_off.cqes;
+    return 0;
+}
+
+/* uring_finish *************************************************************/
+static void uring_finish
+(
+    zlx_aio_t * aio
+)
+{
+    if (aio->sqes) munmap(aio->sqes, aio->sqes_size);
+    if (aio->cq_map && aio->cq_map != aio->sq_map)
+        munmap(aio->cq_map, aio->cq_map_size);
+    if (aio->sq_map) munmap(aio->sq_map, aio->sq_map_size);
+    if (aio->ring_fd >= 0) close(aio->ring_fd);
+    aio->sqes = aio->sq_map = aio->cq_map = NULL;
+    aio->ring_fd = -1;
+}
+
+#endif
+
+/* pool_worker **************************************************************/
+static uint_fast8_t ZLX_CALL pool_worker
+(
+    void * arg
+)
+{
+    zlx_aio_t * aio = arg;
+    zlx_aio_req_t * req;
+
+    for (;;)
+    {
+        zlx_sema_wait(&aio->work);
+        aio->mth->mutex.lock(aio->mutex);
+        req = aio->work_head;
+        if (req)
+        {
+            aio->work_head = req->next;
+            if (!aio->work_head) aio->work_tail = &aio->work_head;
+        }
+        aio->mth->mutex.unlock(aio->mutex);
+        /* a token with no request is the signal to stop */
+        if (!req) return 0;
+        run_req(req);
+        req->next = NULL;
+        aio->mth->mutex.lock(aio->mutex);
+        *aio->pool_done_tail = req;
+        aio->pool_done_tail = &req->next;
+        aio->mth->mutex.unlock(aio->mutex);
+        zlx_sema_post(&aio->pool_sema, 1);
+    }
+}
+
+/* pool_stop ****************************************************************/
+/**
+ *  Stops the first @a started threads and releases the pool.
+ */
+static void pool_stop
+(
+    zlx_aio_t * aio,
+    size_t started
+)
+{
+    size_t i;
+
+    zlx_sema_post(&aio->work, (uint32_t) started);
+    for (i = 0; i < started; ++i) aio->mth->thread.join(aio->threads[i], NULL);
+    ZLX_ARRAY_FREE(aio->ma, aio->threads, aio->thread_count);
+    zlx_sema_finish(&aio->pool_sema);
+    zlx_sema_finish(&aio->work);
+    if (aio->mutex) zlx_mutex_destroy(aio->mutex, aio->ma, &aio->mth->mutex);
+    aio->mutex = NULL;
+}
+
+/* pool_init ****************************************************************/
+static zlx_file_status_t pool_init
+(
+    zlx_aio_t * aio,
+    size_t thread_count
+)
+{
+    zlx_mth_xfc_t * mth = aio->mth;
+    size_t i;
+
+    if (mth->mutex.size)
+    {
+        aio->mutex = zlx_mutex_create(aio->ma, &mth->mutex, "aio mutex");
+        if (!aio->mutex) return ZLXF_NO_MEM;
+    }
+    if (zlx_sema_init(&aio->work, aio->ma, mth, 0)) goto l_no_sema;
+    if (zlx_sema_init(&aio->pool_sema, aio->ma, mth, 0))
+    {
+        zlx_sema_finish(&aio->work);
+        goto l_no_sema;
+    }
+    if (ZLX_ARRAY_ALLOC(aio->ma, aio->threads, aio->thread_count, thread_count,
+                        "aio threads"))
+    {
+        zlx_sema_finish(&aio->pool_sema);
+        zlx_sema_finish(&aio->work);
+        if (aio->mutex) zlx_mutex_destroy(aio->mutex, aio->ma, &mth->mutex);
+        aio->mutex = NULL;
+        return ZLXF_NO_MEM;
+    }
+    for (i = 0; i < aio->thread_count; ++i)
+        if (mth->thread.create(&aio->threads[i], pool_worker, aio)) break;
+    if (i < aio->thread_count)
+    {
+        pool_stop(aio, i);
+        return ZLXF_NO_CODE;
+    }
+    return ZLXF_OK;
+
+l_no_sema:
+    if (aio->mutex) zlx_mutex_destroy(aio->mutex, aio->ma, &mth->mutex);
+    aio->mutex = NULL;
+    return ZLXF_NO_CODE;
+}
+
+/* zlx_aio_init *************************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_init
+(
+    zlx_aio_t * restrict aio,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * mth,
+    uint32_t depth,
+    size_t thread_count,
+    uint32_t flags
+)
+{
+    zlx_file_status_t fs;
+
+    aio->ma = ma;
+    aio->mth = mth ? mth : &zlx_nosup_mth_xfc;
+    aio->in_flight = 0;
+    aio->queued = NULL;
+    aio->queued_tail = &aio->queued;
+    aio->done = NULL;
+    aio->done_tail = &aio->done;
+    aio->done_count = 0;
+    aio->ring_fd = -1;
+    aio->sq_entries = 0;
+    aio->to_submit = 0;
+    aio->sq_map = aio->cq_map = aio->sqes = NULL;
+    aio->mutex = NULL;
+    aio->work_head = NULL;
+    aio->work_tail = &aio->work_head;
+    aio->pool_done = NULL;
+    aio->pool_done_tail = &aio->pool_done;
+    aio->threads = NULL;
+    aio->thread_count = 0;
+
+#if HAVE_URING
+    if (!(flags & ZLX_AIO_NO_URING) && depth)
+    {
+        if (!uring_init(aio, depth))
+        {
+            aio->backend = ZLX_AIO_URING;
+            return ZLXF_OK;
+        }
+        uring_finish(aio);
+    }
+#else
+    (void) depth; (void) flags;
+#endif
+    if (thread_count && aio->mth->cond.size)
+    {
+        fs = pool_init(aio, thread_count);
+        if (fs == ZLXF_OK)
+        {
+            aio->backend = ZLX_AIO_POOL;
+            return ZLXF_OK;
+        }
+        if (fs != ZLXF_NO_CODE) return fs;
+    }
+    aio->backend = ZLX_AIO_INLINE;
+    return ZLXF_OK;
+}
+
+/* zlx_aio_finish ***********************************************************/
+ZLX_API void ZLX_CALL zlx_aio_finish
+(
+    zlx_aio_t * restrict aio
+)
+{
+#if HAVE_URING
+    if (aio->backend == ZLX_AIO_URING) uring_finish(aio);
+#endif
+    if (aio->backend == ZLX_AIO_POOL) pool_stop(aio, aio->thread_count);
+}
+
+#if HAVE_URING
+/* ring_file ****************************************************************/
+/**
+ *  Returns the descriptor-backed file that the ring can serve directly, or
+ *  NULL if requests must go through the class entry points: wrappers like
+ *  buffered or memory-mapped files keep data and state of their own, and
+ *  direct I/O needs the aligned transfers done by the class.
+ */
+static zlx_fd_file_t * ring_file
+(
+    zlx_file_t * file
+)
+{
+    zlx_fd_file_t * ff = zlx_fd_file_from(file);
+    return ff && !ff->dio ? ff : NULL;
+}
+#endif
+
+/* queue ********************************************************************/
+static zlx_file_status_t queue
+(
+    zlx_aio_t * aio,
+    zlx_aio_req_t * req,
+    zlx_file_t * file,
+    void * data,
+    size_t size,
+    uint64_t offset,
+    uint32_t op
+)
+{
+    req->file = file;
+    req->iov.data = data;
+    req->iov.size = size < MAX_XFER ? size : MAX_XFER;
+    req->offset = offset;
+    req->op = op;
+    req->result = 0;
+#if HAVE_URING
+    if (aio->backend == ZLX_AIO_URING)
+    {
+        zlx_fd_file_t * ff = ring_file(file);
+        /* the file is checked here as the kernel does not look at its
+         * flags */
+        if (ff && (file->flags & (op == ZLX_AIO_READ
+                                  ? ZLXF_READ : ZLXF_WRITE)))
+            return uring_queue(aio, req, ff->fd);
+    }
+#endif
+    req->next = NULL;
+    *aio->queued_tail = req;
+    aio->queued_tail = &req->next;
+    return ZLXF_OK;
+}
+
+/* zlx_aio_read *************************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_read
+(
+    zlx_aio_t * restrict aio,
+    zlx_aio_req_t * restrict req,
+    zlx_file_t * file,
+    void * data,
+    size_t size,
+    uint64_t offset
+)
+{
+    return queue(aio, req, file, data, size, offset, ZLX_AIO_READ);
+}
+
+/* zlx_aio_write ************************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_write
+(
+    zlx_aio_t * restrict aio,
+    zlx_aio_req_t * restrict req,
+    zlx_file_t * file,
+    void const * data,
+    size_t size,
+    uint64_t offset
+)
+{
+    return queue(aio, req, file, (void *) data, size, offset, ZLX_AIO_WRITE);
+}
+
+/* zlx_aio_submit ***********************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_aio_submit
+(
+    zlx_aio_t * restrict aio
+)
+{
+    zlx_aio_req_t * req;
+    zlx_aio_req_t * next;
+    ptrdiff_t n = 0;
+
+    req = aio->queued;
+    aio->queued = NULL;
+    aio->queued_tail = &aio->queued;
+    if (req && aio->backend == ZLX_AIO_POOL)
+    {
+        /* hand over the whole batch with one lock */
+        for (next = req; next; next = next->next) ++n;
+        aio->mth->mutex.lock(aio->mutex);
+        *aio->work_tail = req;
+        while (req->next) req = req->next;
+        aio->work_tail = &req->next;
+        aio->mth->mutex.unlock(aio->mutex);
+        aio->in_flight += (uint32_t) n;
+        zlx_sema_post(&aio->work, (uint32_t) n);
+    }
+    else
+    {
+        /* inline backend and files the ring cannot serve */
+        for (; req; req = next, ++n)
+        {
+            next = req->next;
+            run_req(req);
+            req->next = NULL;
+            *aio->done_tail = req;
+            aio->done_tail = &req->next;
+            ++aio->done_count;
+        }
+    }
+#if HAVE_URING
+    if (aio->backend == ZLX_AIO_URING)
+    {
+        int r = uring_submit(aio, 0);
+        if (r < 0) return n ? n : r;
+        n += r;
+    }
+#endif
+    return n;
+}
+
+/* zlx_aio_reap *************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_aio_reap
+(
+    zlx_aio_t * restrict aio,
+    size_t min_count
+)
+{
+    zlx_aio_req_t * req;
+    zlx_aio_req_t * tail;
+    ptrdiff_t r;
+    size_t n, k;
+
+    r = zlx_aio_submit(aio);
+    if (r < 0) return r;
+    if (min_count > aio->in_flight + aio->done_count)
+        min_count = aio->in_flight + aio->done_count;
+
+    req = aio->done;
+    aio->done = NULL;
+    aio->done_tail = &aio->done;
+    aio->done_count = 0;
+    n = complete_list(req);
+
+#if HAVE_URING
+    if (aio->backend == ZLX_AIO_URING)
+    {
+        for (;;)
+        {
+            n += uring_reap(aio);
+            if (n >= min_count) break;
+            r = uring_submit(aio, (uint32_t) (min_count - n));
+            if (r < 0) return n ? (ptrdiff_t) n : r;
+        }
+    }
+#endif
+    if (aio->backend == ZLX_AIO_POOL)
+    {
+        for (k = 0; n + k < min_count; ++k) zlx_sema_wait(&aio->pool_sema);
+        while (zlx_sema_try_wait(&aio->pool_sema)) ++k;
+        if (k)
+        {
+            /* each token stands for one request in the done list */
+            aio->mth->mutex.lock(aio->mutex);
+            req = aio->pool_done;
+            n += k;
+            for (tail = req; --k; ) tail = tail->next;
+            aio->pool_done = tail->next;
+            if (!aio->pool_done) aio->pool_done_tail = &aio->pool_done;
+            aio->mth->mutex.unlock(aio->mutex);
+            tail->next = NULL;
+            aio->in_flight -= (uint32_t) complete_list(req);
+        }
+    }
+    return n;
+}
+
+/* zlx_aio_register_buffers *************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_register_buffers
+(
+    zlx_aio_t * restrict aio,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+#if HAVE_URING
+    long r;
+    if (aio->backend != ZLX_AIO_URING) return ZLXF_OK;
+    /* zlx_iovec_t has the layout of struct iovec */
+    r = syscall(__NR_io_uring_register, aio->ring_fd,
+                IORING_REGISTER_BUFFERS, iov, (unsigned int) count);
+    return r < 0 ? zlx_fd_file_status(errno) : ZLXF_OK;
+#else
+    (void) aio; (void) iov; (void) count;
+    return ZLXF_OK;
+#endif
+}
+
+/* zlx_aio_register_files ***************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_register_files
+(
+    zlx_aio_t * restrict aio,
+    zlx_file_t * const * files,
+    size_t count
+)
+{
+#if HAVE_URING
+    zlx_file_status_t fs = ZLXF_OK;
+    zlx_fd_file_t * ff;
+    int * fds;
+    size_t n, i;
+    long r;
+
+    if (aio->backend != ZLX_AIO_URING) return ZLXF_OK;
+    if (ZLX_ARRAY_ALLOC(aio->ma, fds, n, count, "aio fds")) return ZLXF_NO_MEM;
+    for (i = 0; i < n; ++i)
+    {
+        ff = ring_file(files[i]);
+        if (!ff) { fs = ZLXF_BAD_FILE_DESC; break; }
+        fds[i] = ff->fd;
+    }
+    if (!fs)
+    {
+        r = syscall(__NR_io_uring_register, aio->ring_fd,
+                    IORING_REGISTER_FILES, fds, (unsigned int) n);
+        if (r < 0) fs = zlx_fd_file_status(errno);
+    }
+    ZLX_ARRAY_FREE(aio->ma, fds, n);
+    return fs;
+#else
+    (void) aio; (void) files; (void) count;
+    return ZLXF_OK;
+#endif
+}
+
@@ -0,0 +1,428 @@
+#include "zlx/buffile.h"
+#include "zlx/stdarray.h"
+
+/* number of buffers sent with one call when flushing */
+#define MAX_IOV 16
+
+/* move_down ****************************************************************/
+static void move_down
+(
+    uint8_t * dest,
+    uint8_t const * src,
+    size_t n
+)
+{
+    size_t i;
+    for (i = 0; i < n; ++i) dest[i] = src[i];
+}
+
+/* initial_read_ahead *******************************************************/
+static size_t initial_read_ahead
+(
+    zlx_buf_file_t * bf
+)
+{
+    return bf->size < ZLX_BUF_FILE_MIN_READ_AHEAD
+        ? bf->size : ZLX_BUF_FILE_MIN_READ_AHEAD;
+}
+
+/* inner_read ***************************************************************/
+static ptrdiff_t inner_read
+(
+    zlx_buf_file_t * bf,
+    uint8_t * data,
+    size_t size
+)
+{
+    ptrdiff_t r = zlx_raw_read(bf->inner, data, size);
+    if (r > 0)
+    {
+        if (bf->ipos >= 0) bf->ipos += r;
+        /* no seek since the previous read: the access is sequential */
+        bf->read_ahead = bf->read_ahead < bf->size / 2
+            ? bf->read_ahead * 2 : bf->size;
+    }
+    return r;
+}
+
+/* inner_writev *************************************************************/
+static ptrdiff_t inner_writev
+(
+    zlx_buf_file_t * bf,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    ptrdiff_t w = zlx_raw_writev(bf->inner, iov, count);
+    if (w > 0 && bf->ipos >= 0) bf->ipos += w;
+    return w;
+}
+
+/* drop_read ****************************************************************/
+/**
+ *  Discards read-ahead data moving the wrapped file back to the logical
+ *  position.
+ */
+static zlx_file_status_t drop_read
+(
+    zlx_buf_file_t * bf
+)
+{
+    int64_t o;
+
+    if (bf->rend > bf->rpos)
+    {
+        o = zlx_seek64(bf->inner, -(int64_t) (bf->rend - bf->rpos), ZLXF_CUR);
+        if (o < 0) return (zlx_file_status_t) -o;
+        bf->ipos = o;
+    }
+    bf->rpos = bf->rend = 0;
+    return ZLXF_OK;
+}
+
+/* bf_read ******************************************************************/
+static ptrdiff_t ZLX_CALL bf_read
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size
+)
+{
+    zlx_buf_file_t * bf = (zlx_buf_file_t *) f;
+    zlx_file_status_t fs;
+    ptrdiff_t r;
+    size_t avail;
+
+    if (bf->wlen)
+    {
+        fs = zlx_buf_file_flush(bf);
+        if (fs) return -fs;
+    }
+    avail = bf->rend - bf->rpos;
+    if (!avail)
+    {
+        bf->rpos = bf->rend = 0;
+        if (size >= bf->read_ahead) return inner_read(bf, data, size);
+        r = inner_read(bf, bf->buf, bf->read_ahead);
+        if (r <= 0) return r;
+        bf->rend = avail = r;
+    }
+    if (size > avail) size = avail;
+    zlx_u8a_copy(data, bf->buf + bf->rpos, size);
+    bf->rpos += size;
+    return size;
+}
+
+/* flush_with ***************************************************************/
+/**
+ *  Writes the pending data followed by the given buffers with a single call.
+ *  @returns the amount of data written from @a iov (0 if not all pending
+ *      data went out) or a negated status
+ */
+static ptrdiff_t flush_with
+(
+    zlx_buf_file_t * bf,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    zlx_iovec_t v[MAX_IOV];
+    size_t n;
+    ptrdiff_t w;
+
+    v[0].data = bf->buf;
+    v[0].size = bf->wlen;
+    for (n = 1; n < MAX_IOV && count; ++n, ++iov, --count) v[n] = *iov;
+    do w = inner_writev(bf, v, n);
+    while (w == -ZLXF_INTERRUPTED);
+    if (w < 0) return w;
+    if ((size_t) w < bf->wlen)
+    {
+        move_down(bf->buf, bf->buf + w, bf->wlen - w);
+        bf->wlen -= w;
+        return 0;
+    }
+    w -= bf->wlen;
+    bf->wlen = 0;
+    return w;
+}
+
+/* bf_writev ****************************************************************/
+static ptrdiff_t ZLX_CALL bf_writev
+(
+    zlx_file_t * restrict f,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    zlx_buf_file_t * bf = (zlx_buf_file_t *) f;
+    zlx_file_status_t fs;
+    size_t total, i;
+
+    if (bf->rend > bf->rpos)
+    {
+        /* the read and write sides of a non-seekable file are separate
+         * streams; keep the read data and do not buffer the write */
+        if (!(bf->base.flags & ZLXF_SEEK))
+            return inner_writev(bf, iov, count);
+        fs = drop_read(bf);
+        if (fs) return -fs;
+    }
+    bf->rpos = bf->rend = 0;
+    for (total = 0, i = 0; i < count; ++i) total += iov[i].size;
+    if (total <= bf->size - bf->wlen)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            zlx_u8a_copy(bf->buf + bf->wlen, iov[i].data, iov[i].size);
+            bf->wlen += iov[i].size;
+        }
+        return total;
+    }
+    /* the data does not fit: send it together with the pending data */
+    if (bf->wlen) return flush_with(bf, iov, count);
+    return inner_writev(bf, iov, count);
+}
+
+/* bf_write *****************************************************************/
+static ptrdiff_t ZLX_CALL bf_write
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    zlx_iovec_t v;
+    v.data = (uint8_t *) data;
+    v.size = size;
+    return bf_writev(f, &v, 1);
+}
+
+/* bf_seek64 ****************************************************************/
+static int64_t ZLX_CALL bf_seek64
+(
+    zlx_file_t * restrict f,
+    int64_t offset,
+    int anchor
+)
+{
+    zlx_buf_file_t * bf = (zlx_buf_file_t *) f;
+    zlx_file_status_t fs;
+    int64_t avail, rel, o;
+
+    if (bf->wlen)
+    {
+        fs = zlx_buf_file_flush(bf);
+        if (fs) return -fs;
+    }
+    avail = bf->rend - bf->rpos;
+    if (bf->ipos >= 0 && anchor != ZLXF_END)
+    {
+        rel = anchor == ZLXF_CUR ? offset : offset - (bf->ipos - avail);
+        if (rel >= -(int64_t) bf->rpos && rel <= avail)
+        {
+            bf->rpos += rel;
+            return bf->ipos - (int64_t) (bf->rend - bf->rpos);
+        }
+    }
+    if (anchor == ZLXF_CUR) offset -= avail;
+    o = zlx_seek64(bf->inner, offset, anchor);
+    if (o < 0) return o;
+    bf->rpos = bf->rend = 0;
+    bf->ipos = o;
+    bf->read_ahead = initial_read_ahead(bf);
+    return o;
+}
+
+/* bf_truncate **************************************************************/
+static zlx_file_status_t ZLX_CALL bf_truncate
+(
+    zlx_file_t * restrict f
+)
+{
+    zlx_buf_file_t * bf = (zlx_buf_file_t *) f;
+    zlx_file_status_t fs;
+
+    fs = zlx_buf_file_flush(bf);
+    if (!fs) fs = drop_read(bf);
+    if (!fs) fs = bf->inner->fcls->truncate(bf->inner);
+    return fs;
+}
+
+/* bf_close *****************************************************************/
+static zlx_file_status_t ZLX_CALL bf_close
+(
+    zlx_file_t * restrict f,
+    unsigned int flags // ZLXF_READ | ZLXF_WRITE
+)
+{
+    zlx_buf_file_t * bf = (zlx_buf_file_t *) f;
+    zlx_file_status_t fs = ZLXF_OK, cs;
+
+    if ((flags & ZLXF_WRITE)) fs = zlx_buf_file_flush(bf);
+    if ((flags & ZLXF_READ)) bf->rpos = bf->rend = 0;
+    cs = bf->inner->fcls->close(bf->inner, flags);
+    bf->base.flags &= ~(flags & (ZLXF_READ | ZLXF_WRITE));
+    return fs ? fs : cs;
+}
+
+/* bf_os_handle *************************************************************/
+static intptr_t ZLX_CALL bf_os_handle
+(
+    zlx_file_t * restrict f
+)
+{
+    return zlx_file_os_handle(((zlx_buf_file_t *) f)->inner);
+}
+
+/* bf_pread *****************************************************************/
+static ptrdiff_t ZLX_CALL bf_pread
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_buf_file_t * bf = (zlx_buf_file_t *) f;
+    zlx_file_status_t fs;
+
+    if (bf->wlen)
+    {
+        fs = zlx_buf_file_flush(bf);
+        if (fs) return -fs;
+    }
+    return zlx_raw_pread(bf->inner, data, size, offset);
+}
+
+/* bf_pwrite ****************************************************************/
+static ptrdiff_t ZLX_CALL bf_pwrite
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_buf_file_t * bf = (zlx_buf_file_t *) f;
+    zlx_file_status_t fs;
+
+    fs = zlx_buf_file_flush(bf);
+    /* the write may change data that was read ahead */
+    if (!fs) fs = drop_read(bf);
+    if (fs) return -fs;
+    return zlx_raw_pwrite(bf->inner, data, size, offset);
+}
+
+static zlx_file_class_t buf_file_class =
+{
+    bf_read,
+    bf_write,
+    bf_seek64,
+    bf_truncate,
+    bf_close,
+    "zlx/buffered",
+    bf_os_handle,
+    bf_pread,
+    bf_pwrite,
+    NULL,
+    bf_writev
+};
+
+/* zlx_buf_file_init ********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_buf_file_init
+(
+    zlx_buf_file_t * restrict bf,
+    zlx_file_t * restrict inner,
+    zlx_ma_t * restrict ma,
+    size_t size
+)
+{
+    if (!size) return ZLXF_SIZE_LIMIT;
+    bf->buf = zlx_alloc(ma, size, "file buffer");
+    if (!bf->buf) return ZLXF_NO_MEM;
+    bf->base.fcls = &buf_file_class;
+    bf->base.flags = inner->flags;
+    bf->inner = inner;
+    bf->ma = ma;
+    bf->size = size;
+    bf->rpos = bf->rend = bf->wlen = 0;
+    bf->read_ahead = initial_read_ahead(bf);
+    bf->ipos = (inner->flags & ZLXF_SEEK) ? zlx_seek64(inner, 0, ZLXF_CUR) : -1;
+    if (bf->ipos < 0) bf->ipos = -1;
+    return ZLXF_OK;
+}
+
+/* zlx_buf_file_finish ******************************************************/
+ZLX_API void ZLX_CALL zlx_buf_file_finish
+(
+    zlx_buf_file_t * restrict bf
+)
+{
+    zlx_free(bf->ma, bf->buf, bf->size);
+}
+
+/* zlx_buf_file_flush *******************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_buf_file_flush
+(
+    zlx_buf_file_t * restrict bf
+)
+{
+    zlx_file_status_t fs = ZLXF_OK;
+    size_t done;
+    ptrdiff_t w;
+
+    for (done = 0; done < bf->wlen; done += w)
+    {
+        w = zlx_write(bf->inner, bf->buf + done, bf->wlen - done);
+        if (w < 0)
+        {
+            fs = (zlx_file_status_t) -w;
+            break;
+        }
+        if (bf->ipos >= 0) bf->ipos += w;
+    }
+    if (done)
+    {
+        move_down(bf->buf, bf->buf + done, bf->wlen - done);
+        bf->wlen -= done;
+    }
+    return fs;
+}
+
+/* zlx_buf_file_peek ********************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_buf_file_peek
+(
+    zlx_buf_file_t * restrict bf,
+    uint8_t const * * data,
+    size_t min_size
+)
+{
+    zlx_file_status_t fs;
+    ptrdiff_t r;
+
+    if (!(bf->base.flags & ZLXF_READ)) return -ZLXF_BAD_OPERATION;
+    if (min_size > bf->size) return -ZLXF_SIZE_LIMIT;
+    if (bf->wlen)
+    {
+        fs = zlx_buf_file_flush(bf);
+        if (fs) return -fs;
+    }
+    while (bf->rend - bf->rpos < min_size)
+    {
+        if (bf->rpos)
+        {
+            move_down(bf->buf, bf->buf + bf->rpos, bf->rend - bf->rpos);
+            bf->rend -= bf->rpos;
+            bf->rpos = 0;
+        }
+        r = inner_read(bf, bf->buf + bf->rend, bf->size - bf->rend);
+        if (r == -ZLXF_INTERRUPTED) continue;
+        if (r < 0) return r;
+        if (!r) break;
+        bf->rend += r;
+    }
+    *data = bf->buf + bf->rpos;
+    return bf->rend - bf->rpos;
+}
+
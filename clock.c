@@ -0,0 +1,17 @@
+#include "zlx/clock.h"
+
+#if __linux__
+#include <time.h>
+#endif
+
+/* zlx_clock_mono_ns ********************************************************/
+ZLX_API uint64_t ZLX_CALL zlx_clock_mono_ns ()
+{
+#if __linux__
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) return 0;
+    return (uint64_t) ts.tv_sec * ZLX_NS_PER_SEC + (uint64_t) ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,417 @@
+#include "zlx/crc32c.h"
+#include "zlx/atomic.h"
+
+#if ZLX_AMD64 && __GNUC__
+#include <immintrin.h>
+#define HAVE_SSE42 1
+#endif
+
+/* Castagnoli polynomial, bit-reversed */
+#define POLY 0x82F63B78
+
+static uint32_t table[8][256];
+
+/* initialization state: not started, in progress, done */
+#define INIT_NONE 0
+#define INIT_BUSY 1
+#define INIT_DONE 2
+static uint32_t init_state;
+
+/* multmodp *****************************************************************/
+/**
+ *  Multiplies two polynomials modulo POLY (bit-reversed: the top bit is
+ *  the coefficient of x^0).
+ */
+static uint32_t multmodp
+(
+    uint32_t a,
+    uint32_t b
+)
+{
+    uint32_t m = (uint32_t) 1 << 31;
+    uint32_t p = 0;
+
+    for (; a; m >>= 1)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            a ^= m;
+        }
+        b = b & 1 ? (b >> 1) ^ POLY : b >> 1;
+    }
+    return p;
+}
+
+/* x8nmodp ******************************************************************/
+/**
+ *  Computes x^(8 * @a n) modulo POLY.
+ */
+static uint32_t x8nmodp
+(
+    uint64_t n
+)
+{
+    uint32_t p = (uint32_t) 1 << 31;
+    uint32_t sq = (uint32_t) 1 << 23;
+
+    for (; n; n >>= 1)
+    {
+        if (n & 1) p = multmodp(sq, p);
+        sq = multmodp(sq, sq);
+    }
+    return p;
+}
+
+/* update_table *************************************************************/
+/**
+ *  Updates a checksum (not inverted) 8 bytes at a time with lookups.
+ */
+static uint32_t update_table
+(
+    uint32_t c,
+    uint8_t const * p,
+    size_t n
+)
+{
+    uint32_t hi;
+
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        c ^= ZLX_UREAD_U32LE(p);
+        hi = ZLX_UREAD_U32LE(p + 4);
+        c = table[7][c & 0xFF] ^ table[6][(c >> 8) & 0xFF]
+            ^ table[5][(c >> 16) & 0xFF] ^ table[4][c >> 24]
+            ^ table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF]
+            ^ table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+    }
+    for (; n; --n) c = table[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c;
+}
+
+static uint32_t (* update) (uint32_t c, uint8_t const * p, size_t n) =
+    update_table;
+
+#if HAVE_SSE42
+
+/* sizes of the interleaved streams */
+#define LONG 0x2000
+#define SHORT 0x100
+
+/* shifts of a checksum over LONG and SHORT zero bytes */
+static uint32_t long_shift[4][256];
+static uint32_t short_shift[4][256];
+
+/* init_shift ***************************************************************/
+static void init_shift
+(
+    uint32_t st[4][256],
+    size_t n
+)
+{
+    uint32_t x = x8nmodp(n);
+    unsigned int i, k;
+
+    for (k = 0; k < 4; ++k)
+        for (i = 0; i < 256; ++i)
+            st[k][i] = multmodp(x, (uint32_t) i << (8 * k));
+}
+
+/* shift ********************************************************************/
+static uint32_t shift
+(
+    uint32_t st[4][256],
+    uint32_t c
+)
+{
+    return st[0][c & 0xFF] ^ st[1][(c >> 8) & 0xFF]
+        ^ st[2][(c >> 16) & 0xFF] ^ st[3][c >> 24];
+}
+
+/* update_sse42 *************************************************************/
+/**
+ *  Updates a checksum (not inverted) with the crc32 instruction.
+ *  Large inputs are split in three consecutive streams checksummed in
+ *  parallel, which hides the latency of the instruction.
+ */
+__attribute__ ((target ("sse4.2")))
+static uint32_t update_sse42
+(
+    uint32_t crc,
+    uint8_t const * p,
+    size_t n
+)
+{
+    uint64_t c0 = crc, c1, c2;
+    uint8_t const * end;
+
+    for (; n && ((uintptr_t) p & 7); --n)
+        c0 = _mm_crc32_u8((uint32_t) c0, *p++);
+    for (; n >= 3 * LONG; n -= 3 * LONG, p += 2 * LONG)
+    {
+        c1 = c2 = 0;
+        for (end = p + LONG; p < end; p += 8)
+        {
+            c0 = _mm_crc32_u64(c0, ZLX_UREAD_U64LE(p));
+            c1 = _mm_crc32_u64(c1, ZLX_UREAD_U64LE(p + LONG));
+            c2 = _mm_crc32_u64(c2, ZLX_UREAD_U64LE(p + 2 * LONG));
+        }
+        c0 = shift(long_shift, (uint32_t) c0) ^ (uint32_t) c1;
+        c0 = shift(long_shift, (uint32_t) c0) ^ (uint32_t) c2;
+    }
+    for (; n >= 3 * SHORT; n -= 3 * SHORT, p += 2 * SHORT)
+    {
+        c1 = c2 = 0;
+        for (end = p + SHORT; p < end; p += 8)
+        {
+            c0 = _mm_crc32_u64(c0, ZLX_UREAD_U64LE(p));
+            c1 = _mm_crc32_u64(c1, ZLX_UREAD_U64LE(p + SHORT));
+            c2 = _mm_crc32_u64(c2, ZLX_UREAD_U64LE(p + 2 * SHORT));
+        }
+        c0 = shift(short_shift, (uint32_t) c0) ^ (uint32_t) c1;
+        c0 = shift(short_shift, (uint32_t) c0) ^ (uint32_t) c2;
+    }
+    for (; n >= 8; n -= 8, p += 8) c0 = _mm_crc32_u64(c0, ZLX_UREAD_U64LE(p));
+    for (; n; --n) c0 = _mm_crc32_u8((uint32_t) c0, *p++);
+    return (uint32_t) c0;
+}
+
+#endif
+
+/* init *********************************************************************/
+/**
+ *  Builds the tables and picks the implementation on first use.
+ *  One thread does the work; threads racing with it wait until it is done.
+ */
+static void init ()
+{
+    uint32_t c;
+    unsigned int i, k;
+
+    if (zlx_atomic_load_u32(&init_state) == INIT_DONE) return;
+    if (!zlx_atomic_cas_u32(&init_state, INIT_NONE, INIT_BUSY))
+    {
+        while (zlx_atomic_load_u32(&init_state) != INIT_DONE);
+        return;
+    }
+    for (i = 0; i < 256; ++i)
+    {
+        c = i;
+        for (k = 0; k < 8; ++k) c = c & 1 ? (c >> 1) ^ POLY : c >> 1;
+        table[0][i] = c;
+    }
+    for (k = 1; k < 8; ++k)
+        for (i = 0; i < 256; ++i)
+            table[k][i] = (table[k - 1][i] >> 8)
+                ^ table[0][table[k - 1][i] & 0xFF];
+#if HAVE_SSE42
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        init_shift(long_shift, LONG);
+        init_shift(short_shift, SHORT);
+        update = update_sse42;
+    }
+#endif
+    zlx_atomic_store_u32(&init_state, INIT_DONE);
+}
+
+/* zlx_crc32c ***************************************************************/
+ZLX_API uint32_t ZLX_CALL zlx_crc32c
+(
+    uint32_t crc,
+    void const * data,
+    size_t size
+)
+{
+    init();
+    return ~update(~crc, data, size);
+}
+
+/* zlx_crc32c_sw ************************************************************/
+ZLX_API uint32_t ZLX_CALL zlx_crc32c_sw
+(
+    uint32_t crc,
+    void const * data,
+    size_t size
+)
+{
+    init();
+    return ~update_table(~crc, data, size);
+}
+
+/* zlx_crc32c_combine *******************************************************/
+ZLX_API uint32_t ZLX_CALL zlx_crc32c_combine
+(
+    uint32_t crc1,
+    uint32_t crc2,
+    uint64_t size2
+)
+{
+    return multmodp(x8nmodp(size2), crc1) ^ crc2;
+}
+
+/* crc_iov ******************************************************************/
+/**
+ *  Checksums the first @a n bytes held by @a iov.
+ */
+static uint32_t crc_iov
+(
+    uint32_t crc,
+    zlx_iovec_t const * iov,
+    size_t n
+)
+{
+    size_t len;
+
+    for (; n; n -= len, ++iov)
+    {
+        len = iov->size < n ? iov->size : n;
+        crc = zlx_crc32c(crc, iov->data, len);
+    }
+    return crc;
+}
+
+/* cf_read ******************************************************************/
+static ptrdiff_t ZLX_CALL cf_read
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size
+)
+{
+    zlx_crc_file_t * cf = (zlx_crc_file_t *) f;
+    ptrdiff_t r;
+
+    r = zlx_raw_read(cf->inner, data, size);
+    if (r > 0)
+    {
+        cf->read_crc = zlx_crc32c(cf->read_crc, data, r);
+        cf->read_size += r;
+    }
+    return r;
+}
+
+/* cf_write *****************************************************************/
+static ptrdiff_t ZLX_CALL cf_write
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    zlx_crc_file_t * cf = (zlx_crc_file_t *) f;
+    ptrdiff_t w;
+
+    w = zlx_raw_write(cf->inner, data, size);
+    if (w > 0)
+    {
+        cf->write_crc = zlx_crc32c(cf->write_crc, data, w);
+        cf->write_size += w;
+    }
+    return w;
+}
+
+/* cf_seek64 ****************************************************************/
+static int64_t ZLX_CALL cf_seek64
+(
+    zlx_file_t * restrict f,
+    int64_t offset,
+    int anchor
+)
+{
+    zlx_crc_file_t * cf = (zlx_crc_file_t *) f;
+    return cf->inner->fcls->seek64(cf->inner, offset, anchor);
+}
+
+/* cf_truncate **************************************************************/
+static zlx_file_status_t ZLX_CALL cf_truncate
+(
+    zlx_file_t * restrict f
+)
+{
+    zlx_crc_file_t * cf = (zlx_crc_file_t *) f;
+    return cf->inner->fcls->truncate(cf->inner);
+}
+
+/* cf_close *****************************************************************/
+static zlx_file_status_t ZLX_CALL cf_close
+(
+    zlx_file_t * restrict f,
+    unsigned int flags // ZLXF_READ | ZLXF_WRITE
+)
+{
+    zlx_crc_file_t * cf = (zlx_crc_file_t *) f;
+
+    f->flags &= ~(flags & (ZLXF_READ | ZLXF_WRITE));
+    return cf->inner->fcls->close(cf->inner, flags);
+}
+
+/* cf_readv *****************************************************************/
+static ptrdiff_t ZLX_CALL cf_readv
+(
+    zlx_file_t * restrict f,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    zlx_crc_file_t * cf = (zlx_crc_file_t *) f;
+    ptrdiff_t r;
+
+    r = zlx_raw_readv(cf->inner, iov, count);
+    if (r > 0)
+    {
+        cf->read_crc = crc_iov(cf->read_crc, iov, r);
+        cf->read_size += r;
+    }
+    return r;
+}
+
+/* cf_writev ****************************************************************/
+static ptrdiff_t ZLX_CALL cf_writev
+(
+    zlx_file_t * restrict f,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    zlx_crc_file_t * cf = (zlx_crc_file_t *) f;
+    ptrdiff_t w;
+
+    w = zlx_raw_writev(cf->inner, iov, count);
+    if (w > 0)
+    {
+        cf->write_crc = crc_iov(cf->write_crc, iov, w);
+        cf->write_size += w;
+    }
+    return w;
+}
+
+static zlx_file_class_t crc_file_class =
+{
+    cf_read,
+    cf_write,
+    cf_seek64,
+    cf_truncate,
+    cf_close,
+    "zlx/crc32c",
+    NULL,
+    NULL,
+    NULL,
+    cf_readv,
+    cf_writev
+};
+
+/* zlx_crc_file_init ********************************************************/
+ZLX_API void ZLX_CALL zlx_crc_file_init
+(
+    zlx_crc_file_t * restrict cf,
+    zlx_file_t * restrict inner
+)
+{
+    cf->base.fcls = &crc_file_class;
+    cf->base.flags = inner->flags & (ZLXF_READ | ZLXF_WRITE | ZLXF_SEEK);
+    cf->inner = inner;
+    cf->read_crc = cf->write_crc = 0;
+    cf->read_size = cf->write_size = 0;
+}
+
@@ -18,6 +18,7 @@ ZLX_API unsigned int ZLX_CALL zlx_elal_init
         mutex = zlx_alloc(ma, mutex_xfc->size, "elal mutex");
         if (!mutex) return 1;
         mutex_xfc->init(mutex);
+        if (mutex_xfc->set_info) mutex_xfc->set_info(mutex, "elal mutex");
         ea->mutex_allocated = 1;
     }
     else ea->mutex_allocated = 0;
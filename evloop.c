@@ -0,0 +1,414 @@
+#include "zlx/evloop.h"
+#include "zlx/clock.h"
+
+#if __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#define MAX_EVENTS 64
+
+/* heap_set *****************************************************************/
+static void heap_set
+(
+    zlx_evloop_t * restrict loop,
+    size_t i,
+    zlx_evtimer_t * t
+)
+{
+    loop->heap[i] = t;
+    t->heap_index = i;
+}
+
+/* heap_up ******************************************************************/
+static void heap_up
+(
+    zlx_evloop_t * restrict loop,
+    size_t i
+)
+{
+    zlx_evtimer_t * t = loop->heap[i];
+    while (i)
+    {
+        size_t p = (i - 1) >> 1;
+        if (loop->heap[p]->deadline <= t->deadline) break;
+        heap_set(loop, i, loop->heap[p]);
+        i = p;
+    }
+    heap_set(loop, i, t);
+}
+
+/* heap_down ****************************************************************/
+static void heap_down
+(
+    zlx_evloop_t * restrict loop,
+    size_t i
+)
+{
+    zlx_evtimer_t * t = loop->heap[i];
+    size_t n = loop->heap_len;
+    for (;;)
+    {
+        size_t c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && loop->heap[c + 1]->deadline < loop->heap[c]->deadline)
+            ++c;
+        if (t->deadline <= loop->heap[c]->deadline) break;
+        heap_set(loop, i, loop->heap[c]);
+        i = c;
+    }
+    heap_set(loop, i, t);
+}
+
+/* heap_remove **************************************************************/
+static void heap_remove
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evtimer_t * restrict t
+)
+{
+    size_t i = t->heap_index;
+    zlx_evtimer_t * last = loop->heap[--loop->heap_len];
+    t->heap_index = ZLX_EVTIMER_IDLE;
+    if (last == t) return;
+    heap_set(loop, i, last);
+    if (i && loop->heap[(i - 1) >> 1]->deadline > last->deadline)
+        heap_up(loop, i);
+    else heap_down(loop, i);
+}
+
+/* zlx_evtimer_start ********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evtimer_start
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evtimer_t * restrict timer,
+    uint64_t deadline
+)
+{
+    if (timer->heap_index != ZLX_EVTIMER_IDLE) heap_remove(loop, timer);
+    if (loop->heap_len == loop->heap_cap
+        && ZLX_ARRAY_REALLOC(loop->ma, loop->heap, loop->heap_cap,
+                             loop->heap_cap ? loop->heap_cap * 2 : 16,
+                             "evloop timer heap"))
+        return ZLXF_FAILED;
+    timer->deadline = deadline;
+    loop->heap[loop->heap_len] = timer;
+    heap_up(loop, loop->heap_len++);
+    return ZLXF_OK;
+}
+
+/* zlx_evtimer_stop *********************************************************/
+ZLX_API void ZLX_CALL zlx_evtimer_stop
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evtimer_t * restrict timer
+)
+{
+    if (timer->heap_index != ZLX_EVTIMER_IDLE) heap_remove(loop, timer);
+}
+
+#if __linux__
+
+/* run_timers ***************************************************************/
+static size_t run_timers
+(
+    zlx_evloop_t * restrict loop
+)
+{
+    size_t n = 0;
+    while (loop->heap_len && loop->heap[0]->deadline <= loop->now)
+    {
+        zlx_evtimer_t * t = loop->heap[0];
+        heap_remove(loop, t);
+        t->func(loop, t);
+        ++n;
+    }
+    return n;
+}
+
+/* epoll_flags **************************************************************/
+static uint32_t epoll_flags
+(
+    uint32_t interest
+)
+{
+    uint32_t e = EPOLLET;
+    if ((interest & ZLXF_READ)) e |= EPOLLIN | EPOLLRDHUP;
+    if ((interest & ZLXF_WRITE)) e |= EPOLLOUT;
+    return e;
+}
+
+/* zlx_evloop_init **********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_init
+(
+    zlx_evloop_t * restrict loop,
+    zlx_ma_t * restrict ma
+)
+{
+    struct epoll_event ev;
+
+    loop->ma = ma;
+    loop->heap = NULL;
+    loop->heap_len = 0;
+    loop->heap_cap = 0;
+    loop->now = zlx_clock_mono_ns();
+    loop->pending = NULL;
+    loop->pending_count = 0;
+    loop->wake_func = NULL;
+    loop->wake_ctx = NULL;
+    loop->stopping = 0;
+    loop->poll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+    if (loop->poll_fd < 0 || loop->wake_fd < 0
+        || epoll_ctl(loop->poll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev))
+    {
+        zlx_evloop_finish(loop);
+        return ZLXF_FAILED;
+    }
+    return ZLXF_OK;
+}
+
+/* zlx_evloop_finish ********************************************************/
+ZLX_API void ZLX_CALL zlx_evloop_finish
+(
+    zlx_evloop_t * restrict loop
+)
+{
+    if (loop->poll_fd >= 0) close(loop->poll_fd);
+    if (loop->wake_fd >= 0) close(loop->wake_fd);
+    loop->poll_fd = loop->wake_fd = -1;
+    if (loop->heap) ZLX_ARRAY_FREE(loop->ma, loop->heap, loop->heap_cap);
+    loop->heap = NULL;
+    loop->heap_len = loop->heap_cap = 0;
+}
+
+/* zlx_evloop_add ***********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_add
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src,
+    zlx_file_t * zf,
+    uint32_t interest,
+    zlx_evsrc_func_t func,
+    void * ctx
+)
+{
+    struct epoll_event ev;
+    intptr_t h;
+
+    h = zlx_file_os_handle(zf);
+    if (h < 0) return ZLXF_BAD_FILE_DESC;
+    src->file = zf;
+    src->func = func;
+    src->ctx = ctx;
+    src->fd = (int) h;
+    src->interest = interest;
+    ev.events = epoll_flags(interest);
+    ev.data.ptr = src;
+    if (epoll_ctl(loop->poll_fd, EPOLL_CTL_ADD, src->fd, &ev))
+        return ZLXF_BAD_FILE_DESC;
+    return ZLXF_OK;
+}
+
+/* zlx_evloop_modify ********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_modify
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src,
+    uint32_t interest
+)
+{
+    struct epoll_event ev;
+    ev.events = epoll_flags(interest);
+    ev.data.ptr = src;
+    if (epoll_ctl(loop->poll_fd, EPOLL_CTL_MOD, src->fd, &ev))
+        return ZLXF_BAD_FILE_DESC;
+    src->interest = interest;
+    return ZLXF_OK;
+}
+
+/* zlx_evloop_del ***********************************************************/
+ZLX_API void ZLX_CALL zlx_evloop_del
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src
+)
+{
+    struct epoll_event * ev = loop->pending;
+    int i;
+
+    epoll_ctl(loop->poll_fd, EPOLL_CTL_DEL, src->fd, NULL);
+    /* drop notifications not dispatched yet */
+    for (i = 0; i < loop->pending_count; ++i)
+        if (ev[i].data.ptr == src) ev[i].events = 0;
+}
+
+/* zlx_evloop_wakeup ********************************************************/
+ZLX_API void ZLX_CALL zlx_evloop_wakeup
+(
+    zlx_evloop_t * loop
+)
+{
+    uint64_t one = 1;
+    if (write(loop->wake_fd, &one, sizeof one) < 0) { /* counter saturated */ }
+}
+
+/* zlx_evloop_run_once ******************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_evloop_run_once
+(
+    zlx_evloop_t * restrict loop,
+    int64_t max_wait_ns
+)
+{
+    struct epoll_event ev[MAX_EVENTS];
+    int i, n, timeout_ms;
+    ptrdiff_t dispatched;
+    uint64_t v;
+
+    if (loop->heap_len)
+    {
+        uint64_t now = zlx_clock_mono_ns();
+        uint64_t d = loop->heap[0]->deadline;
+        int64_t tw = d <= now ? 0
+            : d - now > INT64_MAX ? INT64_MAX : (int64_t) (d - now);
+        if (max_wait_ns < 0 || tw < max_wait_ns) max_wait_ns = tw;
+    }
+    if (max_wait_ns < 0) timeout_ms = -1;
+    else if (max_wait_ns >= (int64_t) INT_MAX * ZLX_NS_PER_MS)
+        timeout_ms = INT_MAX;
+    else timeout_ms = (int) ((max_wait_ns + ZLX_NS_PER_MS - 1) / ZLX_NS_PER_MS);
+
+    n = epoll_wait(loop->poll_fd, ev, MAX_EVENTS, timeout_ms);
+    if (n < 0 && errno != EINTR) return -ZLXF_FAILED;
+    loop->now = zlx_clock_mono_ns();
+
+    loop->pending = ev;
+    loop->pending_count = n > 0 ? n : 0;
+    for (dispatched = 0, i = 0; i < loop->pending_count; ++i)
+    {
+        zlx_evsrc_t * src = ev[i].data.ptr;
+        uint32_t e = ev[i].events;
+        uint32_t ready = 0;
+
+        if (!e) continue;
+        if (!src)
+        {
+            if (read(loop->wake_fd, &v, sizeof v) < 0) continue;
+            if (loop->wake_func) loop->wake_func(loop, loop->wake_ctx);
+            ++dispatched;
+            continue;
+        }
+        if ((e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+            ready |= ZLXF_READ;
+        if ((e & (EPOLLOUT | EPOLLHUP | EPOLLERR))) ready |= ZLXF_WRITE;
+        src->func(loop, src, ready);
+        ++dispatched;
+    }
+    loop->pending = NULL;
+    loop->pending_count = 0;
+
+    dispatched += run_timers(loop);
+    return dispatched;
+}
+
+#else
+
+/* zlx_evloop_init **********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_init
+(
+    zlx_evloop_t * restrict loop,
+    zlx_ma_t * restrict ma
+)
+{
+    (void) loop; (void) ma;
+    return ZLXF_NO_CODE;
+}
+
+/* zlx_evloop_finish ********************************************************/
+ZLX_API void ZLX_CALL zlx_evloop_finish
+(
+    zlx_evloop_t * restrict loop
+)
+{
+    (void) loop;
+}
+
+/* zlx_evloop_add ***********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_add
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src,
+    zlx_file_t * zf,
+    uint32_t interest,
+    zlx_evsrc_func_t func,
+    void * ctx
+)
+{
+    (void) loop; (void) src; (void) zf; (void) interest; (void) func;
+    (void) ctx;
+    return ZLXF_NO_CODE;
+}
+
+/* zlx_evloop_modify ********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_modify
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src,
+    uint32_t interest
+)
+{
+    (void) loop; (void) src; (void) interest;
+    return ZLXF_NO_CODE;
+}
+
+/* zlx_evloop_del ***********************************************************/
+ZLX_API void ZLX_CALL zlx_evloop_del
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src
+)
+{
+    (void) loop; (void) src;
+}
+
+/* zlx_evloop_wakeup ********************************************************/
+ZLX_API void ZLX_CALL zlx_evloop_wakeup
+(
+    zlx_evloop_t * loop
+)
+{
+    (void) loop;
+}
+
+/* zlx_evloop_run_once ******************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_evloop_run_once
+(
+    zlx_evloop_t * restrict loop,
+    int64_t max_wait_ns
+)
+{
+    (void) loop; (void) max_wait_ns;
+    return -ZLXF_NO_CODE;
+}
+
+#endif
+
+/* zlx_evloop_run ***********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_run
+(
+    zlx_evloop_t * restrict loop
+)
+{
+    ptrdiff_t r;
+    loop->stopping = 0;
+    while (!loop->stopping)
+    {
+        r = zlx_evloop_run_once(loop, -1);
+        if (r < 0) return (zlx_file_status_t) -r;
+    }
+    return ZLXF_OK;
+}
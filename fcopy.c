@@ -0,0 +1,232 @@
+#if __linux__
+#define _GNU_SOURCE /* for copy_file_range() and splice() */
+#endif
+
+#include "zlx/fcopy.h"
+#include "zlx/fdfile.h"
+#include "zlx/clock.h"
+
+#if __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#endif
+
+/* largest amount handed to the kernel in one call */
+#define MAX_CHUNK 0x40000000
+
+/* size of the buffer used when the bounce buffer cannot be allocated */
+#define STACK_BUFFER_SIZE 0x1000
+
+#if __linux__
+
+/* kernel_copy **************************************************************/
+/**
+ *  Copies with one of the kernel methods.
+ *  @param copied [in, out]
+ *      amount copied so far; updated
+ *  @retval 0 done (copied everything or reached the end of the source)
+ *  @retval -1 method not supported for these descriptors and nothing was
+ *      copied with it
+ *  @retval >0 status of the error
+ */
+static int kernel_copy
+(
+    int method,
+    int dfd,
+    int sfd,
+    uint64_t len,
+    uint64_t * copied
+)
+{
+    uint64_t start = *copied;
+    size_t chunk;
+    ssize_t r;
+
+    while (*copied < len)
+    {
+        chunk = len - *copied < MAX_CHUNK ? len - *copied : MAX_CHUNK;
+        if (method == ZLX_FCOPY_RANGE)
+            r = copy_file_range(sfd, NULL, dfd, NULL, chunk, 0);
+        else if (method == ZLX_FCOPY_SENDFILE)
+            r = sendfile(dfd, sfd, NULL, chunk);
+        else
+            r = splice(sfd, NULL, dfd, NULL, chunk, SPLICE_F_MOVE);
+        if (r > 0) { *copied += r; continue; }
+        if (!r) return 0;
+        if (errno == EINTR) continue;
+        if (*copied == start
+            && (errno == EINVAL || errno == ENOSYS || errno == EXDEV
+                || errno == EOPNOTSUPP || errno == EBADF))
+            return -1;
+        return zlx_fd_file_status(errno);
+    }
+    return 0;
+}
+
+/* is_pipe ******************************************************************/
+static int is_pipe
+(
+    int fd
+)
+{
+    struct stat st;
+    return !fstat(fd, &st) && S_ISFIFO(st.st_mode);
+}
+
+/* pipe_copy ****************************************************************/
+/**
+ *  Splices through a pipe when neither end is one.
+ *  Data left in the pipe after a write error is lost; this is reported as
+ *  an error even if nothing was written.
+ *  @returns see kernel_copy()
+ */
+static int pipe_copy
+(
+    int dfd,
+    int sfd,
+    uint64_t len,
+    uint64_t * copied
+)
+{
+    uint64_t start = *copied;
+    size_t chunk;
+    ssize_t r, w;
+    int p[2];
+    int rc = 0;
+
+    if (pipe2(p, O_CLOEXEC)) return -1;
+    while (*copied < len)
+    {
+        chunk = len - *copied < MAX_CHUNK ? len - *copied : MAX_CHUNK;
+        r = splice(sfd, NULL, p[1], NULL, chunk, SPLICE_F_MOVE);
+        if (r < 0)
+        {
+            if (errno == EINTR) continue;
+            rc = *copied == start && (errno == EINVAL || errno == ENOSYS)
+                ? -1 : (int) zlx_fd_file_status(errno);
+            break;
+        }
+        if (!r) break;
+        while (r)
+        {
+            w = splice(p[0], NULL, dfd, NULL, r, SPLICE_F_MOVE);
+            if (w < 0)
+            {
+                if (errno == EINTR) continue;
+                /* the source data is already in the pipe: no fallback */
+                rc = zlx_fd_file_status(errno);
+                break;
+            }
+            *copied += w;
+            r -= w;
+        }
+        if (rc) break;
+    }
+    close(p[0]);
+    close(p[1]);
+    return rc;
+}
+
+#endif
+
+/* buffer_copy **************************************************************/
+static zlx_file_status_t buffer_copy
+(
+    zlx_file_t * dst,
+    zlx_file_t * src,
+    uint64_t len,
+    uint64_t * copied,
+    uint8_t * buf,
+    size_t buf_size
+)
+{
+    zlx_file_status_t fs;
+    size_t chunk, w;
+    ptrdiff_t r;
+
+    while (*copied < len)
+    {
+        chunk = len - *copied < buf_size ? (size_t) (len - *copied) : buf_size;
+        r = zlx_read(src, buf, chunk);
+        if (r <= 0) return r ? (zlx_file_status_t) -r : ZLXF_OK;
+        fs = zlx_write_full(dst, buf, r, &w);
+        *copied += w;
+        if (fs) return fs;
+    }
+    return ZLXF_OK;
+}
+
+/* zlx_file_copy ************************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_file_copy
+(
+    zlx_file_t * dst,
+    zlx_file_t * src,
+    uint64_t len,
+    zlx_ma_t * ma,
+    zlx_fcopy_stats_t * stats
+)
+{
+    uint8_t stack_buf[STACK_BUFFER_SIZE];
+    uint64_t t0, copied = 0;
+    uint8_t * mem;
+    uint8_t * buf;
+    int method = ZLX_FCOPY_NONE;
+    int rc = -1;
+    zlx_file_status_t fs = ZLXF_OK;
+
+    t0 = zlx_clock_mono_ns();
+    if (!(dst->flags & ZLXF_WRITE) || !(src->flags & ZLXF_READ))
+        rc = ZLXF_BAD_OPERATION;
+#if __linux__
+    else
+    {
+        zlx_fd_file_t * dff = zlx_fd_file_from(dst);
+        zlx_fd_file_t * sff = zlx_fd_file_from(src);
+        if (dff && sff)
+        {
+            for (method = ZLX_FCOPY_RANGE; method <= ZLX_FCOPY_SPLICE;
+                 ++method)
+            {
+                if (method == ZLX_FCOPY_SPLICE
+                    && !is_pipe(sff->fd) && !is_pipe(dff->fd))
+                    rc = pipe_copy(dff->fd, sff->fd, len, &copied);
+                else rc = kernel_copy(method, dff->fd, sff->fd, len, &copied);
+                if (rc >= 0) break;
+            }
+        }
+    }
+#endif
+    if (rc < 0)
+    {
+        method = ZLX_FCOPY_BUFFER;
+        /* page alignment lets the kernel transfer whole pages */
+        mem = zlx_alloc(ma, ZLX_FCOPY_BUFFER_SIZE + 0x1000, "copy buffer");
+        if (mem)
+        {
+            buf = (uint8_t *) (((uintptr_t) mem + 0xFFF) & ~(uintptr_t) 0xFFF);
+            fs = buffer_copy(dst, src, len, &copied, buf,
+                             ZLX_FCOPY_BUFFER_SIZE);
+            zlx_free(ma, mem, ZLX_FCOPY_BUFFER_SIZE + 0x1000);
+        }
+        else fs = buffer_copy(dst, src, len, &copied, stack_buf,
+                              sizeof(stack_buf));
+    }
+    else fs = (zlx_file_status_t) rc;
+
+    if (stats)
+    {
+        stats->bytes = copied;
+        stats->elapsed_ns = zlx_clock_mono_ns() - t0;
+        stats->method = copied ? (uint32_t) method : ZLX_FCOPY_NONE;
+        if (!stats->elapsed_ns) stats->bytes_per_sec = 0;
+        else if (copied <= UINT64_MAX / ZLX_NS_PER_SEC)
+            stats->bytes_per_sec = copied * ZLX_NS_PER_SEC / stats->elapsed_ns;
+        else stats->bytes_per_sec =
+            copied / stats->elapsed_ns * ZLX_NS_PER_SEC;
+    }
+    return fs;
+}
+
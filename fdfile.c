@@ -0,0 +1,668 @@
+#if __linux__
+#define _GNU_SOURCE /* for O_DIRECT */
+#endif
+
+#include "zlx/fdfile.h"
+#include "zlx/atomic.h"
+#include "zlx/stdarray.h"
+
+/* allocation size for a pool buffer: room to align it and to keep the
+ * pointer to the allocated block just before it */
+#define DIO_ALLOC_SIZE(pool) \
+    ((pool)->buf_size + (pool)->align - 1 + sizeof(void *))
+
+#if __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024 /* limits.h defines it only for XSI builds */
+#endif
+
+/* zlx_iovec_t is passed as is to readv() and writev() */
+typedef char iovec_layout_check
+    [(sizeof(zlx_iovec_t) == sizeof(struct iovec)
+      && offsetof(zlx_iovec_t, data) == offsetof(struct iovec, iov_base)
+      && offsetof(zlx_iovec_t, size) == offsetof(struct iovec, iov_len))
+     ? 1 : -1];
+
+/* dio_pread ****************************************************************/
+/**
+ *  Direct read. Aligned spans are read into the caller's buffer, the rest
+ *  through a pool block.
+ *  @returns the amount read (short only at the end of the file or on
+ *      error after some data was read) or a negated status
+ */
+static ptrdiff_t dio_pread
+(
+    zlx_fd_file_t * ff,
+    uint8_t * data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_dio_pool_t * pool = ff->dio;
+    size_t a = pool->align;
+    size_t done = 0, skip, span, n;
+    uint8_t * blk = NULL;
+    zlx_file_status_t fs = ZLXF_OK;
+    ssize_t r;
+
+    if (size > PTRDIFF_MAX) size = PTRDIFF_MAX;
+    while (done < size)
+    {
+        if (!((offset | (uintptr_t) data) & (a - 1)) && size - done >= a)
+        {
+            n = (size - done) & ~(a - 1);
+            r = pread(ff->fd, data, n, (off_t) offset);
+            if (r < 0) { fs = zlx_fd_file_status(errno); break; }
+            done += r;
+            data += r;
+            offset += r;
+            if ((size_t) r < n) break;
+            continue;
+        }
+        if (!blk && !(blk = zlx_dio_pool_get(pool)))
+        {
+            fs = ZLXF_NO_MEM;
+            break;
+        }
+        skip = (size_t) (offset & (a - 1));
+        span = size - done > pool->buf_size - skip
+            ? pool->buf_size : (skip + size - done + a - 1) & ~(a - 1);
+        r = pread(ff->fd, blk, span, (off_t) (offset - skip));
+        if (r < 0) { fs = zlx_fd_file_status(errno); break; }
+        if ((size_t) r <= skip) break;
+        n = r - skip < size - done ? r - skip : size - done;
+        zlx_u8a_copy(data, blk + skip, n);
+        done += n;
+        data += n;
+        offset += n;
+        if ((size_t) r < span) break;
+    }
+    if (blk) zlx_dio_pool_put(pool, blk);
+    if (done || fs == ZLXF_OK) return done;
+    return -(ptrdiff_t) fs;
+}
+
+/* dio_fill_block ***********************************************************/
+/**
+ *  Reads the block at the given offset for a read-modify-write; data past
+ *  the end of the file reads as zeroes.
+ */
+static zlx_file_status_t dio_fill_block
+(
+    zlx_fd_file_t * ff,
+    uint8_t * blk,
+    uint64_t offset
+)
+{
+    size_t a = ff->dio->align;
+    ssize_t r;
+
+    do r = pread(ff->fd, blk, a, (off_t) offset);
+    while (r < 0 && errno == EINTR);
+    if (r < 0) return zlx_fd_file_status(errno);
+    if ((size_t) r < a) zlx_u8a_set(blk + r, a - r, 0);
+    return ZLXF_OK;
+}
+
+/* dio_pwrite ***************************************************************/
+/**
+ *  Direct write. Aligned spans are written from the caller's buffer, the
+ *  rest through a pool block; partial blocks are read first and the file
+ *  is trimmed if padding a block extended it.
+ *  @returns the amount written or a negated status
+ */
+static ptrdiff_t dio_pwrite
+(
+    zlx_fd_file_t * ff,
+    uint8_t const * data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_dio_pool_t * pool = ff->dio;
+    size_t a = pool->align;
+    size_t done = 0, skip, span, n, tail;
+    uint64_t end = 0;
+    uint8_t * blk = NULL;
+    zlx_file_status_t fs = ZLXF_OK;
+    struct stat st;
+    ssize_t w;
+
+    if (size > PTRDIFF_MAX) size = PTRDIFF_MAX;
+    while (done < size)
+    {
+        if (!((offset | (uintptr_t) data) & (a - 1)) && size - done >= a)
+        {
+            n = (size - done) & ~(a - 1);
+            w = pwrite(ff->fd, data, n, (off_t) offset);
+            if (w < 0) { fs = zlx_fd_file_status(errno); break; }
+            done += w;
+            data += w;
+            offset += w;
+            if ((size_t) w < n) break;
+            continue;
+        }
+        if (!blk && !(blk = zlx_dio_pool_get(pool)))
+        {
+            fs = ZLXF_NO_MEM;
+            break;
+        }
+        skip = (size_t) (offset & (a - 1));
+        span = size - done > pool->buf_size - skip
+            ? pool->buf_size : (skip + size - done + a - 1) & ~(a - 1);
+        n = span - skip < size - done ? span - skip : size - done;
+        tail = span - skip - n;
+        if (skip) fs = dio_fill_block(ff, blk, offset - skip);
+        if (!fs && tail)
+        {
+            /* the padding must not extend the file */
+            if (fstat(ff->fd, &st)) fs = zlx_fd_file_status(errno);
+            else
+            {
+                end = (uint64_t) st.st_size > offset + n
+                    ? (uint64_t) st.st_size : offset + n;
+                if (span > a || !skip)
+                    fs = dio_fill_block(ff, blk + span - a,
+                                        offset - skip + span - a);
+            }
+        }
+        if (fs) break;
+        zlx_u8a_copy(blk + skip, data, n);
+        w = pwrite(ff->fd, blk, span, (off_t) (offset - skip));
+        if (w < 0) { fs = zlx_fd_file_status(errno); break; }
+        if ((size_t) w < span)
+        {
+            if ((size_t) w > skip)
+                done += (size_t) w - skip < n ? (size_t) w - skip : n;
+            break;
+        }
+        if (tail && end < offset - skip + span
+            && ftruncate(ff->fd, (off_t) end))
+        {
+            fs = zlx_fd_file_status(errno);
+            break;
+        }
+        done += n;
+        data += n;
+        offset += n;
+    }
+    if (blk) zlx_dio_pool_put(pool, blk);
+    if (done || fs == ZLXF_OK) return done;
+    return -(ptrdiff_t) fs;
+}
+
+/* dio_rw *******************************************************************/
+/**
+ *  Direct read or write at the file position.
+ */
+static ptrdiff_t dio_rw
+(
+    zlx_fd_file_t * ff,
+    uint8_t * data,
+    size_t size,
+    int write
+)
+{
+    off_t o;
+    ptrdiff_t n;
+
+    o = lseek(ff->fd, 0, SEEK_CUR);
+    if (o < 0) return -(ptrdiff_t) zlx_fd_file_status(errno);
+    n = write ? dio_pwrite(ff, data, size, o) : dio_pread(ff, data, size, o);
+    if (n > 0 && lseek(ff->fd, o + n, SEEK_SET) < 0)
+        return -(ptrdiff_t) zlx_fd_file_status(errno);
+    return n;
+}
+
+/* dio_rwv ******************************************************************/
+/**
+ *  Direct vectored read or write at the file position, one buffer at a
+ *  time.
+ */
+static ptrdiff_t dio_rwv
+(
+    zlx_fd_file_t * ff,
+    zlx_iovec_t const * iov,
+    size_t count,
+    int write
+)
+{
+    size_t i, total = 0;
+    ptrdiff_t n;
+
+    for (i = 0; i < count; ++i)
+    {
+        n = dio_rw(ff, iov[i].data, iov[i].size, write);
+        if (n < 0) return total ? (ptrdiff_t) total : n;
+        total += n;
+        if ((size_t) n < iov[i].size) break;
+    }
+    return total;
+}
+
+/* fdf_read *****************************************************************/
+static ptrdiff_t ZLX_CALL fdf_read
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    ssize_t r;
+
+    if (ff->dio) return dio_rw(ff, data, size, 0);
+    r = read(ff->fd, data, size);
+    return r < 0 ? -(ptrdiff_t) zlx_fd_file_status(errno) : r;
+}
+
+/* fdf_write ****************************************************************/
+static ptrdiff_t ZLX_CALL fdf_write
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    ssize_t w;
+
+    if (ff->dio) return dio_rw(ff, (uint8_t *) data, size, 1);
+    w = write(ff->fd, data, size);
+    return w < 0 ? -(ptrdiff_t) zlx_fd_file_status(errno) : w;
+}
+
+/* fdf_seek64 ***************************************************************/
+static int64_t ZLX_CALL fdf_seek64
+(
+    zlx_file_t * restrict f,
+    int64_t offset,
+    int anchor
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    off_t o;
+    int whence;
+
+    switch (anchor)
+    {
+    case ZLXF_SET: whence = SEEK_SET; break;
+    case ZLXF_CUR: whence = SEEK_CUR; break;
+    case ZLXF_END: whence = SEEK_END; break;
+    default: return -ZLXF_BAD_OPERATION;
+    }
+    if ((off_t) offset != offset) return -ZLXF_OVERFLOW;
+    o = lseek(ff->fd, (off_t) offset, whence);
+    return o < 0 ? -(int64_t) zlx_fd_file_status(errno) : (int64_t) o;
+}
+
+/* fdf_truncate *************************************************************/
+static zlx_file_status_t ZLX_CALL fdf_truncate
+(
+    zlx_file_t * restrict f
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    off_t o;
+
+    o = lseek(ff->fd, 0, SEEK_CUR);
+    if (o < 0 || ftruncate(ff->fd, o)) return zlx_fd_file_status(errno);
+    return ZLXF_OK;
+}
+
+/* fdf_close ****************************************************************/
+static zlx_file_status_t ZLX_CALL fdf_close
+(
+    zlx_file_t * restrict f,
+    unsigned int flags // ZLXF_READ | ZLXF_WRITE
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    unsigned int open_sides = f->flags & (ZLXF_READ | ZLXF_WRITE);
+
+    flags &= open_sides;
+    if (!flags) return ZLXF_OK;
+    f->flags &= ~flags;
+    if (flags != open_sides)
+    {
+        /* half-close makes sense only for sockets; for anything else the
+         * side just becomes unusable through this object */
+        if (shutdown(ff->fd, (flags & ZLXF_READ) ? SHUT_RD : SHUT_WR)
+            && errno != ENOTSOCK)
+            return zlx_fd_file_status(errno);
+        return ZLXF_OK;
+    }
+    if (!ff->own) return ZLXF_OK;
+    /* the descriptor is released even if close() reports an error, so it
+     * must not be retried on EINTR */
+    if (close(ff->fd) && errno != EINTR) return zlx_fd_file_status(errno);
+    ff->fd = -1;
+    return ZLXF_OK;
+}
+
+/* fdf_os_handle ************************************************************/
+static intptr_t ZLX_CALL fdf_os_handle
+(
+    zlx_file_t * restrict f
+)
+{
+    return ((zlx_fd_file_t *) f)->fd;
+}
+
+/* fdf_pread ****************************************************************/
+static ptrdiff_t ZLX_CALL fdf_pread
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    ssize_t r;
+
+    if ((off_t) offset < 0 || (uint64_t) (off_t) offset != offset)
+        return -ZLXF_OVERFLOW;
+    if (ff->dio) return dio_pread(ff, data, size, offset);
+    r = pread(ff->fd, data, size, (off_t) offset);
+    return r < 0 ? -(ptrdiff_t) zlx_fd_file_status(errno) : r;
+}
+
+/* fdf_pwrite ***************************************************************/
+static ptrdiff_t ZLX_CALL fdf_pwrite
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    ssize_t w;
+
+    if ((off_t) offset < 0 || (uint64_t) (off_t) offset != offset)
+        return -ZLXF_OVERFLOW;
+    if (ff->dio) return dio_pwrite(ff, data, size, offset);
+    w = pwrite(ff->fd, data, size, (off_t) offset);
+    return w < 0 ? -(ptrdiff_t) zlx_fd_file_status(errno) : w;
+}
+
+/* fdf_readv ****************************************************************/
+static ptrdiff_t ZLX_CALL fdf_readv
+(
+    zlx_file_t * restrict f,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    ssize_t r;
+
+    if (ff->dio) return dio_rwv(ff, iov, count, 0);
+    /* a short transfer is allowed, so longer vectors are just cut */
+    if (count > IOV_MAX) count = IOV_MAX;
+    r = readv(ff->fd, (struct iovec const *) iov, (int) count);
+    return r < 0 ? -(ptrdiff_t) zlx_fd_file_status(errno) : r;
+}
+
+/* fdf_writev ***************************************************************/
+static ptrdiff_t ZLX_CALL fdf_writev
+(
+    zlx_file_t * restrict f,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    zlx_fd_file_t * ff = (zlx_fd_file_t *) f;
+    ssize_t w;
+
+    if (ff->dio) return dio_rwv(ff, iov, count, 1);
+    if (count > IOV_MAX) count = IOV_MAX;
+    w = writev(ff->fd, (struct iovec const *) iov, (int) count);
+    return w < 0 ? -(ptrdiff_t) zlx_fd_file_status(errno) : w;
+}
+
+static zlx_file_class_t fd_file_class =
+{
+    fdf_read,
+    fdf_write,
+    fdf_seek64,
+    fdf_truncate,
+    fdf_close,
+    "zlx/fd",
+    fdf_os_handle,
+    fdf_pread,
+    fdf_pwrite,
+    fdf_readv,
+    fdf_writev
+};
+
+#endif
+
+/* zlx_fd_file_status *******************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_fd_file_status
+(
+    int err
+)
+{
+#if __linux__
+    switch (err)
+    {
+    case 0: return ZLXF_OK;
+    case EINTR: return ZLXF_INTERRUPTED;
+#if EWOULDBLOCK != EAGAIN
+    case EWOULDBLOCK:
+#endif
+    case EAGAIN: return ZLXF_WOULD_BLOCK;
+    case EFAULT: return ZLXF_BAD_BUFFER;
+    case EBADF: return ZLXF_BAD_FILE_DESC;
+    case EINVAL:
+    case ESPIPE:
+    case EISDIR:
+    case EPIPE:
+        return ZLXF_BAD_OPERATION;
+    case EIO: return ZLXF_IO_ERROR;
+    case ENOSPC: return ZLXF_NO_SPACE;
+    case EDQUOT: return ZLXF_QUOTA_EXHAUSTED;
+    case EFBIG: return ZLXF_SIZE_LIMIT;
+    case EOVERFLOW: return ZLXF_OVERFLOW;
+    case ENOENT:
+    case ENOTDIR:
+        return ZLXF_NOT_FOUND;
+    case EACCES:
+    case EPERM:
+    case EROFS:
+        return ZLXF_ACCESS_DENIED;
+    case EEXIST: return ZLXF_ALREADY_EXISTS;
+    case ENOMEM: return ZLXF_NO_MEM;
+    default: return ZLXF_FAILED;
+    }
+#else
+    (void) err;
+    return ZLXF_NO_CODE;
+#endif
+}
+
+/* zlx_fd_file_from *********************************************************/
+ZLX_API zlx_fd_file_t * ZLX_CALL zlx_fd_file_from
+(
+    zlx_file_t * zf
+)
+{
+#if __linux__
+    return zf->fcls == &fd_file_class ? (zlx_fd_file_t *) zf : NULL;
+#else
+    (void) zf;
+    return NULL;
+#endif
+}
+
+/* zlx_fd_file_wrap *********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_fd_file_wrap
+(
+    zlx_fd_file_t * restrict ff,
+    int fd,
+    uint32_t flags
+)
+{
+#if __linux__
+    int fl;
+
+    fl = fcntl(fd, F_GETFL);
+    if (fl < 0) return ZLXF_BAD_FILE_DESC;
+    ff->base.fcls = &fd_file_class;
+    ff->base.flags = flags & (ZLXF_READ | ZLXF_WRITE);
+    if (lseek(fd, 0, SEEK_CUR) >= 0) ff->base.flags |= ZLXF_SEEK;
+    if (fl & O_NONBLOCK) ff->base.flags |= ZLXF_NONBLOCK;
+    ff->fd = fd;
+    ff->own = (flags & ZLX_FDF_OWN) != 0;
+    ff->dio = NULL;
+    return ZLXF_OK;
+#else
+    (void) ff; (void) fd; (void) flags;
+    return ZLXF_NO_CODE;
+#endif
+}
+
+/* zlx_fd_file_open *********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_fd_file_open
+(
+    zlx_fd_file_t * restrict ff,
+    char const * restrict path,
+    uint32_t flags
+)
+{
+#if __linux__
+    int oflags = O_CLOEXEC;
+    int fd;
+    zlx_file_status_t fs;
+
+    switch (flags & (ZLXF_READ | ZLXF_WRITE))
+    {
+    case ZLXF_READ: oflags |= O_RDONLY; break;
+    case ZLXF_WRITE: oflags |= O_WRONLY; break;
+    case ZLXF_READ | ZLXF_WRITE: oflags |= O_RDWR; break;
+    default: return ZLXF_BAD_OPERATION;
+    }
+    if ((flags & ZLXF_NONBLOCK)) oflags |= O_NONBLOCK;
+    if ((flags & ZLX_FDF_CREATE)) oflags |= O_CREAT;
+    if ((flags & ZLX_FDF_EXCL)) oflags |= O_EXCL;
+    if ((flags & ZLX_FDF_TRUNCATE)) oflags |= O_TRUNC;
+    if ((flags & ZLX_FDF_APPEND)) oflags |= O_APPEND;
+    do fd = open(path, oflags, 0666);
+    while (fd < 0 && errno == EINTR);
+    if (fd < 0) return zlx_fd_file_status(errno);
+    fs = zlx_fd_file_wrap(ff, fd, (flags & (ZLXF_READ | ZLXF_WRITE))
+                          | ZLX_FDF_OWN);
+    if (fs) close(fd);
+    return fs;
+#else
+    (void) ff; (void) path; (void) flags;
+    return ZLXF_NO_CODE;
+#endif
+}
+
+/* zlx_fd_file_direct *******************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_fd_file_direct
+(
+    zlx_fd_file_t * restrict ff,
+    zlx_dio_pool_t * pool
+)
+{
+#if __linux__
+    int fl;
+
+    if (!(ff->base.flags & ZLXF_SEEK)) return ZLXF_BAD_OPERATION;
+    fl = fcntl(ff->fd, F_GETFL);
+    if (fl < 0) return zlx_fd_file_status(errno);
+    fl = pool ? fl | O_DIRECT : fl & ~O_DIRECT;
+    if (fcntl(ff->fd, F_SETFL, fl)) return zlx_fd_file_status(errno);
+    ff->dio = pool;
+    return ZLXF_OK;
+#else
+    (void) ff; (void) pool;
+    return ZLXF_NO_CODE;
+#endif
+}
+
+/* zlx_dio_pool_init ********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_dio_pool_init
+(
+    zlx_dio_pool_t * restrict pool,
+    zlx_ma_t * restrict ma,
+    size_t buf_size,
+    size_t align
+)
+{
+    unsigned int i;
+
+    if (!align) align = ZLX_DIO_ALIGN;
+    if ((align & (align - 1)) || align < sizeof(void *))
+        return ZLXF_BAD_OPERATION;
+    if (!buf_size || buf_size > (SIZE_MAX >> 1) - align * 2)
+        return ZLXF_SIZE_LIMIT;
+    pool->ma = ma;
+    pool->buf_size = (buf_size + align - 1) & ~(align - 1);
+    pool->align = align;
+    for (i = 0; i < ZLX_DIO_POOL_SLOTS; ++i) pool->slots[i] = NULL;
+    return ZLXF_OK;
+}
+
+/* zlx_dio_pool_finish ******************************************************/
+ZLX_API void ZLX_CALL zlx_dio_pool_finish
+(
+    zlx_dio_pool_t * restrict pool
+)
+{
+    unsigned int i;
+
+    for (i = 0; i < ZLX_DIO_POOL_SLOTS; ++i)
+        if (pool->slots[i])
+            zlx_free(pool->ma, ((void * *) pool->slots[i])[-1],
+                     DIO_ALLOC_SIZE(pool));
+}
+
+/* zlx_dio_pool_get *********************************************************/
+ZLX_API uint8_t * ZLX_CALL zlx_dio_pool_get
+(
+    zlx_dio_pool_t * pool
+)
+{
+    unsigned int i;
+    uint8_t * raw;
+    uint8_t * buf;
+
+    for (i = 0; i < ZLX_DIO_POOL_SLOTS; ++i)
+    {
+        buf = zlx_atomic_xchg_ptr(&pool->slots[i], NULL);
+        if (buf) return buf;
+    }
+    raw = zlx_alloc(pool->ma, DIO_ALLOC_SIZE(pool), "dio buffer");
+    if (!raw) return NULL;
+    buf = (uint8_t *) (((uintptr_t) raw + sizeof(void *) + pool->align - 1)
+                       & ~(uintptr_t) (pool->align - 1));
+    ((void * *) buf)[-1] = raw;
+    return buf;
+}
+
+/* zlx_dio_pool_put *********************************************************/
+ZLX_API void ZLX_CALL zlx_dio_pool_put
+(
+    zlx_dio_pool_t * pool,
+    uint8_t * buf
+)
+{
+    unsigned int i;
+
+    for (i = 0; i < ZLX_DIO_POOL_SLOTS; ++i)
+        if (zlx_atomic_cas_ptr(&pool->slots[i], NULL, buf)) return;
+    zlx_free(pool->ma, ((void * *) buf)[-1], DIO_ALLOC_SIZE(pool));
+}
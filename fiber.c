@@ -0,0 +1,653 @@
+#include "zlx/fiber.h"
+#include "zlx/assert.h"
+
+#if __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#if ZLX_AMD64 && __GNUC__ && __ELF__ && !_WIN32
+#define FIBER_SWITCH 1
+#endif
+
+#define ACT_NONE 0
+#define ACT_YIELD 1
+#define ACT_PARK 2
+#define ACT_EXIT 3
+
+#if FIBER_SWITCH
+/* zlxi_fiber_switch ********************************************************/
+/**
+ *  Saves the callee-saved registers and the SSE/x87 control words on the
+ *  current stack, stores the stack pointer in @a from and resumes the
+ *  context saved in @a to.
+ */
+ZLX_LOCAL void zlxi_fiber_switch
+(
+    zlx_fiber_ctx_t * from,
+    zlx_fiber_ctx_t * to
+);
+
+/* zlxi_fiber_trampoline ****************************************************/
+/**
+ *  First code executed by a new fiber: calls the function stored in r13
+ *  with the argument stored in r12.
+ */
+ZLX_LOCAL extern char zlxi_fiber_trampoline[];
+
+__asm__(
+    ".text\n"
+    ".p2align 4\n"
+    ".globl zlxi_fiber_switch\n"
+    ".hidden zlxi_fiber_switch\n"
+    ".type zlxi_fiber_switch, @function\n"
+    "zlxi_fiber_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq (%rsi), %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size zlxi_fiber_switch, .-zlxi_fiber_switch\n"
+    ".p2align 4\n"
+    ".globl zlxi_fiber_trampoline\n"
+    ".hidden zlxi_fiber_trampoline\n"
+    ".type zlxi_fiber_trampoline, @function\n"
+    "zlxi_fiber_trampoline:\n"
+    "    movq %r12, %rdi\n"
+    "    callq *%r13\n"
+    "    ud2\n"
+    ".size zlxi_fiber_trampoline, .-zlxi_fiber_trampoline\n"
+    );
+
+#else
+
+/* zlxi_fiber_switch ********************************************************/
+static void zlxi_fiber_switch
+(
+    zlx_fiber_ctx_t * from,
+    zlx_fiber_ctx_t * to
+)
+{
+    /* no fiber can be created on this target so this is never reached */
+    (void) from; (void) to;
+    ZLX_ASSERT(0);
+}
+
+#endif
+
+/* page_size ****************************************************************/
+static size_t page_size ()
+{
+#if __linux__
+    long ps = sysconf(_SC_PAGESIZE);
+    return ps > 0 ? (size_t) ps : 0x1000;
+#else
+    return 0x1000;
+#endif
+}
+
+/* switch_out ***************************************************************/
+static void switch_out
+(
+    zlx_fiber_t * f,
+    uint8_t action
+)
+{
+    f->action = action;
+    zlxi_fiber_switch(&f->ctx, &f->worker->ctx);
+}
+
+#if FIBER_SWITCH
+/* fiber_main ***************************************************************/
+static void ZLX_CALL fiber_main
+(
+    zlx_fiber_t * f
+)
+{
+    f->func(f, f->arg);
+    switch_out(f, ACT_EXIT);
+}
+
+/* fiber_alloc **************************************************************/
+/**
+ *  Allocates in one block the guard page, the stack and the fiber structure
+ *  (at the top of the stack), and prepares the initial stack frame so that
+ *  switching to the fiber starts fiber_main().
+ */
+static zlx_fiber_t * fiber_alloc
+(
+    zlx_fsched_t * restrict sched
+)
+{
+    size_t ps = page_size();
+    size_t block_size;
+    uint8_t * block;
+    uintptr_t guard;
+    zlx_fiber_t * f;
+    uint64_t * sp;
+
+    block_size = sched->stack_size + 2 * ps + sizeof(zlx_fiber_t) + 16;
+    block = zlx_alloc(sched->ma, block_size, "fiber");
+    if (!block) return NULL;
+
+    f = (zlx_fiber_t *) ((uintptr_t) (block + block_size - sizeof(zlx_fiber_t))
+                         & -(uintptr_t) 16);
+    f->block = block;
+    f->block_size = block_size;
+    guard = ((uintptr_t) block + ps - 1) & -(uintptr_t) ps;
+#if __linux__
+    f->guard = mprotect((void *) guard, ps, PROT_NONE) ? NULL : (uint8_t *) guard;
+#else
+    (void) guard;
+    f->guard = NULL;
+#endif
+
+    /* frame popped by zlxi_fiber_switch() */
+    sp = (uint64_t *) f - 8;
+    sp[0] = 0x1F80 | ((uint64_t) 0x037F << 32); /* mxcsr, x87 control word */
+    sp[1] = 0; /* r15 */
+    sp[2] = 0; /* r14 */
+    sp[3] = (uintptr_t) fiber_main; /* r13 */
+    sp[4] = (uintptr_t) f; /* r12 */
+    sp[5] = 0; /* rbx */
+    sp[6] = 0; /* rbp */
+    sp[7] = (uintptr_t) zlxi_fiber_trampoline;
+    f->ctx.sp = sp;
+    return f;
+}
+#endif
+
+/* fiber_free ***************************************************************/
+static void fiber_free
+(
+    zlx_fiber_t * f
+)
+{
+    zlx_ma_t * ma = f->sched->ma;
+    uint8_t * block = f->block;
+    size_t block_size = f->block_size;
+
+#if __linux__
+    if (f->guard) mprotect(f->guard, page_size(), PROT_READ | PROT_WRITE);
+#endif
+    zlx_free(ma, block, block_size);
+}
+
+/* poll_wake ****************************************************************/
+static void poll_wake
+(
+    zlx_fsched_t * restrict s
+)
+{
+#if __linux__
+    uint64_t one = 1;
+    if (write(s->wake_fd, &one, sizeof one) < 0) { /* already signalled */ }
+#else
+    (void) s;
+#endif
+}
+
+/* enqueue_locked ***********************************************************/
+static void enqueue_locked
+(
+    zlx_fsched_t * restrict s,
+    zlx_fiber_t * f
+)
+{
+    ZLX_DLIST_APPEND(s->run_queue, f, links);
+    if (s->idle_count) s->mth->cond.signal(s->cond);
+    else if (s->poller_active) poll_wake(s);
+}
+
+#if __linux__
+/* io_park ******************************************************************/
+static void ZLX_CALL io_park
+(
+    zlx_fiber_t * f,
+    void * ctx
+)
+{
+    zlx_fsched_t * s = f->sched;
+    zlx_mutex_xfc_t * mx = &s->mth->mutex;
+    unsigned int flags = (unsigned int) (uintptr_t) ctx;
+    struct epoll_event ev;
+
+    ev.events = EPOLLONESHOT;
+    if ((flags & ZLXF_READ)) ev.events |= EPOLLIN | EPOLLRDHUP;
+    if ((flags & ZLXF_WRITE)) ev.events |= EPOLLOUT;
+    ev.data.ptr = f;
+
+    mx->lock(s->mutex);
+    s->io_waiter_count++;
+    mx->unlock(s->mutex);
+
+    if (epoll_ctl(s->poll_fd, EPOLL_CTL_ADD, f->io_fd, &ev))
+    {
+        mx->lock(s->mutex);
+        s->io_waiter_count--;
+        f->io_ready = 0;
+        enqueue_locked(s, f);
+        mx->unlock(s->mutex);
+    }
+}
+
+/* poll_io ******************************************************************/
+/**
+ *  Blocks until some descriptor is ready and queues the fibers waiting
+ *  for them.
+ *  Must be called with the scheduler mutex unlocked; returns with the mutex
+ *  locked.
+ */
+static void poll_io
+(
+    zlx_fsched_t * restrict s
+)
+{
+    struct epoll_event ev[64];
+    zlx_fiber_t * f;
+    uint64_t v;
+    uint32_t ready;
+    int i, n;
+
+    n = epoll_wait(s->poll_fd, ev, ZLX_ITEM_COUNT(ev), -1);
+    s->mth->mutex.lock(s->mutex);
+    for (i = 0; i < n; ++i)
+    {
+        f = ev[i].data.ptr;
+        if (!f)
+        {
+            if (read(s->wake_fd, &v, sizeof v) < 0) { /* spurious */ }
+            continue;
+        }
+        epoll_ctl(s->poll_fd, EPOLL_CTL_DEL, f->io_fd, NULL);
+        ready = 0;
+        if ((ev[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+            ready |= ZLXF_READ;
+        if ((ev[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+            ready |= ZLXF_WRITE;
+        f->io_ready = ready ? ready : ZLXF_READ | ZLXF_WRITE;
+        s->io_waiter_count--;
+        enqueue_locked(s, f);
+    }
+}
+#endif
+
+/* worker_loop **************************************************************/
+static zlx_mth_status_t worker_loop
+(
+    zlx_fsched_worker_t * w
+)
+{
+    zlx_fsched_t * s = w->sched;
+    zlx_mutex_xfc_t * mx = &s->mth->mutex;
+    zlx_mth_status_t ms = ZLX_MTH_OK;
+    zlx_fiber_t * f;
+
+    if (s->worker_cpus && s->mth->thread.set_affinity)
+        s->mth->thread.set_affinity(
+            &s->worker_cpus[(size_t) (w - s->workers) % s->worker_cpu_count],
+            1);
+
+    mx->lock(s->mutex);
+    while (!s->stopping)
+    {
+        if (!zlx_dlist_is_empty(&s->run_queue))
+        {
+            f = ZLX_DLIST_ENTRY_TO_ITEM(s->run_queue.next, zlx_fiber_t, links);
+            zlx_dlist_del(&f->links);
+            mx->unlock(s->mutex);
+
+            f->worker = w;
+            f->action = ACT_NONE;
+            zlxi_fiber_switch(&w->ctx, &f->ctx);
+
+            /* the fiber is switched out; act on its request now that its
+             * stack is no longer in use */
+            switch (f->action)
+            {
+            case ACT_YIELD:
+                mx->lock(s->mutex);
+                enqueue_locked(s, f);
+                continue;
+            case ACT_PARK:
+                f->park_func(f, f->park_ctx);
+                break;
+            case ACT_EXIT:
+                fiber_free(f);
+                mx->lock(s->mutex);
+                s->fiber_count--;
+                continue;
+            }
+            mx->lock(s->mutex);
+            continue;
+        }
+
+        if (!s->fiber_count) break;
+
+#if __linux__
+        if (s->io_waiter_count && !s->poller_active)
+        {
+            s->poller_active = 1;
+            mx->unlock(s->mutex);
+            poll_io(s);
+            s->poller_active = 0;
+            continue;
+        }
+#endif
+
+        if (!s->cond)
+        {
+            /* single worker with parked fibers: nobody can unpark them */
+            ms = ZLX_MTH_DEADLOCK;
+            break;
+        }
+        s->idle_count++;
+        s->mth->cond.wait(s->cond, s->mutex);
+        s->idle_count--;
+    }
+    /* let the other idle workers notice we are done; each one passes the
+     * signal further when exiting */
+    if (s->idle_count) s->mth->cond.signal(s->cond);
+    mx->unlock(s->mutex);
+    return ms;
+}
+
+/* worker_thread ************************************************************/
+static uint_fast8_t ZLX_CALL worker_thread
+(
+    void * arg
+)
+{
+    return (uint_fast8_t) worker_loop(arg);
+}
+
+/* zlx_fsched_init **********************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_fsched_init
+(
+    zlx_fsched_t * restrict sched,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * restrict mth,
+    size_t stack_size
+)
+{
+    zlx_mth_status_t ms;
+
+    if (!mth) mth = &zlx_nosup_mth_xfc;
+    if (!stack_size) stack_size = ZLX_FIBER_DEFAULT_STACK_SIZE;
+    zlx_dlist_init(&sched->run_queue);
+    sched->ma = ma;
+    sched->mth = mth;
+    sched->mutex = NULL;
+    sched->cond = NULL;
+    sched->worker_cpus = NULL;
+    sched->worker_cpu_count = 0;
+    sched->workers = NULL;
+    sched->worker_count = 0;
+    sched->stack_size = (stack_size + 15) & -(size_t) 16;
+    sched->fiber_count = 0;
+    sched->idle_count = 0;
+    sched->io_waiter_count = 0;
+    sched->poll_fd = -1;
+    sched->wake_fd = -1;
+    sched->poller_active = 0;
+    sched->stopping = 0;
+
+    if (mth->mutex.size)
+    {
+        sched->mutex = zlx_mutex_create(ma, &mth->mutex, "fsched mutex");
+        if (!sched->mutex) return ZLX_MTH_NO_MEM;
+    }
+
+    if (mth->cond.size)
+    {
+        ms = ZLX_MTH_OK;
+        sched->cond = zlx_cond_create(ma, &mth->cond, &ms, "fsched cond");
+        if (!sched->cond && ms != ZLX_MTH_NO_SUP)
+        {
+            zlx_fsched_finish(sched);
+            return ms;
+        }
+    }
+
+#if __linux__
+    {
+        struct epoll_event ev;
+        sched->poll_fd = epoll_create1(EPOLL_CLOEXEC);
+        sched->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (sched->poll_fd < 0 || sched->wake_fd < 0
+            || epoll_ctl(sched->poll_fd, EPOLL_CTL_ADD, sched->wake_fd, &ev))
+        {
+            zlx_fsched_finish(sched);
+            return ZLX_MTH_NO_RES;
+        }
+    }
+#endif
+
+    return ZLX_MTH_OK;
+}
+
+/* zlx_fsched_finish ********************************************************/
+ZLX_API void ZLX_CALL zlx_fsched_finish
+(
+    zlx_fsched_t * restrict sched
+)
+{
+    ZLX_ASSERT(sched->fiber_count == 0);
+#if __linux__
+    if (sched->poll_fd >= 0) close(sched->poll_fd);
+    if (sched->wake_fd >= 0) close(sched->wake_fd);
+#endif
+    if (sched->cond) zlx_cond_destroy(sched->cond, sched->ma, &sched->mth->cond);
+    if (sched->mutex)
+        zlx_mutex_destroy(sched->mutex, sched->ma, &sched->mth->mutex);
+}
+
+/* zlx_fsched_spawn *********************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_fsched_spawn
+(
+    zlx_fsched_t * restrict sched,
+    zlx_fiber_func_t func,
+    void * arg
+)
+{
+#if FIBER_SWITCH
+    zlx_fiber_t * f;
+
+    f = fiber_alloc(sched);
+    if (!f) return ZLX_MTH_NO_MEM;
+    f->sched = sched;
+    f->worker = NULL;
+    f->func = func;
+    f->arg = arg;
+    f->park_func = NULL;
+    f->park_ctx = NULL;
+    f->io_fd = -1;
+    f->io_ready = 0;
+    f->action = ACT_NONE;
+
+    sched->mth->mutex.lock(sched->mutex);
+    sched->fiber_count++;
+    enqueue_locked(sched, f);
+    sched->mth->mutex.unlock(sched->mutex);
+    return ZLX_MTH_OK;
+#else
+    (void) sched; (void) func; (void) arg;
+    return ZLX_MTH_NO_SUP;
+#endif
+}
+
+/* zlx_fsched_run ***********************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_fsched_run
+(
+    zlx_fsched_t * restrict sched,
+    size_t worker_count
+)
+{
+    zlx_fsched_worker_t * w;
+    zlx_mth_status_t ms, rs;
+    size_t n, i, started;
+
+    if (!worker_count || !sched->cond) worker_count = 1;
+    if (ZLX_ARRAY_ALLOC(sched->ma, w, n, worker_count, "fsched workers"))
+        return ZLX_MTH_NO_MEM;
+    for (i = 0; i < n; ++i) w[i].sched = sched;
+    sched->workers = w;
+    sched->worker_count = n;
+
+    sched->mth->mutex.lock(sched->mutex);
+    sched->stopping = 0;
+    sched->mth->mutex.unlock(sched->mutex);
+
+    ms = ZLX_MTH_OK;
+    for (started = 1; started < n; ++started)
+    {
+        ms = sched->mth->thread.create(&w[started].tid, worker_thread,
+                                       &w[started]);
+        if (ms) break;
+    }
+    if (ms) zlx_fsched_stop(sched);
+
+    rs = worker_loop(&w[0]);
+    for (i = 1; i < started; ++i) sched->mth->thread.join(w[i].tid, NULL);
+
+    sched->workers = NULL;
+    sched->worker_count = 0;
+    ZLX_ARRAY_FREE(sched->ma, w, n);
+    return ms ? ms : rs;
+}
+
+/* zlx_fsched_stop **********************************************************/
+ZLX_API void ZLX_CALL zlx_fsched_stop
+(
+    zlx_fsched_t * restrict sched
+)
+{
+    sched->mth->mutex.lock(sched->mutex);
+    sched->stopping = 1;
+    if (sched->idle_count) sched->mth->cond.signal(sched->cond);
+    if (sched->poller_active) poll_wake(sched);
+    sched->mth->mutex.unlock(sched->mutex);
+}
+
+/* zlx_fiber_yield **********************************************************/
+ZLX_API void ZLX_CALL zlx_fiber_yield
+(
+    zlx_fiber_t * self
+)
+{
+    switch_out(self, ACT_YIELD);
+}
+
+/* zlx_fiber_park ***********************************************************/
+ZLX_API void ZLX_CALL zlx_fiber_park
+(
+    zlx_fiber_t * self,
+    zlx_fiber_park_func_t func,
+    void * ctx
+)
+{
+    self->park_func = func;
+    self->park_ctx = ctx;
+    switch_out(self, ACT_PARK);
+}
+
+/* zlx_fiber_unpark *********************************************************/
+ZLX_API void ZLX_CALL zlx_fiber_unpark
+(
+    zlx_fiber_t * fiber
+)
+{
+    zlx_fsched_t * s = fiber->sched;
+    s->mth->mutex.lock(s->mutex);
+    enqueue_locked(s, fiber);
+    s->mth->mutex.unlock(s->mutex);
+}
+
+/* zlx_fiber_wait_fd ********************************************************/
+ZLX_API int ZLX_CALL zlx_fiber_wait_fd
+(
+    zlx_fiber_t * self,
+    int fd,
+    unsigned int flags
+)
+{
+#if __linux__
+    if (fd < 0) return -ZLXF_BAD_FILE_DESC;
+    if (!(flags & (ZLXF_READ | ZLXF_WRITE))) return -ZLXF_BAD_OPERATION;
+    self->io_fd = fd;
+    self->io_ready = 0;
+    zlx_fiber_park(self, io_park, (void *) (uintptr_t) flags);
+    return self->io_ready ? (int) self->io_ready : -ZLXF_BAD_FILE_DESC;
+#else
+    (void) self; (void) fd; (void) flags;
+    return -ZLXF_NO_CODE;
+#endif
+}
+
+/* zlx_fiber_read ***********************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_fiber_read
+(
+    zlx_fiber_t * self,
+    zlx_file_t * restrict zf,
+    void * restrict data,
+    size_t size
+)
+{
+    ptrdiff_t r;
+    intptr_t h;
+    int w;
+
+    for (;;)
+    {
+        r = zlx_read(zf, data, size);
+        if (r != -ZLXF_WOULD_BLOCK) return r;
+        h = zlx_file_os_handle(zf);
+        if (h < 0) return r;
+        w = zlx_fiber_wait_fd(self, (int) h, ZLXF_READ);
+        if (w < 0) return w;
+    }
+}
+
+/* zlx_fiber_write **********************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_fiber_write
+(
+    zlx_fiber_t * self,
+    zlx_file_t * restrict zf,
+    void const * restrict data,
+    size_t size
+)
+{
+    ptrdiff_t r;
+    intptr_t h;
+    int w;
+
+    for (;;)
+    {
+        r = zlx_write(zf, data, size);
+        if (r != -ZLXF_WOULD_BLOCK) return r;
+        h = zlx_file_os_handle(zf);
+        if (h < 0) return r;
+        w = zlx_fiber_wait_fd(self, (int) h, ZLXF_WRITE);
+        if (w < 0) return w;
+    }
+}
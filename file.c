@@ -41,7 +41,12 @@ static zlx_file_class_t null_file_class =
     null_file_seek64,
     null_file_truncate,
     null_file_close,
-    "zlx/null"
+    "zlx/null",
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
 };
 
 /* zlx_null_file ************************************************************/
@@ -90,6 +95,48 @@ ZLX_API ptrdiff_t ZLX_CALL zlx_write
     return w;
 }
 
+/* zlx_pread ****************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_pread
+(
+    zlx_file_t * restrict zf,
+    void * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    ptrdiff_t r;
+
+    if (!(zf->flags & ZLXF_READ)) return -ZLXF_BAD_OPERATION;
+    if ((ptrdiff_t) size <= 0) return size ? -ZLXF_OVERFLOW : 0;
+    do
+    {
+        r = zlx_raw_pread(zf, data, size, offset);
+    }
+    while (r == -ZLXF_INTERRUPTED);
+    return r;
+}
+
+/* zlx_pwrite ***************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_pwrite
+(
+    zlx_file_t * restrict zf,
+    void const * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    ptrdiff_t w;
+
+    if (!(zf->flags & ZLXF_WRITE)) return -ZLXF_BAD_OPERATION;
+    if ((ptrdiff_t) size <= 0) return size ? -ZLXF_OVERFLOW : 0;
+    do
+    {
+        w = zlx_raw_pwrite(zf, data, size, offset);
+    }
+    while (w == -ZLXF_INTERRUPTED);
+    return w;
+}
+
 /* zlx_write_full ***********************************************************/
 ZLX_API zlx_file_status_t ZLX_CALL zlx_write_full
 (
@@ -104,7 +151,7 @@ ZLX_API zlx_file_status_t ZLX_CALL zlx_write_full
     zlx_file_status_t fs = ZLXF_OK;
     for (z = 0; z < size; z += r)
     {
-        r = zlx_write(zf, data, size);
+        r = zlx_write(zf, (uint8_t const *) data + z, size - z);
         if (r < 0) 
         {
             fs = (zlx_file_status_t) -r;
@@ -115,6 +162,147 @@ ZLX_API zlx_file_status_t ZLX_CALL zlx_write_full
     return fs;
 }
 
+/* iov_total ****************************************************************/
+/**
+ *  Returns the total size or -1 if it does not fit in ptrdiff_t.
+ */
+static ptrdiff_t iov_total
+(
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    size_t i, t;
+    for (t = 0, i = 0; i < count; ++i)
+    {
+        if (iov[i].size > (size_t) PTRDIFF_MAX - t) return -1;
+        t += iov[i].size;
+    }
+    return t;
+}
+
+/* zlx_raw_readv ************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_raw_readv
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    ptrdiff_t r, t;
+    size_t i;
+
+    if (zf->fcls->readv) return zf->fcls->readv(zf, iov, count);
+    for (t = 0, i = 0; i < count; ++i)
+    {
+        if (!iov[i].size) continue;
+        r = zlx_raw_read(zf, iov[i].data, iov[i].size);
+        if (r < 0) return t ? t : r;
+        t += r;
+        if ((size_t) r < iov[i].size) break;
+    }
+    return t;
+}
+
+/* zlx_raw_writev ***********************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_raw_writev
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    ptrdiff_t w, t;
+    size_t i;
+
+    if (zf->fcls->writev) return zf->fcls->writev(zf, iov, count);
+    for (t = 0, i = 0; i < count; ++i)
+    {
+        if (!iov[i].size) continue;
+        w = zlx_raw_write(zf, iov[i].data, iov[i].size);
+        if (w < 0) return t ? t : w;
+        t += w;
+        if ((size_t) w < iov[i].size) break;
+    }
+    return t;
+}
+
+/* zlx_readv ****************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_readv
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    ptrdiff_t r;
+
+    if (!(zf->flags & ZLXF_READ)) return -ZLXF_BAD_OPERATION;
+    r = iov_total(iov, count);
+    if (r <= 0) return r ? -ZLXF_OVERFLOW : 0;
+    do
+    {
+        r = zlx_raw_readv(zf, iov, count);
+    }
+    while (r == -ZLXF_INTERRUPTED);
+    return r;
+}
+
+/* zlx_writev ***************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_writev
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t const * iov,
+    size_t count
+)
+{
+    ptrdiff_t w;
+
+    if (!(zf->flags & ZLXF_WRITE)) return -ZLXF_BAD_OPERATION;
+    w = iov_total(iov, count);
+    if (w <= 0) return w ? -ZLXF_OVERFLOW : 0;
+    do
+    {
+        w = zlx_raw_writev(zf, iov, count);
+    }
+    while (w == -ZLXF_INTERRUPTED);
+    return w;
+}
+
+/* zlx_writev_full **********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_writev_full
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t * iov,
+    size_t count,
+    size_t * written
+)
+{
+    zlx_iovec_t saved;
+    size_t z, skip;
+    ptrdiff_t w;
+    zlx_file_status_t fs = ZLXF_OK;
+
+    /* skip counts the bytes written from the first remaining buffer on */
+    for (z = 0, skip = 0;; skip += w, z += w)
+    {
+        for (; count && iov->size <= skip; ++iov, --count) skip -= iov->size;
+        if (!count) break;
+        saved = *iov;
+        iov->data = (uint8_t *) iov->data + skip;
+        iov->size -= skip;
+        w = zlx_writev(zf, iov, count);
+        *iov = saved;
+        if (w < 0) 
+        {
+            fs = (zlx_file_status_t) -w;
+            break;
+        }
+    }
+    if (written) *written = z;
+    return fs;
+}
+
 /* null_file_read ***********************************************************/
 static ptrdiff_t ZLX_CALL null_file_read
 (
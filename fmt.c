@@ -2,9 +2,127 @@
 #include "zlx/stdarray.h"
 #include "zlx/clconv.h"
 #include "zlx/fmt.h"
+#include "zlx/atomic.h"
 
 ZLX_API char const zlx_digit_char_table[37] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
+/* two-digit decimal strings for 00 - 99 */
+static char const dec_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static uint64_t const pow10_table[20] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+/* bit_len ******************************************************************/
+/**
+ *  Returns the number of significant bits of @a v; 1 for 0.
+ */
+static unsigned int bit_len
+(
+    uint64_t v
+)
+{
+#if __GNUC__
+    return 64 - __builtin_clzll(v | 1);
+#else
+    unsigned int n;
+    for (n = 1; v >> n; ++n);
+    return n;
+#endif
+}
+
+/* dec_len ******************************************************************/
+/**
+ *  Returns the number of decimal digits of @a v; 1 for 0.
+ */
+static unsigned int dec_len
+(
+    uint64_t v
+)
+{
+    /* 1233 / 4096 is just above log10(2) */
+    unsigned int n = (bit_len(v) * 1233) >> 12;
+    return n + ((v | 1) >= pow10_table[n]);
+}
+
+/* put_pair *****************************************************************/
+static uint8_t * put_pair
+(
+    uint8_t * end,
+    uint32_t v
+)
+{
+    end -= 2;
+    end[0] = dec_pairs[2 * v];
+    end[1] = dec_pairs[2 * v + 1];
+    return end;
+}
+
+/* put_dec ******************************************************************/
+/**
+ *  Writes the decimal digits of @a v right to left, ending at @a end.
+ *  Chunks of 8 digits are split off with one 64-bit division, then the
+ *  digits come in pairs from 32-bit arithmetic.
+ */
+static void put_dec
+(
+    uint8_t * end,
+    uint64_t v
+)
+{
+    uint32_t lo;
+
+    while (v >= 100000000)
+    {
+        lo = (uint32_t) (v % 100000000);
+        v /= 100000000;
+        end = put_pair(end, lo % 100);
+        lo /= 100;
+        end = put_pair(end, lo % 100);
+        lo /= 100;
+        end = put_pair(end, lo % 100);
+        end = put_pair(end, lo / 100);
+    }
+    for (lo = (uint32_t) v; lo >= 100; lo /= 100)
+        end = put_pair(end, lo % 100);
+    if (lo >= 10) put_pair(end, lo);
+    else end[-1] = (uint8_t) ('0' + lo);
+}
+
+/* put_hex8 *****************************************************************/
+/**
+ *  Writes the 8 hex digits of @a v.
+ *  The nibbles are spread one per byte, lowest nibble in the lowest byte,
+ *  and turned to ASCII all at once before a big endian store.
+ */
+static void put_hex8
+(
+    uint8_t * p,
+    uint32_t v
+)
+{
+    uint64_t x = v;
+
+    x = ((x & 0xFFFF0000) << 16) | (x & 0xFFFF);
+    x = ((x & 0x0000FF000000FF00) << 8) | (x & 0x000000FF000000FF);
+    x = ((x & 0x00F000F000F000F0) << 4) | (x & 0x000F000F000F000F);
+    /* bytes holding 10 - 15 get the extra distance from '9' to 'A' */
+    x += 0x3030303030303030
+        + (((x + 0x0606060606060606) >> 4) & 0x0101010101010101) * 7;
+    ZLX_UWRITE_U64BE(p, x);
+}
+
 /* zlx_u64_to_str ***********************************************************/
 ZLX_API size_t ZLX_CALL zlx_u64_to_str
 (
@@ -16,7 +134,28 @@ ZLX_API size_t ZLX_CALL zlx_u64_to_str
     uint_fast8_t sep
 )
 {
-    unsigned int g, a, b, i;
+    unsigned int g, a, b, i, n;
+    uint8_t hex[16];
+
+    if (radix == 10 || radix == 16)
+    {
+        n = radix == 10 ? dec_len(value) : (bit_len(value) + 3) >> 2;
+        i = n < width ? width : n;
+        /* fast paths only when no separator would be inserted */
+        if (!group || i < group)
+        {
+            zlx_u8a_set(str, i - n, '0');
+            if (radix == 10) put_dec(str + i, value);
+            else
+            {
+                put_hex8(hex, (uint32_t) (value >> 32));
+                put_hex8(hex + 8, (uint32_t) value);
+                zlx_u8a_copy(str + i - n, hex + 16 - n, n);
+            }
+            str[i] = 0;
+            return i;
+        }
+    }
 
 #if _DEBUG
     if (radix < 2 || radix > 36)
@@ -101,6 +240,99 @@ ZLX_API size_t ZLX_CALL zlx_i64_to_str
     return w + zlx_u64_to_str(str, (uint64_t) value, radix, width, group, sep);
 }
 
+/*  BYTES  */
+/**
+ *  64-bit word with all bytes set to @a _b.
+ */
+#define BYTES(_b) (0x0101010101010101ULL * (_b))
+
+/* byte_range ***************************************************************/
+/**
+ *  Flags the bytes of @a x that are in range @a lo - @a hi (at most 0x7F):
+ *  returns 0x80 in each such byte and 0 in the others.
+ *  The high bit is handled apart so the additions never carry.
+ */
+static uint64_t byte_range
+(
+    uint64_t x,
+    uint8_t lo,
+    uint8_t hi
+)
+{
+    uint64_t y = x & BYTES(0x7F);
+    return (y + BYTES(0x80 - lo)) & ~(y + BYTES(0x7F - hi)) & ~x & BYTES(0x80);
+}
+
+/* lead_len *****************************************************************/
+/**
+ *  Returns the number of leading flagged bytes (in memory order) of a mask
+ *  returned by byte_range().
+ */
+static unsigned int lead_len
+(
+    uint64_t m
+)
+{
+#if __GNUC__
+    m = ~m & BYTES(0x80);
+    return m ? (unsigned int) __builtin_ctzll(m) >> 3 : 8;
+#else
+    unsigned int n;
+    for (n = 0; n < 8 && ((m >> (8 * n)) & 0x80); ++n);
+    return n;
+#endif
+}
+
+/* dec_chunk ****************************************************************/
+/**
+ *  Parses the decimal digits among the 8 bytes at @a p.
+ *  The digits are moved to the end of the word, behind zero bytes acting as
+ *  leading zeroes, and combined pairwise: 2, 4 then 8 digits per lane.
+ *  @returns number of digits parsed
+ */
+static unsigned int dec_chunk
+(
+    uint8_t const * p,
+    uint64_t * out
+)
+{
+    uint64_t x = ZLX_UREAD_U64LE(p);
+    unsigned int n = lead_len(byte_range(x, '0', '9'));
+
+    *out = 0;
+    if (!n) return 0;
+    x = (x & BYTES(0x0F)) << (64 - 8 * n);
+    x = (x * 10 + (x >> 8)) & 0x00FF00FF00FF00FF;
+    x = (x * 100 + (x >> 16)) & 0x0000FFFF0000FFFF;
+    *out = (x * 10000 + (x >> 32)) & 0xFFFFFFFF;
+    return n;
+}
+
+/* hex_chunk ****************************************************************/
+/**
+ *  Parses the hex digits among the 8 bytes at @a p, the same way as
+ *  dec_chunk().
+ *  @returns number of digits parsed
+ */
+static unsigned int hex_chunk
+(
+    uint8_t const * p,
+    uint64_t * out
+)
+{
+    uint64_t x = ZLX_UREAD_U64LE(p);
+    uint64_t letters = byte_range(x | BYTES(0x20), 'a', 'f');
+    unsigned int n = lead_len(byte_range(x, '0', '9') | letters);
+
+    *out = 0;
+    if (!n) return 0;
+    x = ((x & BYTES(0x0F)) + (letters >> 7) * 9) << (64 - 8 * n);
+    x = ((x << 4) | (x >> 8)) & 0x00FF00FF00FF00FF;
+    x = ((x << 8) | (x >> 16)) & 0x0000FFFF0000FFFF;
+    *out = ((x << 16) | (x >> 32)) & 0xFFFFFFFF;
+    return n;
+}
+
 /* zlx_u64_from_str *********************************************************/
 ZLX_API uint_fast8_t ZLX_CALL zlx_u64_from_str
 (
@@ -112,8 +344,9 @@ ZLX_API uint_fast8_t ZLX_CALL zlx_u64_from_str
 )
 {
     size_t i;
-    uint64_t v;
-    uint_fast8_t r = 0;
+    uint64_t v, w, lim;
+    unsigned int n;
+    uint_fast8_t r = 0, rem;
 
     if (len == 0) return ZLX_U64_STOP;
     i = 0;
@@ -134,10 +367,33 @@ ZLX_API uint_fast8_t ZLX_CALL zlx_u64_from_str
         }
     }
 
-    for (v = 0; i < len; ++i)
+    /* 8 digits at a time while the result cannot overflow; the loop below
+     * takes the rest */
+    v = 0;
+    if (radix == 10)
+        while (len - i >= 8 && v < 100000000000ULL)
+        {
+            n = dec_chunk(str + i, &w);
+            v = v * pow10_table[n] + w;
+            i += n;
+            if (n < 8) break;
+        }
+    else if (radix == 16)
+        while (len - i >= 8 && !(v >> 32))
+        {
+            n = hex_chunk(str + i, &w);
+            v = (v << (4 * n)) + w;
+            i += n;
+            if (n < 8) break;
+        }
+
+    /* v * radix + digit overflows iff v > lim or v == lim and digit > rem */
+    lim = radix == 10 ? UINT64_MAX / 10
+        : radix == 16 ? UINT64_MAX / 16 : UINT64_MAX / radix;
+    rem = (uint_fast8_t) (UINT64_MAX - lim * radix);
+    for (; i < len; ++i)
     {
         uint8_t digit;
-        uint64_t w;
         if (str[i] >= '0' && str[i] <= '9') digit = str[i] - '0';
         else
         {
@@ -146,17 +402,135 @@ ZLX_API uint_fast8_t ZLX_CALL zlx_u64_from_str
             else digit = radix;
         }
         if (digit >= radix) { r = ZLX_U64_STOP; break; }
-        w = v * radix;
-        if (w / radix != v) { r = ZLX_U64_OVERFLOW; break; }
-        v = w + digit;
-        if (v < w) { r = ZLX_U64_OVERFLOW; break; }
+        if (v >= lim && (v > lim || digit > rem))
+        {
+            r = ZLX_U64_OVERFLOW;
+            break;
+        }
+        v = v * radix + digit;
     }
     *value = v;
     if (used_len) *used_len = i;
     return r;
 }
-/* zlx_vfmt *****************************************************************/
-#define CMD_NONE 0
+
+/* zlx_u64_list_from_str ****************************************************/
+ZLX_API uint_fast8_t ZLX_CALL zlx_u64_list_from_str
+(
+    uint8_t const * str,
+    size_t len,
+    uint_fast8_t radix,
+    uint8_t sep,
+    uint64_t * values,
+    size_t max_count,
+    size_t * count,
+    size_t * used_len
+)
+{
+    size_t i, n, l;
+    uint64_t v;
+    uint_fast8_t r;
+
+    for (i = n = 0;; ++i)
+    {
+        if (n == max_count || i == len) { r = ZLX_U64_STOP; break; }
+        r = zlx_u64_from_str(str + i, len - i, radix, &v, &l);
+        i += l;
+        if (r == ZLX_U64_OVERFLOW) break;
+        if (!l || (r && str[i] != sep)) { r = ZLX_U64_STOP; break; }
+        values[n++] = v;
+        if (!r) break;
+    }
+    *count = n;
+    if (used_len) *used_len = i;
+    return r;
+}
+
+/* fmt_out_t ****************************************************************/
+/**
+ *  Staging buffer gathering the output of zlx_vfmt_flags().
+ */
+typedef struct fmt_out_s fmt_out_t;
+struct fmt_out_s
+{
+    zlx_write_func_t writer;
+    void * writer_context;
+    size_t len;
+    uint8_t unbuffered;
+    uint8_t data[0x400];
+};
+
+/* out_flush ****************************************************************/
+/**
+ *  Passes the staged data to the writer.
+ *  @returns 0 on success, non-zero on write error
+ */
+static int out_flush
+(
+    fmt_out_t * o
+)
+{
+    size_t n = o->len;
+
+    o->len = 0;
+    return n && o->writer(o->writer_context, o->data, n) != (ptrdiff_t) n;
+}
+
+/* out_write ****************************************************************/
+/**
+ *  Stages data; pieces larger than the staging buffer go to the writer.
+ *  @returns 0 on success, non-zero on write error
+ */
+static int out_write
+(
+    fmt_out_t * o,
+    uint8_t const * data,
+    size_t len
+)
+{
+    if (!len) return 0;
+    if (sizeof(o->data) - o->len < len && out_flush(o)) return 1;
+    if (o->unbuffered || len >= sizeof(o->data))
+        return o->writer(o->writer_context, data, len) != (ptrdiff_t) len;
+    zlx_u8a_copy(o->data + o->len, data, len);
+    o->len += len;
+    return 0;
+}
+
+/* out_pad ******************************************************************/
+/**
+ *  Writes spaces.
+ *  @returns 0 on success, non-zero on write error
+ */
+static int out_pad
+(
+    fmt_out_t * o,
+    size_t n
+)
+{
+    static uint8_t const empty_spaces[] =  // what are we living for?
+        "                                                                ";
+    size_t clen;
+
+    for (; n; n -= clen)
+    {
+        if (o->unbuffered)
+        {
+            clen = n < sizeof(empty_spaces) - 1 ? n : sizeof(empty_spaces) - 1;
+            if (o->writer(o->writer_context, empty_spaces, clen)
+                != (ptrdiff_t) clen)
+                return 1;
+            continue;
+        }
+        if (o->len == sizeof(o->data) && out_flush(o)) return 1;
+        clen = sizeof(o->data) - o->len;
+        if (clen > n) clen = n;
+        zlx_u8a_set(o->data + o->len, clen, ' ');
+        o->len += clen;
+    }
+    return 0;
+}
+
 #define CMD_BUF 1
 #define CMD_STR 2
 #define CMD_CONV 3
@@ -166,329 +540,437 @@ ZLX_API uint_fast8_t ZLX_CALL zlx_u64_from_str
 #define STR_ESC_NONE 0
 #define STR_ESC_C 1
 #define STR_ESC_HEX 2
-ZLX_API unsigned int ZLX_CALL zlx_vfmt
+
+/* fmt_parse ****************************************************************/
+/**
+ *  Parses the literal text or the directive at @a *fp and advances it.
+ *  @retval 0 success
+ *  @retval ZLX_FMT_MALFORMED bad directive
+ */
+static unsigned int fmt_parse
 (
-    zlx_write_func_t writer,
-    void * writer_context,
+    uint8_t const * * fp,
+    zlx_fmt_op_t * op
+)
+{
+    uint8_t const * f = *fp;
+    uint32_t w;
+
+    if (*f != '$')
+    {
+        while (*f && *f != '$') f++;
+        op->type = 0;
+        op->data = *fp;
+        op->len = f - *fp;
+        *fp = f;
+        return 0;
+    }
+    op->data = NULL;
+    op->len = SIZE_MAX;
+    op->width = 0;
+    op->align = ALIGN_DEFAULT;
+    op->sign_mode = ZLX_SIGN_NEG;
+    op->radix = 0;
+    op->esc = STR_ESC_NONE;
+    op->zero_fill = 0;
+    op->group_len = 64;
+    op->sep = '_';
+    op->prec_args = 0;
+    op->prec_arg = 0;
+    for (f++;; ++f)
+    {
+        switch (*f)
+        {
+        case '0':
+            op->zero_fill = 1;
+            continue;
+        case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            for (w = 0; *f >= '0' && *f <= '9'; ++f) w = w * 10 + *f - '0';
+            op->width = w;
+            --f;
+            break;
+        case 'c':
+            if (op->align == ALIGN_DEFAULT) op->align = ALIGN_LEFT;
+            goto l_arg;
+        case 'b': case 'w': case 'd': case 'q':
+        case 'i': case 'l': case 'h': case 'z': case 'p':
+            op->sign_mode = ZLX_NO_SIGN;
+            goto l_int;
+        case 'P':
+            if (op->radix == 0) op->radix = 16;
+            /* fall through */
+        case 'B': case 'W': case 'D': case 'Q':
+        case 'I': case 'L': case 'H': case 'Z':
+        l_int:
+            if (op->radix == 0) op->radix = 10;
+            if (op->align == ALIGN_DEFAULT) op->align = ALIGN_RIGHT;
+            /* fall through */
+        case 's':
+        l_arg:
+            op->type = *f;
+            *fp = f + 1;
+            return 0;
+        case 'y':
+            op->data = (uint8_t const *) "0b";
+            /* fall through */
+        case 'Y':
+            op->radix = 2;
+            break;
+        case 'o':
+            op->data = (uint8_t const *) "0o";
+            /* fall through */
+        case 'O':
+            op->radix = 8;
+            break;
+        case 'n':
+            op->data = (uint8_t const *) "0d";
+            /* fall through */
+        case 'N':
+            op->radix = 10;
+            break;
+        case 'x':
+            op->data = (uint8_t const *) "0x";
+            /* fall through */
+        case 'X':
+            op->esc = STR_ESC_HEX;
+            op->radix = 16;
+            break;
+        case '.':
+            ++f;
+            if (*f == '*')
+            {
+                ++op->prec_args;
+                op->prec_arg = 1;
+            }
+            else
+            {
+                for (op->len = 0; *f >= '0' && *f <= '9'; ++f)
+                    op->len = op->len * 10 + *f - '0';
+                op->prec_arg = 0;
+                --f;
+            }
+            break;
+        case '<':
+            op->align = ALIGN_LEFT;
+            break;
+        case '>':
+            op->align = ALIGN_RIGHT;
+            break;
+        case '/':
+            if (f[1] < '0' || f[1] > '9' ||
+                f[2] == 0) return ZLX_FMT_MALFORMED;
+            op->group_len = f[1] - '0';
+            op->sep = f[2];
+            f += 2;
+            break;
+        case 'e':
+            op->esc = STR_ESC_C;
+            break;
+        default:
+            return ZLX_FMT_MALFORMED;
+        }
+    }
+}
+
+/* fmt_exec_op **************************************************************/
+/**
+ *  Outputs a literal or an argument.
+ *  @param buffer
+ *      scratch buffer of 0x400 bytes
+ */
+static unsigned int fmt_exec_op
+(
+    fmt_out_t * out,
+    zlx_fmt_op_t const * op,
+    va_list * va,
     zlx_write_func_t width_func,
     void * width_context,
-    char const * fmt,
-    va_list va
+    uint8_t * buffer
 )
 {
-    //static uint8_t const nul = 0;
-    static uint8_t const empty_spaces[] =  // what are we living for?
-        "                                                                ";
-    uint8_t buffer[0x400];
-    uint8_t const * f = (uint8_t const *) fmt;
     uint8_t const * str = NULL;
-    uint8_t const * num_pfx;
     zlx_clconv_func_t conv = NULL;
     void * conv_ctx;
-    uint_fast8_t sep;
-    uint_fast8_t group_len;
-    char zero_fill;
-    char align_mode;
-    char sign_mode;
-    size_t z, req_width, arg_len, prec;
-    ptrdiff_t arg_width;
+    size_t arg_len, prec, ofs, in_len, out_len;
+    ptrdiff_t arg_width = 0;
     uint32_t ucp;
-    uint8_t radix;
     int64_t i64;
     char cmd;
-    char esc_mode;
-    size_t ofs, in_len, out_len;
-    uint_fast8_t cc;
+    uint_fast8_t cc, n;
     zlx_clconv_c_escape_t cectx;
 
-    for (;;)
+    if (!op->type)
+        return out_write(out, op->data, op->len) ? ZLX_FMT_WRITE_ERROR : 0;
+    prec = op->len;
+    for (n = op->prec_args; n; --n)
     {
-        uint8_t const * sfmt = f;
-
-        while (*f && *f != '$') f++;
-        z = f - sfmt;
-        if (z && writer(writer_context, sfmt, z) != (ptrdiff_t) z)
-            return ZLX_FMT_WRITE_ERROR;
-        if (*f == 0) break;
-        zero_fill = 0;
-        req_width = 0;
-        sign_mode = ZLX_SIGN_NEG;
-        align_mode = ALIGN_DEFAULT;
-        esc_mode = STR_ESC_NONE;
-        radix = 0;
-        prec = SIZE_MAX;
-        num_pfx = NULL;
-        sep = '_';
-        group_len = 64;
-        arg_width = 0;
-        arg_len = 0;
-        f++;
-        for (cmd = CMD_NONE; cmd == CMD_NONE; ++f)
+        arg_len = va_arg(*va, size_t);
+        if (op->prec_arg) prec = arg_len;
+    }
+    switch (op->type)
+    {
+    case 'c':
+        ucp = va_arg(*va, uint32_t);
+        if (!zlx_ucp_is_valid(ucp)) return ZLX_FMT_MALFORMED;
+        arg_len = zlxi_ucp_to_utf8(ucp, buffer);
+        arg_width = width_func(width_context, buffer, arg_len);
+        if (arg_width < 0) return ZLX_FMT_WIDTH_ERROR;
+        cmd = CMD_BUF;
+        break;
+    case 'b': i64 = (uint8_t) va_arg(*va, int); goto l_int;
+    case 'B': i64 = (int8_t) va_arg(*va, int); goto l_int;
+    case 'w': i64 = (uint16_t) va_arg(*va, int); goto l_int;
+    case 'W': i64 = (int16_t) va_arg(*va, int); goto l_int;
+    case 'd': i64 = va_arg(*va, uint32_t); goto l_int;
+    case 'D': i64 = va_arg(*va, int32_t); goto l_int;
+    case 'q': i64 = va_arg(*va, uint64_t); goto l_int;
+    case 'Q': i64 = va_arg(*va, int64_t); goto l_int;
+    case 'i': i64 = va_arg(*va, unsigned int); goto l_int;
+    case 'I': i64 = va_arg(*va, signed int); goto l_int;
+    case 'l': i64 = va_arg(*va, unsigned long int); goto l_int;
+    case 'L': i64 = va_arg(*va, signed long int); goto l_int;
+    case 'h': i64 = (unsigned short int) va_arg(*va, int); goto l_int;
+    case 'H': i64 = (signed short int) va_arg(*va, int); goto l_int;
+    case 'z': i64 = va_arg(*va, size_t); goto l_int;
+    case 'Z': i64 = va_arg(*va, ptrdiff_t); goto l_int;
+    case 'p': i64 = va_arg(*va, uintptr_t); goto l_int;
+    case 'P': i64 = va_arg(*va, intptr_t);
+    l_int:
+        arg_len = zlx_i64_to_str(buffer, i64, op->sign_mode, op->radix,
+                                 op->data, op->zero_fill ? op->width : 1,
+                                 op->group_len, op->sep);
+        arg_width = width_func(width_context, buffer, arg_len);
+        if (arg_width < 0) return ZLX_FMT_WIDTH_ERROR;
+        cmd = CMD_BUF;
+        break;
+    case 's':
+        str = va_arg(*va, uint8_t const *);
+        if (prec == SIZE_MAX) arg_len = zlx_u8a_zlen(str);
+        else arg_len = prec;
+        switch (op->esc)
         {
-            switch (*f)
-            {
-            case '0':
-                zero_fill = 1;
-                continue;
-            case '1': case '2': case '3': case '4':
-            case '5': case '6': case '7': case '8': case '9':
-                for (req_width = 0; *f >= '0' && *f <= '9'; ++f)
-                    req_width = req_width * 10 + *f - '0';
-                --f;
-                break;
-            case 'c':
-                ucp = va_arg(va, uint32_t);
-                if (!zlx_ucp_is_valid(ucp)) return ZLX_FMT_MALFORMED;
-                arg_len = zlxi_ucp_to_utf8(ucp, buffer);
-                arg_width = width_func(width_context, buffer, arg_len);
-                if (arg_width < 0) return ZLX_FMT_WIDTH_ERROR;
-                cmd = CMD_BUF;
-                if (align_mode == ALIGN_DEFAULT) align_mode = ALIGN_LEFT;
-                break;
-            case 'b':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = (uint8_t) va_arg(va, int);
-            l_int:
-                if (radix == 0) radix = 10;
-                arg_len = zlx_i64_to_str(buffer, i64, sign_mode, radix, num_pfx,
-                                zero_fill ? req_width : 1, group_len, sep);
-                arg_width = width_func(width_context, buffer, arg_len);
-                if (arg_width < 0) return ZLX_FMT_WIDTH_ERROR;
-                cmd = CMD_BUF;
-                if (align_mode == ALIGN_DEFAULT) align_mode = ALIGN_RIGHT;
-                break;
-            case 'B':
-                i64 = (int8_t) va_arg(va, int);
-                goto l_int;
-            case 'w':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = (uint16_t) va_arg(va, int);
-                goto l_int;
-            case 'W':
-                i64 = (int16_t) va_arg(va, int);
-                goto l_int;
-            case 'd':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = va_arg(va, uint32_t);
-                goto l_int;
-            case 'D':
-                i64 = va_arg(va, int32_t);
-                goto l_int;
-            case 'q':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = va_arg(va, uint64_t);
-                goto l_int;
-            case 'Q':
-                i64 = va_arg(va, int64_t);
-                goto l_int;
-            case 'i':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = va_arg(va, unsigned int);
-                goto l_int;
-            case 'I':
-                i64 = va_arg(va, signed int);
-                goto l_int;
-            case 'l':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = va_arg(va, unsigned long int);
-                goto l_int;
-            case 'L':
-                i64 = va_arg(va, signed long int);
-                goto l_int;
-            case 'h':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = (unsigned short int) va_arg(va, int);
-                goto l_int;
-            case 'H':
-                i64 = (signed short int) va_arg(va, int);
-                goto l_int;
-            case 'z':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = va_arg(va, size_t);
-                goto l_int;
-            case 'Z':
-                i64 = va_arg(va, ptrdiff_t);
-                goto l_int;
-            case 'p':
-                sign_mode = ZLX_NO_SIGN;
-                i64 = va_arg(va, uintptr_t);
-                goto l_int;
-            case 'P':
-                i64 = va_arg(va, intptr_t);
-                if (radix == 0) radix = 16;
-                goto l_int;
-            case 'y':
-                num_pfx = (uint8_t const *) "0b";
-            case 'Y':
-                radix = 2;
-                break;
-            case 'o':
-                num_pfx = (uint8_t const *) "0o";
-            case 'O':
-                radix = 8;
-                break;
-            case 'n':
-                num_pfx = (uint8_t const *) "0d";
-            case 'N':
-                radix = 10;
-                break;
-            case 'x':
-                num_pfx = (uint8_t const *) "0x";
-            case 'X':
-                esc_mode = STR_ESC_HEX;
-                radix = 16;
-                break;
-            case 's':
-                str = va_arg(va, uint8_t const *);
-                if (prec == SIZE_MAX) arg_len = zlx_u8a_zlen(str);
-                else arg_len = prec;
-                switch (esc_mode)
-                {
-                case STR_ESC_NONE:
-                    cmd = CMD_STR;
-                    arg_width = width_func(width_context, str, arg_len);
-                    if (arg_width < 0) return ZLX_FMT_WIDTH_ERROR;
-                    break;
-                case STR_ESC_HEX:
-                    cmd = CMD_CONV;
-                    conv = zlx_clconv_bin_to_hex_line;
-                    conv_ctx = NULL;
-                    break;
-                case STR_ESC_C:
-                    cmd = CMD_CONV;
-                    conv = zlx_clconv_c_escape;
-                    conv_ctx = zlx_clconv_c_escape_init(&cectx);
-                    break;
-                default:
-                    return ZLX_FMT_NO_CODE;
-                }
-                if (cmd == CMD_CONV && req_width)
-                {
-                    int32_t width;
-                    for (arg_width = 0, ofs = 0; ofs < arg_len; ofs += in_len)
-                    {
-                        cc = conv(str + ofs, arg_len - ofs, &in_len,
-                                  buffer, sizeof buffer, &out_len, conv_ctx);
-                        if (cc && cc != ZLX_CLCONV_FULL)
-                            return ZLX_FMT_CONV_ERROR;
-                        width = width_func(width_context, buffer, out_len);
-                        if (width < 0) return ZLX_FMT_WIDTH_ERROR;
-                        arg_width += width;
-                    }
-                    cc = conv(NULL, 0, &in_len, buffer, sizeof buffer,
-                              &out_len, conv_ctx);
-                    width = width_func(width_context, buffer, out_len);
-                    if (width < 0) return ZLX_FMT_WIDTH_ERROR;
-                    arg_width += width;
-                }
-                break;
-            case '.':
-                ++f;
-                if (*f == '*')
-                {
-                    prec = va_arg(va, size_t);
-                }
-                else
-                {
-                    for (prec = 0; *f >= '0' && *f <= '9'; ++f)
-                        prec = prec * 10 + *f - '0';
-                    --f;
-                }
-                break;
-            case '<':
-                align_mode = ALIGN_LEFT;
-                break;
-            case '>':
-                align_mode = ALIGN_RIGHT;
-                break;
-            case '/':
-                if (f[1] < '0' || f[1] > '9' ||
-                    f[2] == 0) return ZLX_FMT_MALFORMED;
-                group_len = f[1] - '0';
-                sep = f[2];
-                f += 2;
-                break;
-            case 'e':
-                esc_mode = STR_ESC_C;
-                break;
-            default:
-                return ZLX_FMT_MALFORMED;
-            }
+        case STR_ESC_NONE:
+            cmd = CMD_STR;
+            arg_width = width_func(width_context, str, arg_len);
+            if (arg_width < 0) return ZLX_FMT_WIDTH_ERROR;
+            break;
+        case STR_ESC_HEX:
+            cmd = CMD_CONV;
+            conv = zlx_clconv_bin_to_hex_line;
+            conv_ctx = NULL;
+            break;
+        case STR_ESC_C:
+            cmd = CMD_CONV;
+            conv = zlx_clconv_c_escape;
+            conv_ctx = zlx_clconv_c_escape_init(&cectx);
+            break;
+        default:
+            return ZLX_FMT_NO_CODE;
         }
-
-        if ((size_t) arg_width < req_width && align_mode == ALIGN_RIGHT)
+        if (cmd == CMD_CONV && op->width)
         {
-            size_t pad_width = req_width - arg_width;
-            size_t clen;
-            for (; pad_width; pad_width -= clen)
+            int32_t width;
+            for (arg_width = 0, ofs = 0; ofs < arg_len; ofs += in_len)
             {
-                clen = pad_width;
-                if (clen > sizeof(empty_spaces) - 1)
-                    clen = sizeof(empty_spaces) - 1;
-                if (writer(writer_context, empty_spaces, clen) 
-                    != (ptrdiff_t) clen)
-                    return ZLX_FMT_WRITE_ERROR;
+                cc = conv(str + ofs, arg_len - ofs, &in_len,
+                          buffer, 0x400, &out_len, conv_ctx);
+                if (cc && cc != ZLX_CLCONV_FULL)
+                    return ZLX_FMT_CONV_ERROR;
+                width = width_func(width_context, buffer, out_len);
+                if (width < 0) return ZLX_FMT_WIDTH_ERROR;
+                arg_width += width;
             }
+            cc = conv(NULL, 0, &in_len, buffer, 0x400, &out_len, conv_ctx);
+            width = width_func(width_context, buffer, out_len);
+            if (width < 0) return ZLX_FMT_WIDTH_ERROR;
+            arg_width += width;
         }
+        break;
+    default:
+        return ZLX_FMT_MALFORMED;
+    }
+
+    if ((size_t) arg_width < op->width && op->align == ALIGN_RIGHT
+        && out_pad(out, op->width - arg_width))
+        return ZLX_FMT_WRITE_ERROR;
 
-        switch (cmd)
+    switch (cmd)
+    {
+    case CMD_BUF:
+        if (out_write(out, buffer, arg_len)) return ZLX_FMT_WRITE_ERROR;
+        break;
+    case CMD_STR:
+        if (out_write(out, str, arg_len)) return ZLX_FMT_WRITE_ERROR;
+        break;
+    case CMD_CONV:
+        switch (op->esc)
         {
-        case CMD_BUF:
-            z = writer(writer_context, buffer, arg_len);
-            if (z != arg_len) return ZLX_FMT_WRITE_ERROR;
-            break;
-        case CMD_STR:
-            z = writer(writer_context, str, arg_len);
-            if (z != arg_len) return ZLX_FMT_WRITE_ERROR;
+        case STR_ESC_C:
+            conv_ctx = zlx_clconv_c_escape_init(&cectx);
             break;
-        case CMD_CONV:
-            switch (esc_mode)
-            {
-            case STR_ESC_C:
-                conv_ctx = zlx_clconv_c_escape_init(&cectx);
-                break;
-            default:
-                conv_ctx = NULL;
-            }
-
-            for (ofs = 0; ofs < arg_len; ofs += in_len)
-            {
-                cc = conv(str + ofs, arg_len - ofs, &in_len,
-                          buffer, sizeof buffer, &out_len, conv_ctx);
-                if (cc && cc != ZLX_CLCONV_FULL) return ZLX_FMT_CONV_ERROR;
-                if (writer(writer_context, buffer, out_len) 
-                    != (ptrdiff_t) out_len)
-                    return ZLX_FMT_WRITE_ERROR;
-            }
-            cc = conv(NULL, 0, &in_len,
-                      buffer, sizeof buffer, &out_len, conv_ctx);
-            if (cc) return ZLX_FMT_CONV_ERROR;
-            if (writer(writer_context, buffer, out_len) 
-                != (ptrdiff_t) out_len)
-                return ZLX_FMT_WRITE_ERROR;
+        default:
+            conv_ctx = NULL;
         }
 
-        if ((size_t) arg_width < req_width && align_mode == ALIGN_LEFT)
+        for (ofs = 0; ofs < arg_len; ofs += in_len)
         {
-            size_t pad_width = req_width - arg_width;
-            size_t clen;
-            for (; pad_width; pad_width -= clen)
-            {
-                clen = pad_width;
-                if (clen > sizeof(empty_spaces) - 1)
-                    clen = sizeof(empty_spaces) - 1;
-                if (writer(writer_context, empty_spaces, clen) 
-                    != (ptrdiff_t) clen)
-                    return ZLX_FMT_WRITE_ERROR;
-            }
+            cc = conv(str + ofs, arg_len - ofs, &in_len,
+                      buffer, 0x400, &out_len, conv_ctx);
+            if (cc && cc != ZLX_CLCONV_FULL) return ZLX_FMT_CONV_ERROR;
+            if (out_write(out, buffer, out_len))
+                return ZLX_FMT_WRITE_ERROR;
         }
-
+        cc = conv(NULL, 0, &in_len, buffer, 0x400, &out_len, conv_ctx);
+        if (cc) return ZLX_FMT_CONV_ERROR;
+        if (out_write(out, buffer, out_len)) return ZLX_FMT_WRITE_ERROR;
     }
-    //if (writer(&nul, 1, writer_context) != 1) return ZLX_FMT_WRITE_ERROR;
 
+    if ((size_t) arg_width < op->width && op->align == ALIGN_LEFT
+        && out_pad(out, op->width - arg_width))
+        return ZLX_FMT_WRITE_ERROR;
     return 0;
 }
-#undef CMD_NONE
+
+/* fmt_end ******************************************************************/
+/**
+ *  Flushes the staged output, unless writing already failed.
+ */
+static unsigned int fmt_end
+(
+    fmt_out_t * out,
+    unsigned int rc
+)
+{
+    if (rc != ZLX_FMT_WRITE_ERROR && out_flush(out)) rc = ZLX_FMT_WRITE_ERROR;
+    return rc;
+}
+
+/* zlx_vfmt_flags ***********************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_vfmt_flags
+(
+    zlx_write_func_t writer,
+    void * writer_context,
+    zlx_write_func_t width_func,
+    void * width_context,
+    unsigned int flags,
+    char const * fmt,
+    va_list va
+)
+{
+    fmt_out_t out;
+    uint8_t buffer[0x400];
+    uint8_t const * f = (uint8_t const *) fmt;
+    zlx_fmt_op_t op;
+    va_list ap;
+    unsigned int rc = 0;
+
+    out.writer = writer;
+    out.writer_context = writer_context;
+    out.len = 0;
+    out.unbuffered = (flags & ZLX_FMT_UNBUFFERED) != 0;
+    va_copy(ap, va);
+    while (*f && !rc)
+    {
+        rc = fmt_parse(&f, &op);
+        if (!rc)
+            rc = fmt_exec_op(&out, &op, &ap, width_func, width_context, buffer);
+    }
+    va_end(ap);
+    return fmt_end(&out, rc);
+}
+
+/* zlx_fmt_compile **********************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_fmt_compile
+(
+    zlx_fmt_op_t * ops,
+    size_t max_ops,
+    char const * fmt,
+    size_t * count
+)
+{
+    uint8_t const * f = (uint8_t const *) fmt;
+    zlx_fmt_op_t op;
+    unsigned int rc;
+    size_t n;
+
+    for (n = 0; *f; ++n)
+    {
+        rc = fmt_parse(&f, &op);
+        if (rc) return rc;
+        if (n < max_ops) ops[n] = op;
+    }
+    *count = n;
+    return n > max_ops ? ZLX_FMT_NO_SPACE : 0;
+}
+
+/* zlx_fmt_exec *************************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_fmt_exec
+(
+    zlx_fmt_op_t const * ops,
+    size_t count,
+    zlx_write_func_t writer,
+    void * writer_context,
+    zlx_write_func_t width_func,
+    void * width_context,
+    unsigned int flags,
+    va_list va
+)
+{
+    fmt_out_t out;
+    uint8_t buffer[0x400];
+    va_list ap;
+    unsigned int rc = 0;
+    size_t i;
+
+    out.writer = writer;
+    out.writer_context = writer_context;
+    out.len = 0;
+    out.unbuffered = (flags & ZLX_FMT_UNBUFFERED) != 0;
+    va_copy(ap, va);
+    for (i = 0; i < count && !rc; ++i)
+        rc = fmt_exec_op(&out, &ops[i], &ap, width_func, width_context, buffer);
+    va_end(ap);
+    return fmt_end(&out, rc);
+}
+
+/* zlx_fmt_cached ***********************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_fmt_cached
+(
+    zlx_fmt_cache_t * cache,
+    zlx_write_func_t writer,
+    void * writer_context,
+    zlx_write_func_t width_func,
+    void * width_context,
+    char const * fmt,
+    ...
+)
+{
+    va_list va;
+    uint32_t state;
+    unsigned int rc;
+
+    state = zlx_atomic_load_u32(&cache->state);
+    if (state == ZLX_FMT_CACHE_NEW
+        && zlx_atomic_cas_u32(&cache->state, state, ZLX_FMT_CACHE_BUSY))
+    {
+        /* the other threads interpret the format meanwhile */
+        state = zlx_fmt_compile(cache->ops, ZLX_FMT_CACHE_OPS, fmt,
+                                &cache->count)
+            ? ZLX_FMT_CACHE_FAILED : ZLX_FMT_CACHE_READY;
+        zlx_atomic_store_u32(&cache->state, state);
+    }
+    va_start(va, fmt);
+    if (state == ZLX_FMT_CACHE_READY)
+        rc = zlx_fmt_exec(cache->ops, cache->count, writer, writer_context,
+                          width_func, width_context, 0, va);
+    else
+        rc = zlx_vfmt_flags(writer, writer_context, width_func, width_context,
+                            0, fmt, va);
+    va_end(va);
+    return rc;
+}
+
 #undef CMD_BUF
 #undef CMD_STR
 #undef CMD_CONV
@@ -499,6 +981,21 @@ ZLX_API unsigned int ZLX_CALL zlx_vfmt
 #undef STR_ESC_C
 #undef STR_ESC_HEX
 
+/* zlx_vfmt *****************************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_vfmt
+(
+    zlx_write_func_t writer,
+    void * writer_context,
+    zlx_write_func_t width_func,
+    void * width_context,
+    char const * fmt,
+    va_list va
+)
+{
+    return zlx_vfmt_flags(writer, writer_context, width_func, width_context,
+                          0, fmt, va);
+}
+
 /* zlx_fmt ******************************************************************/
 ZLX_API unsigned int ZLX_CALL zlx_fmt
 (
@@ -0,0 +1,192 @@
+#include "zlx/future.h"
+#include "zlx/sync.h"
+
+/* run_cont *****************************************************************/
+static void run_cont
+(
+    zlx_fcont_t * cont
+)
+{
+    if (cont->exec) cont->exec->run(cont->exec, cont);
+    else cont->func(cont->future, cont);
+}
+
+/* complete *****************************************************************/
+static int complete
+(
+    zlx_future_t * future,
+    void * value,
+    int error
+)
+{
+    zlx_fcont_t * c;
+    zlx_fcont_t * fifo;
+    zlx_fcont_t * next;
+
+    if (!zlx_atomic_cas_u32(&future->claimed, 0, 1)) return 1;
+    future->value = value;
+    future->error = error;
+    /* publishing the marker also publishes the result */
+    c = zlx_atomic_xchg_ptr((void * *) &future->conts, ZLX_FUTURE_DONE);
+    for (fifo = NULL; c; c = next)
+    {
+        next = c->next;
+        c->next = fifo;
+        fifo = c;
+    }
+    for (c = fifo; c; c = next)
+    {
+        /* the continuation may reuse its structure */
+        next = c->next;
+        run_cont(c);
+    }
+    return 0;
+}
+
+/* zlx_future_set_value *****************************************************/
+ZLX_API int ZLX_CALL zlx_future_set_value
+(
+    zlx_future_t * future,
+    void * value
+)
+{
+    return complete(future, value, 0);
+}
+
+/* zlx_future_set_error *****************************************************/
+ZLX_API int ZLX_CALL zlx_future_set_error
+(
+    zlx_future_t * future,
+    int error
+)
+{
+    return complete(future, NULL, error);
+}
+
+/* zlx_future_then **********************************************************/
+ZLX_API void ZLX_CALL zlx_future_then
+(
+    zlx_future_t * future,
+    zlx_fcont_t * cont
+)
+{
+    zlx_fcont_t * head;
+
+    cont->future = future;
+    for (;;)
+    {
+        head = zlx_atomic_load_ptr((void * *) &future->conts);
+        if (head == ZLX_FUTURE_DONE) break;
+        cont->next = head;
+        if (zlx_atomic_cas_ptr((void * *) &future->conts, head, cont)) return;
+    }
+    run_cont(cont);
+}
+
+/* latch_cont ***************************************************************/
+static void ZLX_CALL latch_cont
+(
+    zlx_future_t * future,
+    zlx_fcont_t * cont
+)
+{
+    (void) future;
+    zlx_latch_count_down(cont->ctx, 1);
+}
+
+/* zlx_future_wait **********************************************************/
+ZLX_API int ZLX_CALL zlx_future_wait
+(
+    zlx_future_t * future,
+    zlx_ma_t * ma,
+    zlx_mth_xfc_t * mth
+)
+{
+    zlx_latch_t latch;
+    zlx_fcont_t cont;
+
+    if (zlx_future_is_ready(future)) return future->error;
+    if (zlx_latch_init(&latch, ma, mth, 1)) return -1;
+    zlx_fcont_init(&cont, latch_cont, &latch, NULL);
+    zlx_future_then(future, &cont);
+    zlx_latch_wait(&latch);
+    zlx_latch_finish(&latch);
+    return future->error;
+}
+
+/* unpark_cont **************************************************************/
+static void ZLX_CALL unpark_cont
+(
+    zlx_future_t * future,
+    zlx_fcont_t * cont
+)
+{
+    (void) future;
+    zlx_fiber_unpark(cont->ctx);
+}
+
+/* park_then ****************************************************************/
+static void ZLX_CALL park_then
+(
+    zlx_fiber_t * fiber,
+    void * ctx
+)
+{
+    zlx_fcont_t * cont = ctx;
+    (void) fiber;
+    /* the fiber is switched out so the continuation can unpark it even if
+     * it runs right away */
+    zlx_future_then(cont->future, cont);
+}
+
+/* zlx_future_fiber_wait ****************************************************/
+ZLX_API int ZLX_CALL zlx_future_fiber_wait
+(
+    zlx_future_t * future,
+    zlx_fiber_t * self
+)
+{
+    zlx_fcont_t cont;
+
+    if (zlx_future_is_ready(future)) return future->error;
+    zlx_fcont_init(&cont, unpark_cont, self, NULL);
+    cont.future = future;
+    zlx_fiber_park(self, park_then, &cont);
+    return future->error;
+}
+
+/* fiber_cont ***************************************************************/
+static void ZLX_CALL fiber_cont
+(
+    zlx_fiber_t * self,
+    void * arg
+)
+{
+    zlx_fcont_t * cont = arg;
+    (void) self;
+    cont->func(cont->future, cont);
+}
+
+/* fiber_exec_run ***********************************************************/
+static void ZLX_CALL fiber_exec_run
+(
+    zlx_executor_t * exec,
+    zlx_fcont_t * cont
+)
+{
+    zlx_fiber_executor_t * fe = (zlx_fiber_executor_t *) exec;
+    if (zlx_fsched_spawn(fe->sched, fiber_cont, cont))
+        cont->func(cont->future, cont);
+}
+
+/* zlx_fiber_executor_init **************************************************/
+ZLX_API void ZLX_CALL zlx_fiber_executor_init
+(
+    zlx_fiber_executor_t * fe,
+    zlx_fsched_t * sched
+)
+{
+    fe->exec.run = fiber_exec_run;
+    fe->sched = sched;
+}
+
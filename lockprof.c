@@ -0,0 +1,240 @@
+#include "zlx/lockprof.h"
+#include "zlx/atomic.h"
+#include "zlx/clock.h"
+#include "zlx/fmt.h"
+#include "zlx/unicode.h"
+
+typedef struct wrapped_mutex_s wrapped_mutex_t;
+struct wrapped_mutex_s
+{
+    zlx_lockstat_t * stat;
+    uint64_t acquired_at;
+    uint32_t held;
+};
+
+/* the wrapped mutex follows the header, 16-byte aligned */
+#define INNER_OFS ((sizeof(wrapped_mutex_t) + 15) & ~(size_t) 15)
+#define INNER(_w) ((zlx_mutex_t *) ((uint8_t *) (_w) + INNER_OFS))
+
+static zlx_lockprof_t * active;
+
+/* str_eq *******************************************************************/
+static int str_eq
+(
+    char const * a,
+    char const * b
+)
+{
+    while (*a && *a == *b) ++a, ++b;
+    return *a == *b;
+}
+
+/* lp_init ******************************************************************/
+static void ZLX_CALL lp_init
+(
+    zlx_mutex_t * mutex_p
+)
+{
+    wrapped_mutex_t * w = (wrapped_mutex_t *) mutex_p;
+    w->stat = &active->unnamed;
+    w->acquired_at = 0;
+    w->held = 0;
+    active->inner->init(INNER(w));
+}
+
+/* lp_finish ****************************************************************/
+static void ZLX_CALL lp_finish
+(
+    zlx_mutex_t * mutex_p
+)
+{
+    active->inner->finish(INNER(mutex_p));
+}
+
+/* lp_lock ******************************************************************/
+static void ZLX_CALL lp_lock
+(
+    zlx_mutex_t * mutex_p
+)
+{
+    wrapped_mutex_t * w = (wrapped_mutex_t *) mutex_p;
+    zlx_lockstat_t * st = w->stat;
+    uint32_t contended = zlx_atomic_load_u32(&w->held);
+    uint64_t t0 = zlx_clock_mono_ns();
+    uint64_t t1;
+
+    active->inner->lock(INNER(w));
+    t1 = zlx_clock_mono_ns();
+    zlx_atomic_store_u32(&w->held, 1);
+    w->acquired_at = t1;
+    /* records are shared by all mutexes with the same description */
+    zlx_atomic_add_u64(&st->acquisitions, 1);
+    if (contended) zlx_atomic_add_u64(&st->contended, 1);
+    zlx_atomic_add_u64(&st->wait_ns, t1 - t0);
+    zlx_atomic_max_u64(&st->max_wait_ns, t1 - t0);
+}
+
+/* lp_unlock ****************************************************************/
+static void ZLX_CALL lp_unlock
+(
+    zlx_mutex_t * mutex_p
+)
+{
+    wrapped_mutex_t * w = (wrapped_mutex_t *) mutex_p;
+    zlx_lockstat_t * st = w->stat;
+    uint64_t hold = zlx_clock_mono_ns() - w->acquired_at;
+
+    zlx_atomic_add_u64(&st->hold_ns, hold);
+    zlx_atomic_max_u64(&st->max_hold_ns, hold);
+    zlx_atomic_store_u32(&w->held, 0);
+    active->inner->unlock(INNER(w));
+}
+
+/* lp_set_info **************************************************************/
+static void ZLX_CALL lp_set_info
+(
+    zlx_mutex_t * mutex_p,
+    char const * info
+)
+{
+    wrapped_mutex_t * w = (wrapped_mutex_t *) mutex_p;
+    zlx_lockprof_t * lp = active;
+    zlx_lockstat_t * st;
+
+    if (lp->inner->set_info) lp->inner->set_info(INNER(w), info);
+    if (!info) return;
+    lp->inner->lock(lp->mutex);
+    for (st = lp->stats; st; st = st->next)
+        if (st->info == info || str_eq(st->info, info)) break;
+    if (!st)
+    {
+        st = zlx_alloc(lp->ma, sizeof(zlx_lockstat_t), "lock stats");
+        if (st)
+        {
+            st->info = info;
+            st->acquisitions = st->contended = 0;
+            st->wait_ns = st->max_wait_ns = 0;
+            st->hold_ns = st->max_hold_ns = 0;
+            st->next = lp->stats;
+            lp->stats = st;
+        }
+    }
+    lp->inner->unlock(lp->mutex);
+    if (st) w->stat = st;
+}
+
+/* zlx_lockprof_init ********************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_lockprof_init
+(
+    zlx_lockprof_t * restrict lp,
+    zlx_ma_t * restrict ma,
+    zlx_mutex_xfc_t * restrict inner
+)
+{
+    zlx_lockstat_t * st = &lp->unnamed;
+
+    if (active) return ZLX_MTH_NO_RES;
+    lp->xfc.init = lp_init;
+    lp->xfc.finish = lp_finish;
+    lp->xfc.lock = lp_lock;
+    lp->xfc.unlock = lp_unlock;
+    lp->xfc.size = INNER_OFS + inner->size;
+    lp->xfc.set_info = lp_set_info;
+    lp->inner = inner;
+    lp->ma = ma;
+    lp->stats = st;
+    st->next = NULL;
+    st->info = "(unnamed)";
+    st->acquisitions = st->contended = 0;
+    st->wait_ns = st->max_wait_ns = 0;
+    st->hold_ns = st->max_hold_ns = 0;
+    lp->mutex = NULL;
+    if (inner->size)
+    {
+        lp->mutex = zlx_mutex_create(ma, inner, "lockprof");
+        if (!lp->mutex) return ZLX_MTH_NO_MEM;
+    }
+    active = lp;
+    return ZLX_MTH_OK;
+}
+
+/* zlx_lockprof_finish ******************************************************/
+ZLX_API void ZLX_CALL zlx_lockprof_finish
+(
+    zlx_lockprof_t * restrict lp
+)
+{
+    zlx_lockstat_t * st;
+    while ((st = lp->stats) != &lp->unnamed)
+    {
+        lp->stats = st->next;
+        zlx_free(lp->ma, st, sizeof(zlx_lockstat_t));
+    }
+    if (lp->mutex) zlx_mutex_destroy(lp->mutex, lp->ma, lp->inner);
+    if (active == lp) active = NULL;
+}
+
+/* more_contended ***********************************************************/
+static int more_contended
+(
+    zlx_lockstat_t * a,
+    zlx_lockstat_t * b
+)
+{
+    uint64_t ca = zlx_atomic_load_u64(&a->contended);
+    uint64_t cb = zlx_atomic_load_u64(&b->contended);
+    if (ca != cb) return ca > cb;
+    return zlx_atomic_load_u64(&a->wait_ns) > zlx_atomic_load_u64(&b->wait_ns);
+}
+
+/* zlx_lockprof_dump ********************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_lockprof_dump
+(
+    zlx_lockprof_t * restrict lp,
+    zlx_write_func_t writer,
+    void * writer_context
+)
+{
+    zlx_lockstat_t * * v;
+    zlx_lockstat_t * st;
+    size_t n, i, j, count;
+    unsigned int rc;
+
+    lp->inner->lock(lp->mutex);
+    for (count = 0, st = lp->stats; st; st = st->next) ++count;
+    rc = ZLX_ARRAY_ALLOC(lp->ma, v, n, count, "lock stats report");
+    if (!rc)
+    {
+        /* records are never freed before finish so they can be read after
+         * releasing the list */
+        for (i = 0, st = lp->stats; st; st = st->next)
+        {
+            for (j = i++; j && more_contended(st, v[j - 1]); --j)
+                v[j] = v[j - 1];
+            v[j] = st;
+        }
+    }
+    lp->inner->unlock(lp->mutex);
+    if (rc) return ZLX_FMT_WRITE_ERROR;
+
+    rc = zlx_fmt(writer, writer_context, zlx_utf8_term_width, NULL,
+                 "$<32s $>12s $>12s $>14s $>14s $>14s $>14s\n",
+                 "mutex", "locks", "contended", "wait_ns", "max_wait_ns",
+                 "hold_ns", "max_hold_ns");
+    for (i = 0; i < count && !rc; ++i)
+    {
+        st = v[i];
+        rc = zlx_fmt(writer, writer_context, zlx_utf8_term_width, NULL,
+                     "$<32s $>12q $>12q $>14q $>14q $>14q $>14q\n",
+                     st->info,
+                     zlx_atomic_load_u64(&st->acquisitions),
+                     zlx_atomic_load_u64(&st->contended),
+                     zlx_atomic_load_u64(&st->wait_ns),
+                     zlx_atomic_load_u64(&st->max_wait_ns),
+                     zlx_atomic_load_u64(&st->hold_ns),
+                     zlx_atomic_load_u64(&st->max_hold_ns));
+    }
+    ZLX_ARRAY_FREE(lp->ma, v, n);
+    return rc;
+}
+
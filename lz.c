@@ -0,0 +1,769 @@
+#include "zlx/lz.h"
+#include "zlx/clconv.h"
+#include "zlx/stdarray.h"
+
+#define MIN_MATCH 4
+/* matches start at least this far from the end of the block */
+#define MF_LIMIT 12
+/* the last bytes of a block are always literals */
+#define LAST_LITERALS 5
+#define MAX_OFFSET 0xFFFF
+/* candidates examined for each position */
+#define CHAIN_DEPTH 4
+/* payload size flag for stored frames */
+#define STORED 0x80000000
+
+#define P1 2654435761U
+#define P2 2246822519U
+#define P3 3266489917U
+#define P4 668265263U
+#define P5 374761393U
+
+/* rotl32 *******************************************************************/
+static uint32_t rotl32
+(
+    uint32_t v,
+    unsigned int n
+)
+{
+    return (v << n) | (v >> (32 - n));
+}
+
+/* checksum *****************************************************************/
+/**
+ *  xxHash32 with seed 0.
+ */
+static uint32_t checksum
+(
+    uint8_t const * p,
+    size_t n
+)
+{
+    uint8_t const * end = p + n;
+    uint32_t v1, v2, v3, v4, h;
+
+    if (n >= 16)
+    {
+        v1 = P1 + P2;
+        v2 = P2;
+        v3 = 0;
+        v4 = 0 - P1;
+        for (; end - p >= 16; p += 16)
+        {
+            v1 = rotl32(v1 + ZLX_UREAD_U32LE(p) * P2, 13) * P1;
+            v2 = rotl32(v2 + ZLX_UREAD_U32LE(p + 4) * P2, 13) * P1;
+            v3 = rotl32(v3 + ZLX_UREAD_U32LE(p + 8) * P2, 13) * P1;
+            v4 = rotl32(v4 + ZLX_UREAD_U32LE(p + 12) * P2, 13) * P1;
+        }
+        h = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+    }
+    else h = P5;
+    h += (uint32_t) n;
+    for (; end - p >= 4; p += 4)
+        h = rotl32(h + ZLX_UREAD_U32LE(p) * P3, 17) * P4;
+    for (; p < end; ++p) h = rotl32(h + *p * P5, 11) * P1;
+    h ^= h >> 15;
+    h *= P2;
+    h ^= h >> 13;
+    h *= P3;
+    h ^= h >> 16;
+    return h;
+}
+
+/* ctz64 ********************************************************************/
+static unsigned int ctz64
+(
+    uint64_t v
+)
+{
+#if __GNUC__
+    return __builtin_ctzll(v);
+#else
+    unsigned int n = 0;
+    while (!(v & 1)) { v >>= 1; ++n; }
+    return n;
+#endif
+}
+
+/* hash4 ********************************************************************/
+static uint32_t hash4
+(
+    uint8_t const * p
+)
+{
+    return (ZLX_UREAD_U32LE(p) * P1) >> (32 - ZLX_LZ_HASH_BITS);
+}
+
+/* insert *******************************************************************/
+/**
+ *  Adds a position to the match finder.
+ *  @returns the distance to the previous position with the same hash, if
+ *      within reach, or 0
+ */
+static size_t insert
+(
+    zlx_lz_match_t * m,
+    uint8_t const * in,
+    size_t pos
+)
+{
+    uint32_t h = hash4(in + pos);
+    size_t prev = m->head[h];
+    size_t d;
+
+    d = prev && pos - (prev - 1) <= MAX_OFFSET ? pos - (prev - 1) : 0;
+    m->chain[pos & 0xFFFF] = (uint16_t) d;
+    m->head[h] = (uint32_t) (pos + 1);
+    return d;
+}
+
+/* match_len ****************************************************************/
+/**
+ *  Counts the equal bytes at @a a and @a b, stopping at @a b_end; @a a is
+ *  before @a b.
+ */
+static size_t match_len
+(
+    uint8_t const * a,
+    uint8_t const * b,
+    uint8_t const * b_end
+)
+{
+    uint8_t const * start = b;
+    uint64_t x;
+
+    for (; b_end - b >= 8; a += 8, b += 8)
+    {
+        x = ZLX_UREAD_U64LE(a) ^ ZLX_UREAD_U64LE(b);
+        if (x) return b - start + (ctz64(x) >> 3);
+    }
+    for (; b < b_end && *a == *b; ++a, ++b);
+    return b - start;
+}
+
+/* put_len ******************************************************************/
+static uint8_t * put_len
+(
+    uint8_t * op,
+    size_t n
+)
+{
+    for (; n >= 255; n -= 255) *op++ = 255;
+    *op++ = (uint8_t) n;
+    return op;
+}
+
+/* emit *********************************************************************/
+/**
+ *  Writes a sequence; @a mlen is 0 for the last one (literals only).
+ *  @returns the end of the sequence or NULL if it does not fit
+ */
+static uint8_t * emit
+(
+    uint8_t * op,
+    uint8_t * oend,
+    uint8_t const * lit,
+    size_t lit_len,
+    size_t offset,
+    size_t mlen
+)
+{
+    uint8_t * token;
+
+    if ((size_t) (oend - op)
+        < lit_len + lit_len / 255 + (mlen ? mlen / 255 + 5 : 2))
+        return NULL;
+    token = op++;
+    if (lit_len >= 15)
+    {
+        *token = 15 << 4;
+        op = put_len(op, lit_len - 15);
+    }
+    else *token = (uint8_t) (lit_len << 4);
+    zlx_u8a_copy(op, lit, lit_len);
+    op += lit_len;
+    if (!mlen) return op;
+    ZLX_UWRITE_U16LE(op, (uint16_t) offset);
+    op += 2;
+    mlen -= MIN_MATCH;
+    if (mlen >= 15)
+    {
+        *token |= 15;
+        op = put_len(op, mlen - 15);
+    }
+    else *token |= (uint8_t) mlen;
+    return op;
+}
+
+/* copy_match ***************************************************************/
+static void copy_match
+(
+    uint8_t * op,
+    size_t offset,
+    size_t n
+)
+{
+    uint8_t const * src = op - offset;
+
+    /* 8 bytes at a time when a chunk does not overlap its source */
+    if (offset >= 8)
+        for (; n >= 8; n -= 8, op += 8, src += 8)
+            ZLX_UWRITE_U64LE(op, ZLX_UREAD_U64LE(src));
+    for (; n; --n) *op++ = *src++;
+}
+
+/* zlx_lz_compress **********************************************************/
+ZLX_API size_t ZLX_CALL zlx_lz_compress
+(
+    zlx_lz_match_t * restrict m,
+    uint8_t const * restrict in,
+    size_t in_len,
+    uint8_t * restrict out,
+    size_t out_len
+)
+{
+    uint8_t * op = out;
+    uint8_t * oend = out + out_len;
+    size_t ip = 0, anchor = 0, limit, mend;
+    size_t c, d, len, best_len, best_off = 0;
+    unsigned int depth;
+
+    if (in_len > MF_LIMIT)
+    {
+        zlx_u8a_set((uint8_t *) m->head, sizeof(m->head), 0);
+        limit = in_len - MF_LIMIT;
+        mend = in_len - LAST_LITERALS;
+        while (ip < limit)
+        {
+            d = insert(m, in, ip);
+            best_len = 0;
+            for (depth = CHAIN_DEPTH; d && depth; --depth)
+            {
+                c = ip - d;
+                if (ZLX_UREAD_U32LE(in + c) == ZLX_UREAD_U32LE(in + ip))
+                {
+                    len = MIN_MATCH + match_len(in + c + MIN_MATCH,
+                                                in + ip + MIN_MATCH,
+                                                in + mend);
+                    if (len > best_len)
+                    {
+                        best_len = len;
+                        best_off = ip - c;
+                        if (ip + len == mend) break;
+                    }
+                }
+                /* positions within reach were inserted after the ones
+                 * sharing their chain slot, so the link is current */
+                d = m->chain[c & 0xFFFF];
+                if (!d) break;
+                d += ip - c;
+                if (d > MAX_OFFSET) break;
+            }
+            if (best_len < MIN_MATCH)
+            {
+                /* skip faster through data that does not compress */
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            op = emit(op, oend, in + anchor, ip - anchor, best_off, best_len);
+            if (!op) return 0;
+            ip += best_len;
+            anchor = ip;
+            if (ip - 2 < limit) insert(m, in, ip - 2);
+        }
+    }
+    op = emit(op, oend, in + anchor, in_len - anchor, 0, 0);
+    return op ? (size_t) (op - out) : 0;
+}
+
+/* zlx_lz_decompress ********************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_lz_decompress
+(
+    uint8_t const * restrict in,
+    size_t in_len,
+    uint8_t * restrict out,
+    size_t out_len
+)
+{
+    uint8_t const * ip = in;
+    uint8_t const * iend = in + in_len;
+    uint8_t * op = out;
+    uint8_t * oend = out + out_len;
+    size_t lit, ml, offset;
+    unsigned int token;
+    uint8_t b;
+
+    while (ip < iend)
+    {
+        token = *ip++;
+        lit = token >> 4;
+        if (lit == 15)
+            do
+            {
+                if (ip == iend) return -1;
+                b = *ip++;
+                lit += b;
+            }
+            while (b == 255);
+        if ((size_t) (iend - ip) < lit || (size_t) (oend - op) < lit)
+            return -1;
+        zlx_u8a_copy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend) break;
+        if (iend - ip < 2) return -1;
+        offset = ZLX_UREAD_U16LE(ip);
+        ip += 2;
+        if (!offset || offset > (size_t) (op - out)) return -1;
+        ml = token & 15;
+        if (ml == 15)
+            do
+            {
+                if (ip == iend) return -1;
+                b = *ip++;
+                ml += b;
+            }
+            while (b == 255);
+        ml += MIN_MATCH;
+        if ((size_t) (oend - op) < ml) return -1;
+        copy_match(op, offset, ml);
+        op += ml;
+    }
+    return op - out;
+}
+
+/* enc_frame ****************************************************************/
+/**
+ *  Turns the collected data into a frame, stored if it does not compress.
+ */
+static void enc_frame
+(
+    zlx_lz_enc_t * enc
+)
+{
+    uint8_t * f = enc->frame;
+    size_t n = enc->block_len;
+    size_t c;
+
+    c = zlx_lz_compress(&enc->match, enc->block, n, f + ZLX_LZ_FRAME_HDR,
+                        n - 1);
+    if (c) ZLX_UWRITE_U32LE(f, (uint32_t) c);
+    else
+    {
+        zlx_u8a_copy(f + ZLX_LZ_FRAME_HDR, enc->block, n);
+        c = n;
+        ZLX_UWRITE_U32LE(f, (uint32_t) c | STORED);
+    }
+    ZLX_UWRITE_U32LE(f + 4, (uint32_t) n);
+    ZLX_UWRITE_U32LE(f + 8, checksum(enc->block, n));
+    enc->frame_len = ZLX_LZ_FRAME_HDR + c;
+    enc->frame_pos = 0;
+    enc->block_len = 0;
+}
+
+/* enc_end ******************************************************************/
+/**
+ *  Puts the end marker in the frame buffer.
+ */
+static void enc_end
+(
+    zlx_lz_enc_t * enc
+)
+{
+    zlx_u8a_set(enc->frame, ZLX_LZ_FRAME_HDR, 0);
+    enc->frame_len = ZLX_LZ_FRAME_HDR;
+    enc->frame_pos = 0;
+    enc->ended = 1;
+}
+
+/* frame_need ***************************************************************/
+/**
+ *  Size of the frame being received, as far as known.
+ *  @returns the size or 0 if the header is bad
+ */
+static size_t frame_need
+(
+    zlx_lz_dec_t * dec
+)
+{
+    uint32_t csize;
+
+    if (dec->frame_len < ZLX_LZ_FRAME_HDR) return ZLX_LZ_FRAME_HDR;
+    csize = ZLX_UREAD_U32LE(dec->frame) & ~STORED;
+    if (csize > ZLX_LZ_BOUND(ZLX_LZ_BLOCK_SIZE)
+        || ZLX_UREAD_U32LE(dec->frame + 4) > ZLX_LZ_BLOCK_SIZE)
+        return 0;
+    return ZLX_LZ_FRAME_HDR + csize;
+}
+
+/* dec_frame ****************************************************************/
+/**
+ *  Decodes a complete frame.
+ *  @returns 0 on success, non-zero if the frame is bad
+ */
+static int dec_frame
+(
+    zlx_lz_dec_t * dec
+)
+{
+    uint8_t const * f = dec->frame;
+    uint32_t csize = ZLX_UREAD_U32LE(f);
+    uint32_t usize = ZLX_UREAD_U32LE(f + 4);
+
+    dec->frame_len = 0;
+    dec->block_pos = dec->block_len = 0;
+    if (!csize)
+    {
+        dec->ended = 1;
+        return 0;
+    }
+    if ((csize & STORED))
+    {
+        if ((csize & ~STORED) != usize) return 1;
+        zlx_u8a_copy(dec->block, f + ZLX_LZ_FRAME_HDR, usize);
+    }
+    else if (zlx_lz_decompress(f + ZLX_LZ_FRAME_HDR, csize, dec->block, usize)
+             != (ptrdiff_t) usize)
+        return 1;
+    if (checksum(dec->block, usize) != ZLX_UREAD_U32LE(f + 8)) return 1;
+    dec->block_len = usize;
+    return 0;
+}
+
+/* zlx_lz_enc_init **********************************************************/
+ZLX_API void * ZLX_CALL zlx_lz_enc_init
+(
+    zlx_lz_enc_t * enc
+)
+{
+    enc->block_len = enc->frame_pos = enc->frame_len = 0;
+    enc->ended = 0;
+    return enc;
+}
+
+/* zlx_clconv_lz_compress ***************************************************/
+ZLX_API uint_fast8_t ZLX_CALL zlx_clconv_lz_compress
+(
+    uint8_t const * in,
+    size_t in_len,
+    size_t * in_used_len,
+    uint8_t * out,
+    size_t out_len,
+    size_t * out_used_len,
+    void * ctx
+)
+{
+    zlx_lz_enc_t * enc = ctx;
+    size_t i = 0, o = 0, n;
+
+    for (;;)
+    {
+        if (enc->frame_pos < enc->frame_len)
+        {
+            n = enc->frame_len - enc->frame_pos;
+            if (n > out_len - o) n = out_len - o;
+            zlx_u8a_copy(out + o, enc->frame + enc->frame_pos, n);
+            o += n;
+            enc->frame_pos += n;
+            if (enc->frame_pos < enc->frame_len)
+            {
+                *in_used_len = i;
+                *out_used_len = o;
+                return ZLX_CLCONV_FULL;
+            }
+        }
+        if (in)
+        {
+            if (i == in_len) break;
+            n = ZLX_LZ_BLOCK_SIZE - enc->block_len;
+            if (n > in_len - i) n = in_len - i;
+            zlx_u8a_copy(enc->block + enc->block_len, in + i, n);
+            enc->block_len += n;
+            i += n;
+            if (enc->block_len == ZLX_LZ_BLOCK_SIZE) enc_frame(enc);
+        }
+        else if (enc->block_len) enc_frame(enc);
+        else if (!enc->ended) enc_end(enc);
+        else break;
+    }
+    *in_used_len = i;
+    *out_used_len = o;
+    return ZLX_CLCONV_OK;
+}
+
+/* zlx_lz_dec_init **********************************************************/
+ZLX_API void * ZLX_CALL zlx_lz_dec_init
+(
+    zlx_lz_dec_t * dec
+)
+{
+    dec->frame_len = dec->block_pos = dec->block_len = 0;
+    dec->ended = 0;
+    return dec;
+}
+
+/* zlx_clconv_lz_decompress *************************************************/
+ZLX_API uint_fast8_t ZLX_CALL zlx_clconv_lz_decompress
+(
+    uint8_t const * in,
+    size_t in_len,
+    size_t * in_used_len,
+    uint8_t * out,
+    size_t out_len,
+    size_t * out_used_len,
+    void * ctx
+)
+{
+    zlx_lz_dec_t * dec = ctx;
+    size_t i = 0, o = 0, n, need;
+    uint_fast8_t rc = ZLX_CLCONV_OK;
+
+    for (;;)
+    {
+        if (dec->block_pos < dec->block_len)
+        {
+            n = dec->block_len - dec->block_pos;
+            if (n > out_len - o) n = out_len - o;
+            zlx_u8a_copy(out + o, dec->block + dec->block_pos, n);
+            o += n;
+            dec->block_pos += n;
+            if (dec->block_pos < dec->block_len)
+            {
+                rc = ZLX_CLCONV_FULL;
+                break;
+            }
+        }
+        if (dec->ended) break;
+        need = frame_need(dec);
+        if (!need) { rc = ZLX_CLCONV_MALFORMED; break; }
+        if (dec->frame_len < need)
+        {
+            if (!in) { rc = ZLX_CLCONV_INCOMPLETE; break; }
+            if (i == in_len) break;
+            n = need - dec->frame_len;
+            if (n > in_len - i) n = in_len - i;
+            zlx_u8a_copy(dec->frame + dec->frame_len, in + i, n);
+            dec->frame_len += n;
+            i += n;
+            continue;
+        }
+        if (dec_frame(dec)) { rc = ZLX_CLCONV_MALFORMED; break; }
+    }
+    *in_used_len = i;
+    *out_used_len = o;
+    return rc;
+}
+
+/* read_full ****************************************************************/
+/**
+ *  Reads exactly @a size bytes; running out of data is a format error.
+ */
+static zlx_file_status_t read_full
+(
+    zlx_file_t * zf,
+    uint8_t * data,
+    size_t size
+)
+{
+    ptrdiff_t r;
+
+    for (; size; data += r, size -= r)
+    {
+        r = zlx_read(zf, data, size);
+        if (r < 0) return (zlx_file_status_t) -r;
+        if (!r) return ZLXF_BAD_DATA;
+    }
+    return ZLXF_OK;
+}
+
+/* flush_frame **************************************************************/
+static zlx_file_status_t flush_frame
+(
+    zlx_lz_file_t * lf
+)
+{
+    zlx_lz_enc_t * enc = lf->enc;
+    zlx_file_status_t fs;
+    size_t w;
+
+    fs = zlx_write_full(lf->inner, enc->frame + enc->frame_pos,
+                        enc->frame_len - enc->frame_pos, &w);
+    enc->frame_pos += w;
+    return fs;
+}
+
+/* lzf_read *****************************************************************/
+static ptrdiff_t ZLX_CALL lzf_read
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size
+)
+{
+    zlx_lz_file_t * lf = (zlx_lz_file_t *) f;
+    zlx_lz_dec_t * dec = lf->dec;
+    zlx_file_status_t fs;
+    size_t need;
+
+    while (dec->block_pos == dec->block_len)
+    {
+        if (dec->ended) return 0;
+        fs = read_full(lf->inner, dec->frame, ZLX_LZ_FRAME_HDR);
+        if (fs) return -fs;
+        dec->frame_len = ZLX_LZ_FRAME_HDR;
+        need = frame_need(dec);
+        if (!need) return -ZLXF_BAD_DATA;
+        fs = read_full(lf->inner, dec->frame + ZLX_LZ_FRAME_HDR,
+                       need - ZLX_LZ_FRAME_HDR);
+        if (fs) return -fs;
+        if (dec_frame(dec)) return -ZLXF_BAD_DATA;
+    }
+    if (size > dec->block_len - dec->block_pos)
+        size = dec->block_len - dec->block_pos;
+    zlx_u8a_copy(data, dec->block + dec->block_pos, size);
+    dec->block_pos += size;
+    lf->pos += size;
+    return size;
+}
+
+/* lzf_write ****************************************************************/
+static ptrdiff_t ZLX_CALL lzf_write
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    zlx_lz_file_t * lf = (zlx_lz_file_t *) f;
+    zlx_lz_enc_t * enc = lf->enc;
+    zlx_file_status_t fs;
+
+    /* a frame left by a failed write goes first */
+    if (enc->frame_pos < enc->frame_len)
+    {
+        fs = flush_frame(lf);
+        if (fs) return -fs;
+    }
+    if (size > ZLX_LZ_BLOCK_SIZE - enc->block_len)
+        size = ZLX_LZ_BLOCK_SIZE - enc->block_len;
+    zlx_u8a_copy(enc->block + enc->block_len, data, size);
+    enc->block_len += size;
+    lf->pos += size;
+    if (enc->block_len == ZLX_LZ_BLOCK_SIZE)
+    {
+        enc_frame(enc);
+        /* the data is taken; an error shows up on the next write */
+        flush_frame(lf);
+    }
+    return size;
+}
+
+/* lzf_seek64 ***************************************************************/
+static int64_t ZLX_CALL lzf_seek64
+(
+    zlx_file_t * restrict f,
+    int64_t offset,
+    int anchor
+)
+{
+    if (anchor == ZLXF_CUR && !offset) return ((zlx_lz_file_t *) f)->pos;
+    return -ZLXF_BAD_OPERATION;
+}
+
+/* lzf_truncate *************************************************************/
+static zlx_file_status_t ZLX_CALL lzf_truncate
+(
+    zlx_file_t * restrict f
+)
+{
+    (void) f;
+    return ZLXF_BAD_OPERATION;
+}
+
+/* lzf_close ****************************************************************/
+static zlx_file_status_t ZLX_CALL lzf_close
+(
+    zlx_file_t * restrict f,
+    unsigned int flags // ZLXF_READ | ZLXF_WRITE
+)
+{
+    zlx_lz_file_t * lf = (zlx_lz_file_t *) f;
+    zlx_lz_enc_t * enc = lf->enc;
+    zlx_file_status_t fs = ZLXF_OK, cs;
+
+    if ((flags & f->flags & ZLXF_WRITE) && !enc->ended)
+    {
+        if (enc->frame_pos < enc->frame_len) fs = flush_frame(lf);
+        if (!fs && enc->block_len)
+        {
+            enc_frame(enc);
+            fs = flush_frame(lf);
+        }
+        if (!fs)
+        {
+            enc_end(enc);
+            fs = flush_frame(lf);
+        }
+    }
+    cs = lf->inner->fcls->close(lf->inner, flags);
+    f->flags &= ~(flags & (ZLXF_READ | ZLXF_WRITE));
+    return fs ? fs : cs;
+}
+
+static zlx_file_class_t lz_file_class =
+{
+    lzf_read,
+    lzf_write,
+    lzf_seek64,
+    lzf_truncate,
+    lzf_close,
+    "zlx/lz",
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+/* zlx_lz_file_init *********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_lz_file_init
+(
+    zlx_lz_file_t * restrict lf,
+    zlx_file_t * restrict inner,
+    zlx_ma_t * restrict ma,
+    uint32_t mode
+)
+{
+    lf->enc = NULL;
+    lf->dec = NULL;
+    if (mode == ZLXF_WRITE)
+    {
+        lf->enc = zlx_alloc(ma, sizeof(zlx_lz_enc_t), "lz compressor");
+        if (!lf->enc) return ZLXF_NO_MEM;
+        zlx_lz_enc_init(lf->enc);
+    }
+    else if (mode == ZLXF_READ)
+    {
+        lf->dec = zlx_alloc(ma, sizeof(zlx_lz_dec_t), "lz decompressor");
+        if (!lf->dec) return ZLXF_NO_MEM;
+        zlx_lz_dec_init(lf->dec);
+    }
+    else return ZLXF_BAD_OPERATION;
+    lf->base.fcls = &lz_file_class;
+    lf->base.flags = mode;
+    lf->inner = inner;
+    lf->ma = ma;
+    lf->pos = 0;
+    return ZLXF_OK;
+}
+
+/* zlx_lz_file_finish *******************************************************/
+ZLX_API void ZLX_CALL zlx_lz_file_finish
+(
+    zlx_lz_file_t * restrict lf
+)
+{
+    if (lf->enc) zlx_free(lf->ma, lf->enc, sizeof(zlx_lz_enc_t));
+    if (lf->dec) zlx_free(lf->ma, lf->dec, sizeof(zlx_lz_dec_t));
+}
+
@@ -0,0 +1,342 @@
+#include "zlx/memfile.h"
+#include "zlx/stdarray.h"
+
+#define COPY_OUT 0
+#define COPY_IN 1
+#define ZERO 2
+
+/* chunk_data ***************************************************************/
+static uint8_t * chunk_data
+(
+    zlx_mem_chunk_t * c
+)
+{
+    return (uint8_t *) (c + 1);
+}
+
+/* free_chunks **************************************************************/
+static void free_chunks
+(
+    zlx_ma_t * ma,
+    zlx_mem_chunk_t * c
+)
+{
+    zlx_mem_chunk_t * n;
+    for (; c; c = n)
+    {
+        n = c->next;
+        zlx_free(ma, c, sizeof(zlx_mem_chunk_t) + c->size);
+    }
+}
+
+/* locate *******************************************************************/
+/**
+ *  Finds the block containing the given offset, which must be below the
+ *  capacity.
+ */
+static zlx_mem_chunk_t * locate
+(
+    zlx_mem_file_t * mf,
+    uint64_t offset
+)
+{
+    zlx_mem_chunk_t * c;
+
+    c = mf->cur && mf->cur->offset <= offset ? mf->cur : mf->head;
+    while (offset - c->offset >= c->size) c = c->next;
+    mf->cur = c;
+    return c;
+}
+
+/* transfer *****************************************************************/
+/**
+ *  Copies data between the caller's buffer and the blocks, or clears the
+ *  blocks. The range must be within the capacity.
+ */
+static void transfer
+(
+    zlx_mem_file_t * mf,
+    uint64_t offset,
+    uint8_t * data,
+    size_t size,
+    int op
+)
+{
+    zlx_mem_chunk_t * c;
+    size_t o, n;
+
+    if (!size) return;
+    for (c = locate(mf, offset); ; c = c->next)
+    {
+        o = (size_t) (offset - c->offset);
+        n = c->size - o < size ? c->size - o : size;
+        if (op == COPY_OUT) zlx_u8a_copy(data, chunk_data(c) + o, n);
+        else if (op == COPY_IN) zlx_u8a_copy(chunk_data(c) + o, data, n);
+        else zlx_u8a_set(chunk_data(c) + o, n, 0);
+        size -= n;
+        if (!size) break;
+        if (data) data += n;
+        offset += n;
+    }
+    mf->cur = c;
+}
+
+/* grow *********************************************************************/
+/**
+ *  Adds blocks until the capacity reaches @a end; the new data is
+ *  undefined. The file size does not change.
+ */
+static zlx_file_status_t grow
+(
+    zlx_mem_file_t * mf,
+    uint64_t end
+)
+{
+    zlx_mem_chunk_t * c;
+    size_t n;
+
+    while (mf->capacity < end)
+    {
+        if (end - mf->capacity > SIZE_MAX - sizeof(zlx_mem_chunk_t))
+            return ZLXF_OVERFLOW;
+        n = end - mf->capacity > mf->chunk_size
+            ? (size_t) (end - mf->capacity) : mf->chunk_size;
+        c = zlx_alloc(mf->ma, sizeof(zlx_mem_chunk_t) + n, "mem file chunk");
+        if (!c) return ZLXF_NO_MEM;
+        c->next = NULL;
+        c->offset = mf->capacity;
+        c->size = n;
+        if (mf->tail) mf->tail->next = c;
+        else mf->head = c;
+        mf->tail = c;
+        mf->capacity += n;
+        if (mf->chunk_size < ZLX_MEM_FILE_MAX_CHUNK) mf->chunk_size *= 2;
+    }
+    return ZLXF_OK;
+}
+
+/* extend *******************************************************************/
+/**
+ *  Makes room for data up to @a end and clears what lies between the end
+ *  of the file and @a start (blocks can hold stale data after truncation).
+ */
+static zlx_file_status_t extend
+(
+    zlx_mem_file_t * mf,
+    uint64_t start,
+    uint64_t end
+)
+{
+    zlx_file_status_t fs;
+
+    fs = grow(mf, end);
+    if (fs) return fs;
+    if (start > mf->size)
+    {
+        transfer(mf, mf->size, NULL, (size_t) (start - mf->size), ZERO);
+        mf->size = start;
+    }
+    return ZLXF_OK;
+}
+
+/* mem_pread ****************************************************************/
+static ptrdiff_t ZLX_CALL mem_pread
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_mem_file_t * mf = (zlx_mem_file_t *) f;
+
+    if (offset >= mf->size) return 0;
+    if (size > mf->size - offset) size = (size_t) (mf->size - offset);
+    if (size > PTRDIFF_MAX) size = PTRDIFF_MAX;
+    transfer(mf, offset, data, size, COPY_OUT);
+    return size;
+}
+
+/* mem_pwrite ***************************************************************/
+static ptrdiff_t ZLX_CALL mem_pwrite
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_mem_file_t * mf = (zlx_mem_file_t *) f;
+    zlx_file_status_t fs;
+
+    if (!size) return 0;
+    if (size > PTRDIFF_MAX) size = PTRDIFF_MAX;
+    if (offset > UINT64_MAX - size) return -ZLXF_OVERFLOW;
+    fs = extend(mf, offset, offset + size);
+    if (fs) return -fs;
+    transfer(mf, offset, (uint8_t *) data, size, COPY_IN);
+    if (mf->size < offset + size) mf->size = offset + size;
+    return size;
+}
+
+/* mem_read *****************************************************************/
+static ptrdiff_t ZLX_CALL mem_read
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size
+)
+{
+    zlx_mem_file_t * mf = (zlx_mem_file_t *) f;
+    ptrdiff_t r;
+
+    r = mem_pread(f, data, size, mf->pos);
+    mf->pos += r;
+    return r;
+}
+
+/* mem_write ****************************************************************/
+static ptrdiff_t ZLX_CALL mem_write
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    zlx_mem_file_t * mf = (zlx_mem_file_t *) f;
+    ptrdiff_t w;
+
+    w = mem_pwrite(f, data, size, mf->pos);
+    if (w > 0) mf->pos += w;
+    return w;
+}
+
+/* mem_seek64 ***************************************************************/
+static int64_t ZLX_CALL mem_seek64
+(
+    zlx_file_t * restrict f,
+    int64_t offset,
+    int anchor
+)
+{
+    zlx_mem_file_t * mf = (zlx_mem_file_t *) f;
+    int64_t base;
+
+    switch (anchor)
+    {
+    case ZLXF_SET: base = 0; break;
+    case ZLXF_CUR: base = (int64_t) mf->pos; break;
+    case ZLXF_END: base = (int64_t) mf->size; break;
+    default: return -ZLXF_BAD_OPERATION;
+    }
+    if (offset > 0 ? base > INT64_MAX - offset : base + offset < 0)
+        return offset > 0 ? -ZLXF_OVERFLOW : -ZLXF_BAD_OPERATION;
+    mf->pos = (uint64_t) (base + offset);
+    return (int64_t) mf->pos;
+}
+
+/* mem_truncate *************************************************************/
+static zlx_file_status_t ZLX_CALL mem_truncate
+(
+    zlx_file_t * restrict f
+)
+{
+    zlx_mem_file_t * mf = (zlx_mem_file_t *) f;
+    zlx_mem_chunk_t * * link;
+    zlx_mem_chunk_t * prev = NULL;
+
+    if (mf->pos > mf->size) return extend(mf, mf->pos, mf->pos);
+    mf->size = mf->pos;
+    /* release the blocks past the end */
+    for (link = &mf->head; *link && (*link)->offset < mf->size;
+         link = &(*link)->next)
+        prev = *link;
+    free_chunks(mf->ma, *link);
+    *link = NULL;
+    mf->tail = mf->cur = prev;
+    mf->capacity = prev ? prev->offset + prev->size : 0;
+    return ZLXF_OK;
+}
+
+/* mem_close ****************************************************************/
+static zlx_file_status_t ZLX_CALL mem_close
+(
+    zlx_file_t * restrict f,
+    unsigned int flags // ZLXF_READ | ZLXF_WRITE
+)
+{
+    f->flags &= ~(flags & (ZLXF_READ | ZLXF_WRITE));
+    return ZLXF_OK;
+}
+
+static zlx_file_class_t mem_file_class =
+{
+    mem_read,
+    mem_write,
+    mem_seek64,
+    mem_truncate,
+    mem_close,
+    "zlx/memory",
+    NULL,
+    mem_pread,
+    mem_pwrite,
+    NULL,
+    NULL
+};
+
+/* zlx_mem_file_init ********************************************************/
+ZLX_API void ZLX_CALL zlx_mem_file_init
+(
+    zlx_mem_file_t * restrict mf,
+    zlx_ma_t * restrict ma,
+    size_t chunk_size
+)
+{
+    mf->base.fcls = &mem_file_class;
+    mf->base.flags = ZLXF_READ | ZLXF_WRITE | ZLXF_SEEK;
+    mf->ma = ma;
+    mf->head = mf->tail = mf->cur = NULL;
+    mf->size = mf->capacity = mf->pos = 0;
+    mf->chunk_size = chunk_size ? chunk_size : ZLX_MEM_FILE_MIN_CHUNK;
+}
+
+/* zlx_mem_file_finish ******************************************************/
+ZLX_API void ZLX_CALL zlx_mem_file_finish
+(
+    zlx_mem_file_t * restrict mf
+)
+{
+    free_chunks(mf->ma, mf->head);
+    mf->head = mf->tail = mf->cur = NULL;
+    mf->size = mf->capacity = 0;
+}
+
+/* zlx_mem_file_flatten *****************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mem_file_flatten
+(
+    zlx_mem_file_t * restrict mf,
+    uint8_t * * restrict data
+)
+{
+    zlx_mem_chunk_t * c;
+
+    if (!mf->size) { *data = NULL; return ZLXF_OK; }
+    if (mf->head->size < mf->size)
+    {
+        if (mf->size > SIZE_MAX - sizeof(zlx_mem_chunk_t))
+            return ZLXF_OVERFLOW;
+        c = zlx_alloc(mf->ma, sizeof(zlx_mem_chunk_t) + (size_t) mf->size,
+                      "mem file chunk");
+        if (!c) return ZLXF_NO_MEM;
+        transfer(mf, 0, chunk_data(c), (size_t) mf->size, COPY_OUT);
+        free_chunks(mf->ma, mf->head);
+        c->next = NULL;
+        c->offset = 0;
+        c->size = (size_t) mf->size;
+        mf->head = mf->tail = mf->cur = c;
+        mf->capacity = mf->size;
+    }
+    *data = chunk_data(mf->head);
+    return ZLXF_OK;
+}
+
@@ -0,0 +1,376 @@
+#if __linux__
+#define _GNU_SOURCE /* for mremap() */
+#endif
+
+#include "zlx/mmfile.h"
+#include "zlx/stdarray.h"
+
+#if __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* smallest size a writable file grows to */
+#define MIN_GROW_SIZE 0x10000
+
+/* grow *********************************************************************/
+/**
+ *  Makes sure @a end bytes are backed by the file and mapped.
+ */
+static zlx_file_status_t grow
+(
+    zlx_mm_file_t * mf,
+    uint64_t end
+)
+{
+    uint64_t len;
+    void * m;
+
+    if (end <= mf->disk_size && end <= mf->map_size) return ZLXF_OK;
+    len = mf->disk_size * 2;
+    if (len < end) len = end;
+    if (len < MIN_GROW_SIZE) len = MIN_GROW_SIZE;
+    if (len > SIZE_MAX || (off_t) len < 0) len = end;
+    if (len > SIZE_MAX || (off_t) len < 0) return ZLXF_SIZE_LIMIT;
+    if (len > mf->disk_size)
+    {
+        if (ftruncate(mf->fd, (off_t) len)) return zlx_fd_file_status(errno);
+        mf->disk_size = len;
+    }
+    if (len > mf->map_size)
+    {
+        m = mf->map
+            ? mremap(mf->map, (size_t) mf->map_size, (size_t) len,
+                     MREMAP_MAYMOVE)
+            : mmap(NULL, (size_t) len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   mf->fd, 0);
+        if (m == MAP_FAILED) return zlx_fd_file_status(errno);
+        mf->map = m;
+        mf->map_size = len;
+    }
+    return ZLXF_OK;
+}
+
+/* copy_out *****************************************************************/
+static size_t copy_out
+(
+    zlx_mm_file_t * mf,
+    uint8_t * data,
+    size_t size,
+    uint64_t offset
+)
+{
+    if (offset >= mf->size) return 0;
+    if (size > mf->size - offset) size = (size_t) (mf->size - offset);
+    zlx_u8a_copy(data, mf->map + offset, size);
+    return size;
+}
+
+/* copy_in ******************************************************************/
+static ptrdiff_t copy_in
+(
+    zlx_mm_file_t * mf,
+    uint8_t const * data,
+    size_t size,
+    uint64_t offset
+)
+{
+    zlx_file_status_t fs;
+    uint64_t end = offset + size;
+
+    if (!(mf->base.flags & ZLXF_WRITE)) return -ZLXF_BAD_OPERATION;
+    if (end < offset) return -ZLXF_OVERFLOW;
+    fs = grow(mf, end);
+    if (fs) return -fs;
+    zlx_u8a_copy(mf->map + offset, data, size);
+    if (mf->size < end) mf->size = end;
+    return size;
+}
+
+/* mmf_read *****************************************************************/
+static ptrdiff_t ZLX_CALL mmf_read
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size
+)
+{
+    zlx_mm_file_t * mf = (zlx_mm_file_t *) f;
+    size_t n = copy_out(mf, data, size, mf->pos);
+    mf->pos += n;
+    return n;
+}
+
+/* mmf_write ****************************************************************/
+static ptrdiff_t ZLX_CALL mmf_write
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    zlx_mm_file_t * mf = (zlx_mm_file_t *) f;
+    ptrdiff_t w = copy_in(mf, data, size, mf->pos);
+    if (w > 0) mf->pos += w;
+    return w;
+}
+
+/* mmf_seek64 ***************************************************************/
+static int64_t ZLX_CALL mmf_seek64
+(
+    zlx_file_t * restrict f,
+    int64_t offset,
+    int anchor
+)
+{
+    zlx_mm_file_t * mf = (zlx_mm_file_t *) f;
+    int64_t base;
+
+    switch (anchor)
+    {
+    case ZLXF_SET: base = 0; break;
+    case ZLXF_CUR: base = (int64_t) mf->pos; break;
+    case ZLXF_END: base = (int64_t) mf->size; break;
+    default: return -ZLXF_BAD_OPERATION;
+    }
+    if (offset > 0 ? base > INT64_MAX - offset : base + offset < 0)
+        return offset > 0 ? -ZLXF_OVERFLOW : -ZLXF_BAD_OPERATION;
+    mf->pos = (uint64_t) (base + offset);
+    return (int64_t) mf->pos;
+}
+
+/* mmf_truncate *************************************************************/
+static zlx_file_status_t ZLX_CALL mmf_truncate
+(
+    zlx_file_t * restrict f
+)
+{
+    zlx_mm_file_t * mf = (zlx_mm_file_t *) f;
+    zlx_file_status_t fs;
+
+    if (!(f->flags & ZLXF_WRITE)) return ZLXF_BAD_OPERATION;
+    if (mf->pos > mf->size)
+    {
+        /* the part of the file past the logical size is all zeroes */
+        fs = grow(mf, mf->pos);
+        if (fs) return fs;
+    }
+    else
+    {
+        if (ftruncate(mf->fd, (off_t) mf->pos))
+            return zlx_fd_file_status(errno);
+        /* the mapping stays, only the part below the size is accessed */
+        mf->disk_size = mf->pos;
+    }
+    mf->size = mf->pos;
+    return ZLXF_OK;
+}
+
+/* mmf_close ****************************************************************/
+static zlx_file_status_t ZLX_CALL mmf_close
+(
+    zlx_file_t * restrict f,
+    unsigned int flags // ZLXF_READ | ZLXF_WRITE
+)
+{
+    zlx_mm_file_t * mf = (zlx_mm_file_t *) f;
+    zlx_file_status_t fs = ZLXF_OK;
+    unsigned int open_sides = f->flags & (ZLXF_READ | ZLXF_WRITE);
+
+    flags &= open_sides;
+    if (!flags) return ZLXF_OK;
+    f->flags &= ~flags;
+    if (flags != open_sides) return ZLXF_OK;
+    if (mf->map) munmap(mf->map, (size_t) mf->map_size);
+    mf->map = NULL;
+    mf->map_size = 0;
+    /* drop the slack left by growing */
+    if (mf->disk_size != mf->size && ftruncate(mf->fd, (off_t) mf->size))
+        fs = zlx_fd_file_status(errno);
+    if (mf->own && close(mf->fd) && errno != EINTR && !fs)
+        fs = zlx_fd_file_status(errno);
+    mf->fd = -1;
+    return fs;
+}
+
+/* mmf_os_handle ************************************************************/
+static intptr_t ZLX_CALL mmf_os_handle
+(
+    zlx_file_t * restrict f
+)
+{
+    return ((zlx_mm_file_t *) f)->fd;
+}
+
+/* mmf_pread ****************************************************************/
+static ptrdiff_t ZLX_CALL mmf_pread
+(
+    zlx_file_t * restrict f,
+    uint8_t * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    return copy_out((zlx_mm_file_t *) f, data, size, offset);
+}
+
+/* mmf_pwrite ***************************************************************/
+static ptrdiff_t ZLX_CALL mmf_pwrite
+(
+    zlx_file_t * restrict f,
+    uint8_t const * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    return copy_in((zlx_mm_file_t *) f, data, size, offset);
+}
+
+static zlx_file_class_t mm_file_class =
+{
+    mmf_read,
+    mmf_write,
+    mmf_seek64,
+    mmf_truncate,
+    mmf_close,
+    "zlx/mmap",
+    mmf_os_handle,
+    mmf_pread,
+    mmf_pwrite,
+    NULL,
+    NULL
+};
+
+#endif
+
+/* zlx_mm_file_map **********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mm_file_map
+(
+    zlx_mm_file_t * restrict mf,
+    int fd,
+    uint32_t flags
+)
+{
+#if __linux__
+    struct stat st;
+    int prot = PROT_READ;
+    int mflags = MAP_SHARED;
+    void * m;
+
+    if (!(flags & ZLXF_READ)) return ZLXF_BAD_OPERATION;
+    if (fstat(fd, &st)) return zlx_fd_file_status(errno);
+    if (!S_ISREG(st.st_mode)) return ZLXF_BAD_OPERATION;
+    if ((uint64_t) st.st_size > SIZE_MAX) return ZLXF_SIZE_LIMIT;
+    if ((flags & ZLXF_WRITE)) prot |= PROT_WRITE;
+    if ((flags & ZLX_MMF_POPULATE)) mflags |= MAP_POPULATE;
+    m = NULL;
+    if (st.st_size)
+    {
+        m = mmap(NULL, (size_t) st.st_size, prot, mflags, fd, 0);
+        if (m == MAP_FAILED) return zlx_fd_file_status(errno);
+    }
+    mf->base.fcls = &mm_file_class;
+    mf->base.flags = (flags & (ZLXF_READ | ZLXF_WRITE)) | ZLXF_SEEK;
+    mf->map = m;
+    mf->map_size = mf->disk_size = mf->size = (uint64_t) st.st_size;
+    mf->pos = 0;
+    mf->fd = fd;
+    mf->own = (flags & ZLX_FDF_OWN) != 0;
+    return ZLXF_OK;
+#else
+    (void) mf; (void) fd; (void) flags;
+    return ZLXF_NO_CODE;
+#endif
+}
+
+/* zlx_mm_file_open *********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mm_file_open
+(
+    zlx_mm_file_t * restrict mf,
+    char const * restrict path,
+    uint32_t flags
+)
+{
+#if __linux__
+    int oflags = O_CLOEXEC;
+    int fd;
+    zlx_file_status_t fs;
+
+    if (!(flags & ZLXF_READ)) return ZLXF_BAD_OPERATION;
+    /* a writable shared mapping needs a descriptor open for reading too */
+    oflags |= (flags & ZLXF_WRITE) ? O_RDWR : O_RDONLY;
+    if ((flags & ZLX_FDF_CREATE)) oflags |= O_CREAT;
+    if ((flags & ZLX_FDF_EXCL)) oflags |= O_EXCL;
+    if ((flags & ZLX_FDF_TRUNCATE)) oflags |= O_TRUNC;
+    do fd = open(path, oflags, 0666);
+    while (fd < 0 && errno == EINTR);
+    if (fd < 0) return zlx_fd_file_status(errno);
+    fs = zlx_mm_file_map(mf, fd, (flags & (ZLXF_READ | ZLXF_WRITE
+                                           | ZLX_MMF_POPULATE))
+                         | ZLX_FDF_OWN);
+    if (fs) close(fd);
+    return fs;
+#else
+    (void) mf; (void) path; (void) flags;
+    return ZLXF_NO_CODE;
+#endif
+}
+
+/* zlx_mm_file_advise *******************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mm_file_advise
+(
+    zlx_mm_file_t * restrict mf,
+    uint64_t offset,
+    uint64_t len,
+    int advice
+)
+{
+#if __linux__
+    uint64_t page_mask = (uint64_t) sysconf(_SC_PAGESIZE) - 1;
+    int adv;
+
+    switch (advice)
+    {
+    case ZLX_MMF_SEQUENTIAL: adv = MADV_SEQUENTIAL; break;
+    case ZLX_MMF_RANDOM: adv = MADV_RANDOM; break;
+    case ZLX_MMF_WILLNEED: adv = MADV_WILLNEED; break;
+    case ZLX_MMF_DONTNEED: adv = MADV_DONTNEED; break;
+#ifdef MADV_HUGEPAGE
+    case ZLX_MMF_HUGEPAGE: adv = MADV_HUGEPAGE; break;
+#endif
+    default: return ZLXF_BAD_OPERATION;
+    }
+    if (offset >= mf->map_size) return ZLXF_OK;
+    if (!len || len > mf->map_size - offset) len = mf->map_size - offset;
+    len += offset & page_mask;
+    offset &= ~page_mask;
+    if (madvise(mf->map + offset, (size_t) len, adv))
+        return zlx_fd_file_status(errno);
+    return ZLXF_OK;
+#else
+    (void) mf; (void) offset; (void) len; (void) advice;
+    return ZLXF_NO_CODE;
+#endif
+}
+
+/* zlx_mm_file_flush ********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mm_file_flush
+(
+    zlx_mm_file_t * restrict mf,
+    int wait
+)
+{
+#if __linux__
+    uint64_t len = mf->size < mf->map_size ? mf->size : mf->map_size;
+    if (!len) return ZLXF_OK;
+    if (msync(mf->map, (size_t) len, wait ? MS_SYNC : MS_ASYNC))
+        return zlx_fd_file_status(errno);
+    return ZLXF_OK;
+#else
+    (void) mf; (void) wait;
+    return ZLXF_NO_CODE;
+#endif
+}
+
@@ -0,0 +1,87 @@
+#if __linux__
+#define _GNU_SOURCE /* for sched_getcpu() */
+#endif
+
+#include "zlx/percpu.h"
+#include "zlx/stdarray.h"
+
+#if __linux__
+#include <sched.h>
+#include <unistd.h>
+#if defined(__has_include)
+#if __has_include(<sys/rseq.h>) && (__GNUC__ >= 11 || __clang__)
+#include <sys/rseq.h>
+#define HAVE_RSEQ 1
+#endif
+#endif
+#endif
+
+/* zlx_cpu_count ************************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_cpu_count ()
+{
+#if __linux__
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+    return n > 0 ? (unsigned int) n : 1;
+#else
+    return 1;
+#endif
+}
+
+/* zlx_cpu_current **********************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_cpu_current ()
+{
+#if __linux__
+    int cpu;
+#if HAVE_RSEQ
+    if (__rseq_size)
+    {
+        struct rseq * rs = (struct rseq *)
+            ((uint8_t *) __builtin_thread_pointer() + __rseq_offset);
+        /* the kernel updates this on every migration */
+        cpu = (int) __atomic_load_n(&rs->cpu_id, __ATOMIC_RELAXED);
+        if (cpu >= 0) return (unsigned int) cpu;
+    }
+#endif
+    cpu = sched_getcpu();
+    return cpu >= 0 ? (unsigned int) cpu : 0;
+#else
+    return 0;
+#endif
+}
+
+/* zlx_percpu_init **********************************************************/
+ZLX_API int ZLX_CALL zlx_percpu_init
+(
+    zlx_percpu_t * restrict pc,
+    zlx_ma_t * restrict ma,
+    size_t size
+)
+{
+    uintptr_t a;
+
+    pc->ma = ma;
+    pc->count = zlx_cpu_count();
+    pc->stride = (size + ZLX_CACHE_LINE_SIZE - 1)
+        & ~(size_t) (ZLX_CACHE_LINE_SIZE - 1);
+    if (!pc->stride) pc->stride = ZLX_CACHE_LINE_SIZE;
+    pc->block_size = pc->count * pc->stride + ZLX_CACHE_LINE_SIZE - 1;
+    pc->block = zlx_alloc(ma, pc->block_size, "per-cpu slots");
+    if (!pc->block) return 1;
+    a = ((uintptr_t) pc->block + ZLX_CACHE_LINE_SIZE - 1)
+        & ~(uintptr_t) (ZLX_CACHE_LINE_SIZE - 1);
+    pc->base = (uint8_t *) a;
+    zlx_u8a_set(pc->base, pc->count * pc->stride, 0);
+    return 0;
+}
+
+/* zlx_percpu_finish ********************************************************/
+ZLX_API void ZLX_CALL zlx_percpu_finish
+(
+    zlx_percpu_t * restrict pc
+)
+{
+    zlx_free(pc->ma, pc->block, pc->block_size);
+    pc->block = NULL;
+    pc->base = NULL;
+}
+
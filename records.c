@@ -0,0 +1,312 @@
+#include "zlx/records.h"
+#include "zlx/stdarray.h"
+#include "zlx/atomic.h"
+
+#if (ZLX_AMD64 || ZLX_IA32) && __GNUC__ && __SSE2__
+#include <immintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+#define WINDOW 64
+
+/* mask_scalar **************************************************************/
+/**
+ *  Finds the delimiters in up to 64 bytes, one byte at a time.
+ */
+static uint64_t mask_scalar
+(
+    uint8_t const * p,
+    size_t n,
+    uint8_t delim
+)
+{
+    uint64_t m = 0;
+    size_t i;
+
+    for (i = 0; i < n; ++i) m |= (uint64_t) (p[i] == delim) << i;
+    return m;
+}
+
+#if HAVE_SSE2
+
+/* mask64_sse2 **************************************************************/
+static uint64_t mask64_sse2
+(
+    uint8_t const * p,
+    uint8_t delim
+)
+{
+    __m128i d = _mm_set1_epi8((char) delim);
+    uint64_t m0, m1, m2, m3;
+
+    m0 = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_loadu_si128((__m128i const *) p), d));
+    m1 = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_loadu_si128((__m128i const *) (p + 16)), d));
+    m2 = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_loadu_si128((__m128i const *) (p + 32)), d));
+    m3 = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_loadu_si128((__m128i const *) (p + 48)), d));
+    return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+/* mask64_avx2 **************************************************************/
+__attribute__ ((target ("avx2")))
+static uint64_t mask64_avx2
+(
+    uint8_t const * p,
+    uint8_t delim
+)
+{
+    __m256i d = _mm256_set1_epi8((char) delim);
+    uint64_t lo, hi;
+
+    lo = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+        _mm256_loadu_si256((__m256i const *) p), d));
+    hi = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+        _mm256_loadu_si256((__m256i const *) (p + 32)), d));
+    return lo | (hi << 32);
+}
+
+static uint64_t (* mask64_func) (uint8_t const * p, uint8_t delim) =
+    mask64_sse2;
+static uint32_t mask64_ready;
+
+/* select_mask64 ************************************************************/
+/**
+ *  Picks the implementation on first use. Scans racing with the choice
+ *  load either function, both being correct.
+ */
+static void select_mask64 ()
+{
+    if (zlx_atomic_load_u32(&mask64_ready)) return;
+    if (__builtin_cpu_supports("avx2"))
+        __atomic_store_n(&mask64_func, mask64_avx2, __ATOMIC_RELEASE);
+    zlx_atomic_store_u32(&mask64_ready, 1);
+}
+
+/* mask64 *******************************************************************/
+static uint64_t mask64
+(
+    uint8_t const * p,
+    uint8_t delim
+)
+{
+    return __atomic_load_n(&mask64_func, __ATOMIC_ACQUIRE)(p, delim);
+}
+
+#else
+
+/* mask64 *******************************************************************/
+/**
+ *  Finds the delimiters in 64 bytes, 8 at a time.
+ */
+static uint64_t mask64
+(
+    uint8_t const * p,
+    uint8_t delim
+)
+{
+    uint64_t d = 0x0101010101010101 * delim;
+    uint64_t m = 0, t;
+    unsigned int i;
+
+    for (i = 0; i < WINDOW; i += 8)
+    {
+        t = ZLX_UREAD_U64LE(p + i) ^ d;
+        /* high bit of each byte set exactly for the zero bytes */
+        t = ~(((t & 0x7F7F7F7F7F7F7F7F) + 0x7F7F7F7F7F7F7F7F) | t)
+            & 0x8080808080808080;
+        /* gather the high bits into the low byte */
+        m |= ((t >> 7) * 0x0102040810204080 >> 56) << i;
+    }
+    return m;
+}
+
+#define select_mask64()
+
+#endif
+
+/* ctz64 ********************************************************************/
+static unsigned int ctz64
+(
+    uint64_t v
+)
+{
+#if __GNUC__
+    return __builtin_ctzll(v);
+#else
+    unsigned int n = 0;
+    while (!(v & 1)) { v >>= 1; ++n; }
+    return n;
+#endif
+}
+
+/* find_delim ***************************************************************/
+/**
+ *  Finds the next delimiter in the available data.
+ *  @returns its offset or SIZE_MAX if there is none
+ */
+static size_t find_delim
+(
+    zlx_rec_reader_t * rr
+)
+{
+    size_t n;
+    uint64_t m;
+
+    for (m = rr->mask; !m; rr->mask = m)
+    {
+        rr->scan += rr->mlen;
+        n = rr->end - rr->scan;
+        if (!n) { rr->mlen = 0; return SIZE_MAX; }
+        if (n >= WINDOW)
+        {
+            rr->mlen = WINDOW;
+            m = mask64(rr->data + rr->scan, rr->delim);
+        }
+        else
+        {
+            /* the window is examined again once more data comes */
+            rr->mlen = n;
+            m = mask_scalar(rr->data + rr->scan, n, rr->delim);
+        }
+    }
+    rr->mask = m & (m - 1);
+    return rr->scan + ctz64(m);
+}
+
+/* fill *********************************************************************/
+/**
+ *  Moves the unreturned data to the start of the buffer and reads more.
+ */
+static zlx_file_status_t fill
+(
+    zlx_rec_reader_t * rr
+)
+{
+    size_t new_size;
+    uint8_t * b;
+    ptrdiff_t r;
+
+    if (rr->pos)
+    {
+        zlx_u8a_move(rr->buf, rr->buf + rr->pos, rr->end - rr->pos);
+        rr->end -= rr->pos;
+        rr->scan -= rr->pos;
+        rr->pos = 0;
+    }
+    if (rr->end == rr->size)
+    {
+        if (rr->size == rr->max_size) return ZLXF_SIZE_LIMIT;
+        new_size = rr->size <= rr->max_size / 2 ? rr->size * 2 : rr->max_size;
+        b = zlx_realloc(rr->ma, rr->buf, rr->size, new_size);
+        if (!b) return ZLXF_NO_MEM;
+        rr->buf = b;
+        rr->data = b;
+        rr->size = new_size;
+    }
+    r = zlx_read(rr->file, rr->buf + rr->end, rr->size - rr->end);
+    if (r < 0) return (zlx_file_status_t) -r;
+    if (!r) rr->eof = 1;
+    rr->end += r;
+    return ZLXF_OK;
+}
+
+/* zlx_rec_reader_init ******************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_rec_reader_init
+(
+    zlx_rec_reader_t * restrict rr,
+    zlx_file_t * restrict file,
+    zlx_ma_t * restrict ma,
+    size_t size,
+    size_t max_size,
+    uint8_t delim
+)
+{
+    if (!size || size > max_size) return ZLXF_SIZE_LIMIT;
+    rr->buf = zlx_alloc(ma, size, "record buffer");
+    if (!rr->buf) return ZLXF_NO_MEM;
+    select_mask64();
+    rr->data = rr->buf;
+    rr->pos = rr->end = rr->scan = rr->mlen = 0;
+    rr->mask = 0;
+    rr->file = file;
+    rr->ma = ma;
+    rr->size = size;
+    rr->max_size = max_size;
+    rr->delim = delim;
+    rr->eof = 0;
+    return ZLXF_OK;
+}
+
+/* zlx_rec_reader_init_mem **************************************************/
+ZLX_API void ZLX_CALL zlx_rec_reader_init_mem
+(
+    zlx_rec_reader_t * restrict rr,
+    uint8_t const * data,
+    size_t size,
+    uint8_t delim
+)
+{
+    select_mask64();
+    rr->data = data;
+    rr->pos = rr->scan = rr->mlen = 0;
+    rr->end = size;
+    rr->mask = 0;
+    rr->file = NULL;
+    rr->ma = NULL;
+    rr->buf = NULL;
+    rr->size = rr->max_size = size;
+    rr->delim = delim;
+    rr->eof = 1;
+}
+
+/* zlx_rec_reader_finish ****************************************************/
+ZLX_API void ZLX_CALL zlx_rec_reader_finish
+(
+    zlx_rec_reader_t * restrict rr
+)
+{
+    if (rr->buf) zlx_free(rr->ma, rr->buf, rr->size);
+}
+
+/* zlx_rec_batch ************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_rec_batch
+(
+    zlx_rec_reader_t * restrict rr,
+    zlx_rec_t * restrict recs,
+    size_t count
+)
+{
+    zlx_file_status_t fs;
+    size_t n = 0, d;
+
+    if (count > PTRDIFF_MAX) count = PTRDIFF_MAX;
+    while (n < count)
+    {
+        d = find_delim(rr);
+        if (d == SIZE_MAX)
+        {
+            if (n) break;
+            if (rr->eof)
+            {
+                /* last record without a delimiter */
+                if (rr->pos == rr->end) break;
+                d = rr->end;
+            }
+            else
+            {
+                fs = fill(rr);
+                if (fs) return -(ptrdiff_t) fs;
+                continue;
+            }
+        }
+        recs[n].data = rr->data + rr->pos;
+        recs[n].size = d - rr->pos;
+        ++n;
+        rr->pos = d < rr->end ? d + 1 : d;
+    }
+    return n;
+}
+
@@ -0,0 +1,368 @@
+#include "zlx/sync.h"
+#include "zlx/atomic.h"
+#include "zlx/assert.h"
+
+#if __linux__
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+/* futex_wait ***************************************************************/
+/**
+ *  Blocks while the word has the given value; may return spuriously.
+ */
+static void futex_wait
+(
+    uint32_t * word,
+    uint32_t value
+)
+{
+#if __linux__
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+    (void) word; (void) value;
+#endif
+}
+
+/* futex_wake ***************************************************************/
+static void futex_wake
+(
+    uint32_t * word,
+    uint32_t n
+)
+{
+#if __linux__
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE,
+            n > INT_MAX ? INT_MAX : (int) n, NULL, NULL, 0);
+#else
+    (void) word; (void) n;
+#endif
+}
+
+/* base_init ****************************************************************/
+static zlx_mth_status_t base_init
+(
+    zlx_sync_base_t * b,
+    zlx_ma_t * ma,
+    zlx_mth_xfc_t * mth
+)
+{
+    zlx_mth_status_t ms;
+
+    b->ma = ma;
+    b->mth = mth;
+    b->mutex = NULL;
+    b->cond = NULL;
+    b->sleepers = 0;
+    if (!mth)
+    {
+#if __linux__
+        return ZLX_MTH_OK;
+#else
+        return ZLX_MTH_NO_SUP;
+#endif
+    }
+    if (!mth->cond.size) return ZLX_MTH_NO_SUP;
+    if (mth->mutex.size)
+    {
+        b->mutex = zlx_mutex_create(ma, &mth->mutex, "sync mutex");
+        if (!b->mutex) return ZLX_MTH_NO_MEM;
+    }
+    ms = ZLX_MTH_NO_MEM;
+    b->cond = zlx_cond_create(ma, &mth->cond, &ms, "sync cond");
+    if (!b->cond)
+    {
+        if (b->mutex) zlx_mutex_destroy(b->mutex, ma, &mth->mutex);
+        b->mutex = NULL;
+        return ms;
+    }
+    return ZLX_MTH_OK;
+}
+
+/* base_finish **************************************************************/
+static void base_finish
+(
+    zlx_sync_base_t * b
+)
+{
+    if (!b->mth) return;
+    ZLX_ASSERT(b->sleepers == 0);
+    zlx_cond_destroy(b->cond, b->ma, &b->mth->cond);
+    if (b->mutex) zlx_mutex_destroy(b->mutex, b->ma, &b->mth->mutex);
+}
+
+/* base_lock ****************************************************************/
+static void base_lock
+(
+    zlx_sync_base_t * b
+)
+{
+    b->mth->mutex.lock(b->mutex);
+}
+
+/* base_unlock **************************************************************/
+static void base_unlock
+(
+    zlx_sync_base_t * b
+)
+{
+    b->mth->mutex.unlock(b->mutex);
+}
+
+/* base_sleep ***************************************************************/
+/**
+ *  Waits on the condition; the mutex must be held.
+ */
+static void base_sleep
+(
+    zlx_sync_base_t * b
+)
+{
+    b->sleepers++;
+    b->mth->cond.wait(b->cond, b->mutex);
+    b->sleepers--;
+}
+
+/* base_wake ****************************************************************/
+/**
+ *  Wakes up to @a n sleepers; the mutex must be held.
+ *  The condition interface only has signal so this signals once for each
+ *  thread to wake.
+ */
+static void base_wake
+(
+    zlx_sync_base_t * b,
+    uint32_t n
+)
+{
+    if (n > b->sleepers) n = b->sleepers;
+    while (n--) b->mth->cond.signal(b->cond);
+}
+
+/* zlx_sema_init ************************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_sema_init
+(
+    zlx_sema_t * restrict sema,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * restrict mth,
+    uint32_t count
+)
+{
+    sema->count = count;
+    sema->waiters = 0;
+    return base_init(&sema->base, ma, mth);
+}
+
+/* zlx_sema_finish **********************************************************/
+ZLX_API void ZLX_CALL zlx_sema_finish
+(
+    zlx_sema_t * restrict sema
+)
+{
+    base_finish(&sema->base);
+}
+
+/* zlx_sema_try_wait ********************************************************/
+ZLX_API int ZLX_CALL zlx_sema_try_wait
+(
+    zlx_sema_t * restrict sema
+)
+{
+    uint32_t c;
+    int r;
+
+    if (!sema->base.mth)
+    {
+        while ((c = zlx_atomic_load_u32(&sema->count)))
+            if (zlx_atomic_cas_u32(&sema->count, c, c - 1)) return 1;
+        return 0;
+    }
+    base_lock(&sema->base);
+    r = sema->count != 0;
+    if (r) sema->count--;
+    base_unlock(&sema->base);
+    return r;
+}
+
+/* zlx_sema_wait ************************************************************/
+ZLX_API void ZLX_CALL zlx_sema_wait
+(
+    zlx_sema_t * restrict sema
+)
+{
+    if (!sema->base.mth)
+    {
+        while (!zlx_sema_try_wait(sema))
+        {
+            /* posters check for waiters after raising the count, so either
+             * they see us or the kernel sees the new count */
+            zlx_atomic_add_u32(&sema->waiters, 1);
+            futex_wait(&sema->count, 0);
+            zlx_atomic_add_u32(&sema->waiters, (uint32_t) -1);
+        }
+        return;
+    }
+    base_lock(&sema->base);
+    while (!sema->count) base_sleep(&sema->base);
+    sema->count--;
+    base_unlock(&sema->base);
+}
+
+/* zlx_sema_post ************************************************************/
+ZLX_API void ZLX_CALL zlx_sema_post
+(
+    zlx_sema_t * restrict sema,
+    uint32_t n
+)
+{
+    if (!sema->base.mth)
+    {
+        zlx_atomic_add_u32(&sema->count, n);
+        if (zlx_atomic_load_u32(&sema->waiters)) futex_wake(&sema->count, n);
+        return;
+    }
+    base_lock(&sema->base);
+    sema->count += n;
+    base_wake(&sema->base, n);
+    base_unlock(&sema->base);
+}
+
+/* zlx_latch_init ***********************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_latch_init
+(
+    zlx_latch_t * restrict latch,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * restrict mth,
+    uint32_t count
+)
+{
+    latch->count = count;
+    return base_init(&latch->base, ma, mth);
+}
+
+/* zlx_latch_finish *********************************************************/
+ZLX_API void ZLX_CALL zlx_latch_finish
+(
+    zlx_latch_t * restrict latch
+)
+{
+    base_finish(&latch->base);
+}
+
+/* zlx_latch_count_down *****************************************************/
+ZLX_API void ZLX_CALL zlx_latch_count_down
+(
+    zlx_latch_t * restrict latch,
+    uint32_t n
+)
+{
+    if (!latch->base.mth)
+    {
+        if (zlx_atomic_add_u32(&latch->count, (uint32_t) -n) == n)
+            futex_wake(&latch->count, UINT32_MAX);
+        return;
+    }
+    base_lock(&latch->base);
+    ZLX_ASSERT(latch->count >= n);
+    latch->count -= n;
+    if (!latch->count) base_wake(&latch->base, UINT32_MAX);
+    base_unlock(&latch->base);
+}
+
+/* zlx_latch_try_wait *******************************************************/
+ZLX_API int ZLX_CALL zlx_latch_try_wait
+(
+    zlx_latch_t * restrict latch
+)
+{
+    int r;
+    if (!latch->base.mth) return !zlx_atomic_load_u32(&latch->count);
+    base_lock(&latch->base);
+    r = !latch->count;
+    base_unlock(&latch->base);
+    return r;
+}
+
+/* zlx_latch_wait ***********************************************************/
+ZLX_API void ZLX_CALL zlx_latch_wait
+(
+    zlx_latch_t * restrict latch
+)
+{
+    uint32_t c;
+    if (!latch->base.mth)
+    {
+        while ((c = zlx_atomic_load_u32(&latch->count)))
+            futex_wait(&latch->count, c);
+        return;
+    }
+    base_lock(&latch->base);
+    while (latch->count) base_sleep(&latch->base);
+    base_unlock(&latch->base);
+}
+
+/* zlx_barrier_init *********************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_barrier_init
+(
+    zlx_barrier_t * restrict barrier,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * restrict mth,
+    uint32_t parties
+)
+{
+    barrier->parties = parties;
+    barrier->arrived = 0;
+    barrier->phase = 0;
+    return base_init(&barrier->base, ma, mth);
+}
+
+/* zlx_barrier_finish *******************************************************/
+ZLX_API void ZLX_CALL zlx_barrier_finish
+(
+    zlx_barrier_t * restrict barrier
+)
+{
+    base_finish(&barrier->base);
+}
+
+/* zlx_barrier_wait *********************************************************/
+ZLX_API int ZLX_CALL zlx_barrier_wait
+(
+    zlx_barrier_t * restrict barrier
+)
+{
+    uint32_t phase;
+
+    if (!barrier->base.mth)
+    {
+        phase = zlx_atomic_load_u32(&barrier->phase);
+        if (zlx_atomic_add_u32(&barrier->arrived, 1) + 1 == barrier->parties)
+        {
+            /* reset before publishing the new phase so that early arrivals
+             * for it count from 0 */
+            zlx_atomic_store_u32(&barrier->arrived, 0);
+            zlx_atomic_add_u32(&barrier->phase, 1);
+            futex_wake(&barrier->phase, UINT32_MAX);
+            return 1;
+        }
+        while (zlx_atomic_load_u32(&barrier->phase) == phase)
+            futex_wait(&barrier->phase, phase);
+        return 0;
+    }
+    base_lock(&barrier->base);
+    phase = barrier->phase;
+    if (++barrier->arrived == barrier->parties)
+    {
+        barrier->arrived = 0;
+        barrier->phase++;
+        base_wake(&barrier->base, UINT32_MAX);
+        base_unlock(&barrier->base);
+        return 1;
+    }
+    while (barrier->phase == phase) base_sleep(&barrier->base);
+    base_unlock(&barrier->base);
+    return 0;
+}
+
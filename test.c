@@ -1,7 +1,15 @@
+#if __linux__
+#define _GNU_SOURCE /* for pipe2() */
+#endif
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if __linux__
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include <zlx.h>
 
 #define ZLX_BODY
@@ -178,11 +186,1898 @@ int array_test ()
     c[8] = 0;
     if (!(zlx_cha_cmp(c, "aaaaaaa@", 8) > 0)) return 1;
     zlx_u8a_set(b, 4, 'b');
+    zlx_u8a_copy(b, (uint8_t const *) "0123456789", 10);
+    zlx_u8a_move(b + 2, b, 6);
+    if (memcmp(b, "0101234589", 10)) return 1;
+    zlx_u8a_move(b, b + 3, 7);
+    if (memcmp(b, "1234589589", 10)) return 1;
     // printf("c: \"%s\"\n", c);
     // printf("cmp: %d\n", );
     return 0;
 }
 
+/* std_realloc **************************************************************/
+static void * ZLX_CALL std_realloc
+(
+    void * old_ptr,
+    size_t old_size,
+    size_t new_size,
+    zlx_ma_t * restrict ma
+)
+{
+    (void) old_size; (void) ma;
+    if (new_size) return realloc(old_ptr, new_size);
+    free(old_ptr);
+    return NULL;
+}
+
+static zlx_ma_t std_ma =
+{
+    std_realloc,
+    zlx_ma_nop_info_set,
+    zlx_ma_nop_check
+};
+
+#if __linux__
+/* pth_start_t **************************************************************/
+typedef struct pth_start_s pth_start_t;
+struct pth_start_s
+{
+    zlx_thread_func_t func;
+    void * arg;
+};
+
+/* pth_main *****************************************************************/
+static void * pth_main (void * arg)
+{
+    pth_start_t st = *(pth_start_t *) arg;
+    free(arg);
+    return (void *) (uintptr_t) st.func(st.arg);
+}
+
+/* pth_create ***************************************************************/
+static zlx_mth_status_t ZLX_CALL pth_create
+(
+    zlx_tid_t * tid_p,
+    zlx_thread_func_t func,
+    void * arg
+)
+{
+    pthread_t t;
+    pth_start_t * st = malloc(sizeof(pth_start_t));
+    if (!st) return ZLX_MTH_NO_MEM;
+    st->func = func;
+    st->arg = arg;
+    if (pthread_create(&t, NULL, pth_main, st))
+    {
+        free(st);
+        return ZLX_MTH_NO_RES;
+    }
+    *tid_p = (zlx_tid_t) t;
+    return ZLX_MTH_OK;
+}
+
+/* pth_join *****************************************************************/
+static zlx_mth_status_t ZLX_CALL pth_join
+(
+    zlx_tid_t tid,
+    uint8_t * ret_val_p
+)
+{
+    void * rv;
+    if (pthread_join((pthread_t) tid, &rv)) return ZLX_MTH_FAILED;
+    if (ret_val_p) *ret_val_p = (uint8_t) (uintptr_t) rv;
+    return ZLX_MTH_OK;
+}
+
+static void ZLX_CALL pth_mutex_init (zlx_mutex_t * m)
+{
+    pthread_mutex_init((pthread_mutex_t *) m, NULL);
+}
+
+static void ZLX_CALL pth_mutex_finish (zlx_mutex_t * m)
+{
+    pthread_mutex_destroy((pthread_mutex_t *) m);
+}
+
+static void ZLX_CALL pth_mutex_lock (zlx_mutex_t * m)
+{
+    pthread_mutex_lock((pthread_mutex_t *) m);
+}
+
+static void ZLX_CALL pth_mutex_unlock (zlx_mutex_t * m)
+{
+    pthread_mutex_unlock((pthread_mutex_t *) m);
+}
+
+static zlx_mth_status_t ZLX_CALL pth_cond_init (zlx_cond_t * c)
+{
+    return pthread_cond_init((pthread_cond_t *) c, NULL)
+        ? ZLX_MTH_NO_RES : ZLX_MTH_OK;
+}
+
+static void ZLX_CALL pth_cond_finish (zlx_cond_t * c)
+{
+    pthread_cond_destroy((pthread_cond_t *) c);
+}
+
+static void ZLX_CALL pth_cond_signal (zlx_cond_t * c)
+{
+    pthread_cond_signal((pthread_cond_t *) c);
+}
+
+static void ZLX_CALL pth_cond_wait (zlx_cond_t * c, zlx_mutex_t * m)
+{
+    pthread_cond_wait((pthread_cond_t *) c, (pthread_mutex_t *) m);
+}
+
+static zlx_mth_status_t ZLX_CALL pth_tls_create
+(
+    zlx_tls_key_t * key_p,
+    zlx_tls_dtor_t dtor
+)
+{
+    pthread_key_t k;
+    if (pthread_key_create(&k, dtor)) return ZLX_MTH_NO_RES;
+    *key_p = k;
+    return ZLX_MTH_OK;
+}
+
+static void ZLX_CALL pth_tls_destroy (zlx_tls_key_t key)
+{
+    pthread_key_delete((pthread_key_t) key);
+}
+
+static void * ZLX_CALL pth_tls_get (zlx_tls_key_t key)
+{
+    return pthread_getspecific((pthread_key_t) key);
+}
+
+static zlx_mth_status_t ZLX_CALL pth_tls_set (zlx_tls_key_t key, void * v)
+{
+    return pthread_setspecific((pthread_key_t) key, v)
+        ? ZLX_MTH_NO_MEM : ZLX_MTH_OK;
+}
+
+/* pthread based multithreading interface for the multithreaded tests */
+static zlx_mth_xfc_t pth_mth =
+{
+    { pth_create, pth_join, NULL },
+    {
+        pth_mutex_init, pth_mutex_finish, pth_mutex_lock, pth_mutex_unlock,
+        sizeof(pthread_mutex_t), NULL
+    },
+    {
+        pth_cond_init, pth_cond_finish, pth_cond_signal, pth_cond_wait,
+        sizeof(pthread_cond_t)
+    },
+    { pth_tls_create, pth_tls_destroy, pth_tls_get, pth_tls_set }
+};
+
+/* spin_until ***************************************************************/
+/**
+ *  Waits for @a *p to reach @a v, giving up after about 5 seconds.
+ *  @returns 0 if the value was reached
+ */
+static int spin_until (uint32_t * p, uint32_t v)
+{
+    unsigned int i;
+    for (i = 0; i < 50000; ++i)
+    {
+        if (zlx_atomic_load_u32(p) >= v) return 0;
+        usleep(100);
+    }
+    return 1;
+}
+#endif
+
+static unsigned int fiber_trace[64];
+static unsigned int fiber_trace_len;
+static zlx_fiber_t * parked_fiber;
+static int fiber_pipe[2];
+
+/* fiber_yielder ************************************************************/
+static void ZLX_CALL fiber_yielder (zlx_fiber_t * self, void * arg)
+{
+    unsigned int i;
+    for (i = 0; i < 3; ++i)
+    {
+        fiber_trace[fiber_trace_len++] = (unsigned int) (uintptr_t) arg;
+        zlx_fiber_yield(self);
+    }
+}
+
+/* fiber_park_hook **********************************************************/
+static void ZLX_CALL fiber_park_hook (zlx_fiber_t * fiber, void * ctx)
+{
+    (void) ctx;
+    parked_fiber = fiber;
+}
+
+/* fiber_parker *************************************************************/
+static void ZLX_CALL fiber_parker (zlx_fiber_t * self, void * arg)
+{
+    (void) arg;
+    zlx_fiber_park(self, fiber_park_hook, NULL);
+    fiber_trace[fiber_trace_len++] = 10;
+}
+
+/* fiber_unparker ***********************************************************/
+static void ZLX_CALL fiber_unparker (zlx_fiber_t * self, void * arg)
+{
+    (void) self; (void) arg;
+    fiber_trace[fiber_trace_len++] = 11;
+    zlx_fiber_unpark(parked_fiber);
+}
+
+#if __linux__
+/* fiber_reader *************************************************************/
+static void ZLX_CALL fiber_reader (zlx_fiber_t * self, void * arg)
+{
+    char c = 0;
+    (void) arg;
+    if (zlx_fiber_wait_fd(self, fiber_pipe[0], ZLXF_READ) == ZLXF_READ
+        && read(fiber_pipe[0], &c, 1) == 1)
+        fiber_trace[fiber_trace_len++] = (unsigned char) c;
+}
+
+/* fiber_writer *************************************************************/
+static void ZLX_CALL fiber_writer (zlx_fiber_t * self, void * arg)
+{
+    (void) self; (void) arg;
+    fiber_trace[fiber_trace_len++] = 20;
+    if (write(fiber_pipe[1], "x", 1) != 1) fiber_trace_len = 0;
+}
+#endif
+
+/* fiber_test ***************************************************************/
+int fiber_test ()
+{
+    static unsigned int const expected[] =
+        { 1, 2, 11,
+#if __linux__
+            20,
+#endif
+            1, 2, 10, 1, 2,
+#if __linux__
+            'x'
+#endif
+        };
+    zlx_fsched_t fs;
+    zlx_ma_t * ma;
+    unsigned int i;
+
+    ma = zlx_alloctrk_create(&std_ma, zlx_default_log);
+    if (!ma) return 2;
+    if (zlx_fsched_init(&fs, ma, NULL, 0)) return 1;
+    if (zlx_fsched_spawn(&fs, fiber_yielder, (void *) 1)) return 1;
+    if (zlx_fsched_spawn(&fs, fiber_yielder, (void *) 2)) return 1;
+    if (zlx_fsched_spawn(&fs, fiber_parker, NULL)) return 1;
+    if (zlx_fsched_spawn(&fs, fiber_unparker, NULL)) return 1;
+#if __linux__
+    if (pipe(fiber_pipe)) return 2;
+    if (zlx_fsched_spawn(&fs, fiber_reader, NULL)) return 1;
+    if (zlx_fsched_spawn(&fs, fiber_writer, NULL)) return 1;
+#endif
+    if (zlx_fsched_run(&fs, 1)) return 1;
+    zlx_fsched_finish(&fs);
+#if __linux__
+    close(fiber_pipe[0]);
+    close(fiber_pipe[1]);
+#endif
+    if (fiber_trace_len != ZLX_ITEM_COUNT(expected)) return 1;
+    for (i = 0; i < fiber_trace_len; ++i)
+        if (fiber_trace[i] != expected[i]) return 1;
+    if (zlx_alloctrk_get_count(ma)) return 1;
+    zlx_alloctrk_destroy(ma);
+    return 0;
+}
+
+static unsigned int evloop_trace[8];
+static unsigned int evloop_trace_len;
+
+/* evloop_timer_func ********************************************************/
+static void ZLX_CALL evloop_timer_func (zlx_evloop_t * loop, zlx_evtimer_t * t)
+{
+    (void) loop;
+    evloop_trace[evloop_trace_len++] = (unsigned int) (uintptr_t) t->ctx;
+}
+
+/* evloop_wake_func *********************************************************/
+static void ZLX_CALL evloop_wake_func (zlx_evloop_t * loop, void * ctx)
+{
+    (void) ctx;
+    evloop_trace[evloop_trace_len++] = 0;
+    zlx_evloop_stop(loop);
+}
+
+#if __linux__
+static uint32_t fiber_mt_steps;
+static uint32_t fiber_mt_flag;
+static uint32_t fiber_mt_done;
+static zlx_fiber_t * fiber_mt_parked;
+static int fiber_mt_pipe[2];
+
+/* fiber_mt_yielder *********************************************************/
+static void ZLX_CALL fiber_mt_yielder (zlx_fiber_t * self, void * arg)
+{
+    unsigned int i;
+    (void) arg;
+    for (i = 0; i < 100; ++i)
+    {
+        zlx_atomic_add_u32(&fiber_mt_steps, 1);
+        zlx_fiber_yield(self);
+    }
+}
+
+/* fiber_mt_spinner *********************************************************/
+/**
+ *  Blocks its worker until fiber_mt_setter() ran, which needs a second
+ *  worker.
+ */
+static void ZLX_CALL fiber_mt_spinner (zlx_fiber_t * self, void * arg)
+{
+    (void) self; (void) arg;
+    if (!spin_until(&fiber_mt_flag, 1)) zlx_atomic_add_u32(&fiber_mt_done, 1);
+}
+
+/* fiber_mt_setter **********************************************************/
+static void ZLX_CALL fiber_mt_setter (zlx_fiber_t * self, void * arg)
+{
+    (void) self; (void) arg;
+    zlx_atomic_store_u32(&fiber_mt_flag, 1);
+}
+
+/* fiber_mt_park_hook *******************************************************/
+static void ZLX_CALL fiber_mt_park_hook (zlx_fiber_t * fiber, void * ctx)
+{
+    (void) ctx;
+    zlx_atomic_xchg_ptr((void * *) &fiber_mt_parked, fiber);
+}
+
+/* fiber_mt_parker **********************************************************/
+static void ZLX_CALL fiber_mt_parker (zlx_fiber_t * self, void * arg)
+{
+    (void) arg;
+    zlx_fiber_park(self, fiber_mt_park_hook, NULL);
+    zlx_atomic_add_u32(&fiber_mt_done, 0x10);
+}
+
+/* fiber_mt_reader **********************************************************/
+static void ZLX_CALL fiber_mt_reader (zlx_fiber_t * self, void * arg)
+{
+    char c = 0;
+    (void) arg;
+    if (zlx_fiber_wait_fd(self, fiber_mt_pipe[0], ZLXF_READ) == ZLXF_READ
+        && read(fiber_mt_pipe[0], &c, 1) == 1 && c == 'x')
+        zlx_atomic_add_u32(&fiber_mt_done, 0x100);
+}
+
+/* fiber_mt_waker ***********************************************************/
+/**
+ *  Thread outside of the scheduler unparking a fiber and feeding the pipe
+ *  polled by another.
+ */
+static uint_fast8_t ZLX_CALL fiber_mt_waker (void * arg)
+{
+    zlx_fiber_t * f;
+    unsigned int i;
+    (void) arg;
+    for (i = 0; !(f = zlx_atomic_load_ptr((void * *) &fiber_mt_parked)); ++i)
+    {
+        if (i == 50000) return 1;
+        usleep(100);
+    }
+    zlx_fiber_unpark(f);
+    usleep(1000);
+    return write(fiber_mt_pipe[1], "x", 1) != 1;
+}
+
+/* fiber_mt_test ************************************************************/
+int fiber_mt_test ()
+{
+    zlx_fsched_t fs;
+    zlx_ma_t * ma;
+    zlx_tid_t tid;
+    uint8_t rv;
+    unsigned int i;
+    zlx_mth_status_t st;
+
+    ma = zlx_alloctrk_create(&std_ma, zlx_default_log);
+    if (!ma) return 2;
+    if (pipe(fiber_mt_pipe)) return 2;
+    st = zlx_fsched_init(&fs, ma, &pth_mth, 0);
+    if (st) return 1;
+    for (i = 0; i < 8; ++i)
+        if (zlx_fsched_spawn(&fs, fiber_mt_yielder, NULL)) return 1;
+    if (zlx_fsched_spawn(&fs, fiber_mt_spinner, NULL)
+        || zlx_fsched_spawn(&fs, fiber_mt_setter, NULL)
+        || zlx_fsched_spawn(&fs, fiber_mt_parker, NULL)
+        || zlx_fsched_spawn(&fs, fiber_mt_reader, NULL)) return 1;
+    if (pth_mth.thread.create(&tid, fiber_mt_waker, NULL)) return 2;
+    st = zlx_fsched_run(&fs, 4);
+    if (pth_mth.thread.join(tid, &rv) || rv) return 1;
+    if (st) return 1;
+    zlx_fsched_finish(&fs);
+    close(fiber_mt_pipe[0]);
+    close(fiber_mt_pipe[1]);
+    if (fiber_mt_steps != 800 || fiber_mt_done != 0x111) return 1;
+    if (zlx_alloctrk_get_count(ma)) return 1;
+    zlx_alloctrk_destroy(ma);
+    return 0;
+}
+#endif
+
+/* evloop_test **************************************************************/
+int evloop_test ()
+{
+    zlx_evloop_t loop;
+    zlx_evtimer_t t[3];
+    uint64_t now;
+    unsigned int i;
+
+    if (zlx_evloop_init(&loop, &std_ma)) return 1;
+    now = zlx_evloop_now(&loop);
+    for (i = 0; i < 3; ++i)
+    {
+        zlx_evtimer_init(&t[i], evloop_timer_func, (void *) (uintptr_t) (i + 1));
+        if (zlx_evtimer_start(&loop, &t[i], now + ((i + 2) % 3) * ZLX_NS_PER_MS))
+            return 1;
+    }
+    zlx_evtimer_stop(&loop, &t[1]);
+    while (evloop_trace_len < 2)
+        if (zlx_evloop_run_once(&loop, -1) < 0) return 1;
+    zlx_evloop_set_wake_func(&loop, evloop_wake_func, NULL);
+    zlx_evloop_wakeup(&loop);
+    if (zlx_evloop_run(&loop)) return 1;
+    zlx_evloop_finish(&loop);
+    if (evloop_trace_len != 3 || evloop_trace[0] != 3 || evloop_trace[1] != 1
+        || evloop_trace[2] != 0) return 1;
+    return 0;
+}
+
+static uint64_t twheel_trace[8];
+static unsigned int twheel_trace_len;
+
+/* twheel_timer_func ********************************************************/
+static void ZLX_CALL twheel_timer_func (zlx_twheel_t * tw, zlx_twtimer_t * t)
+{
+    twheel_trace[twheel_trace_len++] = tw->now;
+    /* the timer with a context re-arms itself once */
+    if (t->ctx) { t->ctx = NULL; zlx_twheel_add(tw, t, tw->now + 100); }
+}
+
+/* twheel_test **************************************************************/
+int twheel_test ()
+{
+    static uint64_t const expires[] = { 70, 5, 4100, 300000, 3, 70 };
+    static uint64_t const expected[] = { 5, 70, 70, 170, 4100, 300000 };
+    zlx_twheel_t tw;
+    zlx_twtimer_t t[ZLX_ITEM_COUNT(expires)];
+    unsigned int i;
+
+    zlx_twheel_init(&tw, 1);
+    for (i = 0; i < ZLX_ITEM_COUNT(expires); ++i)
+    {
+        zlx_twtimer_init(&t[i], twheel_timer_func, i ? NULL : &tw);
+        zlx_twheel_add(&tw, &t[i], expires[i]);
+    }
+    zlx_twheel_cancel(&tw, &t[4]);
+    if (zlx_twheel_next_expiry(&tw) != 5) return 1;
+    if (zlx_twheel_advance(&tw, 69) != 1) return 1;
+    if (zlx_twheel_advance(&tw, 5000) != 4) return 1;
+    if (tw.count != 1 || zlx_twheel_next_expiry(&tw) > 300000) return 1;
+    if (zlx_twheel_advance(&tw, (uint64_t) 1 << 40) != 1) return 1;
+    if (tw.count || zlx_twheel_next_expiry(&tw) != UINT64_MAX) return 1;
+    if (twheel_trace_len != ZLX_ITEM_COUNT(expected)) return 1;
+    for (i = 0; i < twheel_trace_len; ++i)
+        if (twheel_trace[i] != expected[i]) return 1;
+    return 0;
+}
+
+/* percpu_test **************************************************************/
+int percpu_test ()
+{
+    zlx_percpu_t pc;
+    unsigned int i, n;
+
+    if (zlx_percpu_init(&pc, &std_ma, sizeof(uint64_t))) return 1;
+    n = zlx_cpu_count();
+    if (pc.count != n || pc.stride != ZLX_CACHE_LINE_SIZE) return 1;
+    if (((uintptr_t) pc.base & (ZLX_CACHE_LINE_SIZE - 1))) return 1;
+    if (zlx_cpu_current() >= n) return 1;
+    for (i = 0; i < 1000; ++i) *(uint64_t *) zlx_percpu_local(&pc) += 1;
+    for (i = 0; i < n; ++i)
+        *(uint64_t *) zlx_percpu_slot(&pc, 0) +=
+            i ? *(uint64_t *) zlx_percpu_slot(&pc, i) : 0;
+    if (*(uint64_t *) zlx_percpu_slot(&pc, 0) != 1000) return 1;
+    zlx_percpu_finish(&pc);
+    return 0;
+}
+
+/* topo_test ****************************************************************/
+int topo_test ()
+{
+    zlx_topo_t topo;
+    unsigned int * cpus;
+    unsigned int i, n;
+
+    if (zlx_topo_init(&topo, &std_ma)) return 1;
+    if (!topo.cpu_count || !topo.core_count
+        || topo.core_count > topo.cpu_count) return 1;
+    cpus = malloc(topo.cpu_count * sizeof(unsigned int));
+    if (!cpus) return 1;
+    if (zlx_topo_core_cpus(&topo, cpus) != topo.core_count) return 1;
+    for (i = 1; i < topo.core_count; ++i)
+        if (zlx_topo_distance(&topo, cpus[i - 1], cpus[i])
+            <= ZLX_TOPO_SAME_CORE) return 1;
+    n = zlx_topo_steal_order(&topo, 0, cpus);
+    if (n != topo.cpu_count - 1) return 1;
+    for (i = 1; i < n; ++i)
+        if (zlx_topo_distance(&topo, 0, cpus[i - 1])
+            > zlx_topo_distance(&topo, 0, cpus[i])) return 1;
+    free(cpus);
+    zlx_topo_finish(&topo);
+    return 0;
+}
+
+#if __linux__
+/* sync_mt_t ****************************************************************/
+typedef struct sync_mt_s sync_mt_t;
+struct sync_mt_s
+{
+    zlx_sema_t sema;
+    zlx_latch_t latch;
+    zlx_barrier_t barrier;
+    uint32_t taken;
+    uint32_t arrived;
+    uint32_t leaders;
+    uint32_t errors;
+};
+
+#define SYNC_MT_THREADS 4
+#define SYNC_MT_UNITS 200
+#define SYNC_MT_PHASES 50
+
+/* sync_mt_worker ***********************************************************/
+static uint_fast8_t ZLX_CALL sync_mt_worker (void * arg)
+{
+    sync_mt_t * s = arg;
+    unsigned int i;
+
+    for (i = 0; i < SYNC_MT_UNITS; ++i)
+    {
+        zlx_sema_wait(&s->sema);
+        zlx_atomic_add_u32(&s->taken, 1);
+    }
+    for (i = 0; i < SYNC_MT_PHASES; ++i)
+    {
+        zlx_atomic_add_u32(&s->arrived, 1);
+        if (zlx_barrier_wait(&s->barrier))
+            zlx_atomic_add_u32(&s->leaders, 1);
+        if (zlx_atomic_load_u32(&s->arrived) < (i + 1) * SYNC_MT_THREADS)
+            zlx_atomic_add_u32(&s->errors, 1);
+    }
+    zlx_latch_count_down(&s->latch, 1);
+    return 0;
+}
+
+/* sync_mt_run **************************************************************/
+/**
+ *  Runs the primitives with threads blocking on them.
+ *  @param mth [in]
+ *      backend for the primitives; NULL for futexes
+ */
+static int sync_mt_run (zlx_mth_xfc_t * mth)
+{
+    sync_mt_t s;
+    zlx_tid_t tid[SYNC_MT_THREADS];
+    unsigned int i;
+
+    memset(&s, 0, sizeof(s));
+    if (zlx_sema_init(&s.sema, &std_ma, mth, 0)
+        || zlx_latch_init(&s.latch, &std_ma, mth, SYNC_MT_THREADS)
+        || zlx_barrier_init(&s.barrier, &std_ma, mth, SYNC_MT_THREADS))
+        return 1;
+    for (i = 0; i < SYNC_MT_THREADS; ++i)
+        if (pth_mth.thread.create(&tid[i], sync_mt_worker, &s)) return 2;
+    /* the workers must block before the first unit comes */
+    if (spin_until(mth ? &s.sema.base.sleepers : &s.sema.waiters, 1))
+        return 1;
+    /* then trickle the units so that they keep blocking */
+    for (i = 0; i < SYNC_MT_THREADS * SYNC_MT_UNITS; ++i)
+    {
+        zlx_sema_post(&s.sema, 1);
+        if (!(i & 0x3F)) usleep(500);
+    }
+    zlx_latch_wait(&s.latch);
+    if (!zlx_latch_try_wait(&s.latch)) return 1;
+    for (i = 0; i < SYNC_MT_THREADS; ++i)
+        if (pth_mth.thread.join(tid[i], NULL)) return 1;
+    if (s.taken != SYNC_MT_THREADS * SYNC_MT_UNITS || s.sema.count
+        || s.leaders != SYNC_MT_PHASES || s.errors) return 1;
+    zlx_sema_finish(&s.sema);
+    zlx_latch_finish(&s.latch);
+    zlx_barrier_finish(&s.barrier);
+    return 0;
+}
+#endif
+
+/* sync_test ****************************************************************/
+int sync_test ()
+{
+    zlx_sema_t sema;
+    zlx_latch_t latch;
+    zlx_barrier_t barrier;
+
+    if (zlx_sema_init(&sema, &std_ma, &zlx_nosup_mth_xfc, 1) != ZLX_MTH_NO_SUP)
+        return 1;
+#if __linux__
+    if (zlx_sema_init(&sema, &std_ma, NULL, 2)) return 1;
+    if (!zlx_sema_try_wait(&sema) || !zlx_sema_try_wait(&sema)
+        || zlx_sema_try_wait(&sema)) return 1;
+    zlx_sema_post(&sema, 1);
+    zlx_sema_wait(&sema);
+    if (sema.count) return 1;
+    zlx_sema_finish(&sema);
+
+    if (zlx_latch_init(&latch, &std_ma, NULL, 2)) return 1;
+    zlx_latch_count_down(&latch, 1);
+    if (zlx_latch_try_wait(&latch)) return 1;
+    zlx_latch_count_down(&latch, 1);
+    zlx_latch_wait(&latch);
+    zlx_latch_finish(&latch);
+
+    if (zlx_barrier_init(&barrier, &std_ma, NULL, 1)) return 1;
+    if (zlx_barrier_wait(&barrier) != 1 || zlx_barrier_wait(&barrier) != 1
+        || barrier.phase != 2) return 1;
+    zlx_barrier_finish(&barrier);
+
+    /* contended, with futexes and with the mutex + condition fallback */
+    if (sync_mt_run(NULL) || sync_mt_run(&pth_mth)) return 1;
+#else
+    (void) latch; (void) barrier;
+#endif
+    return 0;
+}
+
+/* lockprof_test ************************************************************/
+int lockprof_test ()
+{
+    zlx_lockprof_t lp;
+    zlx_mutex_t * a;
+    zlx_mutex_t * b;
+    zlx_lockstat_t * st;
+    zlx_sbw_t sbw;
+    uint8_t buf[0x400];
+    unsigned int i;
+
+    if (zlx_lockprof_init(&lp, &std_ma, &zlx_nosup_mth_xfc.mutex)) return 1;
+    a = zlx_mutex_create(&std_ma, &lp.xfc, "test mutex a");
+    b = zlx_mutex_create(&std_ma, &lp.xfc, "test mutex b");
+    if (!a || !b) return 1;
+    for (i = 0; i < 3; ++i) { lp.xfc.lock(a); lp.xfc.unlock(a); }
+    lp.xfc.lock(b); lp.xfc.unlock(b);
+    for (st = lp.stats; st; st = st->next)
+        if (st->acquisitions != (!strcmp(st->info, "test mutex a") ? 3
+                                 : !strcmp(st->info, "test mutex b")))
+            return 1;
+    zlx_sbw_init(&sbw, buf, sizeof(buf) - 1);
+    if (zlx_lockprof_dump(&lp, zlx_sbw_write, &sbw)) return 1;
+    buf[sbw.size] = 0;
+    if (!strstr((char *) buf, "test mutex a") || !strstr((char *) buf, "contended"))
+        return 1;
+    zlx_mutex_destroy(a, &std_ma, &lp.xfc);
+    zlx_mutex_destroy(b, &std_ma, &lp.xfc);
+    zlx_lockprof_finish(&lp);
+    return 0;
+}
+
+static unsigned int future_trace[8];
+static unsigned int future_trace_len;
+
+/* future_cont **************************************************************/
+static void ZLX_CALL future_cont (zlx_future_t * f, zlx_fcont_t * c)
+{
+    future_trace[future_trace_len++] = (unsigned int) (uintptr_t) c->ctx
+        + (unsigned int) (uintptr_t) f->value;
+}
+
+/* future_waiter ************************************************************/
+static void ZLX_CALL future_waiter (zlx_fiber_t * self, void * arg)
+{
+    future_trace[future_trace_len++] = 100;
+    zlx_future_fiber_wait(arg, self);
+    future_trace[future_trace_len++] = 101;
+}
+
+/* future_setter ************************************************************/
+static void ZLX_CALL future_setter (zlx_fiber_t * self, void * arg)
+{
+    (void) self;
+    future_trace[future_trace_len++] = 200;
+    zlx_future_set_value(arg, (void *) 10);
+}
+
+/* future_test **************************************************************/
+int future_test ()
+{
+    static unsigned int const expected[] = { 11, 12, 13, 100, 200, 24, 101 };
+    zlx_future_t f;
+    zlx_fcont_t c[3];
+    zlx_fsched_t fs;
+    zlx_fiber_executor_t fe;
+    unsigned int i;
+
+    zlx_future_init(&f);
+    zlx_fcont_init(&c[0], future_cont, (void *) 10, NULL);
+    zlx_fcont_init(&c[1], future_cont, (void *) 11, NULL);
+    zlx_future_then(&f, &c[0]);
+    zlx_future_then(&f, &c[1]);
+    if (zlx_future_is_ready(&f) || future_trace_len) return 1;
+    if (zlx_future_set_value(&f, (void *) 1)) return 1;
+    if (!zlx_future_set_error(&f, 5) || f.error) return 1;
+    zlx_fcont_init(&c[2], future_cont, (void *) 12, NULL);
+    zlx_future_then(&f, &c[2]);
+    if (zlx_future_wait(&f, &std_ma, &zlx_nosup_mth_xfc)) return 1;
+
+    if (zlx_fsched_init(&fs, &std_ma, NULL, 0)) return 1;
+    zlx_fiber_executor_init(&fe, &fs);
+    zlx_future_init(&f);
+    zlx_fcont_init(&c[0], future_cont, (void *) 14, &fe.exec);
+    zlx_future_then(&f, &c[0]);
+    if (zlx_fsched_spawn(&fs, future_waiter, &f) == ZLX_MTH_NO_SUP)
+    {
+        zlx_fsched_finish(&fs);
+        return 0;
+    }
+    if (zlx_fsched_spawn(&fs, future_setter, &f)) return 1;
+    if (zlx_fsched_run(&fs, 1)) return 1;
+    zlx_fsched_finish(&fs);
+
+    if (future_trace_len != ZLX_ITEM_COUNT(expected)) return 1;
+    for (i = 0; i < future_trace_len; ++i)
+        if (future_trace[i] != expected[i]) return 1;
+    return 0;
+}
+
+/* tee_fail_write ***********************************************************/
+static ptrdiff_t ZLX_CALL tee_fail_write
+(
+    void * obj,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    (void) obj; (void) data; (void) size;
+    return -1;
+}
+
+/* tee_test *****************************************************************/
+int tee_test ()
+{
+    zlx_tee_t tee;
+    zlx_tee_target_t t[4];
+    zlx_sbw_t sbw[2];
+    uint8_t out[2][40];
+    uint8_t stage[8];
+
+    zlx_tee_target_init(&t[0], zlx_sbw_write,
+                        zlx_sbw_init(&sbw[0], out[0], sizeof(out[0])),
+                        NULL, 0, ZLX_TEE_FAIL);
+    zlx_tee_target_init(&t[1], zlx_sbw_write,
+                        zlx_sbw_init(&sbw[1], out[1], sizeof(out[1])),
+                        stage, sizeof(stage), ZLX_TEE_FAIL);
+    zlx_tee_target_init(&t[2], tee_fail_write, NULL, NULL, 0, ZLX_TEE_DETACH);
+    zlx_tee_target_init(&t[3], tee_fail_write, NULL, NULL, 0, ZLX_TEE_IGNORE);
+    zlx_tee_init(&tee, t, 4);
+    if (zlx_tee_write(&tee, (uint8_t const *) "hello", 5) != 5) return 1;
+    if (sbw[0].size != 5 || sbw[1].size || t[1].buf_len != 5) return 1;
+    if (!t[2].detached || t[2].errors != 1 || t[3].errors != 1) return 1;
+    /* the staging buffer is flushed when the data does not fit */
+    if (zlx_tee_write(&tee, (uint8_t const *) ", world", 7) != 7) return 1;
+    if (sbw[1].size != 5 || t[1].buf_len != 7) return 1;
+    if (t[2].errors != 1 || t[3].errors != 2) return 1;
+    /* large writes go straight through */
+    if (zlx_tee_write(&tee, (uint8_t const *) " - 0123456789", 13) != 13)
+        return 1;
+    if (sbw[1].size != 25 || t[1].buf_len) return 1;
+    if (zlx_tee_flush(&tee)) return 1;
+    if (sbw[0].size != 25 || memcmp(out[0], "hello, world - 0123456789", 25))
+        return 1;
+    if (sbw[1].size != 25 || memcmp(out[0], out[1], 25)) return 1;
+
+    t[2].policy = ZLX_TEE_FAIL;
+    t[2].detached = 0;
+    if (zlx_tee_write(&tee, (uint8_t const *) "!", 1) != -1) return 1;
+    if (sbw[0].size != 26 || t[1].buf_len != 1) return 1;
+    return 0;
+}
+
+/* dbw_test *****************************************************************/
+int dbw_test ()
+{
+    zlx_dbw_t dbw;
+    uint8_t * p;
+    size_t size, cap, i;
+
+    zlx_dbw_init(&dbw, &std_ma);
+    if (zlx_fmt(zlx_dbw_write, &dbw, zlx_utf8_term_width, NULL,
+                "$s=$>6i", "value", 42)) return 1;
+    if (dbw.size != 12 || memcmp(dbw.data, "value=    42", 12)) return 1;
+    for (i = 0; i < 1000; ++i)
+        if (zlx_dbw_write(&dbw, (uint8_t const *) "0123456789", 10) != 10)
+            return 1;
+    if (dbw.size != 10012 || dbw.capacity < 10012) return 1;
+    if (memcmp(dbw.data + 10002, "0123456789", 10)) return 1;
+    if (zlx_dbw_shrink(&dbw) || dbw.capacity != 10012) return 1;
+
+    /* reset keeps the memory; reserve avoids reallocating */
+    p = dbw.data;
+    zlx_dbw_reset(&dbw);
+    if (dbw.size || dbw.data != p) return 1;
+    if (zlx_dbw_reserve(&dbw, 15000) || dbw.capacity < 15000) return 1;
+    p = dbw.data;
+    for (i = 0; i < 1500; ++i)
+        if (zlx_dbw_write(&dbw, (uint8_t const *) "0123456789", 10) != 10)
+            return 1;
+    if (dbw.size != 15000 || dbw.data != p) return 1;
+    if (zlx_dbw_reserve(&dbw, SIZE_MAX) != -1) return 1;
+
+    p = zlx_dbw_take(&dbw, &size, &cap);
+    if (!p || size != 15000 || cap < size || dbw.data || dbw.capacity)
+        return 1;
+    zlx_free(&std_ma, p, cap);
+    if (zlx_dbw_write(&dbw, (uint8_t const *) "x", 1) != 1) return 1;
+    zlx_dbw_finish(&dbw);
+    return 0;
+}
+
+typedef struct fmt_counter_s fmt_counter_t;
+struct fmt_counter_s
+{
+    unsigned int calls;
+    zlx_dbw_t dbw;
+};
+
+/* fmt_count_write **********************************************************/
+static ptrdiff_t ZLX_CALL fmt_count_write
+(
+    void * obj,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    fmt_counter_t * fc = obj;
+    ++fc->calls;
+    return zlx_dbw_write(&fc->dbw, data, size);
+}
+
+/* fmt_flags ****************************************************************/
+static unsigned int fmt_flags
+(
+    fmt_counter_t * fc,
+    unsigned int flags,
+    char const * fmt,
+    ...
+)
+{
+    va_list va;
+    unsigned int rc;
+
+    va_start(va, fmt);
+    rc = zlx_vfmt_flags(fmt_count_write, fc, zlx_utf8_term_width, NULL,
+                        flags, fmt, va);
+    va_end(va);
+    return rc;
+}
+
+/* fmt_exec_args ************************************************************/
+static unsigned int fmt_exec_args
+(
+    fmt_counter_t * fc,
+    zlx_fmt_op_t const * ops,
+    size_t count,
+    ...
+)
+{
+    va_list va;
+    unsigned int rc;
+
+    va_start(va, count);
+    rc = zlx_fmt_exec(ops, count, fmt_count_write, fc, zlx_utf8_term_width,
+                      NULL, 0, va);
+    va_end(va);
+    return rc;
+}
+
+/* fmt_test *****************************************************************/
+int fmt_test ()
+{
+    static char const fmt[] = "[$.*s|$08Xq|$x/4 W|$>6.3es|$Q|$<4c] done";
+    fmt_counter_t w;
+    zlx_dbw_t ref;
+    zlx_fmt_op_t ops[20];
+    static char big[3000];
+    unsigned int flags, rc;
+    size_t n, i;
+
+    zlx_u8a_set((uint8_t *) big, sizeof(big) - 1, 'x');
+    for (flags = 0; flags <= ZLX_FMT_UNBUFFERED; ++flags)
+    {
+        w.calls = 0;
+        zlx_dbw_init(&w.dbw, &std_ma);
+        if (fmt_flags(&w, flags, "a=$i, b=$>70s|$<3i|", 12, "xy", 7))
+            return 1;
+        if (w.dbw.size != 83 || memcmp(w.dbw.data, "a=12, b=", 8)
+            || memcmp(w.dbw.data + 76, "xy|7  |", 7)) return 1;
+        if (flags ? w.calls < 8 : w.calls != 1) return 1;
+        /* large arguments go straight to the writer */
+        w.calls = 0;
+        zlx_dbw_reset(&w.dbw);
+        if (fmt_flags(&w, flags, "<$s>", big)) return 1;
+        if (w.dbw.size != sizeof(big) + 1 || w.calls != 3) return 1;
+        zlx_dbw_finish(&w.dbw);
+    }
+
+    /* compiled formats give the same output */
+    if (zlx_fmt_compile(ops, 20, "ok $k", &n) != ZLX_FMT_MALFORMED) return 1;
+    if (zlx_fmt_compile(ops, 2, fmt, &n) != ZLX_FMT_NO_SPACE || n != 13)
+        return 1;
+    if (zlx_fmt_compile(ops, 20, fmt, &n) || n != 13) return 1;
+    zlx_dbw_init(&w.dbw, &std_ma);
+    zlx_dbw_init(&ref, &std_ma);
+    if (fmt_flags(&w, 0, fmt, (size_t) 3, "abcdef", (uint64_t) 0xBEEF, -2,
+                  "a\nbc", (int64_t) -5, (uint32_t) 'z')) return 1;
+    if (w.dbw.size != 39
+        || memcmp(w.dbw.data, "[abc|0000BEEF|-0x2|  a\\nb|-5|z   ] done", 39))
+        return 1;
+    ref = w.dbw;
+    zlx_dbw_init(&w.dbw, &std_ma);
+    for (i = 0; i < 3; ++i)
+    {
+        zlx_dbw_reset(&w.dbw);
+        if (i == 0)
+            rc = fmt_exec_args(&w, ops, n, (size_t) 3, "abcdef",
+                               (uint64_t) 0xBEEF, -2, "a\nbc", (int64_t) -5,
+                               (uint32_t) 'z');
+        else
+            ZLX_FMT_CACHED(rc, fmt_count_write, &w, zlx_utf8_term_width, NULL,
+                           fmt, (size_t) 3, "abcdef", (uint64_t) 0xBEEF, -2,
+                           "a\nbc", (int64_t) -5, (uint32_t) 'z');
+        if (rc || w.dbw.size != ref.size
+            || memcmp(w.dbw.data, ref.data, ref.size)) return 1;
+    }
+    zlx_dbw_finish(&w.dbw);
+    zlx_dbw_finish(&ref);
+    return 0;
+}
+
+/* u64_to_str_test **********************************************************/
+int u64_to_str_test ()
+{
+    static uint32_t const widths[] = { 0, 1, 5, 19, 20, 21, 30 };
+    uint8_t buf[80];
+    char ref[80];
+    uint64_t v, p, seed = 1;
+    size_t n;
+    unsigned int i, j, k;
+
+    for (i = 0; i < 3 * 20 + 100; ++i)
+    {
+        if (i < 60)
+        {
+            for (p = 1, k = 0; k < i / 3; ++k) p *= 10;
+            v = p - 1 + i % 3;
+        }
+        else
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            v = seed >> (i % 64);
+        }
+        if (i == 61) v = UINT64_MAX;
+        for (j = 0; j < sizeof(widths) / sizeof(widths[0]); ++j)
+        {
+            n = zlx_u64_to_str(buf, v, 10, widths[j], 64, 0);
+            snprintf(ref, sizeof(ref), "%0*llu", (int) widths[j],
+                     (unsigned long long) v);
+            if (n != strlen(ref) || strcmp((char *) buf, ref)) return 1;
+            n = zlx_u64_to_str(buf, v, 16, widths[j], 0, 0);
+            snprintf(ref, sizeof(ref), "%0*llX", (int) widths[j],
+                     (unsigned long long) v);
+            if (n != strlen(ref) || strcmp((char *) buf, ref)) return 1;
+            n = zlx_u64_to_str(buf, v, 8, widths[j], 64, 0);
+            snprintf(ref, sizeof(ref), "%0*llo", (int) widths[j],
+                     (unsigned long long) v);
+            if (n != strlen(ref) || strcmp((char *) buf, ref)) return 1;
+        }
+    }
+    /* grouping takes the generic path */
+    n = zlx_u64_to_str(buf, 1234567, 10, 0, 3, '\'');
+    if (n != 9 || strcmp((char *) buf, "1'234'567")) return 1;
+    n = zlx_u64_to_str(buf, 0xABCDE, 16, 6, 4, '_');
+    if (n != 6 || strcmp((char *) buf, "A_BCDE")) return 1;
+    n = zlx_u64_to_str(buf, 12, 10, 3, 4, ',');
+    if (n != 3 || strcmp((char *) buf, "012")) return 1;
+    return 0;
+}
+
+/* u64_from_str_ref *********************************************************/
+/**
+ *  Digit by digit parser used as reference for zlx_u64_from_str().
+ */
+static uint_fast8_t u64_from_str_ref
+(
+    uint8_t const * str,
+    size_t len,
+    uint_fast8_t radix,
+    uint64_t * value,
+    size_t * used_len
+)
+{
+    size_t i = 0;
+    uint64_t v = 0;
+    int d;
+    uint_fast8_t r = 0;
+
+    if (!len) return ZLX_U64_STOP;
+    if (!radix)
+    {
+        radix = 10;
+        if (len > 1 && str[0] == '0')
+        {
+            if (str[1] == 'x') { radix = 16; i = 2; }
+            else if (str[1] == 'b') { radix = 2; i = 2; }
+            else if (str[1] == 'd') i = 2;
+        }
+    }
+    for (; i < len; ++i)
+    {
+        d = zlx_digit_from_char(str[i], radix);
+        if (d < 0) { r = ZLX_U64_STOP; break; }
+        if (v > (UINT64_MAX - d) / radix) { r = ZLX_U64_OVERFLOW; break; }
+        v = v * radix + d;
+    }
+    *value = v;
+    *used_len = i;
+    return r;
+}
+
+/* u64_from_str_test ********************************************************/
+int u64_from_str_test ()
+{
+    static char const chars[] = "0123456789012345678901234567890123456789"
+        "abcdefABCDEF0000000099999999ffffffffFFFFgGx,- ";
+    static uint8_t const radixes[] = { 10, 16, 0, 8, 36 };
+    static char const list[] = "12,0x1F,,7,18446744073709551616,5";
+    uint8_t buf[40];
+    uint64_t v, w, vals[4], seed = 7;
+    size_t n, m, i, len, k;
+    uint_fast8_t r;
+
+    for (k = 0; k < 40000; ++k)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        len = (seed >> 59) + ((seed >> 40) & 7);
+        for (i = 0; i < len; ++i)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            buf[i] = chars[(seed >> 33) % (sizeof(chars) - 1)];
+        }
+        if (k & 1 && len > 2) { buf[0] = '0'; buf[1] = 'x'; }
+        r = zlx_u64_from_str(buf, len, radixes[k % 5], &v, &n);
+        if (r != u64_from_str_ref(buf, len, radixes[k % 5], &w, &m)
+            || v != w || n != m) return 1;
+    }
+    if (zlx_u64_from_str((uint8_t const *) "18446744073709551615", 20, 10,
+                         &v, &n) || v != UINT64_MAX || n != 20) return 1;
+    if (zlx_u64_from_str((uint8_t const *) "18446744073709551616", 20, 10,
+                         &v, &n) != ZLX_U64_OVERFLOW
+        || v != UINT64_MAX / 10 || n != 19) return 1;
+    if (zlx_u64_from_str((uint8_t const *) "0x00000000000000000fedcba987654321",
+                         34, 0, &v, &n) || v != 0xFEDCBA987654321 || n != 34)
+        return 1;
+    if (zlx_u64_from_str((uint8_t const *) "FFFFFFFFFFFFFFFF0", 17, 16,
+                         &v, &n) != ZLX_U64_OVERFLOW
+        || v != UINT64_MAX || n != 16) return 1;
+
+    /* lists */
+    if (zlx_u64_list_from_str((uint8_t const *) list, 7, 0, ',', vals, 4,
+                              &n, &m) || n != 2 || m != 7
+        || vals[0] != 12 || vals[1] != 31) return 1;
+    if (zlx_u64_list_from_str((uint8_t const *) list, sizeof(list) - 1, 0,
+                              ',', vals, 4, &n, &m) != ZLX_U64_STOP
+        || n != 2 || m != 8) return 1;
+    if (zlx_u64_list_from_str((uint8_t const *) list + 9, sizeof(list) - 10,
+                              10, ',', vals, 4, &n, &m) != ZLX_U64_OVERFLOW
+        || n != 1 || vals[0] != 7 || m != 21) return 1;
+    if (zlx_u64_list_from_str((uint8_t const *) list + 9, 5, 10, ',', vals,
+                              1, &n, &m) != ZLX_U64_STOP || n != 1 || m != 2)
+        return 1;
+    if (zlx_u64_list_from_str((uint8_t const *) "1,2;3", 5, 10, ',', vals, 4,
+                              &n, &m) != ZLX_U64_STOP || n != 1 || m != 3)
+        return 1;
+    /* a trailing separator leaves an empty last field */
+    if (zlx_u64_list_from_str((uint8_t const *) "1,2,", 4, 10, ',', vals, 4,
+                              &n, &m) != ZLX_U64_STOP || n != 2 || m != 4
+        || vals[1] != 2) return 1;
+    m = 99;
+    if (zlx_u64_list_from_str((uint8_t const *) "", 0, 10, ',', vals, 4,
+                              &n, &m) != ZLX_U64_STOP || n || m) return 1;
+    return 0;
+}
+
+/* memfile_test *************************************************************/
+int memfile_test ()
+{
+    zlx_mem_file_t mf;
+    zlx_mem_chunk_t * it = NULL;
+    uint8_t buf[40];
+    uint8_t * d;
+    size_t len, total, n;
+
+    zlx_mem_file_init(&mf, &std_ma, 8);
+    if (zlx_fprint(&mf.base, "$s-", "abcdefghij") != 11) return 1;
+    if (zlx_fprint(&mf.base, "$i", 12345) != 5) return 1;
+    if (mf.size != 16 || mf.head == mf.tail) return 1;
+    if (zlx_seek64(&mf.base, 6, ZLXF_SET) != 6) return 1;
+    if (zlx_read(&mf.base, buf, 6) != 6 || memcmp(buf, "ghij-1", 6)) return 1;
+    /* writing past the end leaves a hole filled with zeroes */
+    if (zlx_pwrite(&mf.base, "xy", 2, 20) != 2 || mf.size != 22) return 1;
+    if (zlx_pread(&mf.base, buf, sizeof(buf), 14) != 8) return 1;
+    if (memcmp(buf, "45\0\0\0\0xy", 8)) return 1;
+    for (total = 0, n = 0; (d = zlx_mem_file_chunk(&mf, &it, &len)); ++n)
+    {
+        if (memcmp(d, "abcdefghij-12345\0\0\0\0xy" + total, len)) return 1;
+        total += len;
+    }
+    if (total != 22 || n < 2) return 1;
+
+    /* truncating drops blocks; stale data does not show up again */
+    if (zlx_seek64(&mf.base, 3, ZLXF_SET) != 3) return 1;
+    if (mf.base.fcls->truncate(&mf.base) || mf.head != mf.tail) return 1;
+    if (zlx_pwrite(&mf.base, "!", 1, 5) != 1) return 1;
+    if (zlx_pread(&mf.base, buf, sizeof(buf), 0) != 6) return 1;
+    if (memcmp(buf, "abc\0\0!", 6)) return 1;
+
+    if (zlx_seek64(&mf.base, 0, ZLXF_END) != 6) return 1;
+    if (zlx_write(&mf.base, "0123456789", 10) != 10) return 1;
+    if (zlx_mem_file_flatten(&mf, &d)) return 1;
+    if (mf.head != mf.tail || memcmp(d, "abc\0\0!0123456789", 16)) return 1;
+    zlx_mem_file_finish(&mf);
+    return 0;
+}
+
+/* records_test *************************************************************/
+int records_test ()
+{
+    zlx_mem_file_t mf;
+    zlx_rec_reader_t rr;
+    zlx_rec_t recs[7];
+    uint8_t * data;
+    size_t lens[40];
+    size_t i, j, n, k;
+    ptrdiff_t r;
+    int pass;
+
+    zlx_mem_file_init(&mf, &std_ma, 0);
+    for (i = 0; i < 40; ++i)
+    {
+        lens[i] = (i * 37) % 151;
+        for (j = 0; j < lens[i]; ++j)
+            if (zlx_write(&mf.base, "abcdefghijklmnopqrstuvwxyz" + (i + j) % 26, 1)
+                != 1) return 1;
+        if (i < 39 && zlx_write(&mf.base, "\n", 1) != 1) return 1;
+    }
+    if (zlx_mem_file_flatten(&mf, &data)) return 1;
+
+    for (pass = 0; pass < 2; ++pass)
+    {
+        if (pass) zlx_rec_reader_init_mem(&rr, data, mf.size, '\n');
+        else
+        {
+            if (zlx_seek64(&mf.base, 0, ZLXF_SET)) return 1;
+            if (zlx_rec_reader_init(&rr, &mf.base, &std_ma, 16, 256, '\n'))
+                return 1;
+        }
+        for (n = 0; (r = zlx_rec_batch(&rr, recs, 7)) > 0; )
+        {
+            for (k = 0; k < (size_t) r; ++k, ++n)
+            {
+                if (n >= 40 || recs[k].size != lens[n]) return 1;
+                for (j = 0; j < lens[n]; ++j)
+                    if (recs[k].data[j] != 'a' + (n + j) % 26) return 1;
+            }
+        }
+        if (r || n != 40) return 1;
+        zlx_rec_reader_finish(&rr);
+    }
+
+    /* records longer than the buffer limit */
+    if (zlx_seek64(&mf.base, 0, ZLXF_SET)) return 1;
+    if (zlx_rec_reader_init(&rr, &mf.base, &std_ma, 16, 64, '\n')) return 1;
+    while ((r = zlx_rec_next(&rr, recs)) > 0);
+    if (r != -ZLXF_SIZE_LIMIT) return 1;
+    zlx_rec_reader_finish(&rr);
+    zlx_mem_file_finish(&mf);
+    return 0;
+}
+
+/* lz_test ******************************************************************/
+int lz_test ()
+{
+    static zlx_lz_match_t m;
+    static zlx_lz_enc_t enc;
+    static zlx_lz_dec_t dec;
+    zlx_mem_file_t mf;
+    zlx_lz_file_t lf;
+    uint8_t * data;
+    uint8_t * z;
+    uint8_t * out;
+    uint8_t * d;
+    size_t n = 200000, i, zn, o, used, len;
+    uint32_t x = 1;
+    ptrdiff_t r;
+    uint_fast8_t rc;
+
+    data = malloc(n);
+    z = malloc(ZLX_LZ_BOUND(n) + 16 * ZLX_LZ_FRAME_HDR);
+    out = malloc(n);
+    if (!data || !z || !out) return 1;
+    /* repetitive text, then noise */
+    for (i = 0; i < n / 2; ++i)
+        data[i] = "the quick brown fox jumps over the lazy dog "
+            [i % 44 + (i / 1000 & 1)];
+    for (; i < n; ++i)
+    {
+        x = x * 1103515245 + 12345;
+        data[i] = (uint8_t) (x >> 16);
+    }
+
+    /* blocks */
+    zn = zlx_lz_compress(&m, data, n / 2, z, ZLX_LZ_BOUND(n / 2));
+    if (!zn || zn > n / 20) return 1;
+    if (zlx_lz_decompress(z, zn, out, n) != (ptrdiff_t) (n / 2)) return 1;
+    if (memcmp(out, data, n / 2)) return 1;
+    if (zlx_lz_decompress(z, zn, out, n / 2 - 1) != -1) return 1;
+    zn = zlx_lz_compress(&m, data + n / 2, n / 2, z, ZLX_LZ_BOUND(n / 2));
+    /* noise does not compress */
+    if (!zn || zlx_lz_compress(&m, data + n / 2, n / 2, z, n / 2)) return 1;
+    if (zlx_lz_decompress(z, zn, out, n) != (ptrdiff_t) (n / 2)) return 1;
+    if (memcmp(out, data + n / 2, n / 2)) return 1;
+
+    /* streams through small output buffers */
+    zlx_lz_enc_init(&enc);
+    for (i = zn = 0; i < n; i += used, zn += o)
+    {
+        rc = zlx_clconv_lz_compress(data + i, n - i, &used, z + zn, 1000, &o,
+                                    &enc);
+        if (rc != ZLX_CLCONV_OK && rc != ZLX_CLCONV_FULL) return 1;
+    }
+    do
+    {
+        rc = zlx_clconv_lz_compress(NULL, 0, &used, z + zn, 1000, &o, &enc);
+        zn += o;
+    }
+    while (rc == ZLX_CLCONV_FULL);
+    if (rc) return 1;
+    zlx_lz_dec_init(&dec);
+    for (i = len = 0; i < zn; i += used, len += o)
+    {
+        rc = zlx_clconv_lz_decompress(z + i, zn - i < 777 ? zn - i : 777,
+                                      &used, out + len, n - len, &o, &dec);
+        if (rc) return 1;
+    }
+    if (len != n || memcmp(out, data, n) || !dec.ended) return 1;
+    zlx_lz_dec_init(&dec);
+    /* the end marker is missing */
+    rc = zlx_clconv_lz_decompress(z, zn - 1, &used, out, n, &o, &dec);
+    if (rc || o != n) return 1;
+    rc = zlx_clconv_lz_decompress(NULL, 0, &used, out, n, &o, &dec);
+    if (rc != ZLX_CLCONV_INCOMPLETE) return 1;
+
+    /* compressed file over a memory file */
+    zlx_mem_file_init(&mf, &std_ma, 0);
+    if (zlx_lz_file_init(&lf, &mf.base, &std_ma, ZLXF_READ | ZLXF_WRITE)
+        != ZLXF_BAD_OPERATION) return 1;
+    if (zlx_lz_file_init(&lf, &mf.base, &std_ma, ZLXF_WRITE)) return 1;
+    for (i = 0; i < n; i += (size_t) r)
+    {
+        r = zlx_write(&lf.base, data + i, n - i < 3000 ? n - i : 3000);
+        if (r <= 0) return 1;
+    }
+    if (zlx_seek64(&lf.base, 0, ZLXF_CUR) != (int64_t) n) return 1;
+    if (lf.base.fcls->close(&lf.base, ZLXF_WRITE)) return 1;
+    zlx_lz_file_finish(&lf);
+    if (mf.size != zn || zlx_pread(&mf.base, z, zn, 0) != (ptrdiff_t) zn)
+        return 1;
+    if (zlx_seek64(&mf.base, 0, ZLXF_SET)) return 1;
+    if (zlx_lz_file_init(&lf, &mf.base, &std_ma, ZLXF_READ)) return 1;
+    for (len = 0; (r = zlx_read(&lf.base, out + len, n - len)) > 0; len += r);
+    if (r || len != n || memcmp(out, data, n)) return 1;
+    zlx_lz_file_finish(&lf);
+
+    /* corrupted data */
+    if (zlx_mem_file_flatten(&mf, &d)) return 1;
+    d[100] ^= 0x40;
+    if (zlx_seek64(&mf.base, 0, ZLXF_SET)) return 1;
+    if (zlx_lz_file_init(&lf, &mf.base, &std_ma, ZLXF_READ)) return 1;
+    while ((r = zlx_read(&lf.base, out, n)) > 0);
+    if (r != -ZLXF_BAD_DATA) return 1;
+    zlx_lz_file_finish(&lf);
+    zlx_mem_file_finish(&mf);
+    free(data);
+    free(z);
+    free(out);
+    return 0;
+}
+
+/* crc_ref ******************************************************************/
+static uint32_t crc_ref
+(
+    uint8_t const * p,
+    size_t n
+)
+{
+    uint32_t c = 0xFFFFFFFF;
+    unsigned int k;
+
+    for (; n; --n)
+        for (c ^= *p++, k = 0; k < 8; ++k)
+            c = c & 1 ? (c >> 1) ^ 0x82F63B78 : c >> 1;
+    return ~c;
+}
+
+/* crc32c_test **************************************************************/
+int crc32c_test ()
+{
+    zlx_mem_file_t mf;
+    zlx_crc_file_t cf;
+    zlx_iovec_t iov[2];
+    uint8_t * data;
+    uint8_t buf[1000];
+    size_t n = 100000, i, j;
+    uint32_t ref, c, x = 7;
+    ptrdiff_t r;
+
+    if (zlx_crc32c(0, "123456789", 9) != 0xE3069283) return 1;
+    if (zlx_crc32c(0, "", 0) != 0) return 1;
+    data = malloc(n);
+    if (!data) return 1;
+    for (i = 0; i < n; ++i)
+    {
+        x = x * 1103515245 + 12345;
+        data[i] = (uint8_t) (x >> 16);
+    }
+    /* odd sizes and alignments go through every stage */
+    for (i = 0; i < 4; ++i)
+    {
+        j = n - i * 12345 - i;
+        ref = crc_ref(data + i, j);
+        if (zlx_crc32c(0, data + i, j) != ref) return 1;
+        /* slice-by-8, which the hardware path hides on SSE4.2 hosts */
+        c = zlx_crc32c_sw(0, data + i, j / 2 + i);
+        if (zlx_crc32c_sw(c, data + i + j / 2 + i, j - j / 2 - i) != ref)
+            return 1;
+        c = zlx_crc32c(0, data + i, j / 3);
+        c = zlx_crc32c(c, data + i + j / 3, j - j / 3);
+        if (c != ref) return 1;
+        c = zlx_crc32c_combine(zlx_crc32c(0, data + i, 1000),
+                               zlx_crc32c(0, data + i + 1000, j - 1000),
+                               j - 1000);
+        if (c != ref) return 1;
+    }
+
+    zlx_mem_file_init(&mf, &std_ma, 0);
+    zlx_crc_file_init(&cf, &mf.base);
+    if (zlx_write(&cf.base, data, 777) != 777) return 1;
+    iov[0].data = data + 777;
+    iov[0].size = 1000;
+    iov[1].data = data + 1777;
+    iov[1].size = n - 1777;
+    if (zlx_writev(&cf.base, iov, 2) != (ptrdiff_t) (n - 777)) return 1;
+    if (cf.write_size != n || cf.write_crc != crc_ref(data, n)) return 1;
+    if (zlx_seek64(&cf.base, 0, ZLXF_SET)) return 1;
+    for (i = 0; (r = zlx_read(&cf.base, buf, sizeof(buf))) > 0; i += r)
+        if (memcmp(buf, data + i, r)) return 1;
+    if (r || i != n || cf.read_crc != cf.write_crc) return 1;
+    if (zlx_close(&cf.base)) return 1;
+    zlx_mem_file_finish(&mf);
+    free(data);
+    return 0;
+}
+
+#if __linux__
+/* fdfile_test **************************************************************/
+int fdfile_test ()
+{
+    static char const text[] = "hello world";
+    char path[] = "/tmp/zlx-fdfile-XXXXXX";
+    zlx_fd_file_t ff;
+    uint8_t buf[16];
+    int fd, p[2];
+
+    if (zlx_fd_file_open(&ff, "/nonexistent/zlx", ZLXF_READ)
+        != ZLXF_NOT_FOUND) return 1;
+    fd = mkstemp(path);
+    if (fd < 0) return 1;
+    unlink(path);
+    if (zlx_fd_file_wrap(&ff, fd, ZLXF_READ | ZLXF_WRITE | ZLX_FDF_OWN))
+        return 1;
+    if (!(ff.base.flags & ZLXF_SEEK)) return 1;
+    if (zlx_write(&ff.base, text, 11) != 11) return 1;
+    if (zlx_pwrite(&ff.base, "W", 1, 6) != 1) return 1;
+    if (zlx_pread(&ff.base, buf, sizeof(buf), 4) != 7) return 1;
+    if (memcmp(buf, "o World", 7)) return 1;
+    /* positional I/O leaves the file position alone */
+    if (zlx_seek64(&ff.base, 0, ZLXF_CUR) != 11) return 1;
+    if (zlx_seek64(&ff.base, 5, ZLXF_SET) != 5) return 1;
+    if (ff.base.fcls->truncate(&ff.base)) return 1;
+    if (zlx_seek64(&ff.base, 0, ZLXF_END) != 5) return 1;
+    if (zlx_read(&ff.base, buf, sizeof(buf)) != 0) return 1;
+    if (zlx_pread(&ff.base, buf, sizeof(buf), 0) != 5) return 1;
+    if (memcmp(buf, text, 5)) return 1;
+    if (zlx_close(&ff.base)) return 1;
+
+    if (pipe2(p, O_NONBLOCK)) return 1;
+    if (zlx_fd_file_wrap(&ff, p[0], ZLXF_READ | ZLX_FDF_OWN)) return 1;
+    if ((ff.base.flags & (ZLXF_SEEK | ZLXF_NONBLOCK)) != ZLXF_NONBLOCK)
+        return 1;
+    if (zlx_read(&ff.base, buf, 1) != -ZLXF_WOULD_BLOCK) return 1;
+    if (zlx_pread(&ff.base, buf, 1, 0) != -ZLXF_BAD_OPERATION) return 1;
+    if (zlx_close(&ff.base)) return 1;
+    close(p[1]);
+    return 0;
+}
+
+/* buffile_test *************************************************************/
+int buffile_test ()
+{
+    char path[] = "/tmp/zlx-buffile-XXXXXX";
+    zlx_fd_file_t ff;
+    zlx_buf_file_t bf;
+    uint8_t const * d;
+    uint8_t buf[16];
+    int fd;
+
+    fd = mkstemp(path);
+    if (fd < 0) return 1;
+    unlink(path);
+    if (zlx_fd_file_wrap(&ff, fd, ZLXF_READ | ZLXF_WRITE | ZLX_FDF_OWN))
+        return 1;
+    if (zlx_buf_file_init(&bf, &ff.base, &std_ma, 8)) return 1;
+    if (zlx_fprint(&bf.base, "$s-$i", "abc", 12) != 6) return 1;
+    /* coalesced writes stay in the buffer until it fills or is flushed */
+    if (zlx_pread(&ff.base, buf, sizeof(buf), 0) != 0) return 1;
+    /* data that does not fit leaves together with the pending data */
+    if (zlx_write(&bf.base, "xyz", 3) != 3) return 1;
+    if (zlx_buf_file_flush(&bf)) return 1;
+    if (zlx_pread(&ff.base, buf, sizeof(buf), 0) != 9) return 1;
+    if (memcmp(buf, "abc-12xyz", 9)) return 1;
+
+    if (zlx_seek64(&bf.base, 1, ZLXF_SET) != 1) return 1;
+    if (zlx_buf_file_peek(&bf, &d, 4) != 8) return 1;
+    if (memcmp(d, "bc-12xyz", 8)) return 1;
+    zlx_buf_file_consume(&bf, 3);
+    /* seeks inside the buffered data do not reach the wrapped file */
+    if (zlx_seek64(&bf.base, 0, ZLXF_CUR) != 4) return 1;
+    if (zlx_seek64(&bf.base, -2, ZLXF_CUR) != 2) return 1;
+    if (zlx_seek64(&ff.base, 0, ZLXF_CUR) != 9) return 1;
+    if (zlx_read(&bf.base, buf, 2) != 2 || memcmp(buf, "c-", 2)) return 1;
+    if (zlx_buf_file_peek(&bf, &d, 9) != -ZLXF_SIZE_LIMIT) return 1;
+    /* writing after reading continues at the logical position */
+    if (zlx_write(&bf.base, "34", 2) != 2) return 1;
+    if (bf.base.fcls->truncate(&bf.base)) return 1;
+    if (zlx_pread(&ff.base, buf, sizeof(buf), 0) != 6) return 1;
+    if (memcmp(buf, "abc-34", 6)) return 1;
+    if (zlx_close(&bf.base)) return 1;
+    zlx_buf_file_finish(&bf);
+    return 0;
+}
+
+/* writev_test **************************************************************/
+int writev_test ()
+{
+    zlx_iovec_t iov[4];
+    zlx_fd_file_t rf, wf;
+    zlx_buf_file_t bf;
+    uint8_t buf[0x20];
+    size_t w;
+    int p[2];
+    ptrdiff_t r;
+
+    if (pipe(p)) return 1;
+    if (zlx_fd_file_wrap(&rf, p[0], ZLXF_READ | ZLX_FDF_OWN)
+        || zlx_fd_file_wrap(&wf, p[1], ZLXF_WRITE | ZLX_FDF_OWN)) return 1;
+    if (zlx_buf_file_init(&bf, &wf.base, &std_ma, 8)) return 1;
+    iov[0].data = "ab"; iov[0].size = 2;
+    iov[1].data = ""; iov[1].size = 0;
+    iov[2].data = "cdefghij"; iov[2].size = 8;
+    iov[3].data = "\n"; iov[3].size = 1;
+    if (zlx_writev(&bf.base, iov, 2) != 2) return 1;
+    if (zlx_writev_full(&bf.base, iov + 2, 2, &w) || w != 9) return 1;
+    if (iov[2].size != 8) return 1;
+    if (zlx_buf_file_flush(&bf)) return 1;
+    r = zlx_read(&rf.base, buf, sizeof(buf));
+    if (r != 11 || memcmp(buf, "abcdefghij\n", 11)) return 1;
+
+    /* the generic fallback stops at the first short read */
+    iov[0].data = buf; iov[0].size = 4;
+    iov[1].data = buf + 8; iov[1].size = 4;
+    if (zlx_write(&wf.base, "0123456", 7) != 7) return 1;
+    if (zlx_raw_readv(&zlx_null_file, iov, 2) != 0) return 1;
+    if (zlx_readv(&rf.base, iov, 2) != 7) return 1;
+    if (memcmp(buf, "0123", 4) || memcmp(buf + 8, "456", 3)) return 1;
+    if (zlx_close(&bf.base) || zlx_close(&rf.base)) return 1;
+    zlx_buf_file_finish(&bf);
+    return 0;
+}
+
+static unsigned int aio_cont_count;
+
+/* aio_cont *****************************************************************/
+static void ZLX_CALL aio_cont (zlx_future_t * f, zlx_fcont_t * c)
+{
+    (void) c;
+    if (!f->error) ++aio_cont_count;
+}
+
+/* aio_run ******************************************************************/
+static int aio_run (zlx_aio_t * aio, zlx_fd_file_t * ff)
+{
+    static uint8_t rbuf[2][8];
+    zlx_aio_req_t req[4];
+    zlx_fcont_t cont[4];
+    zlx_iovec_t reg;
+    zlx_file_t * files[1];
+    unsigned int i;
+
+    reg.data = rbuf;
+    reg.size = sizeof(rbuf);
+    files[0] = &ff->base;
+    if (zlx_aio_register_buffers(aio, &reg, 1)
+        || zlx_aio_register_files(aio, files, 1)) return 1;
+    aio_cont_count = 0;
+    for (i = 0; i < 4; ++i)
+    {
+        zlx_aio_req_init(&req[i]);
+        zlx_fcont_init(&cont[i], aio_cont, NULL, NULL);
+        zlx_future_then(&req[i].future, &cont[i]);
+    }
+    req[1].buf_index = 0;
+    req[1].file_index = 0;
+    if (zlx_aio_write(aio, &req[0], &ff->base, "0123456789", 10, 0)
+        || zlx_aio_submit(aio) != 1
+        || zlx_aio_reap(aio, 1) != 1
+        || req[0].result != 10) return 1;
+    if (zlx_aio_read(aio, &req[1], &ff->base, rbuf[0], 8, 2)
+        || zlx_aio_read(aio, &req[2], &ff->base, rbuf[1], 8, 6)
+        || zlx_aio_read(aio, &req[3], &zlx_null_file, rbuf, 8, 0)) return 1;
+    for (i = 1; i < 4; )
+    {
+        ptrdiff_t r = zlx_aio_reap(aio, 3);
+        if (r < 0) return 1;
+        i += (unsigned int) r;
+    }
+    /* the null file has no positional read */
+    if (!zlx_future_is_ready(&req[3].future)
+        || req[3].future.error != ZLXF_BAD_OPERATION
+        || req[3].result != -ZLXF_BAD_OPERATION || aio_cont_count != 3)
+        return 1;
+    if (req[1].result != 8 || memcmp(rbuf[0], "23456789", 8)) return 1;
+    if (req[2].result != 4 || memcmp(rbuf[1], "6789", 4)) return 1;
+    if (aio->in_flight) return 1;
+    return 0;
+}
+
+#define AIO_POOL_REQS 32
+
+static unsigned int aio_pool_order[AIO_POOL_REQS];
+static unsigned int aio_pool_done;
+static unsigned int aio_pool_errors;
+static pthread_t aio_pool_reaper;
+
+/* aio_pool_cont ************************************************************/
+static void ZLX_CALL aio_pool_cont (zlx_future_t * f, zlx_fcont_t * c)
+{
+    (void) f;
+    /* pool threads only queue completions; futures complete in the reaper */
+    if (!pthread_equal(pthread_self(), aio_pool_reaper)) ++aio_pool_errors;
+    aio_pool_order[aio_pool_done++] = (unsigned int) (uintptr_t) c->ctx;
+}
+
+/* aio_pool_run *************************************************************/
+/**
+ *  Reads a file in chunks through the thread pool.
+ *  @param fifo [in]
+ *      non-zero if the pool has one thread, so requests must complete in
+ *      the order they were queued
+ */
+static int aio_pool_run (zlx_aio_t * aio, zlx_fd_file_t * ff, int fifo)
+{
+    static uint8_t pattern[AIO_POOL_REQS * 0x400];
+    static uint8_t data[AIO_POOL_REQS][0x400];
+    zlx_aio_req_t req[AIO_POOL_REQS];
+    zlx_fcont_t cont[AIO_POOL_REQS];
+    uint32_t seen = 0;
+    unsigned int i;
+    ptrdiff_t r;
+
+    if (aio->backend != ZLX_AIO_POOL) return 1;
+    for (i = 0; i < sizeof(pattern); ++i)
+        pattern[i] = (uint8_t) (i * 7 + (i >> 10));
+    if (zlx_pwrite(&ff->base, pattern, sizeof(pattern), 0)
+        != (ptrdiff_t) sizeof(pattern)) return 1;
+    aio_pool_reaper = pthread_self();
+    aio_pool_done = aio_pool_errors = 0;
+    memset(data, 0, sizeof(data));
+    for (i = 0; i < AIO_POOL_REQS; ++i)
+    {
+        zlx_aio_req_init(&req[i]);
+        zlx_fcont_init(&cont[i], aio_pool_cont, (void *) (uintptr_t) i, NULL);
+        zlx_future_then(&req[i].future, &cont[i]);
+        if (zlx_aio_read(aio, &req[i], &ff->base, data[i], 0x400,
+                         (uint64_t) i * 0x400)) return 1;
+    }
+    if (zlx_aio_submit(aio) != AIO_POOL_REQS) return 1;
+    /* nothing completes before reaping, however long the pool took */
+    usleep(20000);
+    for (i = 0; i < AIO_POOL_REQS; ++i)
+        if (zlx_future_is_ready(&req[i].future)) return 1;
+    for (i = 0; i < AIO_POOL_REQS; i += (unsigned int) r)
+    {
+        r = zlx_aio_reap(aio, 1);
+        if (r <= 0 || aio_pool_done != i + r) return 1;
+    }
+    if (aio->in_flight || aio_pool_errors) return 1;
+    for (i = 0; i < AIO_POOL_REQS; ++i)
+    {
+        if (fifo && aio_pool_order[i] != i) return 1;
+        seen |= (uint32_t) 1 << aio_pool_order[i];
+        if (req[i].result != 0x400
+            || memcmp(data[i], pattern + i * 0x400, 0x400)) return 1;
+    }
+    return seen != UINT32_MAX;
+}
+
+/* aio_wrapped_run **********************************************************/
+/**
+ *  Reads through a buffered file holding unflushed data; the request must
+ *  go through the buffered file class, not to the descriptor below.
+ */
+static int aio_wrapped_run (zlx_aio_t * aio, zlx_fd_file_t * ff)
+{
+    zlx_buf_file_t bf;
+    zlx_file_t * files[1];
+    zlx_aio_req_t req;
+    uint8_t buf[8];
+    int ok;
+
+    if (zlx_pwrite(&ff->base, "--------", 8, 0) != 8
+        || zlx_buf_file_init(&bf, &ff->base, &std_ma, 64)) return 1;
+    files[0] = &bf.base;
+    zlx_aio_req_init(&req);
+    ok = zlx_write(&bf.base, "pending", 7) == 7
+        && zlx_aio_register_files(aio, files, 1)
+        == (aio->backend == ZLX_AIO_URING ? ZLXF_BAD_FILE_DESC : ZLXF_OK)
+        && !zlx_aio_read(aio, &req, &bf.base, buf, 8, 0)
+        && zlx_aio_submit(aio) >= 0
+        && zlx_aio_reap(aio, 1) == 1
+        && req.result == 8 && !memcmp(buf, "pending-", 8);
+    zlx_buf_file_finish(&bf);
+    return !ok;
+}
+
+/* aio_test *****************************************************************/
+int aio_test ()
+{
+    char path[] = "/tmp/zlx-aio-XXXXXX";
+    zlx_fd_file_t ff;
+    zlx_aio_t aio;
+    int fd, r;
+
+    fd = mkstemp(path);
+    if (fd < 0) return 1;
+    unlink(path);
+    if (zlx_fd_file_wrap(&ff, fd, ZLXF_READ | ZLXF_WRITE | ZLX_FDF_OWN))
+        return 1;
+    /* io_uring if the kernel has it */
+    if (zlx_aio_init(&aio, &std_ma, NULL, 4, 0, 0)) return 1;
+    r = aio_run(&aio, &ff);
+    if (!r) r = aio_wrapped_run(&aio, &ff);
+    zlx_aio_finish(&aio);
+    if (r) return r;
+    /* no threads: served inline */
+    if (zlx_aio_init(&aio, &std_ma, &zlx_nosup_mth_xfc, 4, 2,
+                     ZLX_AIO_NO_URING)) return 1;
+    if (aio.backend != ZLX_AIO_INLINE) return 1;
+    r = aio_run(&aio, &ff);
+    zlx_aio_finish(&aio);
+    if (r) return r;
+    /* thread pool; registered buffers and files are accepted and ignored */
+    if (zlx_aio_init(&aio, &std_ma, &pth_mth, 4, 4, ZLX_AIO_NO_URING))
+        return 1;
+    r = aio_run(&aio, &ff);
+    if (!r) r = aio_pool_run(&aio, &ff, 0);
+    zlx_aio_finish(&aio);
+    if (r) return r;
+    if (zlx_aio_init(&aio, &std_ma, &pth_mth, 4, 1, ZLX_AIO_NO_URING))
+        return 1;
+    r = aio_pool_run(&aio, &ff, 1);
+    zlx_aio_finish(&aio);
+    if (zlx_close(&ff.base)) return 1;
+    return r;
+}
+
+/* direct_test **************************************************************/
+int direct_test ()
+{
+    char path[] = "/tmp/zlx-direct-XXXXXX";
+    zlx_fd_file_t ff;
+    zlx_dio_pool_t pool;
+    zlx_iovec_t iov[2];
+    zlx_file_status_t fs;
+    uint8_t * blk;
+    uint8_t * buf;
+    size_t i;
+    int fd, r = 1;
+
+    fd = mkstemp(path);
+    if (fd < 0) return 1;
+    unlink(path);
+    if (zlx_fd_file_wrap(&ff, fd, ZLXF_READ | ZLXF_WRITE | ZLX_FDF_OWN))
+        return 1;
+    if (zlx_dio_pool_init(&pool, &std_ma, 0x2000, 0)) return 1;
+    fs = zlx_fd_file_direct(&ff, &pool);
+    /* file systems like tmpfs on older kernels have no direct I/O */
+    if (fs == ZLXF_BAD_OPERATION) r = 0;
+    buf = malloc(0x3005);
+    blk = zlx_dio_pool_get(&pool);
+    if (fs || !buf || !blk) goto l_exit;
+
+    /* unaligned write crossing a block boundary into an empty file */
+    if (zlx_pwrite(&ff.base, "hello", 5, 4094) != 5) goto l_exit;
+    if (lseek(fd, 0, SEEK_END) != 4099) goto l_exit;
+    /* aligned write straight from a pool block */
+    for (i = 0; i < 0x2000; ++i) blk[i] = (uint8_t) i;
+    if (zlx_pwrite(&ff.base, blk, 0x2000, 0x2000) != 0x2000) goto l_exit;
+    /* unaligned read into an unaligned buffer */
+    if (zlx_pread(&ff.base, buf + 1, 0x3004, 4092) != 0x3004) goto l_exit;
+    if (memcmp(buf + 1, "\0\0hello\0", 8)) goto l_exit;
+    for (i = 0; i < 0x2000; ++i)
+        if (buf[1 + 0x2000 - 4092 + i] != (uint8_t) i) goto l_exit;
+    /* partial block in the middle keeps the data around it */
+    if (zlx_seek64(&ff.base, 0x2001, ZLXF_SET) != 0x2001) goto l_exit;
+    iov[0].data = "ab";
+    iov[0].size = 2;
+    iov[1].data = "c";
+    iov[1].size = 1;
+    if (zlx_writev(&ff.base, iov, 2) != 3) goto l_exit;
+    if (zlx_seek64(&ff.base, 0, ZLXF_CUR) != 0x2004) goto l_exit;
+    if (zlx_read(&ff.base, buf, 2) != 2 || buf[0] != 4 || buf[1] != 5)
+        goto l_exit;
+    if (lseek(fd, 0, SEEK_END) != 0x4000) goto l_exit;
+    /* read at the end of the file */
+    if (zlx_pread(&ff.base, buf, 0x10, 0x3FFC) != 4) goto l_exit;
+    if (zlx_pread(&ff.base, buf, 0x10, 0x4000) != 0) goto l_exit;
+
+    if (zlx_fd_file_direct(&ff, NULL)) goto l_exit;
+    if (zlx_pread(&ff.base, buf, 5, 0x2000) != 5) goto l_exit;
+    if (memcmp(buf, "\0abc\4", 5)) goto l_exit;
+    r = 0;
+l_exit:
+    if (blk) zlx_dio_pool_put(&pool, blk);
+    free(buf);
+    zlx_dio_pool_finish(&pool);
+    if (zlx_close(&ff.base)) return 1;
+    return r;
+}
+
+/* mmfile_test **************************************************************/
+int mmfile_test ()
+{
+    char path[] = "/tmp/zlx-mmfile-XXXXXX";
+    zlx_mm_file_t mf;
+    uint8_t buf[8];
+    uint8_t * v;
+    size_t len;
+    int fd;
+
+    fd = mkstemp(path);
+    if (fd < 0) return 1;
+    if (zlx_mm_file_map(&mf, fd, ZLXF_READ | ZLXF_WRITE | ZLX_FDF_OWN))
+        return 1;
+    if (mf.map) return 1;
+    if (zlx_fprint(&mf.base, "$s:$i", "abc", 123) != 7) return 1;
+    if (zlx_pwrite(&mf.base, "x", 1, 0x20000) != 1) return 1;
+    if (mf.size != 0x20001 || mf.disk_size < mf.size) return 1;
+    if (zlx_seek64(&mf.base, 4, ZLXF_SET) != 4) return 1;
+    if (mf.base.fcls->truncate(&mf.base)) return 1;
+    if (zlx_mm_file_flush(&mf, 1)) return 1;
+    if (zlx_close(&mf.base)) return 1;
+
+    if (zlx_mm_file_open(&mf, path, ZLXF_READ | ZLX_MMF_POPULATE)) return 1;
+    unlink(path);
+    if (mf.size != 4) return 1;
+    if (zlx_mm_file_advise(&mf, 0, 0, ZLX_MMF_SEQUENTIAL)) return 1;
+    len = 100;
+    v = zlx_mm_file_view(&mf, 1, &len);
+    if (!v || len != 3 || memcmp(v, "bc:", 3)) return 1;
+    len = 1;
+    if (zlx_mm_file_view(&mf, 4, &len) || len) return 1;
+    if (zlx_read(&mf.base, buf, sizeof(buf)) != 4) return 1;
+    if (memcmp(buf, "abc:", 4)) return 1;
+    if (zlx_write(&mf.base, "z", 1) != -ZLXF_BAD_OPERATION) return 1;
+    /* the class itself refuses to write into a read-only mapping */
+    if (mf.base.fcls->write(&mf.base, (uint8_t const *) "z", 1)
+        != -ZLXF_BAD_OPERATION
+        || mf.base.fcls->pwrite(&mf.base, (uint8_t const *) "z", 1, 0)
+        != -ZLXF_BAD_OPERATION) return 1;
+    if (zlx_close(&mf.base)) return 1;
+    return 0;
+}
+
+/* fcopy_test ***************************************************************/
+int fcopy_test ()
+{
+    char path[] = "/tmp/zlx-fcopy-XXXXXX";
+    zlx_fd_file_t src, dst, pr, pw;
+    zlx_buf_file_t bf;
+    zlx_fcopy_stats_t st;
+    uint8_t buf[16];
+    int fd, p[2];
+
+    fd = mkstemp(path);
+    if (fd < 0) return 1;
+    unlink(path);
+    if (zlx_fd_file_wrap(&src, fd, ZLXF_READ | ZLXF_WRITE | ZLX_FDF_OWN))
+        return 1;
+    if (zlx_fprint(&src.base, "0123456789") != 10) return 1;
+    strcpy(path, "/tmp/zlx-fcopy-XXXXXX");
+    fd = mkstemp(path);
+    if (fd < 0) return 1;
+    unlink(path);
+    if (zlx_fd_file_wrap(&dst, fd, ZLXF_READ | ZLXF_WRITE | ZLX_FDF_OWN))
+        return 1;
+    if (pipe2(p, O_CLOEXEC)) return 1;
+    if (zlx_fd_file_wrap(&pr, p[0], ZLXF_READ | ZLX_FDF_OWN)) return 1;
+    if (zlx_fd_file_wrap(&pw, p[1], ZLXF_WRITE | ZLX_FDF_OWN)) return 1;
+    if (zlx_fd_file_from(&src.base) != &src) return 1;
+
+    /* file to file, in the kernel */
+    if (zlx_seek64(&src.base, 2, ZLXF_SET) != 2) return 1;
+    if (zlx_file_copy(&dst.base, &src.base, ZLX_FCOPY_ALL, &std_ma, &st))
+        return 1;
+    if (st.bytes != 8 || st.method == ZLX_FCOPY_NONE
+        || st.method == ZLX_FCOPY_BUFFER) return 1;
+    if (zlx_pread(&dst.base, buf, sizeof(buf), 0) != 8) return 1;
+    if (memcmp(buf, "23456789", 8)) return 1;
+
+    /* file to pipe, limited length */
+    if (zlx_seek64(&src.base, 0, ZLXF_SET) != 0) return 1;
+    if (zlx_file_copy(&pw.base, &src.base, 3, &std_ma, &st)) return 1;
+    if (st.bytes != 3) return 1;
+    if (zlx_read(&pr.base, buf, sizeof(buf)) != 3) return 1;
+    if (memcmp(buf, "012", 3)) return 1;
+
+    /* buffered source: through the bounce buffer */
+    if (zlx_buf_file_init(&bf, &src.base, &std_ma, 4)) return 1;
+    if (zlx_read(&bf.base, buf, 1) != 1 || buf[0] != '3') return 1;
+    if (zlx_file_copy(&pw.base, &bf.base, ZLX_FCOPY_ALL, &std_ma, &st))
+        return 1;
+    if (st.bytes != 6 || st.method != ZLX_FCOPY_BUFFER) return 1;
+    if (zlx_read(&pr.base, buf, sizeof(buf)) != 6) return 1;
+    if (memcmp(buf, "456789", 6)) return 1;
+    zlx_buf_file_finish(&bf);
+
+    if (zlx_file_copy(&pr.base, &src.base, 1, &std_ma, &st)
+        != ZLXF_BAD_OPERATION || st.bytes) return 1;
+    if (zlx_close(&pw.base) || zlx_close(&pr.base)) return 1;
+    if (zlx_close(&dst.base) || zlx_close(&src.base)) return 1;
+    return 0;
+}
+#endif
+
 /* main *********************************************************************/
 int main ()
 {
@@ -190,8 +2085,39 @@ int main ()
 
     printf("zlx test using %s\n", zlx_lib_name);
     t = array_test(); r |= t; printf("array_test: %u\n", t);
+    t = fiber_test(); r |= t; printf("fiber_test: %u\n", t);
+#if __linux__
+    t = fiber_mt_test(); r |= t; printf("fiber_mt_test: %u\n", t);
+#endif
+#if __linux__
+    t = evloop_test(); r |= t; printf("evloop_test: %u\n", t);
+#endif
+    t = twheel_test(); r |= t; printf("twheel_test: %u\n", t);
+    t = percpu_test(); r |= t; printf("percpu_test: %u\n", t);
+    t = topo_test(); r |= t; printf("topo_test: %u\n", t);
+    t = sync_test(); r |= t; printf("sync_test: %u\n", t);
+    t = lockprof_test(); r |= t; printf("lockprof_test: %u\n", t);
+    t = future_test(); r |= t; printf("future_test: %u\n", t);
+    t = tee_test(); r |= t; printf("tee_test: %u\n", t);
+    t = dbw_test(); r |= t; printf("dbw_test: %u\n", t);
+    t = fmt_test(); r |= t; printf("fmt_test: %u\n", t);
+    t = u64_to_str_test(); r |= t; printf("u64_to_str_test: %u\n", t);
+    t = u64_from_str_test(); r |= t; printf("u64_from_str_test: %u\n", t);
+    t = memfile_test(); r |= t; printf("memfile_test: %u\n", t);
+    t = records_test(); r |= t; printf("records_test: %u\n", t);
+    t = lz_test(); r |= t; printf("lz_test: %u\n", t);
+    t = crc32c_test(); r |= t; printf("crc32c_test: %u\n", t);
+#if __linux__
+    t = fdfile_test(); r |= t; printf("fdfile_test: %u\n", t);
+    t = buffile_test(); r |= t; printf("buffile_test: %u\n", t);
+    t = writev_test(); r |= t; printf("writev_test: %u\n", t);
+    t = direct_test(); r |= t; printf("direct_test: %u\n", t);
+    t = mmfile_test(); r |= t; printf("mmfile_test: %u\n", t);
+    t = aio_test(); r |= t; printf("aio_test: %u\n", t);
+    t = fcopy_test(); r |= t; printf("fcopy_test: %u\n", t);
+#endif
     t = jrbt_test(); r |= t; printf("jrbt_test: %u\n", t);
     t = irbt_test(); r |= t; printf("irbt_test: %u\n", t);
-    return t;
+    return r;
 }
 
@@ -6,14 +6,16 @@ ZLX_API zlx_mth_xfc_t zlx_nosup_mth_xfc =
 {
     {
         zlx_nosup_thread_create,
-        zlx_nosup_thread_join
+        zlx_nosup_thread_join,
+        zlx_nosup_thread_set_affinity
     },
     {
         zlx_nop_mutex_op,
         zlx_nop_mutex_op,
         zlx_nop_mutex_op,
         zlx_nop_mutex_op,
-        0
+        0,
+        NULL
     },
     {
         zlx_nosup_cond_init,
@@ -21,6 +23,12 @@ ZLX_API zlx_mth_xfc_t zlx_nosup_mth_xfc =
         zlx_nop_cond_op,
         zlx_nop_cond_wait,
         0
+    },
+    {
+        zlx_nosup_tls_create,
+        zlx_nop_tls_destroy,
+        zlx_nosup_tls_get,
+        zlx_nosup_tls_set
     }
 };
 
@@ -48,6 +56,17 @@ ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_thread_join
     return ZLX_MTH_NO_SUP;
 }
 
+/* zlx_nosup_thread_set_affinity ********************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_thread_set_affinity
+    (
+        unsigned int const * cpus,
+        size_t cpu_count
+    )
+{
+    (void) cpus, (void) cpu_count;
+    return ZLX_MTH_NO_SUP;
+}
+
 /* zlx_nop_mutex_op *********************************************************/
 ZLX_API void ZLX_CALL zlx_nop_mutex_op (zlx_mutex_t * mutex_p)
 {
@@ -77,3 +96,37 @@ ZLX_API void ZLX_CALL zlx_nop_cond_wait
     (void) cond_p, (void) mutex_p;
 }
 
+/* zlx_nosup_tls_create *****************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_tls_create
+    (
+        zlx_tls_key_t * key_p,
+        zlx_tls_dtor_t dtor
+    )
+{
+    (void) key_p, (void) dtor;
+    return ZLX_MTH_NO_SUP;
+}
+
+/* zlx_nop_tls_destroy ******************************************************/
+ZLX_API void ZLX_CALL zlx_nop_tls_destroy (zlx_tls_key_t key)
+{
+    (void) key;
+}
+
+/* zlx_nosup_tls_get ********************************************************/
+ZLX_API void * ZLX_CALL zlx_nosup_tls_get (zlx_tls_key_t key)
+{
+    (void) key;
+    return NULL;
+}
+
+/* zlx_nosup_tls_set ********************************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_tls_set
+    (
+        zlx_tls_key_t key,
+        void * value
+    )
+{
+    (void) key, (void) value;
+    return ZLX_MTH_NO_SUP;
+}
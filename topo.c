@@ -0,0 +1,409 @@
+#if __linux__
+#define _GNU_SOURCE /* for CPU_SET() */
+#endif
+
+#include "zlx/topo.h"
+#include "zlx/percpu.h"
+#include "zlx/fmt.h"
+
+#if __linux__
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#if (ZLX_AMD64 || ZLX_IA32) && __GNUC__
+#include <cpuid.h>
+#define HAVE_CPUID 1
+#endif
+
+#define SYS_CPU "/sys/devices/system/cpu/cpu"
+#define SYS_NODE "/sys/devices/system/node/"
+
+#if __linux__
+
+/* put_str ******************************************************************/
+static char * put_str
+(
+    char * p,
+    char const * s
+)
+{
+    while (*s) *p++ = *s++;
+    *p = 0;
+    return p;
+}
+
+/* put_num ******************************************************************/
+static char * put_num
+(
+    char * p,
+    unsigned int n
+)
+{
+    return p + zlx_u64_to_str((uint8_t *) p, n, 10, 0, 64, 0);
+}
+
+/* read_text ****************************************************************/
+/**
+ *  Reads a small sysfs file as a NUL-terminated string.
+ *  @returns length or -1 on error
+ */
+static int read_text
+(
+    char const * path,
+    char * buf,
+    size_t size
+)
+{
+    ssize_t n;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    n = read(fd, buf, size - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buf[n] = 0;
+    return (int) n;
+}
+
+/* parse_num ****************************************************************/
+static char const * parse_num
+(
+    char const * p,
+    uint64_t * value
+)
+{
+    size_t used = 0;
+    size_t len = 0;
+    while (p[len] >= '0' && p[len] <= '9') ++len;
+    if (!len) return NULL;
+    zlx_u64_from_str((uint8_t const *) p, len, 10, value, &used);
+    return p + used;
+}
+
+/* read_num *****************************************************************/
+/**
+ *  Reads a number from a sysfs file, applying K/M suffixes.
+ */
+static int read_num
+(
+    char const * path,
+    uint64_t * value
+)
+{
+    char buf[64];
+    char const * p;
+    if (read_text(path, buf, sizeof buf) < 0) return 0;
+    p = parse_num(buf, value);
+    if (!p) return 0;
+    if (*p == 'K') *value <<= 10;
+    else if (*p == 'M') *value <<= 20;
+    return 1;
+}
+
+/* parse_range **************************************************************/
+/**
+ *  Parses the next range from a CPU/node list like "0-3,8-11".
+ *  @returns pointer past the range or NULL at the end of the list
+ */
+static char const * parse_range
+(
+    char const * p,
+    uint64_t * lo,
+    uint64_t * hi
+)
+{
+    if (*p == ',') ++p;
+    p = parse_num(p, lo);
+    if (!p) return NULL;
+    *hi = *lo;
+    if (*p == '-')
+    {
+        p = parse_num(p + 1, hi);
+        if (!p) return NULL;
+    }
+    return p;
+}
+
+/* read_list_first **********************************************************/
+/**
+ *  Reads the first item from a list file.
+ */
+static int read_list_first
+(
+    char const * path,
+    uint32_t * value
+)
+{
+    char buf[0x400];
+    uint64_t lo, hi;
+    if (read_text(path, buf, sizeof buf) < 0) return 0;
+    if (!parse_range(buf, &lo, &hi)) return 0;
+    *value = (uint32_t) lo;
+    return 1;
+}
+
+/* read_caches **************************************************************/
+/**
+ *  Fills in the cache domains of a CPU (and the cache sizes, for CPU 0).
+ *  @returns whether sysfs describes the caches
+ */
+static int read_caches
+(
+    zlx_topo_t * topo,
+    unsigned int cpu
+)
+{
+    char path[128];
+    char type[32];
+    char * d;
+    char * e;
+    unsigned int k;
+    uint64_t level, size;
+    uint32_t first;
+
+    d = put_str(put_num(put_str(path, SYS_CPU), cpu), "/cache/index");
+    for (k = 0; ; ++k)
+    {
+        e = put_num(d, k);
+        put_str(e, "/type");
+        if (read_text(path, type, sizeof type) < 0) break;
+        if (type[0] == 'I') continue;
+        put_str(e, "/level");
+        if (!read_num(path, &level)) continue;
+        put_str(e, "/shared_cpu_list");
+        if (!read_list_first(path, &first)) first = cpu;
+        if (level == 2) topo->cpus[cpu].l2 = first;
+        else if (level == 3) topo->cpus[cpu].l3 = first;
+        if (cpu) continue;
+        put_str(e, "/size");
+        if (!read_num(path, &size)) size = 0;
+        if (level == 1) topo->l1d_size = (uint32_t) size;
+        else if (level == 2) topo->l2_size = (uint32_t) size;
+        else if (level == 3) topo->l3_size = (uint32_t) size;
+        put_str(e, "/coherency_line_size");
+        if (read_num(path, &size)) topo->line_size = (uint32_t) size;
+    }
+    return k != 0;
+}
+
+/* read_sysfs ***************************************************************/
+/**
+ *  @returns whether sysfs describes the caches
+ */
+static int read_sysfs
+(
+    zlx_topo_t * topo
+)
+{
+    char path[128];
+    char list[0x400];
+    char * d;
+    char const * p;
+    char const * q;
+    uint64_t lo, hi, c, v;
+    unsigned int i, nodes;
+    int caches = 1;
+
+    for (i = 0; i < topo->cpu_count; ++i)
+    {
+        zlx_topo_cpu_t * tc = &topo->cpus[i];
+        d = put_str(put_num(put_str(path, SYS_CPU), i), "/topology/");
+        put_str(d, "thread_siblings_list");
+        read_list_first(path, &tc->core);
+        put_str(d, "physical_package_id");
+        if (read_num(path, &v)) tc->package = (uint32_t) v;
+        caches &= read_caches(topo, i);
+    }
+
+    if (read_text(SYS_NODE "possible", list, sizeof list) < 0) return caches;
+    nodes = 0;
+    for (p = list; (p = parse_range(p, &lo, &hi)); )
+        for (; lo <= hi; ++lo)
+        {
+            char buf[0x400];
+            ++nodes;
+            put_str(put_num(put_str(path, SYS_NODE "node"), (unsigned int) lo),
+                    "/cpulist");
+            if (read_text(path, buf, sizeof buf) < 0) continue;
+            for (q = buf; (q = parse_range(q, &c, &v)); )
+                for (; c <= v && c < topo->cpu_count; ++c)
+                    topo->cpus[c].node = (uint32_t) lo;
+        }
+    if (nodes) topo->node_count = nodes;
+    return caches;
+}
+
+#endif
+
+#if HAVE_CPUID
+/* read_cpuid ***************************************************************/
+/**
+ *  Estimates caches from CPUID leaf 4, assuming CPUs sharing a cache have
+ *  consecutive numbers.
+ */
+static void read_cpuid
+(
+    zlx_topo_t * topo,
+    int domains
+)
+{
+    unsigned int a, b, c, d, k, i, max_leaf;
+
+    max_leaf = __get_cpuid_max(0, NULL);
+    if (max_leaf < 4) return;
+    for (k = 0; k < 16; ++k)
+    {
+        unsigned int type, level, share;
+        uint32_t size;
+        __cpuid_count(4, k, a, b, c, d);
+        type = a & 0x1F;
+        if (!type) break;
+        if (type == 2) continue; /* instruction cache */
+        level = (a >> 5) & 7;
+        share = ((a >> 14) & 0xFFF) + 1;
+        size = (((b >> 22) & 0x3FF) + 1) * (((b >> 12) & 0x3FF) + 1)
+            * ((b & 0xFFF) + 1) * (c + 1);
+        if (level == 1) topo->l1d_size = size;
+        else if (level == 2) topo->l2_size = size;
+        else if (level == 3) topo->l3_size = size;
+        topo->line_size = (b & 0xFFF) + 1;
+        if (!domains) continue;
+        for (i = 0; i < topo->cpu_count; ++i)
+            if (level == 2) topo->cpus[i].l2 = i - i % share;
+            else if (level == 3) topo->cpus[i].l3 = i - i % share;
+    }
+    (void) d;
+}
+#endif
+
+/* zlx_topo_init ************************************************************/
+ZLX_API int ZLX_CALL zlx_topo_init
+(
+    zlx_topo_t * restrict topo,
+    zlx_ma_t * restrict ma
+)
+{
+    unsigned int i, j;
+    int caches = 0;
+
+    topo->ma = ma;
+    topo->cpu_count = zlx_cpu_count();
+    topo->cpus = zlx_alloc(ma, topo->cpu_count * sizeof(zlx_topo_cpu_t),
+                           "topology");
+    if (!topo->cpus) return 1;
+    topo->node_count = 1;
+    topo->l1d_size = topo->l2_size = topo->l3_size = topo->line_size = 0;
+    for (i = 0; i < topo->cpu_count; ++i)
+    {
+        zlx_topo_cpu_t * tc = &topo->cpus[i];
+        tc->core = tc->l2 = tc->l3 = i;
+        tc->package = tc->node = 0;
+    }
+
+#if __linux__
+    caches = read_sysfs(topo);
+#endif
+#if HAVE_CPUID
+    if (!caches) read_cpuid(topo, 1);
+#endif
+    (void) caches;
+
+    topo->core_count = topo->package_count = 0;
+    for (i = 0; i < topo->cpu_count; ++i)
+    {
+        if (topo->cpus[i].core == i) topo->core_count++;
+        for (j = 0; j < i; ++j)
+            if (topo->cpus[j].package == topo->cpus[i].package) break;
+        if (j == i) topo->package_count++;
+    }
+    return 0;
+}
+
+/* zlx_topo_finish **********************************************************/
+ZLX_API void ZLX_CALL zlx_topo_finish
+(
+    zlx_topo_t * restrict topo
+)
+{
+    zlx_free(topo->ma, topo->cpus, topo->cpu_count * sizeof(zlx_topo_cpu_t));
+    topo->cpus = NULL;
+}
+
+/* zlx_topo_distance ********************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_topo_distance
+(
+    zlx_topo_t const * topo,
+    unsigned int a,
+    unsigned int b
+)
+{
+    zlx_topo_cpu_t const * x = &topo->cpus[a];
+    zlx_topo_cpu_t const * y = &topo->cpus[b];
+    if (a == b) return ZLX_TOPO_SAME_CPU;
+    if (x->core == y->core) return ZLX_TOPO_SAME_CORE;
+    if (x->l2 == y->l2) return ZLX_TOPO_SAME_L2;
+    if (x->l3 == y->l3) return ZLX_TOPO_SAME_L3;
+    if (x->node == y->node) return ZLX_TOPO_SAME_NODE;
+    return ZLX_TOPO_REMOTE;
+}
+
+/* zlx_topo_core_cpus *******************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_topo_core_cpus
+(
+    zlx_topo_t const * topo,
+    unsigned int * cpus
+)
+{
+    unsigned int i, j, n = 0;
+
+    for (i = 0; i < topo->cpu_count; ++i)
+    {
+        uint32_t node = topo->cpus[i].node;
+        if (topo->cpus[i].core != i) continue;
+        /* insertion sort by node keeps the CPU order inside each node */
+        for (j = n++; j && topo->cpus[cpus[j - 1]].node > node; --j)
+            cpus[j] = cpus[j - 1];
+        cpus[j] = i;
+    }
+    return n;
+}
+
+/* zlx_topo_steal_order *****************************************************/
+ZLX_API unsigned int ZLX_CALL zlx_topo_steal_order
+(
+    zlx_topo_t const * topo,
+    unsigned int cpu,
+    unsigned int * cpus
+)
+{
+    unsigned int d, i, n = 0;
+
+    for (d = ZLX_TOPO_SAME_CORE; d <= ZLX_TOPO_REMOTE; ++d)
+        for (i = 0; i < topo->cpu_count; ++i)
+            if (zlx_topo_distance(topo, cpu, i) == d) cpus[n++] = i;
+    return n;
+}
+
+/* zlx_os_thread_set_affinity ***********************************************/
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_os_thread_set_affinity
+(
+    unsigned int const * cpus,
+    size_t cpu_count
+)
+{
+#if __linux__
+    cpu_set_t set;
+    size_t i;
+
+    CPU_ZERO(&set);
+    for (i = 0; i < cpu_count; ++i)
+        if (cpus[i] < CPU_SETSIZE) CPU_SET(cpus[i], &set);
+    if (sched_setaffinity(0, sizeof set, &set)) return ZLX_MTH_FAILED;
+    return ZLX_MTH_OK;
+#else
+    (void) cpus; (void) cpu_count;
+    return ZLX_MTH_NO_SUP;
+#endif
+}
+
@@ -0,0 +1,325 @@
+#include "zlx/twheel.h"
+
+#define LEVEL_MASK ((uint64_t) ZLX_TWHEEL_SLOTS - 1)
+
+/* msb_index ****************************************************************/
+static unsigned int msb_index
+(
+    uint64_t x
+)
+{
+#if __GNUC__
+    return 63 - (unsigned int) __builtin_clzll(x);
+#else
+    unsigned int i = 0;
+    while (x >>= 1) ++i;
+    return i;
+#endif
+}
+
+/* lsb_index ****************************************************************/
+static unsigned int lsb_index
+(
+    uint64_t x
+)
+{
+#if __GNUC__
+    return (unsigned int) __builtin_ctzll(x);
+#else
+    unsigned int i = 0;
+    while (!(x & 1)) { x >>= 1; ++i; }
+    return i;
+#endif
+}
+
+/* digit ********************************************************************/
+static unsigned int digit
+(
+    uint64_t t,
+    unsigned int level
+)
+{
+    return (unsigned int) ((t >> (level * ZLX_TWHEEL_LEVEL_BITS)) & LEVEL_MASK);
+}
+
+/* enqueue ******************************************************************/
+static void enqueue
+(
+    zlx_twheel_t * tw,
+    zlx_twtimer_t * timer
+)
+{
+    uint64_t d = timer->expires ^ tw->now;
+    unsigned int level = d ? msb_index(d) / ZLX_TWHEEL_LEVEL_BITS : 0;
+    unsigned int s = digit(timer->expires, level);
+
+    timer->slot = level * ZLX_TWHEEL_SLOTS + s;
+    zlx_dlist_ins(&tw->slots[timer->slot], &timer->links, ZLX_PREV);
+    tw->occupied[level] |= (uint64_t) 1 << s;
+}
+
+/* take_slot ****************************************************************/
+/**
+ *  Moves all timers from a slot to the given list in one step.
+ */
+static void take_slot
+(
+    zlx_twheel_t * tw,
+    unsigned int level,
+    unsigned int s,
+    zlx_np_t * list
+)
+{
+    zlx_np_t * slot = &tw->slots[level * ZLX_TWHEEL_SLOTS + s];
+    zlx_dlist_init(list);
+    zlx_dlist_extend(list, slot, ZLX_PREV);
+    zlx_dlist_init(slot);
+    tw->occupied[level] &= ~((uint64_t) 1 << s);
+}
+
+/* next_event ***************************************************************/
+/**
+ *  Returns the first tick after the current one where a first-level slot
+ *  expires or a higher-level slot must be cascaded, or UINT64_MAX.
+ *  Occupied slots on each level are always past the digit of the current
+ *  time on that level, and slots on a level start before any slot on the
+ *  levels above, so the first level with something queued gives the answer.
+ */
+static uint64_t next_event
+(
+    zlx_twheel_t * tw
+)
+{
+    unsigned int level;
+    for (level = 0; level < ZLX_TWHEEL_LEVELS; ++level)
+    {
+        unsigned int shift = level * ZLX_TWHEEL_LEVEL_BITS;
+        unsigned int top = shift + ZLX_TWHEEL_LEVEL_BITS;
+        uint64_t m = tw->occupied[level]
+            & ~(((uint64_t) 2 << digit(tw->now, level)) - 1);
+        if (!m) continue;
+        return (top < 64 ? (tw->now >> top) << top : 0)
+            | ((uint64_t) lsb_index(m) << shift);
+    }
+    return UINT64_MAX;
+}
+
+/* cascade ******************************************************************/
+/**
+ *  Spreads on lower levels the slots starting at the current tick.
+ */
+static void cascade
+(
+    zlx_twheel_t * tw
+)
+{
+    unsigned int level;
+    zlx_np_t list;
+
+    for (level = 1; level < ZLX_TWHEEL_LEVELS; ++level)
+    {
+        unsigned int s;
+        if ((tw->now & (((uint64_t) 1 << (level * ZLX_TWHEEL_LEVEL_BITS)) - 1)))
+            break;
+        s = digit(tw->now, level);
+        if (!(tw->occupied[level] & ((uint64_t) 1 << s))) continue;
+        take_slot(tw, level, s, &list);
+        while (!zlx_dlist_is_empty(&list))
+        {
+            zlx_twtimer_t * timer =
+                ZLX_STRUCT_FROM_FIELD(zlx_twtimer_t, links, list.next);
+            zlx_dlist_del(&timer->links);
+            enqueue(tw, timer);
+        }
+    }
+}
+
+/* fire_current *************************************************************/
+static size_t fire_current
+(
+    zlx_twheel_t * tw
+)
+{
+    unsigned int s = digit(tw->now, 0);
+    zlx_np_t list;
+    size_t n = 0;
+
+    if (!(tw->occupied[0] & ((uint64_t) 1 << s))) return 0;
+    take_slot(tw, 0, s, &list);
+    while (!zlx_dlist_is_empty(&list))
+    {
+        zlx_twtimer_t * timer =
+            ZLX_STRUCT_FROM_FIELD(zlx_twtimer_t, links, list.next);
+        zlx_dlist_del(&timer->links);
+        timer->slot = ZLX_TWTIMER_IDLE;
+        tw->count -= 1;
+        timer->func(tw, timer);
+        ++n;
+    }
+    return n;
+}
+
+/* ticks_to_ns **************************************************************/
+static uint64_t ticks_to_ns
+(
+    zlx_twheel_t * tw,
+    uint64_t ticks
+)
+{
+    if (ticks > UINT64_MAX / tw->tick_ns) return UINT64_MAX;
+    return ticks * tw->tick_ns;
+}
+
+/* arm **********************************************************************/
+static zlx_file_status_t arm
+(
+    zlx_twheel_t * tw
+)
+{
+    uint64_t next = zlx_twheel_next_expiry(tw);
+    return zlx_evtimer_start(tw->loop, &tw->evtimer,
+                             next == UINT64_MAX
+                             ? UINT64_MAX : ticks_to_ns(tw, next));
+}
+
+/* evtimer_func *************************************************************/
+static void ZLX_CALL evtimer_func
+(
+    zlx_evloop_t * loop,
+    zlx_evtimer_t * evtimer
+)
+{
+    zlx_twheel_t * tw = evtimer->ctx;
+    zlx_twheel_advance(tw, zlx_evloop_now(loop) / tw->tick_ns);
+    /* the loop timer was just dequeued so there is room to queue it back */
+    if (tw->loop) arm(tw);
+}
+
+/* zlx_twheel_init **********************************************************/
+ZLX_API void ZLX_CALL zlx_twheel_init
+(
+    zlx_twheel_t * tw,
+    uint64_t now
+)
+{
+    unsigned int i;
+    for (i = 0; i < ZLX_ITEM_COUNT(tw->slots); ++i)
+        zlx_dlist_init(&tw->slots[i]);
+    for (i = 0; i < ZLX_TWHEEL_LEVELS; ++i) tw->occupied[i] = 0;
+    tw->now = now;
+    tw->count = 0;
+    tw->loop = NULL;
+    tw->tick_ns = 1;
+    zlx_evtimer_init(&tw->evtimer, evtimer_func, tw);
+}
+
+/* zlx_twheel_add ***********************************************************/
+ZLX_API void ZLX_CALL zlx_twheel_add
+(
+    zlx_twheel_t * tw,
+    zlx_twtimer_t * timer,
+    uint64_t expires
+)
+{
+    zlx_twheel_cancel(tw, timer);
+    timer->expires = expires < tw->now ? tw->now : expires;
+    enqueue(tw, timer);
+    tw->count += 1;
+    if (tw->loop)
+    {
+        uint64_t d = ticks_to_ns(tw, timer->expires);
+        /* the loop timer stays queued while attached, so re-queuing it
+         * cannot fail */
+        if (tw->evtimer.heap_index == ZLX_EVTIMER_IDLE
+            || d < tw->evtimer.deadline)
+            zlx_evtimer_start(tw->loop, &tw->evtimer, d);
+    }
+}
+
+/* zlx_twheel_cancel ********************************************************/
+ZLX_API void ZLX_CALL zlx_twheel_cancel
+(
+    zlx_twheel_t * tw,
+    zlx_twtimer_t * timer
+)
+{
+    uint32_t i = timer->slot;
+    if (i == ZLX_TWTIMER_IDLE) return;
+    zlx_dlist_del(&timer->links);
+    if (zlx_dlist_is_empty(&tw->slots[i]))
+        tw->occupied[i / ZLX_TWHEEL_SLOTS] &=
+            ~((uint64_t) 1 << (i % ZLX_TWHEEL_SLOTS));
+    timer->slot = ZLX_TWTIMER_IDLE;
+    tw->count -= 1;
+}
+
+/* zlx_twheel_advance *******************************************************/
+ZLX_API size_t ZLX_CALL zlx_twheel_advance
+(
+    zlx_twheel_t * tw,
+    uint64_t now
+)
+{
+    size_t n = 0;
+
+    for (;;)
+    {
+        uint64_t next;
+        n += fire_current(tw);
+        if (tw->now >= now) break;
+        /* callbacks re-added timers for the current tick */
+        if ((tw->occupied[0] & ((uint64_t) 1 << digit(tw->now, 0)))) continue;
+        next = next_event(tw);
+        if (next > now)
+        {
+            /* no slot starts in between so nothing has to move */
+            tw->now = now;
+            break;
+        }
+        tw->now = next;
+        cascade(tw);
+    }
+    return n;
+}
+
+/* zlx_twheel_next_expiry ***************************************************/
+ZLX_API uint64_t ZLX_CALL zlx_twheel_next_expiry
+(
+    zlx_twheel_t * tw
+)
+{
+    if ((tw->occupied[0] & ((uint64_t) 1 << digit(tw->now, 0))))
+        return tw->now;
+    return next_event(tw);
+}
+
+/* zlx_twheel_attach ********************************************************/
+ZLX_API zlx_file_status_t ZLX_CALL zlx_twheel_attach
+(
+    zlx_twheel_t * tw,
+    zlx_evloop_t * loop,
+    uint64_t tick_ns
+)
+{
+    tw->loop = NULL;
+    tw->tick_ns = tick_ns;
+    zlx_twheel_advance(tw, zlx_evloop_now(loop) / tick_ns);
+    tw->loop = loop;
+    if (arm(tw))
+    {
+        tw->loop = NULL;
+        return ZLXF_FAILED;
+    }
+    return ZLXF_OK;
+}
+
+/* zlx_twheel_detach ********************************************************/
+ZLX_API void ZLX_CALL zlx_twheel_detach
+(
+    zlx_twheel_t * tw
+)
+{
+    if (tw->loop) zlx_evtimer_stop(tw->loop, &tw->evtimer);
+    tw->loop = NULL;
+}
+
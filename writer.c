@@ -48,3 +48,222 @@ ZLX_API ptrdiff_t ZLX_CALL zlx_sbw_write
     return len;
 }
 
+/* zlx_dbw_init *************************************************************/
+ZLX_API zlx_dbw_t * ZLX_CALL zlx_dbw_init
+(
+    zlx_dbw_t * restrict dbw,
+    zlx_ma_t * restrict ma
+)
+{
+    dbw->data = NULL;
+    dbw->size = dbw->capacity = 0;
+    dbw->ma = ma;
+    return dbw;
+}
+
+/* zlx_dbw_finish ***********************************************************/
+ZLX_API void ZLX_CALL zlx_dbw_finish
+(
+    zlx_dbw_t * restrict dbw
+)
+{
+    if (dbw->data) zlx_free(dbw->ma, dbw->data, dbw->capacity);
+    dbw->data = NULL;
+    dbw->size = dbw->capacity = 0;
+}
+
+/* dbw_resize ***************************************************************/
+static int dbw_resize
+(
+    zlx_dbw_t * restrict dbw,
+    size_t capacity
+)
+{
+    uint8_t * p;
+
+    if (dbw->data)
+        p = zlx_realloc(dbw->ma, dbw->data, dbw->capacity, capacity);
+    else p = zlx_alloc(dbw->ma, capacity, "dbw buffer");
+    if (!p) return -1;
+    dbw->data = p;
+    dbw->capacity = capacity;
+    return 0;
+}
+
+/* zlx_dbw_reserve **********************************************************/
+ZLX_API int ZLX_CALL zlx_dbw_reserve
+(
+    zlx_dbw_t * restrict dbw,
+    size_t len
+)
+{
+    size_t need, cap;
+
+    need = dbw->size + len;
+    if (need < len || need > PTRDIFF_MAX) return -1;
+    if (need <= dbw->capacity) return 0;
+    cap = dbw->capacity < 0x20 ? 0x40 : dbw->capacity * 2;
+    if (cap < need || cap > PTRDIFF_MAX) cap = need;
+    return dbw_resize(dbw, cap);
+}
+
+/* zlx_dbw_write ************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_dbw_write
+(
+    void * restrict dbw,
+    uint8_t const * restrict data,
+    size_t len
+)
+{
+    zlx_dbw_t * restrict d = dbw;
+
+    if (d->capacity - d->size < len && zlx_dbw_reserve(d, len)) return -1;
+    zlx_u8a_copy(d->data + d->size, data, len);
+    d->size += len;
+    return len;
+}
+
+/* zlx_dbw_shrink ***********************************************************/
+ZLX_API int ZLX_CALL zlx_dbw_shrink
+(
+    zlx_dbw_t * restrict dbw
+)
+{
+    if (dbw->size == dbw->capacity) return 0;
+    if (dbw->size) return dbw_resize(dbw, dbw->size);
+    zlx_dbw_finish(dbw);
+    return 0;
+}
+
+/* zlx_dbw_take *************************************************************/
+ZLX_API uint8_t * ZLX_CALL zlx_dbw_take
+(
+    zlx_dbw_t * restrict dbw,
+    size_t * restrict size,
+    size_t * restrict capacity
+)
+{
+    uint8_t * p = dbw->data;
+
+    *size = dbw->size;
+    *capacity = dbw->capacity;
+    dbw->data = NULL;
+    dbw->size = dbw->capacity = 0;
+    return p;
+}
+
+/* zlx_tee_target_init ******************************************************/
+ZLX_API zlx_tee_target_t * ZLX_CALL zlx_tee_target_init
+(
+    zlx_tee_target_t * restrict t,
+    zlx_write_func_t func,
+    void * obj,
+    uint8_t * buf,
+    size_t buf_size,
+    uint8_t policy
+)
+{
+    t->func = func;
+    t->obj = obj;
+    t->buf = buf_size ? buf : NULL;
+    t->buf_size = buf_size;
+    t->buf_len = 0;
+    t->errors = 0;
+    t->policy = policy;
+    t->detached = 0;
+    return t;
+}
+
+/* zlx_tee_init *************************************************************/
+ZLX_API zlx_tee_t * ZLX_CALL zlx_tee_init
+(
+    zlx_tee_t * restrict tee,
+    zlx_tee_target_t * targets,
+    size_t count
+)
+{
+    tee->targets = targets;
+    tee->count = count;
+    return tee;
+}
+
+/* tee_forward **************************************************************/
+/**
+ *  Writes to a target, applying its error policy.
+ *  @returns 0 on success or if the error does not count, -1 otherwise
+ */
+static int tee_forward
+(
+    zlx_tee_target_t * t,
+    uint8_t const * data,
+    size_t size
+)
+{
+    if (t->func(t->obj, data, size) == (ptrdiff_t) size) return 0;
+    ++t->errors;
+    if (t->policy == ZLX_TEE_DETACH) t->detached = 1;
+    return t->policy == ZLX_TEE_FAIL ? -1 : 0;
+}
+
+/* tee_target_flush *********************************************************/
+/**
+ *  Passes the staged data to the writer; the data is dropped if it fails.
+ */
+static int tee_target_flush
+(
+    zlx_tee_target_t * t
+)
+{
+    size_t n = t->buf_len;
+
+    if (!n || t->detached) return 0;
+    t->buf_len = 0;
+    return tee_forward(t, t->buf, n);
+}
+
+/* zlx_tee_write ************************************************************/
+ZLX_API ptrdiff_t ZLX_CALL zlx_tee_write
+(
+    void * restrict tee,
+    uint8_t const * restrict data,
+    size_t size
+)
+{
+    zlx_tee_t * restrict tw = tee;
+    zlx_tee_target_t * t;
+    zlx_tee_target_t * end = tw->targets + tw->count;
+    int rc = 0;
+
+    for (t = tw->targets; t < end; ++t)
+    {
+        if (t->detached) continue;
+        if (!t->buf) { rc |= tee_forward(t, data, size); continue; }
+        if (t->buf_size - t->buf_len < size)
+        {
+            rc |= tee_target_flush(t);
+            if (t->detached) continue;
+            if (size >= t->buf_size)
+            {
+                rc |= tee_forward(t, data, size);
+                continue;
+            }
+        }
+        zlx_u8a_copy(t->buf + t->buf_len, data, size);
+        t->buf_len += size;
+    }
+    return rc ? -1 : (ptrdiff_t) size;
+}
+
+/* zlx_tee_flush ************************************************************/
+ZLX_API int ZLX_CALL zlx_tee_flush
+(
+    zlx_tee_t * restrict tee
+)
+{
+    zlx_tee_target_t * t;
+    zlx_tee_target_t * end = tee->targets + tee->count;
+    int rc = 0;
+
+    for (t = tee->targets; t < end; ++t) rc |= tee_target_flush(t);
+    return rc;
+}
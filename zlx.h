@@ -12,13 +12,32 @@
  *      - memory allocation tracker
  *      - logging interface
  *      - string formatting (printf-like but with different escapes)
- *      - basic multithreading interface
+ *      - basic multithreading interface (threads, mutexes, conditions, TLS)
+ *      - semaphores, latches and barriers
+ *      - lock contention profiler
+ *      - per-CPU data slots
+ *      - CPU topology discovery
  *      - lookaside list element allocator
+ *      - fibers (stackful coroutines) with an M:N scheduler
+ *      - futures with continuations
+ *      - event loop with timers for non-blocking files
+ *      - files backed by OS descriptors, with positional and direct I/O
+ *      - buffered files with read-ahead and write coalescing
+ *      - memory-mapped files with zero-copy views
+ *      - growable in-memory files
+ *      - SIMD record (line) splitter
+ *      - file-to-file copy done by the kernel when possible
+ *      - LZ4-style block compression and compressed files
+ *      - CRC32C (SSE4.2 when available) and a checksumming file filter
+ *      - asynchronous file I/O (io_uring, with a thread pool fallback)
+ *      - hierarchical timer wheel
  *      - etc.
  *
  *  The library does not depend on any external function and only uses standard
  *  headers documented in the C99 standard as available in freestanding
- *  environments.
+ *  environments. The few components that need OS services (like guard pages
+ *  for fiber stacks or waiting for file descriptors) use them only when
+ *  built for Linux and report "not supported" statuses elsewhere.
  *
  *  @section License
  *
@@ -73,9 +92,28 @@ extern ZLX_API char const * const zlx_lib_name;
 #include "zlx/clconv.h"
 #include "zlx/fmt.h"
 #include "zlx/file.h"
+#include "zlx/fdfile.h"
+#include "zlx/buffile.h"
+#include "zlx/mmfile.h"
+#include "zlx/memfile.h"
+#include "zlx/records.h"
+#include "zlx/fcopy.h"
+#include "zlx/lz.h"
+#include "zlx/crc32c.h"
 #include "zlx/assert.h"
 #include "zlx/thread.h"
+#include "zlx/atomic.h"
+#include "zlx/sync.h"
+#include "zlx/lockprof.h"
 #include "zlx/elal.h"
+#include "zlx/fiber.h"
+#include "zlx/future.h"
+#include "zlx/aio.h"
+#include "zlx/clock.h"
+#include "zlx/evloop.h"
+#include "zlx/twheel.h"
+#include "zlx/percpu.h"
+#include "zlx/topo.h"
 
 #ifdef __cplusplus
 }
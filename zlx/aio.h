@@ -0,0 +1,348 @@
+#ifndef _ZLX_AIO_H
+#define _ZLX_AIO_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "thread.h"
+#include "file.h"
+#include "future.h"
+#include "sync.h"
+
+/** @defgroup aio Asynchronous file I/O
+ *  Positional reads and writes on file objects, completed asynchronously.
+ *
+ *  Requests are queued with zlx_aio_read() and zlx_aio_write(), handed to
+ *  the backend in batches by zlx_aio_submit() and completed in bulk by
+ *  zlx_aio_reap(). Each request holds a future that is completed by the
+ *  thread calling zlx_aio_reap(): callers can attach continuations, poll
+ *  it, or park a fiber on it with zlx_future_fiber_wait() while another
+ *  fiber or thread reaps.
+ *
+ *  Backends, in order of preference:
+ *      - io_uring (Linux), used for plain descriptor files (see
+ *        zlx_fd_file_from()) not in direct I/O mode; other files, wrappers
+ *        included, are served inline at submit through their class;
+ *        buffers and files can be registered to save per-request mapping
+ *        costs in the kernel;
+ *      - a pool of threads (created with the given multithreading
+ *        interface) doing zlx_pread() / zlx_pwrite();
+ *      - inline: requests are executed by zlx_aio_submit().
+ *
+ *  Since requests use the positional entry points of the file class, the
+ *  same file object can be used by synchronous code at the same time.
+ *  A context must be used by one thread at a time.
+ *  @{ */
+
+/*  zlx_aio_t  */
+/**
+ *  Asynchronous I/O context.
+ */
+typedef struct zlx_aio_s zlx_aio_t;
+
+/*  zlx_aio_req_t  */
+/**
+ *  Asynchronous I/O request.
+ */
+typedef struct zlx_aio_req_s zlx_aio_req_t;
+
+/** Request type: read */
+#define ZLX_AIO_READ 0
+
+/** Request type: write */
+#define ZLX_AIO_WRITE 1
+
+/** Backend: io_uring */
+#define ZLX_AIO_URING 1
+
+/** Backend: thread pool */
+#define ZLX_AIO_POOL 2
+
+/** Backend: inline execution */
+#define ZLX_AIO_INLINE 3
+
+/** Flag for zlx_aio_init(): do not use io_uring */
+#define ZLX_AIO_NO_URING (1 << 0)
+
+struct zlx_aio_req_s
+{
+    /** completed with this request as value, or with a #zlx_file_status_t
+     *  as error */
+    zlx_future_t future;
+
+    /** link used while the request is queued */
+    zlx_aio_req_t * next;
+
+    /** file */
+    zlx_file_t * file;
+
+    /** buffer */
+    zlx_iovec_t iov;
+
+    /** file offset */
+    uint64_t offset;
+
+    /** bytes transferred or a negated #zlx_file_status_t value */
+    ptrdiff_t result;
+
+    /** ZLX_AIO_READ or ZLX_AIO_WRITE */
+    uint32_t op;
+
+    /** index of the registered buffer containing #iov or -1 */
+    int32_t buf_index;
+
+    /** index of #file among the registered files or -1 */
+    int32_t file_index;
+};
+
+struct zlx_aio_s
+{
+    /** one of ZLX_AIO_URING, ZLX_AIO_POOL, ZLX_AIO_INLINE */
+    uint32_t backend;
+
+    /** requests submitted and not reaped yet */
+    uint32_t in_flight;
+
+    /** allocator */
+    zlx_ma_t * ma;
+
+    /** multithreading interface for the thread pool */
+    zlx_mth_xfc_t * mth;
+
+    /** requests queued and not submitted (pool and inline backends) */
+    zlx_aio_req_t * queued;
+
+    /** tail link of #queued */
+    zlx_aio_req_t * * queued_tail;
+
+    /** requests completed by zlx_aio_submit() */
+    zlx_aio_req_t * done;
+
+    /** tail link of #done */
+    zlx_aio_req_t * * done_tail;
+
+    /** number of requests in #done */
+    uint32_t done_count;
+
+    /** io_uring descriptor */
+    int ring_fd;
+
+    /** number of entries in the submission queue */
+    uint32_t sq_entries;
+
+    /** SQEs written and not submitted */
+    uint32_t to_submit;
+
+    /** submission queue ring mapping */
+    void * sq_map;
+
+    /** size of #sq_map */
+    size_t sq_map_size;
+
+    /** completion queue ring mapping (can be the same as #sq_map) */
+    void * cq_map;
+
+    /** size of #cq_map */
+    size_t cq_map_size;
+
+    /** submission queue entries */
+    void * sqes;
+
+    /** size of #sqes */
+    size_t sqes_size;
+
+    /** ring fields */
+    uint32_t * sq_head;
+    uint32_t * sq_tail;
+    uint32_t * sq_mask;
+    uint32_t * sq_array;
+    uint32_t * cq_head;
+    uint32_t * cq_tail;
+    uint32_t * cq_mask;
+    void * cqes;
+
+    /** mutex protecting the pool queues */
+    zlx_mutex_t * mutex;
+
+    /** counts requests waiting for a pool thread */
+    zlx_sema_t work;
+
+    /** counts requests completed by pool threads */
+    zlx_sema_t pool_sema;
+
+    /** requests waiting for a pool thread */
+    zlx_aio_req_t * work_head;
+
+    /** tail link of #work_head */
+    zlx_aio_req_t * * work_tail;
+
+    /** requests completed by pool threads */
+    zlx_aio_req_t * pool_done;
+
+    /** tail link of #pool_done */
+    zlx_aio_req_t * * pool_done_tail;
+
+    /** pool threads */
+    zlx_tid_t * threads;
+
+    /** number of pool threads */
+    size_t thread_count;
+};
+
+/* zlx_aio_req_init *********************************************************/
+/**
+ *  Initializes a request; the future is reset to pending and the request
+ *  uses no registered buffer or file.
+ */
+ZLX_INLINE void zlx_aio_req_init
+(
+    zlx_aio_req_t * req
+)
+{
+    zlx_future_init(&req->future);
+    req->next = NULL;
+    req->result = 0;
+    req->buf_index = -1;
+    req->file_index = -1;
+}
+
+/* zlx_aio_init *************************************************************/
+/**
+ *  Initializes an asynchronous I/O context.
+ *  @param aio [out]
+ *      context
+ *  @param ma [in]
+ *      allocator
+ *  @param mth [in, opt]
+ *      multithreading interface for the thread pool
+ *  @param depth [in]
+ *      number of requests that can be queued before submitting
+ *  @param thread_count [in]
+ *      number of pool threads to use if io_uring is not available; 0 to
+ *      execute requests inline instead
+ *  @param flags [in]
+ *      0 or #ZLX_AIO_NO_URING
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_NO_MEM
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_init
+(
+    zlx_aio_t * restrict aio,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * mth,
+    uint32_t depth,
+    size_t thread_count,
+    uint32_t flags
+);
+
+/* zlx_aio_finish ***********************************************************/
+/**
+ *  Releases the context; all submitted requests must have been reaped.
+ */
+ZLX_API void ZLX_CALL zlx_aio_finish
+(
+    zlx_aio_t * restrict aio
+);
+
+/* zlx_aio_read *************************************************************/
+/**
+ *  Queues a positional read.
+ *  @param aio [in, out]
+ *      context
+ *  @param req [in, out]
+ *      request initialized with zlx_aio_req_init(); it must stay valid
+ *      until completed
+ *  @param file [in]
+ *      file to read
+ *  @param data [out]
+ *      buffer
+ *  @param size [in]
+ *      buffer size; reads can be short
+ *  @param offset [in]
+ *      file offset
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_WOULD_BLOCK the submission queue is full even after
+ *      submitting; reap some requests first
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_read
+(
+    zlx_aio_t * restrict aio,
+    zlx_aio_req_t * restrict req,
+    zlx_file_t * file,
+    void * data,
+    size_t size,
+    uint64_t offset
+);
+
+/* zlx_aio_write ************************************************************/
+/**
+ *  Queues a positional write. See zlx_aio_read().
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_write
+(
+    zlx_aio_t * restrict aio,
+    zlx_aio_req_t * restrict req,
+    zlx_file_t * file,
+    void const * data,
+    size_t size,
+    uint64_t offset
+);
+
+/* zlx_aio_submit ***********************************************************/
+/**
+ *  Hands the queued requests to the backend with as few calls as possible.
+ *  @returns the number of requests submitted or a negated
+ *      #zlx_file_status_t value
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_aio_submit
+(
+    zlx_aio_t * restrict aio
+);
+
+/* zlx_aio_reap *************************************************************/
+/**
+ *  Completes the requests that are done, waiting until at least
+ *  @a min_count of them are (or until all submitted ones are, if fewer).
+ *  Continuations attached to the futures of the requests run in the
+ *  calling thread before this returns.
+ *  Queued requests are submitted first.
+ *  @returns the number of completed requests or a negated
+ *      #zlx_file_status_t value
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_aio_reap
+(
+    zlx_aio_t * restrict aio,
+    size_t min_count
+);
+
+/* zlx_aio_register_buffers *************************************************/
+/**
+ *  Registers buffers with the kernel; requests whose buffer lies inside
+ *  the buffer with index i can set zlx_aio_req_t#buf_index to i.
+ *  Does nothing for backends other than io_uring.
+ *  @returns the status of the operation
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_register_buffers
+(
+    zlx_aio_t * restrict aio,
+    zlx_iovec_t const * iov,
+    size_t count
+);
+
+/* zlx_aio_register_files ***************************************************/
+/**
+ *  Registers the descriptors of files with the kernel; requests on the
+ *  file with index i can set zlx_aio_req_t#file_index to i.
+ *  Does nothing for backends other than io_uring.
+ *  @retval ZLXF_BAD_FILE_DESC a file cannot be served by the ring: it is
+ *      not a plain descriptor file or it is in direct I/O mode
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_aio_register_files
+(
+    zlx_aio_t * restrict aio,
+    zlx_file_t * const * files,
+    size_t count
+);
+
+/** @} */
+
+#endif /* _ZLX_AIO_H */
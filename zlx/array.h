@@ -60,6 +60,7 @@
 
 FDP void F(set) (T * arr, size_t n, T val) FDS;
 FDP void F(copy) (T * restrict a, T const * restrict b, size_t n) FDS;
+FDP void F(move) (T * a, T const * b, size_t n) FDS;
 FDP T * F(zcopy) (T * restrict a, T const * restrict b) FDS;
 
 FDP int F(cmp) (T const * a, T const * b, size_t n) FDS;
@@ -89,6 +90,25 @@ FDP void F(copy) (T * restrict a, T const * restrict b, size_t n) FDS
     }
 }
 
+FDP void F(move) (T * a, T const * b, size_t n) FDS
+{
+    size_t i;
+    if (a <= b)
+    {
+        for (i = 0; i < n; ++i)
+        {
+            COPY(a[i], b[i]);
+        }
+    }
+    else
+    {
+        for (i = n; i--; )
+        {
+            COPY(a[i], b[i]);
+        }
+    }
+}
+
 FDP T * F(zcopy) (T * restrict a, T const * restrict b) FDS
 {
     size_t i;
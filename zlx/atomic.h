@@ -0,0 +1,192 @@
+#ifndef _ZLX_ATOMIC_H
+#define _ZLX_ATOMIC_H
+
+#include "base.h"
+
+/** @defgroup atomic Atomic operations
+ *  Sequentially consistent atomic operations on 32-bit ints and pointers.
+ *  @{ */
+
+#if __GNUC__
+
+/* zlx_atomic_load_u32 ******************************************************/
+/**
+ *  Loads a 32-bit value.
+ */
+ZLX_INLINE uint32_t zlx_atomic_load_u32 (uint32_t * p)
+{
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_store_u32 *****************************************************/
+/**
+ *  Stores a 32-bit value.
+ */
+ZLX_INLINE void zlx_atomic_store_u32 (uint32_t * p, uint32_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_add_u32 *******************************************************/
+/**
+ *  Adds to a 32-bit value.
+ *  @returns the previous value
+ */
+ZLX_INLINE uint32_t zlx_atomic_add_u32 (uint32_t * p, uint32_t v)
+{
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_cas_u32 *******************************************************/
+/**
+ *  Replaces a 32-bit value if it matches the expected one.
+ *  @returns non-zero if the value was replaced
+ */
+ZLX_INLINE int zlx_atomic_cas_u32 (uint32_t * p, uint32_t expected,
+                                   uint32_t desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_load_u64 ******************************************************/
+/**
+ *  Loads a 64-bit value.
+ */
+ZLX_INLINE uint64_t zlx_atomic_load_u64 (uint64_t * p)
+{
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_add_u64 *******************************************************/
+/**
+ *  Adds to a 64-bit value.
+ *  @returns the previous value
+ */
+ZLX_INLINE uint64_t zlx_atomic_add_u64 (uint64_t * p, uint64_t v)
+{
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_cas_u64 *******************************************************/
+/**
+ *  Replaces a 64-bit value if it matches the expected one.
+ *  @returns non-zero if the value was replaced
+ */
+ZLX_INLINE int zlx_atomic_cas_u64 (uint64_t * p, uint64_t expected,
+                                   uint64_t desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_load_ptr ******************************************************/
+/**
+ *  Loads a pointer.
+ */
+ZLX_INLINE void * zlx_atomic_load_ptr (void * * p)
+{
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_cas_ptr *******************************************************/
+/**
+ *  Replaces a pointer if it matches the expected one.
+ *  @returns non-zero if the pointer was replaced
+ */
+ZLX_INLINE int zlx_atomic_cas_ptr (void * * p, void * expected, void * desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* zlx_atomic_xchg_ptr ******************************************************/
+/**
+ *  Replaces a pointer.
+ *  @returns the previous pointer
+ */
+ZLX_INLINE void * zlx_atomic_xchg_ptr (void * * p, void * v)
+{
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+#elif _MSC_VER
+
+#include <intrin.h>
+
+ZLX_INLINE uint32_t zlx_atomic_load_u32 (uint32_t * p)
+{
+    return (uint32_t) _InterlockedOr((long volatile *) p, 0);
+}
+
+ZLX_INLINE void zlx_atomic_store_u32 (uint32_t * p, uint32_t v)
+{
+    _InterlockedExchange((long volatile *) p, (long) v);
+}
+
+ZLX_INLINE uint32_t zlx_atomic_add_u32 (uint32_t * p, uint32_t v)
+{
+    return (uint32_t) _InterlockedExchangeAdd((long volatile *) p, (long) v);
+}
+
+ZLX_INLINE int zlx_atomic_cas_u32 (uint32_t * p, uint32_t expected,
+                                   uint32_t desired)
+{
+    return (uint32_t) _InterlockedCompareExchange
+        ((long volatile *) p, (long) desired, (long) expected) == expected;
+}
+
+ZLX_INLINE uint64_t zlx_atomic_load_u64 (uint64_t * p)
+{
+    return (uint64_t) _InterlockedCompareExchange64
+        ((__int64 volatile *) p, 0, 0);
+}
+
+ZLX_INLINE uint64_t zlx_atomic_add_u64 (uint64_t * p, uint64_t v)
+{
+    return (uint64_t) _InterlockedExchangeAdd64
+        ((__int64 volatile *) p, (__int64) v);
+}
+
+ZLX_INLINE int zlx_atomic_cas_u64 (uint64_t * p, uint64_t expected,
+                                   uint64_t desired)
+{
+    return (uint64_t) _InterlockedCompareExchange64
+        ((__int64 volatile *) p, (__int64) desired, (__int64) expected)
+        == expected;
+}
+
+ZLX_INLINE void * zlx_atomic_load_ptr (void * * p)
+{
+    return _InterlockedCompareExchangePointer(p, NULL, NULL);
+}
+
+ZLX_INLINE int zlx_atomic_cas_ptr (void * * p, void * expected, void * desired)
+{
+    return _InterlockedCompareExchangePointer(p, desired, expected)
+        == expected;
+}
+
+ZLX_INLINE void * zlx_atomic_xchg_ptr (void * * p, void * v)
+{
+    return _InterlockedExchangePointer(p, v);
+}
+
+#else
+#error atomic operations not implemented for this compiler
+#endif
+
+/* zlx_atomic_max_u64 *******************************************************/
+/**
+ *  Raises a 64-bit value to at least @a v.
+ */
+ZLX_INLINE void zlx_atomic_max_u64 (uint64_t * p, uint64_t v)
+{
+    uint64_t c;
+    while ((c = zlx_atomic_load_u64(p)) < v && !zlx_atomic_cas_u64(p, c, v))
+        ;
+}
+
+/** @} */
+
+#endif /* _ZLX_ATOMIC_H */
@@ -0,0 +1,160 @@
+#ifndef _ZLX_BUFFILE_H
+#define _ZLX_BUFFILE_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "file.h"
+
+/** @defgroup buffile Buffered files
+ *  File object adding a buffer in front of another file.
+ *
+ *  Small writes are coalesced in the buffer and reach the wrapped file when
+ *  the buffer fills up, on zlx_buf_file_flush(), on seek and on close, so
+ *  formatted output costs one write per buffer instead of one per fragment.
+ *  Data that does not fit in the buffer is sent together with the pending
+ *  data using a single vectored write, without being copied; a batch of
+ *  records given to zlx_writev() leaves in one call.
+ *
+ *  Reads refill the buffer with a read-ahead amount that starts small after
+ *  initialization or a seek and doubles with every refill that continues the
+ *  previous one, up to the buffer size; random access thus reads little past
+ *  what is asked while sequential scans quickly move to full buffers.
+ *  Seeks that land inside the buffered data do not reach the wrapped file.
+ *  zlx_buf_file_peek() and zlx_buf_file_consume() let parsers work on the
+ *  buffered data in place.
+ *
+ *  The buffer holds either read-ahead data or pending writes; switching from
+ *  reading to writing moves the position of a seekable wrapped file back to
+ *  the logical position.
+ *  @{ */
+
+/*  zlx_buf_file_t  */
+/**
+ *  Buffered file.
+ */
+typedef struct zlx_buf_file_s zlx_buf_file_t;
+
+/*  ZLX_BUF_FILE_MIN_READ_AHEAD  */
+/**
+ *  Read-ahead amount after initialization or a seek.
+ */
+#define ZLX_BUF_FILE_MIN_READ_AHEAD 0x1000
+
+struct zlx_buf_file_s
+{
+    /** base file object */
+    zlx_file_t base;
+
+    /** wrapped file */
+    zlx_file_t * inner;
+
+    /** allocator for the buffer */
+    zlx_ma_t * ma;
+
+    /** buffer */
+    uint8_t * buf;
+
+    /** buffer size */
+    size_t size;
+
+    /** offset of the next buffered byte to read */
+    size_t rpos;
+
+    /** end of the buffered read data */
+    size_t rend;
+
+    /** amount of pending write data at the start of the buffer */
+    size_t wlen;
+
+    /** size of the next refill */
+    size_t read_ahead;
+
+    /** position of the wrapped file or -1 if unknown */
+    int64_t ipos;
+};
+
+/* zlx_buf_file_init ********************************************************/
+/**
+ *  Initializes a buffered file.
+ *  @param bf [out]
+ *      buffered file; it supports the operations of @a inner
+ *  @param inner [in, out]
+ *      wrapped file
+ *  @param ma [in]
+ *      allocator for the buffer
+ *  @param size [in]
+ *      buffer size
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_NO_MEM
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_buf_file_init
+(
+    zlx_buf_file_t * restrict bf,
+    zlx_file_t * restrict inner,
+    zlx_ma_t * restrict ma,
+    size_t size
+);
+
+/* zlx_buf_file_finish ******************************************************/
+/**
+ *  Frees the buffer.
+ *  This neither flushes nor closes; pending writes not flushed are lost.
+ */
+ZLX_API void ZLX_CALL zlx_buf_file_finish
+(
+    zlx_buf_file_t * restrict bf
+);
+
+/* zlx_buf_file_flush *******************************************************/
+/**
+ *  Writes the pending data to the wrapped file.
+ *  On failure, data that could not be written stays in the buffer.
+ *  @returns the status of the last write
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_buf_file_flush
+(
+    zlx_buf_file_t * restrict bf
+);
+
+/* zlx_buf_file_peek ********************************************************/
+/**
+ *  Gives access to buffered read data, reading more if needed.
+ *  @param bf [in, out]
+ *      buffered file
+ *  @param data [out]
+ *      receives a pointer to the buffered data; it stays valid until the
+ *      next operation on the file
+ *  @param min_size [in]
+ *      amount of data wanted; less is returned only at end of file
+ *  @returns
+ *      the amount of data available at @a *data (which can be more than
+ *      @a min_size) or a negated #zlx_file_status_t value;
+ *      -#ZLXF_SIZE_LIMIT if @a min_size is larger than the buffer
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_buf_file_peek
+(
+    zlx_buf_file_t * restrict bf,
+    uint8_t const * * data,
+    size_t min_size
+);
+
+/* zlx_buf_file_consume *****************************************************/
+/**
+ *  Marks data returned by zlx_buf_file_peek() as read.
+ *  @param bf [in, out]
+ *      buffered file
+ *  @param size [in]
+ *      amount of data; it must not exceed what zlx_buf_file_peek() returned
+ */
+ZLX_INLINE void zlx_buf_file_consume
+(
+    zlx_buf_file_t * restrict bf,
+    size_t size
+)
+{
+    bf->rpos += size;
+}
+
+/** @} */
+
+#endif /* _ZLX_BUFFILE_H */
@@ -0,0 +1,26 @@
+#ifndef _ZLX_CLOCK_H
+#define _ZLX_CLOCK_H
+
+#include "base.h"
+
+/** @defgroup clock Clock
+ *  Access to the monotonic clock of the host.
+ *  @{ */
+
+/** Nanoseconds in a millisecond */
+#define ZLX_NS_PER_MS 1000000
+
+/** Nanoseconds in a second */
+#define ZLX_NS_PER_SEC 1000000000
+
+/* zlx_clock_mono_ns ********************************************************/
+/**
+ *  Reads the monotonic clock.
+ *  @returns time in nanoseconds from an unspecified starting point, or 0 when
+ *      the target has no supported clock
+ */
+ZLX_API uint64_t ZLX_CALL zlx_clock_mono_ns ();
+
+/** @} */
+
+#endif /* _ZLX_CLOCK_H */
@@ -0,0 +1,116 @@
+#ifndef _ZLX_CRC32C_H
+#define _ZLX_CRC32C_H
+
+#include "base.h"
+#include "file.h"
+
+/** @defgroup crc32c CRC32C
+ *  CRC-32 with the Castagnoli polynomial (iSCSI, ext4, SSE4.2 crc32).
+ *
+ *  On x86-64 processors with SSE4.2 the checksum is computed with the crc32
+ *  instruction over three interleaved streams, whose results are merged by
+ *  table-driven shifts; elsewhere it uses 8 lookup tables (slice-by-8).
+ *
+ *  Checksums of separate chunks, for instance computed by several threads,
+ *  are merged with zlx_crc32c_combine(). A filter file, #zlx_crc_file_t,
+ *  checksums the data passing through it.
+ *  @{ */
+
+/*  zlx_crc_file_t  */
+/**
+ *  File object passing reads and writes to another file while checksumming
+ *  the data.
+ */
+typedef struct zlx_crc_file_s zlx_crc_file_t;
+
+struct zlx_crc_file_s
+{
+    /** base file object */
+    zlx_file_t base;
+
+    /** file doing the I/O */
+    zlx_file_t * inner;
+
+    /** checksum of the data read */
+    uint32_t read_crc;
+
+    /** checksum of the data written */
+    uint32_t write_crc;
+
+    /** amount of data read */
+    uint64_t read_size;
+
+    /** amount of data written */
+    uint64_t write_size;
+};
+
+/* zlx_crc32c ***************************************************************/
+/**
+ *  Updates a checksum.
+ *  @param crc [in]
+ *      checksum of the preceding data; 0 for none
+ *  @param data [in]
+ *      data
+ *  @param size [in]
+ *      size of data
+ *  @returns the checksum of the preceding data followed by @a data
+ */
+ZLX_API uint32_t ZLX_CALL zlx_crc32c
+(
+    uint32_t crc,
+    void const * data,
+    size_t size
+);
+
+/* zlx_crc32c_sw ************************************************************/
+/**
+ *  Updates a checksum with the lookup tables only, whatever the processor
+ *  supports. The result is the same as with zlx_crc32c().
+ */
+ZLX_API uint32_t ZLX_CALL zlx_crc32c_sw
+(
+    uint32_t crc,
+    void const * data,
+    size_t size
+);
+
+/* zlx_crc32c_combine *******************************************************/
+/**
+ *  Computes the checksum of two concatenated chunks.
+ *  @param crc1 [in]
+ *      checksum of the first chunk
+ *  @param crc2 [in]
+ *      checksum of the second chunk
+ *  @param size2 [in]
+ *      size of the second chunk
+ */
+ZLX_API uint32_t ZLX_CALL zlx_crc32c_combine
+(
+    uint32_t crc1,
+    uint32_t crc2,
+    uint64_t size2
+);
+
+/* zlx_crc_file_init ********************************************************/
+/**
+ *  Initializes a checksumming filter.
+ *  Data is checksummed in the caller's buffers once transferred, so the
+ *  filter makes no copy; only the bytes actually read or written count.
+ *  Seeking and truncating are passed through but do not affect the
+ *  checksums, which cover the data in the order it went through; positional
+ *  I/O is not supported. Closing closes @a inner.
+ *  @param cf [out]
+ *      filter
+ *  @param inner [in, out]
+ *      file to read from or write to; the filter gets its access and seek
+ *      flags
+ */
+ZLX_API void ZLX_CALL zlx_crc_file_init
+(
+    zlx_crc_file_t * restrict cf,
+    zlx_file_t * restrict inner
+);
+
+/** @} */
+
+#endif /* _ZLX_CRC32C_H */
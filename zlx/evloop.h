@@ -0,0 +1,364 @@
+#ifndef _ZLX_EVLOOP_H
+#define _ZLX_EVLOOP_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "file.h"
+
+/** @defgroup evloop Event loop
+ *  Readiness notifications for file objects backed by descriptors, timers
+ *  and cross-thread wake-ups, all dispatched on the thread running the loop.
+ *
+ *  The loop is implemented with edge-triggered epoll and an eventfd, so it
+ *  is available only when building for Linux; elsewhere zlx_evloop_init()
+ *  returns #ZLXF_NO_CODE.
+ *  Loops share no state, so a process can run one loop per core.
+ *  @{ */
+
+/*  zlx_evloop_t  */
+/**
+ *  Event loop instance.
+ */
+typedef struct zlx_evloop_s zlx_evloop_t;
+
+/*  zlx_evsrc_t  */
+/**
+ *  File registered with an event loop.
+ *  This is owned by the caller (usually embedded in the structure
+ *  describing the stream) and must stay valid while registered.
+ */
+typedef struct zlx_evsrc_s zlx_evsrc_t;
+
+/*  zlx_evtimer_t  */
+/**
+ *  Timer owned by the caller and queued in the timer heap of an event loop.
+ */
+typedef struct zlx_evtimer_s zlx_evtimer_t;
+
+/*  zlx_evsrc_func_t  */
+/**
+ *  Readiness callback.
+ *  Notifications are edge-triggered: the callback is invoked once when the
+ *  file becomes ready and it should read or write until the file reports
+ *  #ZLXF_WOULD_BLOCK, otherwise it will not be notified again.
+ *  @param loop [in, out]
+ *      event loop
+ *  @param src [in, out]
+ *      registered source
+ *  @param ready [in]
+ *      combination of #ZLXF_READ and #ZLXF_WRITE; errors and hang-ups are
+ *      reported as both flags so that the next operation returns the error
+ */
+typedef void (ZLX_CALL * zlx_evsrc_func_t)
+    (
+        zlx_evloop_t * loop,
+        zlx_evsrc_t * src,
+        uint32_t ready
+    );
+
+/*  zlx_evtimer_func_t  */
+/**
+ *  Timer callback. The timer is no longer queued when this is called so
+ *  the callback can restart it.
+ */
+typedef void (ZLX_CALL * zlx_evtimer_func_t)
+    (
+        zlx_evloop_t * loop,
+        zlx_evtimer_t * timer
+    );
+
+/*  zlx_evloop_wake_func_t  */
+/**
+ *  Function called on the loop thread after zlx_evloop_wakeup().
+ */
+typedef void (ZLX_CALL * zlx_evloop_wake_func_t)
+    (
+        zlx_evloop_t * loop,
+        void * ctx
+    );
+
+/** Value of zlx_evtimer_t#heap_index for timers not queued */
+#define ZLX_EVTIMER_IDLE SIZE_MAX
+
+struct zlx_evsrc_s
+{
+    /** registered file */
+    zlx_file_t * file;
+
+    /** readiness callback */
+    zlx_evsrc_func_t func;
+
+    /** user context */
+    void * ctx;
+
+    /** descriptor obtained with zlx_file_os_handle() */
+    int fd;
+
+    /** interest flags: #ZLXF_READ and/or #ZLXF_WRITE */
+    uint32_t interest;
+};
+
+struct zlx_evtimer_s
+{
+    /** expiry time, in zlx_clock_mono_ns() units */
+    uint64_t deadline;
+
+    /** callback */
+    zlx_evtimer_func_t func;
+
+    /** user context */
+    void * ctx;
+
+    /** position in the timer heap or #ZLX_EVTIMER_IDLE */
+    size_t heap_index;
+};
+
+struct zlx_evloop_s
+{
+    /** allocator for the timer heap */
+    zlx_ma_t * ma;
+
+    /** timer heap (min-heap on zlx_evtimer_t#deadline) */
+    zlx_evtimer_t * * heap;
+
+    /** number of queued timers */
+    size_t heap_len;
+
+    /** allocated entries in #heap */
+    size_t heap_cap;
+
+    /** time cached at the last poll; see zlx_evloop_now() */
+    uint64_t now;
+
+    /** events returned by the last poll which are still to be dispatched */
+    void * pending;
+
+    /** number of entries in #pending */
+    int pending_count;
+
+    /** epoll descriptor */
+    int poll_fd;
+
+    /** eventfd used by zlx_evloop_wakeup() */
+    int wake_fd;
+
+    /** function called after a wake-up */
+    zlx_evloop_wake_func_t wake_func;
+
+    /** context for #wake_func */
+    void * wake_ctx;
+
+    /** set by zlx_evloop_stop() */
+    uint8_t stopping;
+};
+
+/* zlx_evloop_init **********************************************************/
+/**
+ *  Initializes an event loop.
+ *  @param loop [out]
+ *      loop to initialize
+ *  @param ma [in]
+ *      allocator for the timer heap
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_FAILED failed creating the descriptors
+ *  @retval ZLXF_NO_CODE not supported on this platform
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_init
+(
+    zlx_evloop_t * restrict loop,
+    zlx_ma_t * restrict ma
+);
+
+/* zlx_evloop_finish ********************************************************/
+/**
+ *  Frees the resources of the loop.
+ *  Registered sources and queued timers are simply forgotten.
+ */
+ZLX_API void ZLX_CALL zlx_evloop_finish
+(
+    zlx_evloop_t * restrict loop
+);
+
+/* zlx_evloop_add ***********************************************************/
+/**
+ *  Registers a file for readiness notifications.
+ *  @param loop [in, out]
+ *      event loop
+ *  @param src [out]
+ *      source structure to fill in and register
+ *  @param zf [in]
+ *      file; it must be backed by a descriptor (see zlx_file_os_handle())
+ *      and should be non-blocking (#ZLXF_NONBLOCK)
+ *  @param interest [in]
+ *      #ZLXF_READ and/or #ZLXF_WRITE
+ *  @param func [in]
+ *      readiness callback
+ *  @param ctx [in]
+ *      user context stored in zlx_evsrc_t#ctx
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_BAD_FILE_DESC file has no descriptor or it cannot be polled
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_add
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src,
+    zlx_file_t * zf,
+    uint32_t interest,
+    zlx_evsrc_func_t func,
+    void * ctx
+);
+
+/* zlx_evloop_modify ********************************************************/
+/**
+ *  Changes the interest flags of a registered source.
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_modify
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src,
+    uint32_t interest
+);
+
+/* zlx_evloop_del ***********************************************************/
+/**
+ *  Unregisters a source.
+ *  This is safe to call from callbacks, including for sources with
+ *  notifications pending in the current dispatch round; after this returns
+ *  the source can be freed.
+ */
+ZLX_API void ZLX_CALL zlx_evloop_del
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evsrc_t * restrict src
+);
+
+/* zlx_evtimer_init *********************************************************/
+/**
+ *  Initializes a timer in the idle state.
+ */
+ZLX_INLINE void zlx_evtimer_init
+(
+    zlx_evtimer_t * timer,
+    zlx_evtimer_func_t func,
+    void * ctx
+)
+{
+    timer->deadline = 0;
+    timer->func = func;
+    timer->ctx = ctx;
+    timer->heap_index = ZLX_EVTIMER_IDLE;
+}
+
+/* zlx_evtimer_start ********************************************************/
+/**
+ *  Queues (or re-queues) a timer to expire at the given time.
+ *  @param loop [in, out]
+ *      event loop
+ *  @param timer [in, out]
+ *      timer initialized with zlx_evtimer_init()
+ *  @param deadline [in]
+ *      expiry time in zlx_clock_mono_ns() units; see zlx_evloop_now()
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_FAILED failed to grow the timer heap
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evtimer_start
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evtimer_t * restrict timer,
+    uint64_t deadline
+);
+
+/* zlx_evtimer_stop *********************************************************/
+/**
+ *  Removes a timer from the queue; does nothing if the timer is idle.
+ */
+ZLX_API void ZLX_CALL zlx_evtimer_stop
+(
+    zlx_evloop_t * restrict loop,
+    zlx_evtimer_t * restrict timer
+);
+
+/* zlx_evloop_now ***********************************************************/
+/**
+ *  Returns the time cached by the loop when it last returned from polling.
+ *  Use this to compute timer deadlines without reading the clock.
+ */
+ZLX_INLINE uint64_t zlx_evloop_now
+(
+    zlx_evloop_t * loop
+)
+{
+    return loop->now;
+}
+
+/* zlx_evloop_set_wake_func *************************************************/
+/**
+ *  Sets the function to call on the loop thread after zlx_evloop_wakeup().
+ *  This must be called before other threads use zlx_evloop_wakeup().
+ */
+ZLX_INLINE void zlx_evloop_set_wake_func
+(
+    zlx_evloop_t * loop,
+    zlx_evloop_wake_func_t func,
+    void * ctx
+)
+{
+    loop->wake_func = func;
+    loop->wake_ctx = ctx;
+}
+
+/* zlx_evloop_wakeup ********************************************************/
+/**
+ *  Wakes up the loop from another thread.
+ *  Several wake-ups sent before the loop gets to process them result in a
+ *  single call to the wake function.
+ */
+ZLX_API void ZLX_CALL zlx_evloop_wakeup
+(
+    zlx_evloop_t * loop
+);
+
+/* zlx_evloop_run_once ******************************************************/
+/**
+ *  Waits for events and dispatches them.
+ *  @param loop [in, out]
+ *      event loop
+ *  @param max_wait_ns [in]
+ *      maximum time to wait; negative to wait until something happens,
+ *      0 to just poll; the wait is also limited by the earliest timer
+ *  @returns number of callbacks invoked, or a negated #zlx_file_status_t
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_evloop_run_once
+(
+    zlx_evloop_t * restrict loop,
+    int64_t max_wait_ns
+);
+
+/* zlx_evloop_run ***********************************************************/
+/**
+ *  Dispatches events until zlx_evloop_stop() is called.
+ *  @retval ZLXF_OK stopped
+ *  @retval other error from polling
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_evloop_run
+(
+    zlx_evloop_t * restrict loop
+);
+
+/* zlx_evloop_stop **********************************************************/
+/**
+ *  Makes zlx_evloop_run() return after the current dispatch round.
+ *  This must be called on the loop thread (for instance from the wake
+ *  function).
+ */
+ZLX_INLINE void zlx_evloop_stop
+(
+    zlx_evloop_t * loop
+)
+{
+    loop->stopping = 1;
+}
+
+/** @} */
+
+#endif /* _ZLX_EVLOOP_H */
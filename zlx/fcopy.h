@@ -0,0 +1,90 @@
+#ifndef _ZLX_FCOPY_H
+#define _ZLX_FCOPY_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "file.h"
+
+/** @defgroup fcopy File copy
+ *  Copying data between file objects.
+ *
+ *  When both ends are descriptor-backed files (see zlx_fd_file_from()) the
+ *  data is moved by the kernel and never enters user space; the methods
+ *  tried are, in order, copy_file_range(), sendfile() and splice() (through
+ *  a pipe if neither end is one). A method the kernel rejects for the given
+ *  descriptors is skipped as long as nothing was copied with it. Otherwise,
+ *  data goes through a large page-aligned bounce buffer.
+ *  Copying starts at, and advances, the current position of each file.
+ *  @{ */
+
+/*  zlx_fcopy_stats_t  */
+/**
+ *  Statistics of a copy operation.
+ */
+typedef struct zlx_fcopy_stats_s zlx_fcopy_stats_t;
+
+/** Copy method: nothing was copied */
+#define ZLX_FCOPY_NONE 0
+
+/** Copy method: copy_file_range() */
+#define ZLX_FCOPY_RANGE 1
+
+/** Copy method: sendfile() */
+#define ZLX_FCOPY_SENDFILE 2
+
+/** Copy method: splice() */
+#define ZLX_FCOPY_SPLICE 3
+
+/** Copy method: read and write through a buffer */
+#define ZLX_FCOPY_BUFFER 4
+
+/** Length for zlx_file_copy() meaning "up to the end of the source" */
+#define ZLX_FCOPY_ALL UINT64_MAX
+
+/** Size of the bounce buffer */
+#define ZLX_FCOPY_BUFFER_SIZE 0x100000
+
+struct zlx_fcopy_stats_s
+{
+    /** bytes moved */
+    uint64_t bytes;
+
+    /** duration of the copy in nanoseconds */
+    uint64_t elapsed_ns;
+
+    /** throughput in bytes per second; 0 if too fast to measure */
+    uint64_t bytes_per_sec;
+
+    /** method that moved the data; one of ZLX_FCOPY_xxx */
+    uint32_t method;
+};
+
+/* zlx_file_copy ************************************************************/
+/**
+ *  Copies data from one file to another.
+ *  @param dst [in, out]
+ *      destination
+ *  @param src [in, out]
+ *      source
+ *  @param len [in]
+ *      amount to copy or #ZLX_FCOPY_ALL
+ *  @param ma [in]
+ *      allocator for the bounce buffer; if the allocation fails a small
+ *      buffer on the stack is used
+ *  @param stats [out, opt]
+ *      receives the statistics, also on error
+ *  @returns ZLXF_OK if @a len bytes were copied or the source ended,
+ *      the status of the failed operation otherwise
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_file_copy
+(
+    zlx_file_t * dst,
+    zlx_file_t * src,
+    uint64_t len,
+    zlx_ma_t * ma,
+    zlx_fcopy_stats_t * stats
+);
+
+/** @} */
+
+#endif /* _ZLX_FCOPY_H */
@@ -0,0 +1,260 @@
+#ifndef _ZLX_FDFILE_H
+#define _ZLX_FDFILE_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "file.h"
+
+/** @defgroup fdfile Descriptor-backed files
+ *  File objects working on OS file descriptors.
+ *
+ *  Operations map directly to the system calls (read, write, lseek,
+ *  ftruncate, pread, pwrite, close) and OS errors are translated to
+ *  #zlx_file_status_t values; an interrupted call returns -#ZLXF_INTERRUPTED
+ *  (zlx_read() and friends retry it) and a non-blocking descriptor that is
+ *  not ready returns -#ZLXF_WOULD_BLOCK. Positional reads and writes do not
+ *  touch the shared file position so several threads can work on the same
+ *  file object. Available only when built for Linux.
+ *
+ *  A file can be switched to direct I/O (O_DIRECT) with
+ *  zlx_fd_file_direct() so large scans do not evict other data from the
+ *  page cache. The kernel then requires offsets, sizes and buffer addresses
+ *  aligned to the block size; the file object takes care of that: aligned
+ *  spans go straight to the caller's buffer while unaligned heads and tails
+ *  are staged through blocks from a #zlx_dio_pool_t (writes to partial
+ *  blocks read, patch and write back the whole block).
+ *  @{ */
+
+/*  zlx_fd_file_t  */
+/**
+ *  File object wrapping a file descriptor.
+ */
+typedef struct zlx_fd_file_s zlx_fd_file_t;
+
+/*  zlx_dio_pool_t  */
+/**
+ *  Pool of aligned buffers used for direct I/O.
+ *  Getting and putting buffers is lock-free; the pool keeps up to
+ *  #ZLX_DIO_POOL_SLOTS free buffers and allocates more when they are all
+ *  in use, so the allocator must be thread-safe if the pool is shared by
+ *  threads.
+ */
+typedef struct zlx_dio_pool_s zlx_dio_pool_t;
+
+/** Number of free buffers kept by a #zlx_dio_pool_t */
+#define ZLX_DIO_POOL_SLOTS 8
+
+/** Default alignment for direct I/O; it matches the logical block size of
+ *  common devices */
+#define ZLX_DIO_ALIGN 0x1000
+
+/*  ZLX_FDF_CREATE  */
+/**
+ *  Open flag: create the file if it does not exist.
+ */
+#define ZLX_FDF_CREATE (1 << 8)
+
+/*  ZLX_FDF_EXCL  */
+/**
+ *  Open flag: together with #ZLX_FDF_CREATE, fail with #ZLXF_ALREADY_EXISTS
+ *  if the file exists.
+ */
+#define ZLX_FDF_EXCL (1 << 9)
+
+/*  ZLX_FDF_TRUNCATE  */
+/**
+ *  Open flag: truncate the file to zero length.
+ */
+#define ZLX_FDF_TRUNCATE (1 << 10)
+
+/*  ZLX_FDF_APPEND  */
+/**
+ *  Open flag: all writes go to the end of the file.
+ */
+#define ZLX_FDF_APPEND (1 << 11)
+
+/*  ZLX_FDF_OWN  */
+/**
+ *  Wrap flag: the descriptor is closed when the file object is closed.
+ *  Files opened with zlx_fd_file_open() always own their descriptor.
+ */
+#define ZLX_FDF_OWN (1 << 12)
+
+struct zlx_dio_pool_s
+{
+    /** allocator */
+    zlx_ma_t * ma;
+
+    /** size of each buffer; a multiple of #align */
+    size_t buf_size;
+
+    /** alignment of buffers and of direct transfers; a power of 2 */
+    size_t align;
+
+    /** free buffers; NULL entries are empty */
+    void * slots[ZLX_DIO_POOL_SLOTS];
+};
+
+struct zlx_fd_file_s
+{
+    /** base file object */
+    zlx_file_t base;
+
+    /** file descriptor */
+    int fd;
+
+    /** non-zero if the descriptor is closed together with the file */
+    uint32_t own;
+
+    /** buffer pool when doing direct I/O, NULL otherwise */
+    zlx_dio_pool_t * dio;
+};
+
+/* zlx_fd_file_open *********************************************************/
+/**
+ *  Opens a file.
+ *  @param ff [out]
+ *      file object to initialize
+ *  @param path [in]
+ *      file path
+ *  @param flags [in]
+ *      combination of #ZLXF_READ, #ZLXF_WRITE, #ZLXF_NONBLOCK and the
+ *      ZLX_FDF_xxx open flags; new files are created with permissions 0666
+ *      (filtered by the process umask)
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_NOT_FOUND
+ *  @retval ZLXF_ACCESS_DENIED
+ *  @retval ZLXF_ALREADY_EXISTS
+ *  @retval ZLXF_NO_CODE not supported on this platform
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_fd_file_open
+(
+    zlx_fd_file_t * restrict ff,
+    char const * restrict path,
+    uint32_t flags
+);
+
+/* zlx_fd_file_wrap *********************************************************/
+/**
+ *  Initializes a file object for an existing descriptor.
+ *  Whether the descriptor is seekable or non-blocking is queried from the OS.
+ *  @param ff [out]
+ *      file object to initialize
+ *  @param fd [in]
+ *      descriptor
+ *  @param flags [in]
+ *      combination of #ZLXF_READ, #ZLXF_WRITE (operations allowed through
+ *      the file object) and #ZLX_FDF_OWN
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_BAD_FILE_DESC
+ *  @retval ZLXF_NO_CODE not supported on this platform
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_fd_file_wrap
+(
+    zlx_fd_file_t * restrict ff,
+    int fd,
+    uint32_t flags
+);
+
+/* zlx_fd_file_from *********************************************************/
+/**
+ *  Checks whether a file object is a descriptor-backed file.
+ *  Unlike zlx_file_os_handle(), this does not accept wrappers (like
+ *  buffered or memory-mapped files) whose position or data are not those
+ *  of the descriptor.
+ *  @returns the file object or NULL
+ */
+ZLX_API zlx_fd_file_t * ZLX_CALL zlx_fd_file_from
+(
+    zlx_file_t * zf
+);
+
+/* zlx_fd_file_direct *******************************************************/
+/**
+ *  Turns direct I/O on or off.
+ *  While on, the file position is read and updated with lseek() around
+ *  each read and write, so the position must not be shared with other
+ *  threads doing sequential I/O; positional I/O is fine. Vectored I/O goes
+ *  through the same path one buffer at a time.
+ *  @param ff [in, out]
+ *      seekable file
+ *  @param pool [in, opt]
+ *      pool providing staging blocks; its alignment must be a multiple of
+ *      the logical block size of the file system; NULL turns direct I/O off
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_BAD_OPERATION the file is not seekable or the file system
+ *      does not support direct I/O
+ *  @retval ZLXF_NO_CODE not supported on this platform
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_fd_file_direct
+(
+    zlx_fd_file_t * restrict ff,
+    zlx_dio_pool_t * pool
+);
+
+/* zlx_dio_pool_init ********************************************************/
+/**
+ *  Initializes an empty buffer pool.
+ *  @param pool [out]
+ *      pool
+ *  @param ma [in]
+ *      allocator
+ *  @param buf_size [in]
+ *      size of each buffer; rounded up to a multiple of @a align
+ *  @param align [in]
+ *      alignment; a power of 2, at least the size of a pointer; 0 for
+ *      #ZLX_DIO_ALIGN
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_BAD_OPERATION bad alignment
+ *  @retval ZLXF_SIZE_LIMIT bad size
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_dio_pool_init
+(
+    zlx_dio_pool_t * restrict pool,
+    zlx_ma_t * restrict ma,
+    size_t buf_size,
+    size_t align
+);
+
+/* zlx_dio_pool_finish ******************************************************/
+/**
+ *  Frees the buffers in the pool. All buffers must have been put back.
+ */
+ZLX_API void ZLX_CALL zlx_dio_pool_finish
+(
+    zlx_dio_pool_t * restrict pool
+);
+
+/* zlx_dio_pool_get *********************************************************/
+/**
+ *  Gets a buffer of zlx_dio_pool_t#buf_size bytes aligned to
+ *  zlx_dio_pool_t#align.
+ *  @returns the buffer or NULL if out of memory
+ */
+ZLX_API uint8_t * ZLX_CALL zlx_dio_pool_get
+(
+    zlx_dio_pool_t * pool
+);
+
+/* zlx_dio_pool_put *********************************************************/
+/**
+ *  Returns a buffer to the pool.
+ */
+ZLX_API void ZLX_CALL zlx_dio_pool_put
+(
+    zlx_dio_pool_t * pool,
+    uint8_t * buf
+);
+
+/* zlx_fd_file_status *******************************************************/
+/**
+ *  Translates an OS error code (errno value) to a file status.
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_fd_file_status
+(
+    int err
+);
+
+/** @} */
+
+#endif /* _ZLX_FDFILE_H */
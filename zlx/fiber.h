@@ -0,0 +1,393 @@
+#ifndef _ZLX_FIBER_H
+#define _ZLX_FIBER_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "dlist.h"
+#include "thread.h"
+#include "file.h"
+
+/** @defgroup fiber Fibers
+ *  Stackful coroutines and an M:N scheduler that runs them on a set of
+ *  worker threads created through #zlx_thread_xfc_t.
+ *
+ *  Context switching is implemented only for AMD64 System V targets (ELF);
+ *  on other targets zlx_fsched_spawn() returns #ZLX_MTH_NO_SUP.
+ *  Guard pages for the fiber stacks and parking fibers on file descriptors
+ *  are available only when building for Linux.
+ *  @{ */
+
+/*  zlx_fiber_t  */
+/**
+ *  Fiber instance.
+ */
+typedef struct zlx_fiber_s zlx_fiber_t;
+
+/*  zlx_fsched_t  */
+/**
+ *  Fiber scheduler instance.
+ */
+typedef struct zlx_fsched_s zlx_fsched_t;
+
+/*  zlx_fsched_worker_t  */
+/**
+ *  Per worker thread state of the fiber scheduler.
+ */
+typedef struct zlx_fsched_worker_s zlx_fsched_worker_t;
+
+/*  zlx_fiber_ctx_t  */
+/**
+ *  Saved execution context of a fiber.
+ */
+typedef struct zlx_fiber_ctx_s zlx_fiber_ctx_t;
+
+/*  zlx_fiber_func_t  */
+/**
+ *  Fiber function.
+ *  @param self [in, out]
+ *      the fiber running the function; this must be passed to all
+ *      fiber functions that suspend the fiber (zlx_fiber_yield(),
+ *      zlx_fiber_park(), zlx_fiber_wait_fd()...)
+ *  @param arg [in]
+ *      argument given to zlx_fsched_spawn()
+ */
+typedef void (ZLX_CALL * zlx_fiber_func_t)
+    (
+        zlx_fiber_t * self,
+        void * arg
+    );
+
+/*  zlx_fiber_park_func_t  */
+/**
+ *  Function called after a fiber got suspended by zlx_fiber_park().
+ *  The function runs on the worker thread, outside of the stack of the
+ *  fiber, so it can safely publish the fiber to whatever component will
+ *  call zlx_fiber_unpark() for it.
+ */
+typedef void (ZLX_CALL * zlx_fiber_park_func_t)
+    (
+        zlx_fiber_t * fiber,
+        void * ctx
+    );
+
+/** Default stack size for fibers (used when 0 is given to zlx_fsched_init) */
+#define ZLX_FIBER_DEFAULT_STACK_SIZE 0x10000
+
+struct zlx_fiber_ctx_s
+{
+    void * sp; /**< saved stack pointer */
+};
+
+struct zlx_fiber_s
+{
+    /** links in the run queue of the scheduler */
+    zlx_np_t links;
+
+    /** saved context while the fiber is not running */
+    zlx_fiber_ctx_t ctx;
+
+    /** scheduler owning the fiber */
+    zlx_fsched_t * sched;
+
+    /** worker currently running the fiber */
+    zlx_fsched_worker_t * worker;
+
+    /** fiber function */
+    zlx_fiber_func_t func;
+
+    /** argument for the fiber function */
+    void * arg;
+
+    /** function to call after the fiber got parked */
+    zlx_fiber_park_func_t park_func;
+
+    /** context for #park_func */
+    void * park_ctx;
+
+    /** allocated block holding the stack and this structure */
+    uint8_t * block;
+
+    /** size of #block */
+    size_t block_size;
+
+    /** start of the guard page or NULL if there is no guard page */
+    uint8_t * guard;
+
+    /** file descriptor the fiber waits on */
+    int io_fd;
+
+    /** readiness flags (#ZLXF_READ, #ZLXF_WRITE) reported by the poller */
+    uint32_t io_ready;
+
+    /** what the fiber asked its worker to do after switching out */
+    uint8_t action;
+};
+
+struct zlx_fsched_worker_s
+{
+    /** context of the worker loop */
+    zlx_fiber_ctx_t ctx;
+
+    /** scheduler */
+    zlx_fsched_t * sched;
+
+    /** thread id (not valid for the worker running on the calling thread) */
+    zlx_tid_t tid;
+};
+
+struct zlx_fsched_s
+{
+    /** queue of fibers ready to run */
+    zlx_np_t run_queue;
+
+    /** memory allocator for fibers and internal structures */
+    zlx_ma_t * ma;
+
+    /** multithreading interface */
+    zlx_mth_xfc_t * mth;
+
+    /** mutex protecting the scheduler; NULL if the mutex interface has no
+     *  instance size */
+    zlx_mutex_t * mutex;
+
+    /** condition where idle workers wait; NULL when the interface does not
+     *  support condition variables */
+    zlx_cond_t * cond;
+
+    /** CPUs for pinning workers or NULL; see zlx_fsched_set_worker_cpus() */
+    unsigned int const * worker_cpus;
+
+    /** number of items in #worker_cpus */
+    size_t worker_cpu_count;
+
+    /** workers; valid during zlx_fsched_run() */
+    zlx_fsched_worker_t * workers;
+
+    /** number of items in #workers */
+    size_t worker_count;
+
+    /** stack size for new fibers */
+    size_t stack_size;
+
+    /** number of fibers spawned and not finished yet */
+    size_t fiber_count;
+
+    /** number of workers waiting on #cond */
+    size_t idle_count;
+
+    /** number of fibers waiting for file descriptors */
+    size_t io_waiter_count;
+
+    /** poll descriptor (epoll on Linux) or -1 */
+    int poll_fd;
+
+    /** descriptor used to wake up the worker polling (eventfd) or -1 */
+    int wake_fd;
+
+    /** set while a worker is blocked polling for I/O */
+    uint8_t poller_active;
+
+    /** set by zlx_fsched_stop() */
+    uint8_t stopping;
+};
+
+/* zlx_fsched_init **********************************************************/
+/**
+ *  Initializes a fiber scheduler.
+ *  @param sched [out]
+ *      scheduler to initialize
+ *  @param ma [in]
+ *      memory allocator used for fiber stacks and internal structures
+ *  @param mth [in, opt]
+ *      multithreading interface; if NULL, #zlx_nosup_mth_xfc is used and the
+ *      scheduler can only run on the calling thread
+ *  @param stack_size [in]
+ *      stack size for fibers; 0 selects #ZLX_FIBER_DEFAULT_STACK_SIZE
+ *  @retval ZLX_MTH_OK
+ *  @retval ZLX_MTH_NO_MEM
+ *  @retval ZLX_MTH_NO_RES failed to create the I/O poller
+ */
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_fsched_init
+(
+    zlx_fsched_t * restrict sched,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * restrict mth,
+    size_t stack_size
+);
+
+/* zlx_fsched_finish ********************************************************/
+/**
+ *  Frees the resources held by the scheduler.
+ *  All fibers must have finished before calling this.
+ */
+ZLX_API void ZLX_CALL zlx_fsched_finish
+(
+    zlx_fsched_t * restrict sched
+);
+
+/* zlx_fsched_spawn *********************************************************/
+/**
+ *  Creates a fiber and queues it for running.
+ *  This can be called from any thread and from inside fibers.
+ *  @param sched [in, out]
+ *      scheduler
+ *  @param func [in]
+ *      fiber function
+ *  @param arg [in]
+ *      argument for @a func
+ *  @retval ZLX_MTH_OK
+ *  @retval ZLX_MTH_NO_MEM
+ *  @retval ZLX_MTH_NO_SUP context switching not available for this target
+ */
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_fsched_spawn
+(
+    zlx_fsched_t * restrict sched,
+    zlx_fiber_func_t func,
+    void * arg
+);
+
+/* zlx_fsched_set_worker_cpus ***********************************************/
+/**
+ *  Pins the workers started by zlx_fsched_run() to CPUs: worker @a i runs
+ *  on @a cpus[i % @a cpu_count]. Worker 0 is the thread calling
+ *  zlx_fsched_run() and it stays pinned after the call returns.
+ *  Pass the output of zlx_topo_core_cpus() to run one worker per physical
+ *  core. Pinning uses zlx_thread_xfc_t#set_affinity and is skipped when the
+ *  interface does not provide it.
+ *  @param sched [in, out]
+ *      scheduler
+ *  @param cpus [in]
+ *      CPU indexes; the array must stay valid while the scheduler runs;
+ *      NULL to disable pinning
+ *  @param cpu_count [in]
+ *      number of items in @a cpus
+ */
+ZLX_INLINE void zlx_fsched_set_worker_cpus
+(
+    zlx_fsched_t * sched,
+    unsigned int const * cpus,
+    size_t cpu_count
+)
+{
+    sched->worker_cpus = cpu_count ? cpus : NULL;
+    sched->worker_cpu_count = cpu_count;
+}
+
+/* zlx_fsched_run ***********************************************************/
+/**
+ *  Runs the fibers on @a worker_count workers: the calling thread plus
+ *  @a worker_count - 1 threads created with the thread interface.
+ *  Returns when all fibers finished or zlx_fsched_stop() was called.
+ *  @retval ZLX_MTH_OK
+ *  @retval ZLX_MTH_NO_MEM
+ *  @retval ZLX_MTH_DEADLOCK there are parked fibers but nothing that can
+ *      unpark them (only reported when condition variables are not
+ *      supported by the interface)
+ *  @retval other status returned by the thread interface when creating
+ *      workers
+ */
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_fsched_run
+(
+    zlx_fsched_t * restrict sched,
+    size_t worker_count
+);
+
+/* zlx_fsched_stop **********************************************************/
+/**
+ *  Asks all workers to return after finishing the fiber they run.
+ */
+ZLX_API void ZLX_CALL zlx_fsched_stop
+(
+    zlx_fsched_t * restrict sched
+);
+
+/* zlx_fiber_yield **********************************************************/
+/**
+ *  Puts the running fiber at the end of the run queue and switches to
+ *  the next ready fiber.
+ */
+ZLX_API void ZLX_CALL zlx_fiber_yield
+(
+    zlx_fiber_t * self
+);
+
+/* zlx_fiber_park ***********************************************************/
+/**
+ *  Suspends the running fiber until zlx_fiber_unpark() is called for it.
+ *  @param self [in, out]
+ *      running fiber
+ *  @param func [in]
+ *      function called with the fiber already switched out; this is where
+ *      the fiber should be handed to whoever will unpark it
+ *  @param ctx [in]
+ *      context for @a func
+ */
+ZLX_API void ZLX_CALL zlx_fiber_park
+(
+    zlx_fiber_t * self,
+    zlx_fiber_park_func_t func,
+    void * ctx
+);
+
+/* zlx_fiber_unpark *********************************************************/
+/**
+ *  Queues a parked fiber for running.
+ *  This can be called from any thread.
+ */
+ZLX_API void ZLX_CALL zlx_fiber_unpark
+(
+    zlx_fiber_t * fiber
+);
+
+/* zlx_fiber_wait_fd ********************************************************/
+/**
+ *  Parks the running fiber until the given file descriptor is ready.
+ *  Only one fiber can wait on a given descriptor at a time.
+ *  @param self [in, out]
+ *      running fiber
+ *  @param fd [in]
+ *      file descriptor
+ *  @param flags [in]
+ *      #ZLXF_READ and/or #ZLXF_WRITE
+ *  @returns readiness flags (#ZLXF_READ, #ZLXF_WRITE) or a negated
+ *      #zlx_file_status_t value: -#ZLXF_BAD_FILE_DESC if the descriptor
+ *      cannot be polled or -#ZLXF_NO_CODE if not supported on this platform
+ */
+ZLX_API int ZLX_CALL zlx_fiber_wait_fd
+(
+    zlx_fiber_t * self,
+    int fd,
+    unsigned int flags
+);
+
+/* zlx_fiber_read ***********************************************************/
+/**
+ *  Reads from a file parking the fiber while the file would block.
+ *  This is zlx_read() for fibers: when a non-blocking file (#ZLXF_NONBLOCK)
+ *  reports #ZLXF_WOULD_BLOCK, the fiber waits for the descriptor returned
+ *  by zlx_file_os_handle() to become readable and retries.
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_fiber_read
+(
+    zlx_fiber_t * self,
+    zlx_file_t * restrict zf,
+    void * restrict data,
+    size_t size
+);
+
+/* zlx_fiber_write **********************************************************/
+/**
+ *  Writes to a file parking the fiber while the file would block.
+ *  See zlx_fiber_read().
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_fiber_write
+(
+    zlx_fiber_t * self,
+    zlx_file_t * restrict zf,
+    void const * restrict data,
+    size_t size
+);
+
+/** @} */
+
+#endif /* _ZLX_FIBER_H */
@@ -26,6 +26,13 @@ typedef struct zlx_file_s zlx_file_t;
  */
 typedef struct zlx_file_class_s zlx_file_class_t;
 
+/*  zlx_iovec_t  */
+/**
+ *  Buffer descriptor for vectored (scatter/gather) I/O.
+ *  On POSIX systems it has the layout of struct iovec.
+ */
+typedef struct zlx_iovec_s zlx_iovec_t;
+
 /*  zlx_file_writer_ctx_t  */
 /**
  *  Context structure to allow using files where a writer (#zlx_writer_t) is 
@@ -74,6 +81,15 @@ typedef struct zlx_file_writer_ctx_s zlx_file_writer_ctx_t;
  */
 #define ZLXF_NONBLOCK (1 << 3)
 
+struct zlx_iovec_s
+{
+    /** buffer */
+    void * data;
+
+    /** buffer size */
+    size_t size;
+};
+
 enum zlx_file_status_enum
 {
     /** Ok */
@@ -125,7 +141,22 @@ enum zlx_file_status_enum
     ZLXF_FMT_CONV_ERROR,
 
     /** No code */
-    ZLXF_NO_CODE
+    ZLXF_NO_CODE,
+
+    /** File or directory not found */
+    ZLXF_NOT_FOUND,
+
+    /** Access to the file was denied */
+    ZLXF_ACCESS_DENIED,
+
+    /** File already exists (exclusive creation) */
+    ZLXF_ALREADY_EXISTS,
+
+    /** Not enough memory */
+    ZLXF_NO_MEM,
+
+    /** Malformed or corrupted data */
+    ZLXF_BAD_DATA
 };
 
 struct zlx_file_class_s
@@ -189,6 +220,77 @@ struct zlx_file_class_s
 
     /** A static name describing the file class */
     char const * restrict name;
+
+    /** Retrieves the OS handle backing the file (a file descriptor on
+     *  Unix-like systems). This member is optional and can be NULL for
+     *  classes that are not backed by an OS object.
+     *  @returns the handle or a negative value if there is none */
+    intptr_t (ZLX_CALL * os_handle)
+        (
+            zlx_file_t * restrict f
+        );
+
+    /** Reads from the given offset without using or changing the file
+     *  position, so several threads can read the same file concurrently.
+     *  This member is optional and can be NULL.
+     *  @param f [in, out]
+     *      file to read from
+     *  @param data [out]
+     *      buffer to fill with data
+     *  @param size [in]
+     *      amount of data requested
+     *  @param offset [in]
+     *      file offset to read from
+     *  @returns 
+     *      number of bytes read, which can be less than @a size, or a
+     *      negative number on error matching a negated #zlx_file_status_t value
+     **/
+    ptrdiff_t (ZLX_CALL * pread)
+        (
+            zlx_file_t * restrict f,
+            uint8_t * restrict data,
+            size_t size,
+            uint64_t offset
+        );
+
+    /** Writes at the given offset without using or changing the file
+     *  position. This member is optional and can be NULL.
+     *  @returns number of bytes written, which can be less than @a size, or a
+     *      negative number on error, matching a negated #zlx_file_status_t
+     *      value.
+     **/
+    ptrdiff_t (ZLX_CALL * pwrite)
+        (
+            zlx_file_t * restrict f,
+            uint8_t const * restrict data,
+            size_t size,
+            uint64_t offset
+        );
+
+    /** Reads into several buffers, filling each before moving to the next.
+     *  This member is optional and can be NULL (see zlx_raw_readv()).
+     *  @returns total number of bytes read or a negative number on error,
+     *      matching a negated #zlx_file_status_t value
+     **/
+    ptrdiff_t (ZLX_CALL * readv)
+        (
+            zlx_file_t * restrict f,
+            zlx_iovec_t const * iov,
+            size_t count
+        );
+
+    /** Writes the contents of several buffers in order.
+     *  This member is optional and can be NULL (see zlx_raw_writev()).
+     *  @returns total number of bytes written, which can be less than the
+     *      total size, or a negative number on error, matching a negated
+     *      #zlx_file_status_t value
+     **/
+    ptrdiff_t (ZLX_CALL * writev)
+        (
+            zlx_file_t * restrict f,
+            zlx_iovec_t const * iov,
+            size_t count
+        );
 };
 
 struct zlx_file_s
@@ -277,6 +379,182 @@ ZLX_API ptrdiff_t ZLX_CALL zlx_write
     size_t size
 );
 
+/* zlx_raw_pread ************************************************************/
+/**
+ *  Reads data from a given offset of a file.
+ *  This invokes the pread function from the file class of the given file
+ *  object. See zlx_file_class_t#pread.
+ *  @retval -ZLXF_BAD_OPERATION
+ *      the file class has no positional read
+ */
+ZLX_INLINE ptrdiff_t zlx_raw_pread
+(
+    zlx_file_t * restrict zf,
+    void * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    if (!zf->fcls->pread) return -ZLXF_BAD_OPERATION;
+    return zf->fcls->pread(zf, data, size, offset);
+}
+
+/* zlx_raw_pwrite ***********************************************************/
+/**
+ *  Writes data at a given offset of a file.
+ *  This invokes the pwrite function from the file class of the given file
+ *  object. See zlx_file_class_t#pwrite.
+ *  @retval -ZLXF_BAD_OPERATION
+ *      the file class has no positional write
+ */
+ZLX_INLINE ptrdiff_t zlx_raw_pwrite
+(
+    zlx_file_t * restrict zf,
+    void const * restrict data,
+    size_t size,
+    uint64_t offset
+)
+{
+    if (!zf->fcls->pwrite) return -ZLXF_BAD_OPERATION;
+    return zf->fcls->pwrite(zf, data, size, offset);
+}
+
+/* zlx_pread ****************************************************************/
+/**
+ *  Reads from a given offset of a file ignoring interruptions.
+ *  The file position is neither used nor changed.
+ *  @retval -ZLXF_BAD_OPERATION
+ *      read not allowed for this file or the class has no positional read
+ *  @retval -ZLXF_OVERFLOW
+ *      @a size was too big causing integer overflow
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_pread
+(
+    zlx_file_t * restrict zf,
+    void * restrict data,
+    size_t size,
+    uint64_t offset
+);
+
+/* zlx_pwrite ***************************************************************/
+/**
+ *  Writes at a given offset of a file ignoring interruptions.
+ *  The file position is neither used nor changed.
+ *  @retval -ZLXF_BAD_OPERATION
+ *      write not allowed for this file or the class has no positional write
+ *  @retval -ZLXF_OVERFLOW
+ *      @a size was too big causing integer overflow
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_pwrite
+(
+    zlx_file_t * restrict zf,
+    void const * restrict data,
+    size_t size,
+    uint64_t offset
+);
+
+/* zlx_write_full ***********************************************************/
+/**
+ *  Writes the whole buffer, resuming after partial writes.
+ *  @param zf [in, out]
+ *      file to write to
+ *  @param data [in]
+ *      data
+ *  @param size [in]
+ *      size of data
+ *  @param written [out, opt]
+ *      receives the amount written, which is less than @a size only on error
+ *  @returns the status of the operation
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_write_full
+(
+    zlx_file_t * restrict zf,
+    void const * restrict data,
+    size_t size,
+    size_t * written
+);
+
+/* zlx_raw_readv ************************************************************/
+/**
+ *  Reads into several buffers.
+ *  This invokes the readv function from the file class of the given file
+ *  object; if the class has none, the buffers are filled with successive
+ *  reads, stopping at the first short read.
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_raw_readv
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t const * iov,
+    size_t count
+);
+
+/* zlx_raw_writev ***********************************************************/
+/**
+ *  Writes several buffers.
+ *  This invokes the writev function from the file class of the given file
+ *  object; if the class has none, the buffers are written with successive
+ *  writes, stopping at the first short write.
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_raw_writev
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t const * iov,
+    size_t count
+);
+
+/* zlx_readv ****************************************************************/
+/**
+ *  Reads into several buffers ignoring interruptions.
+ *  @retval -ZLXF_BAD_OPERATION
+ *      read not allowed for this file
+ *  @retval -ZLXF_OVERFLOW
+ *      the total size is too big
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_readv
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t const * iov,
+    size_t count
+);
+
+/* zlx_writev ***************************************************************/
+/**
+ *  Writes several buffers ignoring interruptions.
+ *  @retval -ZLXF_BAD_OPERATION
+ *      write not allowed for this file
+ *  @retval -ZLXF_OVERFLOW
+ *      the total size is too big
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_writev
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t const * iov,
+    size_t count
+);
+
+/* zlx_writev_full **********************************************************/
+/**
+ *  Writes all buffers, resuming after partial writes that can end anywhere,
+ *  including in the middle of a buffer.
+ *  @param zf [in, out]
+ *      file to write to
+ *  @param iov [in, out]
+ *      buffers; an entry is temporarily adjusted while resuming inside it
+ *      and restored before returning
+ *  @param count [in]
+ *      number of buffers
+ *  @param written [out, opt]
+ *      receives the total amount written
+ *  @returns the status of the operation
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_writev_full
+(
+    zlx_file_t * restrict zf,
+    zlx_iovec_t * iov,
+    size_t count,
+    size_t * written
+);
+
 struct zlx_file_writer_ctx_s
 {
     zlx_file_t * file;
@@ -329,6 +607,20 @@ ZLX_INLINE int64_t zlx_seek64
     return zf->fcls->seek64(zf, ofs, anchor);
 }
 
+/* zlx_file_os_handle *******************************************************/
+/**
+ *  Retrieves the OS handle backing the file.
+ *  See zlx_file_class_t#os_handle.
+ *  @returns the handle or -1 if the file is not backed by an OS object
+ */
+ZLX_INLINE intptr_t zlx_file_os_handle
+(
+    zlx_file_t * restrict zf
+)
+{
+    return zf->fcls->os_handle ? zf->fcls->os_handle(zf) : -1;
+}
+
 /* zlx_close ****************************************************************/
 /**
  *  Closes both the read and write ends of the stream.
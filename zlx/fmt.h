@@ -1,6 +1,7 @@
 #ifndef _ZLX_FMT_H
 #define _ZLX_FMT_H
 
+#include <stdarg.h>
 #include "base.h"
 #include "writer.h"
 
@@ -131,15 +132,56 @@ ZLX_API uint_fast8_t ZLX_CALL zlx_u64_from_str
     size_t * used_len
 );
 
+/* zlx_u64_list_from_str ****************************************************/
+/**
+ *  Parses a list of unsigned ints separated by a delimiter, like
+ *  "12,7,300".
+ *  Each field is parsed by zlx_u64_from_str() and must be a non-empty
+ *  number ending at a separator or at the end of the input.
+ *  @param [in]     str     pointer to data
+ *  @param [in]     len     length of input string
+ *  @param [in]     radix   numeration base; 0 autodetects for each field
+ *  @param [in]     sep     separator char
+ *  @param [out]    values  filled with the parsed values
+ *  @param [in]     max_count   number of items in @a values
+ *  @param [out]    count   filled with the number of values stored
+ *  @param [out]    used_len filled with the offset where parsing stopped:
+ *                          the end, the bad char, or the start of the next
+ *                          field if @a values is full; can be NULL
+ *  @retval 0 all fields parsed
+ *  @retval ZLX_U64_STOP empty field, bad char or @a values full
+ *  @retval ZLX_U64_OVERFLOW
+ */
+ZLX_API uint_fast8_t ZLX_CALL zlx_u64_list_from_str
+(
+    uint8_t const * str,
+    size_t len,
+    uint_fast8_t radix,
+    uint8_t sep,
+    uint64_t * values,
+    size_t max_count,
+    size_t * count,
+    size_t * used_len
+);
+
 #define ZLX_FMT_MALFORMED 1 /**< bad format string error code */
 #define ZLX_FMT_WIDTH_ERROR 2 /**< width function returned error */
 #define ZLX_FMT_WRITE_ERROR 3 /**< write error */
 #define ZLX_FMT_CONV_ERROR 4 /**< conversion error during escaping of some string */
 #define ZLX_FMT_NO_CODE 5 /**< feature not implemented */
+#define ZLX_FMT_NO_SPACE 6 /**< compiled format does not fit */
+
+#define ZLX_FMT_UNBUFFERED 1
+/**< flag for zlx_vfmt_flags(): pass each piece of the output to the writer
+  as soon as it is produced */
 
 /* zlx_vfmt *****************************************************************/
 /**
  *  Writes formatted UTF-8 text (similar to printf formatting).
+ *  The output is gathered in a 1 KiB buffer on the stack and passed to the
+ *  writer when the buffer fills up and at the end, so short outputs take
+ *  a single writer call; pieces larger than the buffer go straight to the
+ *  writer. After a write error, the output of the failed call is partial.
  *  @retval 0 success
  *  @retval ZLX_FMT_MALFORMED bad format string
  *  @retval ZLX_FMT_WIDTH_ERROR
@@ -190,6 +232,25 @@ ZLX_API unsigned int ZLX_CALL zlx_vfmt
     va_list va
 );
 
+/* zlx_vfmt_flags ***********************************************************/
+/**
+ *  Writes formatted UTF-8 text.
+ *  See zlx_vfmt().
+ *  @param flags
+ *      0 or #ZLX_FMT_UNBUFFERED to call the writer for each literal segment,
+ *      padding chunk and argument, without staging
+ */
+ZLX_API unsigned int ZLX_CALL zlx_vfmt_flags
+(
+    zlx_write_func_t writer,
+    void * writer_context,
+    zlx_write_func_t width_func,
+    void * width_context,
+    unsigned int flags,
+    char const * fmt,
+    va_list va
+);
+
 /* zlx_fmt ******************************************************************/
 /**
  *  Writes formatted UTF-8 text.
@@ -205,6 +266,156 @@ ZLX_API unsigned int ZLX_CALL zlx_fmt
     ...
 );
 
+/*  zlx_fmt_op_t  */
+/**
+ *  Compiled format operation: a literal span or a conversion with all its
+ *  options resolved. Produced by zlx_fmt_compile(); the fields are meant
+ *  for zlx_fmt_exec() only.
+ */
+typedef struct zlx_fmt_op_s zlx_fmt_op_t;
+struct zlx_fmt_op_s
+{
+    /** literal text or number prefix */
+    uint8_t const * data;
+
+    /** literal length or string precision (SIZE_MAX for none) */
+    size_t len;
+
+    /** requested width */
+    uint32_t width;
+
+    /** conversion type character; 0 for a literal */
+    uint8_t type;
+
+    /** alignment */
+    uint8_t align;
+
+    /** sign mode for integers */
+    uint8_t sign_mode;
+
+    /** radix for integers */
+    uint8_t radix;
+
+    /** string escaping */
+    uint8_t esc;
+
+    /** non-zero to pad integers with zeroes */
+    uint8_t zero_fill;
+
+    /** digit group length */
+    uint8_t group_len;
+
+    /** digit group separator */
+    uint8_t sep;
+
+    /** number of precision arguments consumed before the value */
+    uint8_t prec_args;
+
+    /** non-zero if the precision is the last precision argument */
+    uint8_t prec_arg;
+};
+
+/* zlx_fmt_compile **********************************************************/
+/**
+ *  Compiles a format string into a sequence of operations.
+ *  The operations point into @a fmt, which must outlive them.
+ *  @param ops [out]
+ *      array receiving the operations
+ *  @param max_ops [in]
+ *      size of @a ops
+ *  @param fmt [in]
+ *      format string; see zlx_vfmt()
+ *  @param count [out]
+ *      number of operations needed
+ *  @retval 0 success
+ *  @retval ZLX_FMT_MALFORMED bad format string
+ *  @retval ZLX_FMT_NO_SPACE more than @a max_ops operations are needed
+ */
+ZLX_API unsigned int ZLX_CALL zlx_fmt_compile
+(
+    zlx_fmt_op_t * ops,
+    size_t max_ops,
+    char const * fmt,
+    size_t * count
+);
+
+/* zlx_fmt_exec *************************************************************/
+/**
+ *  Writes formatted text from a compiled format.
+ *  The output is the same as the one of zlx_vfmt_flags() with the format
+ *  string given to zlx_fmt_compile().
+ */
+ZLX_API unsigned int ZLX_CALL zlx_fmt_exec
+(
+    zlx_fmt_op_t const * ops,
+    size_t count,
+    zlx_write_func_t writer,
+    void * writer_context,
+    zlx_write_func_t width_func,
+    void * width_context,
+    unsigned int flags,
+    va_list va
+);
+
+/** Maximum number of operations in a #zlx_fmt_cache_t */
+#define ZLX_FMT_CACHE_OPS 24
+
+#define ZLX_FMT_CACHE_NEW 0 /**< format not compiled yet */
+#define ZLX_FMT_CACHE_BUSY 1 /**< format being compiled */
+#define ZLX_FMT_CACHE_READY 2 /**< compiled format available */
+#define ZLX_FMT_CACHE_FAILED 3 /**< format too long or malformed */
+
+/*  zlx_fmt_cache_t  */
+/**
+ *  Compiled format for one call site; static, zero-initialized storage
+ *  starts it in the #ZLX_FMT_CACHE_NEW state. See ZLX_FMT_CACHED().
+ */
+typedef struct zlx_fmt_cache_s zlx_fmt_cache_t;
+struct zlx_fmt_cache_s
+{
+    /** operations */
+    zlx_fmt_op_t ops[ZLX_FMT_CACHE_OPS];
+
+    /** number of operations */
+    size_t count;
+
+    /** ZLX_FMT_CACHE_xxx */
+    uint32_t state;
+};
+
+/* zlx_fmt_cached ***********************************************************/
+/**
+ *  Writes formatted text, compiling the format on first use.
+ *  The first caller compiles @a fmt into @a cache; the format must be the
+ *  same on every call with a given cache. Calls that find the cache being
+ *  compiled, or holding a format that cannot be compiled, interpret the
+ *  format with zlx_vfmt().
+ */
+ZLX_API unsigned int ZLX_CALL zlx_fmt_cached
+(
+    zlx_fmt_cache_t * cache,
+    zlx_write_func_t writer,
+    void * writer_context,
+    zlx_write_func_t width_func,
+    void * width_context,
+    char const * fmt,
+    ...
+);
+
+/*  ZLX_FMT_CACHED  */
+/**
+ *  Writes formatted text with a format compiled once for the call site.
+ *  @param _rc
+ *      variable receiving the status; see zlx_vfmt()
+ *  The remaining arguments are those of zlx_fmt(); the format string should
+ *  be a literal.
+ */
+#define ZLX_FMT_CACHED(_rc, ...) \
+    do { \
+        static zlx_fmt_cache_t zlx_fmt_cache_; \
+        (_rc) = zlx_fmt_cached(&zlx_fmt_cache_, __VA_ARGS__); \
+    } while (0)
+
 /** @} */
 
 #endif
@@ -0,0 +1,245 @@
+#ifndef _ZLX_FUTURE_H
+#define _ZLX_FUTURE_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "thread.h"
+#include "fiber.h"
+#include "atomic.h"
+
+/** @defgroup future Futures
+ *  One-shot results of asynchronous operations.
+ *
+ *  A future is completed once, with a value or an error, by whoever runs
+ *  the operation; consumers can poll it, block on it, park a fiber on it or
+ *  attach continuations. Futures and continuations are plain structures
+ *  owned by the caller (usually embedded in the request structure), so
+ *  nothing is allocated. The state is a lock-free stack of continuations
+ *  that completion swaps for a marker: checking a completed future is a
+ *  single load and attaching a continuation is a single compare-and-swap.
+ *  @{ */
+
+/*  zlx_future_t  */
+/**
+ *  Future.
+ */
+typedef struct zlx_future_s zlx_future_t;
+
+/*  zlx_fcont_t  */
+/**
+ *  Continuation attached to a future.
+ */
+typedef struct zlx_fcont_s zlx_fcont_t;
+
+/*  zlx_executor_t  */
+/**
+ *  Something that runs continuations (a thread pool, a fiber scheduler...).
+ */
+typedef struct zlx_executor_s zlx_executor_t;
+
+/*  zlx_fiber_executor_t  */
+/**
+ *  Executor running each continuation in a new fiber.
+ */
+typedef struct zlx_fiber_executor_s zlx_fiber_executor_t;
+
+/*  zlx_fcont_func_t  */
+/**
+ *  Continuation function; called once the future is complete.
+ */
+typedef void (ZLX_CALL * zlx_fcont_func_t)
+    (
+        zlx_future_t * future,
+        zlx_fcont_t * cont
+    );
+
+/** Value of zlx_future_t#conts once the future is complete */
+#define ZLX_FUTURE_DONE ((zlx_fcont_t *) 1)
+
+struct zlx_future_s
+{
+    /** stack of continuations or #ZLX_FUTURE_DONE */
+    zlx_fcont_t * conts;
+
+    /** value; valid after completion */
+    void * value;
+
+    /** error code; 0 for success, valid after completion */
+    int error;
+
+    /** set by the first completion call */
+    uint32_t claimed;
+};
+
+struct zlx_fcont_s
+{
+    /** next continuation in the stack */
+    zlx_fcont_t * next;
+
+    /** future this is attached to; set by zlx_future_then() */
+    zlx_future_t * future;
+
+    /** function */
+    zlx_fcont_func_t func;
+
+    /** user context */
+    void * ctx;
+
+    /** executor or NULL to run inline */
+    zlx_executor_t * exec;
+};
+
+struct zlx_executor_s
+{
+    /** Runs the continuation, calling zlx_fcont_t#func. */
+    void (ZLX_CALL * run) (zlx_executor_t * exec, zlx_fcont_t * cont);
+};
+
+struct zlx_fiber_executor_s
+{
+    /** executor interface */
+    zlx_executor_t exec;
+
+    /** scheduler where the fibers are spawned */
+    zlx_fsched_t * sched;
+};
+
+/* zlx_future_init **********************************************************/
+/**
+ *  Initializes (or resets) a future to the pending state.
+ */
+ZLX_INLINE void zlx_future_init
+(
+    zlx_future_t * future
+)
+{
+    future->conts = NULL;
+    future->value = NULL;
+    future->error = 0;
+    future->claimed = 0;
+}
+
+/* zlx_future_is_ready ******************************************************/
+/**
+ *  Tells, without blocking, whether the future is complete.
+ *  When this returns non-zero the value and error can be read.
+ */
+ZLX_INLINE int zlx_future_is_ready
+(
+    zlx_future_t * future
+)
+{
+    return zlx_atomic_load_ptr((void * *) &future->conts) == ZLX_FUTURE_DONE;
+}
+
+/* zlx_fcont_init ***********************************************************/
+/**
+ *  Initializes a continuation.
+ *  @param cont [out]
+ *      continuation
+ *  @param func [in]
+ *      function to call
+ *  @param ctx [in]
+ *      user context
+ *  @param exec [in, opt]
+ *      executor; NULL to run the function inline, either in the thread
+ *      completing the future or in zlx_future_then() if the future is
+ *      already complete
+ */
+ZLX_INLINE void zlx_fcont_init
+(
+    zlx_fcont_t * cont,
+    zlx_fcont_func_t func,
+    void * ctx,
+    zlx_executor_t * exec
+)
+{
+    cont->next = NULL;
+    cont->future = NULL;
+    cont->func = func;
+    cont->ctx = ctx;
+    cont->exec = exec;
+}
+
+/* zlx_future_set_value *****************************************************/
+/**
+ *  Completes the future successfully and runs its continuations.
+ *  @retval 0 completed
+ *  @retval 1 the future was already completed (nothing changed)
+ */
+ZLX_API int ZLX_CALL zlx_future_set_value
+(
+    zlx_future_t * future,
+    void * value
+);
+
+/* zlx_future_set_error *****************************************************/
+/**
+ *  Completes the future with a non-zero error and runs its continuations.
+ *  @retval 0 completed
+ *  @retval 1 the future was already completed (nothing changed)
+ */
+ZLX_API int ZLX_CALL zlx_future_set_error
+(
+    zlx_future_t * future,
+    int error
+);
+
+/* zlx_future_then **********************************************************/
+/**
+ *  Attaches a continuation; if the future is already complete the
+ *  continuation runs right away. Continuations attached before completion
+ *  run in the order they were attached.
+ */
+ZLX_API void ZLX_CALL zlx_future_then
+(
+    zlx_future_t * future,
+    zlx_fcont_t * cont
+);
+
+/* zlx_future_wait **********************************************************/
+/**
+ *  Blocks the calling thread until the future is complete.
+ *  Nothing is allocated when the future is already complete or when
+ *  waiting with futexes.
+ *  @param future [in, out]
+ *      future
+ *  @param ma [in]
+ *      allocator used by the mutex and condition variable (if any)
+ *  @param mth [in, opt]
+ *      interface to block with; NULL for futexes (see @ref sync)
+ *  @returns the error of the future, or -1 if blocking is not possible
+ *      with the given interface
+ */
+ZLX_API int ZLX_CALL zlx_future_wait
+(
+    zlx_future_t * future,
+    zlx_ma_t * ma,
+    zlx_mth_xfc_t * mth
+);
+
+/* zlx_future_fiber_wait ****************************************************/
+/**
+ *  Parks the running fiber until the future is complete.
+ *  @returns the error of the future
+ */
+ZLX_API int ZLX_CALL zlx_future_fiber_wait
+(
+    zlx_future_t * future,
+    zlx_fiber_t * self
+);
+
+/* zlx_fiber_executor_init **************************************************/
+/**
+ *  Initializes an executor that spawns a fiber for each continuation.
+ *  If spawning fails the continuation runs inline.
+ */
+ZLX_API void ZLX_CALL zlx_fiber_executor_init
+(
+    zlx_fiber_executor_t * fe,
+    zlx_fsched_t * sched
+);
+
+/** @} */
+
+#endif /* _ZLX_FUTURE_H */
@@ -0,0 +1,134 @@
+#ifndef _ZLX_LOCKPROF_H
+#define _ZLX_LOCKPROF_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "thread.h"
+#include "writer.h"
+
+/** @defgroup lockprof Lock profiler
+ *  Mutex interface that wraps another one and records contention.
+ *
+ *  Statistics are kept per description string (the info given to
+ *  zlx_mutex_create()), so all mutexes created at the same place add up
+ *  together. A lock is counted as contended when the mutex was already held
+ *  as the caller started waiting (this is sampled without synchronization,
+ *  so it is approximate under heavy contention). Wait and hold times use
+ *  zlx_clock_mono_ns().
+ *
+ *  Mutex interface functions do not get a pointer to their interface, so
+ *  only one profiler can be active at a time.
+ *  @{ */
+
+/*  zlx_lockprof_t  */
+/**
+ *  Lock profiler.
+ */
+typedef struct zlx_lockprof_s zlx_lockprof_t;
+
+/*  zlx_lockstat_t  */
+/**
+ *  Statistics for the mutexes sharing one description.
+ */
+typedef struct zlx_lockstat_s zlx_lockstat_t;
+
+struct zlx_lockstat_s
+{
+    /** next record */
+    zlx_lockstat_t * next;
+
+    /** description of the mutexes */
+    char const * info;
+
+    /** number of lock operations */
+    uint64_t acquisitions;
+
+    /** number of lock operations that found the mutex held */
+    uint64_t contended;
+
+    /** total time spent waiting to acquire, in nanoseconds */
+    uint64_t wait_ns;
+
+    /** longest wait */
+    uint64_t max_wait_ns;
+
+    /** total time the mutexes were held, in nanoseconds */
+    uint64_t hold_ns;
+
+    /** longest hold */
+    uint64_t max_hold_ns;
+};
+
+struct zlx_lockprof_s
+{
+    /** the profiling interface; pass this where a mutex interface is needed */
+    zlx_mutex_xfc_t xfc;
+
+    /** wrapped interface */
+    zlx_mutex_xfc_t * inner;
+
+    /** allocator for statistics records */
+    zlx_ma_t * ma;
+
+    /** mutex (from #inner) protecting the list of records */
+    zlx_mutex_t * mutex;
+
+    /** records, most recently created first */
+    zlx_lockstat_t * stats;
+
+    /** record for mutexes created without a description */
+    zlx_lockstat_t unnamed;
+};
+
+/* zlx_lockprof_init ********************************************************/
+/**
+ *  Initializes the profiler and makes it the active one.
+ *  @param lp [out]
+ *      profiler; after this returns, use @a lp->xfc as mutex interface
+ *  @param ma [in]
+ *      allocator for the statistics records
+ *  @param inner [in]
+ *      mutex interface doing the real work
+ *  @retval ZLX_MTH_OK
+ *  @retval ZLX_MTH_NO_MEM
+ *  @retval ZLX_MTH_NO_RES another profiler is active
+ */
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_lockprof_init
+(
+    zlx_lockprof_t * restrict lp,
+    zlx_ma_t * restrict ma,
+    zlx_mutex_xfc_t * restrict inner
+);
+
+/* zlx_lockprof_finish ******************************************************/
+/**
+ *  Frees the statistics; all mutexes created with the profiling interface
+ *  must have been destroyed.
+ */
+ZLX_API void ZLX_CALL zlx_lockprof_finish
+(
+    zlx_lockprof_t * restrict lp
+);
+
+/* zlx_lockprof_dump ********************************************************/
+/**
+ *  Writes a report with one line per description, the most contended
+ *  first (ties are broken by total wait time).
+ *  @param lp [in]
+ *      profiler
+ *  @param writer [in]
+ *      write function
+ *  @param writer_context [in]
+ *      context for @a writer
+ *  @returns 0 on success or a ZLX_FMT_xxx error
+ */
+ZLX_API unsigned int ZLX_CALL zlx_lockprof_dump
+(
+    zlx_lockprof_t * restrict lp,
+    zlx_write_func_t writer,
+    void * writer_context
+);
+
+/** @} */
+
+#endif /* _ZLX_LOCKPROF_H */
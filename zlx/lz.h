@@ -0,0 +1,278 @@
+#ifndef _ZLX_LZ_H
+#define _ZLX_LZ_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "file.h"
+
+/** @defgroup lz LZ compression
+ *  Fast LZ77 compression without an entropy stage.
+ *
+ *  Blocks use the LZ4 block format: sequences of literals and matches
+ *  (offsets up to 64 KiB) found through a hash table with short chains.
+ *
+ *  Streams are made of frames, each holding one block of up to
+ *  #ZLX_LZ_BLOCK_SIZE bytes of data:
+ *      - 32-bit little endian payload size, with bit 31 set if the payload
+ *        is stored uncompressed;
+ *      - 32-bit little endian data size;
+ *      - 32-bit little endian xxHash32 (seed 0) of the data;
+ *      - payload.
+ *
+ *  A frame header with payload size 0 ends the stream.
+ *  Streams can be produced and decoded with the chunked convertors
+ *  zlx_clconv_lz_compress() and zlx_clconv_lz_decompress() or through a
+ *  file object, #zlx_lz_file_t.
+ *  @{ */
+
+/*  zlx_lz_match_t  */
+/**
+ *  Match finder tables used by zlx_lz_compress().
+ */
+typedef struct zlx_lz_match_s zlx_lz_match_t;
+
+/*  zlx_lz_enc_t  */
+/**
+ *  Stream compressor state. It is large (about 320 KiB).
+ */
+typedef struct zlx_lz_enc_s zlx_lz_enc_t;
+
+/*  zlx_lz_dec_t  */
+/**
+ *  Stream decompressor state. It is large (about 130 KiB).
+ */
+typedef struct zlx_lz_dec_s zlx_lz_dec_t;
+
+/*  zlx_lz_file_t  */
+/**
+ *  File object compressing the data written to another file or
+ *  decompressing the data read from it.
+ */
+typedef struct zlx_lz_file_s zlx_lz_file_t;
+
+/** Maximum amount of data in a frame */
+#define ZLX_LZ_BLOCK_SIZE 0x10000
+
+/** Size of a frame header */
+#define ZLX_LZ_FRAME_HDR 12
+
+/** Number of hash table entries in #zlx_lz_match_t (log 2) */
+#define ZLX_LZ_HASH_BITS 14
+
+/*  ZLX_LZ_BOUND  */
+/**
+ *  Maximum size of the compressed form of @a _n bytes.
+ */
+#define ZLX_LZ_BOUND(_n) ((_n) + (_n) / 255 + 16)
+
+struct zlx_lz_match_s
+{
+    /** most recent position + 1 for each hash of 4 bytes; 0 for none */
+    uint32_t head[1 << ZLX_LZ_HASH_BITS];
+
+    /** distance to the previous position with the same hash, for each
+     *  position modulo 64 KiB */
+    uint16_t chain[0x10000];
+};
+
+struct zlx_lz_enc_s
+{
+    /** match finder */
+    zlx_lz_match_t match;
+
+    /** data collected for the next frame */
+    uint8_t block[ZLX_LZ_BLOCK_SIZE];
+
+    /** frame being output */
+    uint8_t frame[ZLX_LZ_FRAME_HDR + ZLX_LZ_BOUND(ZLX_LZ_BLOCK_SIZE)];
+
+    /** amount of data in #block */
+    size_t block_len;
+
+    /** amount of #frame already output */
+    size_t frame_pos;
+
+    /** size of #frame */
+    size_t frame_len;
+
+    /** non-zero once the end marker was produced */
+    uint8_t ended;
+};
+
+struct zlx_lz_dec_s
+{
+    /** frame being received */
+    uint8_t frame[ZLX_LZ_FRAME_HDR + ZLX_LZ_BOUND(ZLX_LZ_BLOCK_SIZE)];
+
+    /** decoded data */
+    uint8_t block[ZLX_LZ_BLOCK_SIZE];
+
+    /** amount of #frame received */
+    size_t frame_len;
+
+    /** amount of #block already output */
+    size_t block_pos;
+
+    /** amount of data in #block */
+    size_t block_len;
+
+    /** non-zero once the end marker was received */
+    uint8_t ended;
+};
+
+struct zlx_lz_file_s
+{
+    /** base file object */
+    zlx_file_t base;
+
+    /** compressed file */
+    zlx_file_t * inner;
+
+    /** allocator for the state */
+    zlx_ma_t * ma;
+
+    /** compressor state (write mode) */
+    zlx_lz_enc_t * enc;
+
+    /** decompressor state (read mode) */
+    zlx_lz_dec_t * dec;
+
+    /** position in the uncompressed data */
+    uint64_t pos;
+};
+
+/* zlx_lz_compress **********************************************************/
+/**
+ *  Compresses a block.
+ *  @param m [out]
+ *      match finder tables; their previous content does not matter
+ *  @param in [in]
+ *      data
+ *  @param in_len [in]
+ *      data size; under 2 GiB
+ *  @param out [out]
+ *      buffer for the compressed block
+ *  @param out_len [in]
+ *      buffer size; #ZLX_LZ_BOUND(@a in_len) is always enough
+ *  @returns the size of the compressed block or 0 if it does not fit
+ */
+ZLX_API size_t ZLX_CALL zlx_lz_compress
+(
+    zlx_lz_match_t * restrict m,
+    uint8_t const * restrict in,
+    size_t in_len,
+    uint8_t * restrict out,
+    size_t out_len
+);
+
+/* zlx_lz_decompress ********************************************************/
+/**
+ *  Decompresses a block.
+ *  @returns the size of the data, or -1 if the block is malformed or does
+ *      not fit in @a out_len bytes
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_lz_decompress
+(
+    uint8_t const * restrict in,
+    size_t in_len,
+    uint8_t * restrict out,
+    size_t out_len
+);
+
+/* zlx_lz_enc_init **********************************************************/
+/**
+ *  Initializes a stream compressor for zlx_clconv_lz_compress().
+ *  @returns @a enc
+ */
+ZLX_API void * ZLX_CALL zlx_lz_enc_init
+(
+    zlx_lz_enc_t * enc
+);
+
+/* zlx_clconv_lz_compress ***************************************************/
+/**
+ *  Chunked stream compressor. See #zlx_clconv_func_t.
+ *  @param ctx
+ *      a #zlx_lz_enc_t initialized with zlx_lz_enc_init()
+ */
+ZLX_API uint_fast8_t ZLX_CALL zlx_clconv_lz_compress
+(
+    uint8_t const * in,
+    size_t in_len,
+    size_t * in_used_len,
+    uint8_t * out,
+    size_t out_len,
+    size_t * out_used_len,
+    void * ctx
+);
+
+/* zlx_lz_dec_init **********************************************************/
+/**
+ *  Initializes a stream decompressor for zlx_clconv_lz_decompress().
+ *  @returns @a dec
+ */
+ZLX_API void * ZLX_CALL zlx_lz_dec_init
+(
+    zlx_lz_dec_t * dec
+);
+
+/* zlx_clconv_lz_decompress *************************************************/
+/**
+ *  Chunked stream decompressor. See #zlx_clconv_func_t.
+ *  Input after the end marker is not used.
+ *  @param ctx
+ *      a #zlx_lz_dec_t initialized with zlx_lz_dec_init()
+ *  @retval ZLX_CLCONV_MALFORMED
+ *      bad frame or checksum mismatch
+ *  @retval ZLX_CLCONV_INCOMPLETE
+ *      the input ended (@a in is NULL) before the end marker
+ */
+ZLX_API uint_fast8_t ZLX_CALL zlx_clconv_lz_decompress
+(
+    uint8_t const * in,
+    size_t in_len,
+    size_t * in_used_len,
+    uint8_t * out,
+    size_t out_len,
+    size_t * out_used_len,
+    void * ctx
+);
+
+/* zlx_lz_file_init *********************************************************/
+/**
+ *  Initializes a compressed file object.
+ *  In write mode, closing the write side writes the last frame and the end
+ *  marker. Besides reading or writing, the file only supports getting the
+ *  current position with zlx_seek64(f, 0, ZLXF_CUR).
+ *  @param lf [out]
+ *      file object
+ *  @param inner [in, out]
+ *      compressed file; it is closed when @a lf is closed
+ *  @param ma [in]
+ *      allocator for the state
+ *  @param mode [in]
+ *      #ZLXF_READ to decompress or #ZLXF_WRITE to compress
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_NO_MEM
+ *  @retval ZLXF_BAD_OPERATION bad mode
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_lz_file_init
+(
+    zlx_lz_file_t * restrict lf,
+    zlx_file_t * restrict inner,
+    zlx_ma_t * restrict ma,
+    uint32_t mode
+);
+
+/* zlx_lz_file_finish *******************************************************/
+/**
+ *  Frees the state; data not flushed by closing is lost.
+ */
+ZLX_API void ZLX_CALL zlx_lz_file_finish
+(
+    zlx_lz_file_t * restrict lf
+);
+
+/** @} */
+
+#endif /* _ZLX_LZ_H */
@@ -0,0 +1,155 @@
+#ifndef _ZLX_MEMFILE_H
+#define _ZLX_MEMFILE_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "file.h"
+
+/** @defgroup memfile Memory files
+ *  Growable file objects keeping their data in memory.
+ *
+ *  The data is stored in a list of blocks allocated from a #zlx_ma_t, each
+ *  block twice the size of the previous one (up to
+ *  #ZLX_MEM_FILE_MAX_CHUNK), so growing never copies the existing data.
+ *  Unlike #zlx_sbw_t there is no size limit other than the memory available.
+ *
+ *  The contents can be accessed without copying, block by block, with
+ *  zlx_mem_file_chunk(), or in one piece after zlx_mem_file_flatten().
+ *  @{ */
+
+/*  zlx_mem_file_t  */
+/**
+ *  Memory file.
+ */
+typedef struct zlx_mem_file_s zlx_mem_file_t;
+
+/*  zlx_mem_chunk_t  */
+/**
+ *  Block of memory file data; the data follows the header.
+ */
+typedef struct zlx_mem_chunk_s zlx_mem_chunk_t;
+
+/** Default size of the first block */
+#define ZLX_MEM_FILE_MIN_CHUNK 0x1000
+
+/** Blocks stop doubling at this size; larger ones are allocated only for
+ *  writes that need them */
+#define ZLX_MEM_FILE_MAX_CHUNK 0x100000
+
+struct zlx_mem_chunk_s
+{
+    /** next block */
+    zlx_mem_chunk_t * next;
+
+    /** file offset of the first byte in the block */
+    uint64_t offset;
+
+    /** block capacity */
+    size_t size;
+};
+
+struct zlx_mem_file_s
+{
+    /** base file object */
+    zlx_file_t base;
+
+    /** allocator for the blocks */
+    zlx_ma_t * ma;
+
+    /** first block */
+    zlx_mem_chunk_t * head;
+
+    /** last block */
+    zlx_mem_chunk_t * tail;
+
+    /** block last accessed; lookups start here when moving forward */
+    zlx_mem_chunk_t * cur;
+
+    /** file size */
+    uint64_t size;
+
+    /** total capacity of the blocks */
+    uint64_t capacity;
+
+    /** file position */
+    uint64_t pos;
+
+    /** capacity of the next block to allocate */
+    size_t chunk_size;
+};
+
+/* zlx_mem_file_init ********************************************************/
+/**
+ *  Initializes an empty memory file, open for reading and writing.
+ *  @param mf [out]
+ *      file object to initialize
+ *  @param ma [in]
+ *      allocator
+ *  @param chunk_size [in]
+ *      capacity of the first block or 0 for #ZLX_MEM_FILE_MIN_CHUNK
+ */
+ZLX_API void ZLX_CALL zlx_mem_file_init
+(
+    zlx_mem_file_t * restrict mf,
+    zlx_ma_t * restrict ma,
+    size_t chunk_size
+);
+
+/* zlx_mem_file_finish ******************************************************/
+/**
+ *  Frees the data. Closing the file does not.
+ */
+ZLX_API void ZLX_CALL zlx_mem_file_finish
+(
+    zlx_mem_file_t * restrict mf
+);
+
+/* zlx_mem_file_chunk *******************************************************/
+/**
+ *  Iterates over the file data, block by block.
+ *  @param mf [in]
+ *      file
+ *  @param it [in, out]
+ *      iterator; initialize it to NULL before the first call
+ *  @param len [out]
+ *      amount of data at the returned pointer
+ *  @returns pointer to the data or NULL after the last block
+ */
+ZLX_INLINE uint8_t * zlx_mem_file_chunk
+(
+    zlx_mem_file_t * restrict mf,
+    zlx_mem_chunk_t * * restrict it,
+    size_t * restrict len
+)
+{
+    zlx_mem_chunk_t * c = *it ? (*it)->next : mf->head;
+
+    if (!c || c->offset >= mf->size) { *len = 0; return NULL; }
+    *it = c;
+    *len = mf->size - c->offset < c->size
+        ? (size_t) (mf->size - c->offset) : c->size;
+    return (uint8_t *) (c + 1);
+}
+
+/* zlx_mem_file_flatten *****************************************************/
+/**
+ *  Gives access to the whole file data as one buffer, merging the blocks
+ *  if there are several. Later writes past the end of the buffer add new
+ *  blocks and do not move it.
+ *  @param mf [in, out]
+ *      file
+ *  @param data [out]
+ *      receives the data pointer (NULL for an empty file)
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_NO_MEM
+ *  @retval ZLXF_OVERFLOW the data does not fit in the address space
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mem_file_flatten
+(
+    zlx_mem_file_t * restrict mf,
+    uint8_t * * restrict data
+);
+
+/** @} */
+
+#endif /* _ZLX_MEMFILE_H */
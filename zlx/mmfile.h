@@ -0,0 +1,185 @@
+#ifndef _ZLX_MMFILE_H
+#define _ZLX_MMFILE_H
+
+#include "base.h"
+#include "file.h"
+#include "fdfile.h"
+
+/** @defgroup mmfile Memory-mapped files
+ *  File objects accessing a file through a memory mapping.
+ *
+ *  The whole file is mapped. Besides the usual file operations (which copy
+ *  between the mapping and the caller's buffer, without system calls) the
+ *  data can be accessed in place with zlx_mm_file_view().
+ *
+ *  Writable files grow on demand: the file is extended with ftruncate()
+ *  geometrically and remapped, then trimmed to its logical size on close.
+ *  Growing may move the mapping, so pointers returned by zlx_mm_file_view()
+ *  are valid only until the next write past the end of the file. Growth is
+ *  not synchronized with concurrent positional I/O on the same object.
+ *  Available only when built for Linux.
+ *  @{ */
+
+/*  zlx_mm_file_t  */
+/**
+ *  Memory-mapped file.
+ */
+typedef struct zlx_mm_file_s zlx_mm_file_t;
+
+/*  ZLX_MMF_POPULATE  */
+/**
+ *  Open flag: pre-fault the whole mapping when opening (MAP_POPULATE) so
+ *  later accesses do not take page faults.
+ */
+#define ZLX_MMF_POPULATE (1 << 13)
+
+/** Advice for zlx_mm_file_advise(): pages will be accessed sequentially */
+#define ZLX_MMF_SEQUENTIAL 1
+
+/** Advice for zlx_mm_file_advise(): pages will be accessed randomly */
+#define ZLX_MMF_RANDOM 2
+
+/** Advice for zlx_mm_file_advise(): pages will be needed soon (read them
+ *  ahead) */
+#define ZLX_MMF_WILLNEED 3
+
+/** Advice for zlx_mm_file_advise(): pages will not be needed soon */
+#define ZLX_MMF_DONTNEED 4
+
+/** Advice for zlx_mm_file_advise(): back the range with huge pages if the
+ *  file system supports it */
+#define ZLX_MMF_HUGEPAGE 5
+
+struct zlx_mm_file_s
+{
+    /** base file object */
+    zlx_file_t base;
+
+    /** mapping; NULL while the file is empty */
+    uint8_t * map;
+
+    /** size of the mapping */
+    uint64_t map_size;
+
+    /** size of the file on disk; it is larger than #size after growing */
+    uint64_t disk_size;
+
+    /** logical size of the file */
+    uint64_t size;
+
+    /** file position */
+    uint64_t pos;
+
+    /** file descriptor */
+    int fd;
+
+    /** non-zero if the descriptor is closed together with the file */
+    uint32_t own;
+};
+
+/* zlx_mm_file_open *********************************************************/
+/**
+ *  Opens and maps a file.
+ *  @param mf [out]
+ *      file object to initialize
+ *  @param path [in]
+ *      file path
+ *  @param flags [in]
+ *      #ZLXF_READ, optionally #ZLXF_WRITE, the open flags #ZLX_FDF_CREATE,
+ *      #ZLX_FDF_EXCL, #ZLX_FDF_TRUNCATE and #ZLX_MMF_POPULATE
+ *  @returns the status of the operation; #ZLXF_NO_CODE when not supported
+ *      on this platform
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mm_file_open
+(
+    zlx_mm_file_t * restrict mf,
+    char const * restrict path,
+    uint32_t flags
+);
+
+/* zlx_mm_file_map **********************************************************/
+/**
+ *  Maps a file given by an open descriptor.
+ *  @param mf [out]
+ *      file object to initialize
+ *  @param fd [in]
+ *      descriptor of a regular file, open for reading (and writing if
+ *      #ZLXF_WRITE is given)
+ *  @param flags [in]
+ *      #ZLXF_READ, optionally #ZLXF_WRITE, #ZLX_FDF_OWN and
+ *      #ZLX_MMF_POPULATE
+ *  @returns the status of the operation; #ZLXF_NO_CODE when not supported
+ *      on this platform
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mm_file_map
+(
+    zlx_mm_file_t * restrict mf,
+    int fd,
+    uint32_t flags
+);
+
+/* zlx_mm_file_view *********************************************************/
+/**
+ *  Gives direct access to the file data.
+ *  @param mf [in]
+ *      file
+ *  @param offset [in]
+ *      offset in the file
+ *  @param len [in, out]
+ *      on input the length wanted; on output the length available at the
+ *      returned pointer, which is less only near the end of the file
+ *  @returns pointer into the mapping or NULL if @a offset is at or past the
+ *      end of the file
+ */
+ZLX_INLINE uint8_t * zlx_mm_file_view
+(
+    zlx_mm_file_t * restrict mf,
+    uint64_t offset,
+    size_t * restrict len
+)
+{
+    if (offset >= mf->size) { *len = 0; return NULL; }
+    if (*len > mf->size - offset) *len = (size_t) (mf->size - offset);
+    return mf->map + offset;
+}
+
+/* zlx_mm_file_advise *******************************************************/
+/**
+ *  Tells the OS how a range of the file will be accessed.
+ *  @param mf [in]
+ *      file
+ *  @param offset [in]
+ *      start of the range; rounded down to a page boundary
+ *  @param len [in]
+ *      length of the range; 0 for up to the end of the mapping
+ *  @param advice [in]
+ *      one of ZLX_MMF_SEQUENTIAL, ZLX_MMF_RANDOM, ZLX_MMF_WILLNEED,
+ *      ZLX_MMF_DONTNEED, ZLX_MMF_HUGEPAGE
+ *  @returns the status of the operation
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mm_file_advise
+(
+    zlx_mm_file_t * restrict mf,
+    uint64_t offset,
+    uint64_t len,
+    int advice
+);
+
+/* zlx_mm_file_flush ********************************************************/
+/**
+ *  Writes modified pages to the file (msync).
+ *  @param mf [in]
+ *      file
+ *  @param wait [in]
+ *      non-zero to wait for the write to complete, zero to just schedule it
+ *  @returns the status of the operation
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_mm_file_flush
+(
+    zlx_mm_file_t * restrict mf,
+    int wait
+);
+
+/** @} */
+
+#endif /* _ZLX_MMFILE_H */
@@ -0,0 +1,121 @@
+#ifndef _ZLX_PERCPU_H
+#define _ZLX_PERCPU_H
+
+#include "base.h"
+#include "memalloc.h"
+
+/** @defgroup percpu Per-CPU data
+ *  Sharded data indexed by the CPU running the caller.
+ *
+ *  The current CPU is read from the restartable sequences area registered
+ *  by the C library (a plain load) with sched_getcpu() as fallback; this is
+ *  available only when building for Linux, elsewhere all callers map to
+ *  CPU 0.
+ *  A thread can migrate right after reading its CPU so a slot is not owned
+ *  by a thread: the point is that concurrent users of the same slot are
+ *  rare and the slot cache line stays local, so updates can use uncontended
+ *  atomic operations (or no atomics at all for statistics that tolerate
+ *  the odd lost update).
+ *  @{ */
+
+/** Assumed size of a cache line; slots are padded to multiples of this */
+#define ZLX_CACHE_LINE_SIZE 64
+
+/*  zlx_percpu_t  */
+/**
+ *  Array of per-CPU slots.
+ */
+typedef struct zlx_percpu_s zlx_percpu_t;
+
+struct zlx_percpu_s
+{
+    /** first slot (aligned to #ZLX_CACHE_LINE_SIZE) */
+    uint8_t * base;
+
+    /** distance between slots */
+    size_t stride;
+
+    /** number of slots */
+    size_t count;
+
+    /** allocator */
+    zlx_ma_t * ma;
+
+    /** allocated block */
+    void * block;
+
+    /** size of #block */
+    size_t block_size;
+};
+
+/* zlx_cpu_count ************************************************************/
+/**
+ *  Returns the number of CPUs configured in the system (at least 1).
+ */
+ZLX_API unsigned int ZLX_CALL zlx_cpu_count ();
+
+/* zlx_cpu_current **********************************************************/
+/**
+ *  Returns the index of the CPU running the caller.
+ */
+ZLX_API unsigned int ZLX_CALL zlx_cpu_current ();
+
+/* zlx_percpu_init **********************************************************/
+/**
+ *  Allocates zeroed slots for all CPUs.
+ *  @param pc [out]
+ *      per-CPU array to initialize
+ *  @param ma [in]
+ *      allocator
+ *  @param size [in]
+ *      size of the data in each slot; it is rounded up to a multiple of
+ *      #ZLX_CACHE_LINE_SIZE so slots do not share cache lines
+ *  @retval 0 success
+ *  @retval 1 no memory
+ */
+ZLX_API int ZLX_CALL zlx_percpu_init
+(
+    zlx_percpu_t * restrict pc,
+    zlx_ma_t * restrict ma,
+    size_t size
+);
+
+/* zlx_percpu_finish ********************************************************/
+/**
+ *  Frees the slots.
+ */
+ZLX_API void ZLX_CALL zlx_percpu_finish
+(
+    zlx_percpu_t * restrict pc
+);
+
+/* zlx_percpu_slot **********************************************************/
+/**
+ *  Returns the slot for the given CPU.
+ */
+ZLX_INLINE void * zlx_percpu_slot
+(
+    zlx_percpu_t const * pc,
+    unsigned int cpu
+)
+{
+    /* CPUs hot-plugged after init share slots */
+    if (cpu >= pc->count) cpu %= pc->count;
+    return pc->base + cpu * pc->stride;
+}
+
+/* zlx_percpu_local *********************************************************/
+/**
+ *  Returns the slot for the CPU running the caller.
+ */
+ZLX_INLINE void * zlx_percpu_local
+(
+    zlx_percpu_t const * pc
+)
+{
+    return zlx_percpu_slot(pc, zlx_cpu_current());
+}
+
+/** @} */
+
+#endif /* _ZLX_PERCPU_H */
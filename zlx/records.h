@@ -0,0 +1,181 @@
+#ifndef _ZLX_RECORDS_H
+#define _ZLX_RECORDS_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "file.h"
+
+/** @defgroup records Record reader
+ *  Splits input into records separated by a delimiter byte (like lines).
+ *
+ *  The input is a file object, read into a buffer owned by the reader, or
+ *  a memory block (for instance a view of a memory-mapped file, see
+ *  zlx_mm_file_view(), or a flattened memory file). Records are returned as
+ *  slices of the buffer or block, without the delimiter and without
+ *  copying; they stay valid until the next call on the reader. A record
+ *  straddling the end of the buffered data is moved to the start of the
+ *  buffer and completed with the next read; the buffer grows as needed for
+ *  long records, up to a limit.
+ *
+ *  Delimiters are searched 64 bytes at a time with SSE2 or, where the CPU
+ *  has it, AVX2 compares; other targets compare 8 bytes at a time within
+ *  a 64-bit word. zlx_rec_batch() returns many records per call.
+ *  @{ */
+
+/*  zlx_rec_t  */
+/**
+ *  Record slice.
+ */
+typedef struct zlx_rec_s zlx_rec_t;
+
+/*  zlx_rec_reader_t  */
+/**
+ *  Record reader.
+ */
+typedef struct zlx_rec_reader_s zlx_rec_reader_t;
+
+struct zlx_rec_s
+{
+    /** record data */
+    uint8_t const * data;
+
+    /** record size, not counting the delimiter */
+    size_t size;
+};
+
+struct zlx_rec_reader_s
+{
+    /** data: the buffer or the memory block */
+    uint8_t const * data;
+
+    /** offset of the first byte not returned yet */
+    size_t pos;
+
+    /** amount of data available */
+    size_t end;
+
+    /** offset of the window whose delimiters are in #mask */
+    size_t scan;
+
+    /** length of the window at #scan */
+    size_t mlen;
+
+    /** delimiters not returned yet from the window at #scan: bit i is set
+     *  if the byte at #scan + i is a delimiter */
+    uint64_t mask;
+
+    /** file read into the buffer; NULL for a memory block */
+    zlx_file_t * file;
+
+    /** allocator for the buffer */
+    zlx_ma_t * ma;
+
+    /** buffer */
+    uint8_t * buf;
+
+    /** buffer size */
+    size_t size;
+
+    /** maximum buffer size */
+    size_t max_size;
+
+    /** delimiter */
+    uint8_t delim;
+
+    /** non-zero once the end of the input was reached */
+    uint8_t eof;
+};
+
+/* zlx_rec_reader_init ******************************************************/
+/**
+ *  Initializes a reader over a file.
+ *  @param rr [out]
+ *      reader
+ *  @param file [in, out]
+ *      file to read; any class works, including buffered files
+ *  @param ma [in]
+ *      allocator for the buffer
+ *  @param size [in]
+ *      initial buffer size
+ *  @param max_size [in]
+ *      limit for the buffer size; longer records are reported as
+ *      #ZLXF_SIZE_LIMIT
+ *  @param delim [in]
+ *      delimiter byte
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_NO_MEM
+ *  @retval ZLXF_SIZE_LIMIT @a size is 0 or larger than @a max_size
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_rec_reader_init
+(
+    zlx_rec_reader_t * restrict rr,
+    zlx_file_t * restrict file,
+    zlx_ma_t * restrict ma,
+    size_t size,
+    size_t max_size,
+    uint8_t delim
+);
+
+/* zlx_rec_reader_init_mem **************************************************/
+/**
+ *  Initializes a reader over a memory block, which must stay valid and
+ *  unchanged while the reader is used.
+ */
+ZLX_API void ZLX_CALL zlx_rec_reader_init_mem
+(
+    zlx_rec_reader_t * restrict rr,
+    uint8_t const * data,
+    size_t size,
+    uint8_t delim
+);
+
+/* zlx_rec_reader_finish ****************************************************/
+/**
+ *  Frees the buffer.
+ */
+ZLX_API void ZLX_CALL zlx_rec_reader_finish
+(
+    zlx_rec_reader_t * restrict rr
+);
+
+/* zlx_rec_batch ************************************************************/
+/**
+ *  Gets the next records.
+ *  Reads from the file only if no complete record is buffered, so the
+ *  records returned by one call come from the same buffer contents.
+ *  The last record does not need a delimiter after it.
+ *  @param rr [in, out]
+ *      reader
+ *  @param recs [out]
+ *      array receiving the records
+ *  @param count [in]
+ *      size of @a recs
+ *  @returns the number of records (0 at the end of the input) or a negated
+ *      #zlx_file_status_t value; after an error the records read before
+ *      it are returned first
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_rec_batch
+(
+    zlx_rec_reader_t * restrict rr,
+    zlx_rec_t * restrict recs,
+    size_t count
+);
+
+/* zlx_rec_next *************************************************************/
+/**
+ *  Gets the next record.
+ *  @returns 1, 0 at the end of the input, or a negated #zlx_file_status_t
+ *      value
+ */
+ZLX_INLINE ptrdiff_t zlx_rec_next
+(
+    zlx_rec_reader_t * restrict rr,
+    zlx_rec_t * restrict rec
+)
+{
+    return zlx_rec_batch(rr, rec, 1);
+}
+
+/** @} */
+
+#endif /* _ZLX_RECORDS_H */
@@ -0,0 +1,264 @@
+#ifndef _ZLX_SYNC_H
+#define _ZLX_SYNC_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "thread.h"
+
+/** @defgroup sync Synchronization primitives
+ *  Counting semaphore, one-shot latch and reusable barrier.
+ *
+ *  Each primitive is initialized either with a multithreading interface,
+ *  in which case it blocks using the mutex and condition variable from
+ *  that interface, or with NULL to use futexes directly (Linux only; on
+ *  other targets initialization returns #ZLX_MTH_NO_SUP).
+ *  With futexes, operations that do not have to block or wake anybody are
+ *  a single atomic operation.
+ *  @{ */
+
+/*  zlx_sync_base_t  */
+/**
+ *  Blocking backend shared by the primitives.
+ */
+typedef struct zlx_sync_base_s zlx_sync_base_t;
+
+/*  zlx_sema_t  */
+/**
+ *  Counting semaphore.
+ */
+typedef struct zlx_sema_s zlx_sema_t;
+
+/*  zlx_latch_t  */
+/**
+ *  Countdown latch: threads wait until the count reaches zero, once.
+ */
+typedef struct zlx_latch_s zlx_latch_t;
+
+/*  zlx_barrier_t  */
+/**
+ *  Barrier for a fixed number of threads, reusable for successive phases.
+ */
+typedef struct zlx_barrier_s zlx_barrier_t;
+
+struct zlx_sync_base_s
+{
+    /** allocator for the mutex and condition variable */
+    zlx_ma_t * ma;
+
+    /** multithreading interface or NULL for futexes */
+    zlx_mth_xfc_t * mth;
+
+    /** mutex protecting the state (NULL with futexes or no-op mutexes) */
+    zlx_mutex_t * mutex;
+
+    /** condition where threads block (NULL with futexes) */
+    zlx_cond_t * cond;
+
+    /** number of threads waiting on #cond */
+    uint32_t sleepers;
+};
+
+struct zlx_sema_s
+{
+    /** backend */
+    zlx_sync_base_t base;
+
+    /** available units; this is the futex word */
+    uint32_t count;
+
+    /** threads blocked in zlx_sema_wait() (futex backend) */
+    uint32_t waiters;
+};
+
+struct zlx_latch_s
+{
+    /** backend */
+    zlx_sync_base_t base;
+
+    /** remaining count; this is the futex word */
+    uint32_t count;
+};
+
+struct zlx_barrier_s
+{
+    /** backend */
+    zlx_sync_base_t base;
+
+    /** number of threads taking part */
+    uint32_t parties;
+
+    /** threads arrived in the current phase */
+    uint32_t arrived;
+
+    /** phase number; this is the futex word */
+    uint32_t phase;
+};
+
+/* zlx_sema_init ************************************************************/
+/**
+ *  Initializes a semaphore.
+ *  @param sema [out]
+ *      semaphore
+ *  @param ma [in]
+ *      allocator for the mutex and condition variable
+ *  @param mth [in, opt]
+ *      multithreading interface; NULL to use futexes
+ *  @param count [in]
+ *      initial count
+ *  @retval ZLX_MTH_OK
+ *  @retval ZLX_MTH_NO_MEM
+ *  @retval ZLX_MTH_NO_SUP futexes or condition variables not available
+ */
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_sema_init
+(
+    zlx_sema_t * restrict sema,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * restrict mth,
+    uint32_t count
+);
+
+/* zlx_sema_finish **********************************************************/
+/**
+ *  Frees the resources of the semaphore. Nobody must be waiting on it.
+ */
+ZLX_API void ZLX_CALL zlx_sema_finish
+(
+    zlx_sema_t * restrict sema
+);
+
+/* zlx_sema_wait ************************************************************/
+/**
+ *  Takes one unit, blocking while none is available.
+ */
+ZLX_API void ZLX_CALL zlx_sema_wait
+(
+    zlx_sema_t * restrict sema
+);
+
+/* zlx_sema_try_wait ********************************************************/
+/**
+ *  Takes one unit if available.
+ *  @returns non-zero if a unit was taken
+ */
+ZLX_API int ZLX_CALL zlx_sema_try_wait
+(
+    zlx_sema_t * restrict sema
+);
+
+/* zlx_sema_post ************************************************************/
+/**
+ *  Releases @a n units, waking up to @a n waiters.
+ */
+ZLX_API void ZLX_CALL zlx_sema_post
+(
+    zlx_sema_t * restrict sema,
+    uint32_t n
+);
+
+/* zlx_latch_init ***********************************************************/
+/**
+ *  Initializes a latch.
+ *  @param latch [out]
+ *      latch
+ *  @param ma [in]
+ *      allocator for the mutex and condition variable
+ *  @param mth [in, opt]
+ *      multithreading interface; NULL to use futexes
+ *  @param count [in]
+ *      number of zlx_latch_count_down() units to wait for
+ *  @retval ZLX_MTH_OK
+ *  @retval ZLX_MTH_NO_MEM
+ *  @retval ZLX_MTH_NO_SUP futexes or condition variables not available
+ */
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_latch_init
+(
+    zlx_latch_t * restrict latch,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * restrict mth,
+    uint32_t count
+);
+
+/* zlx_latch_finish *********************************************************/
+/**
+ *  Frees the resources of the latch. Nobody must be waiting on it.
+ */
+ZLX_API void ZLX_CALL zlx_latch_finish
+(
+    zlx_latch_t * restrict latch
+);
+
+/* zlx_latch_count_down *****************************************************/
+/**
+ *  Decrements the count by @a n and releases the waiters when it reaches 0.
+ *  The total decrement must not exceed the initial count.
+ */
+ZLX_API void ZLX_CALL zlx_latch_count_down
+(
+    zlx_latch_t * restrict latch,
+    uint32_t n
+);
+
+/* zlx_latch_try_wait *******************************************************/
+/**
+ *  Tells whether the count reached 0.
+ */
+ZLX_API int ZLX_CALL zlx_latch_try_wait
+(
+    zlx_latch_t * restrict latch
+);
+
+/* zlx_latch_wait ***********************************************************/
+/**
+ *  Blocks until the count reaches 0.
+ */
+ZLX_API void ZLX_CALL zlx_latch_wait
+(
+    zlx_latch_t * restrict latch
+);
+
+/* zlx_barrier_init *********************************************************/
+/**
+ *  Initializes a barrier.
+ *  @param barrier [out]
+ *      barrier
+ *  @param ma [in]
+ *      allocator for the mutex and condition variable
+ *  @param mth [in, opt]
+ *      multithreading interface; NULL to use futexes
+ *  @param parties [in]
+ *      number of threads that call zlx_barrier_wait() in each phase
+ *  @retval ZLX_MTH_OK
+ *  @retval ZLX_MTH_NO_MEM
+ *  @retval ZLX_MTH_NO_SUP futexes or condition variables not available
+ */
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_barrier_init
+(
+    zlx_barrier_t * restrict barrier,
+    zlx_ma_t * restrict ma,
+    zlx_mth_xfc_t * restrict mth,
+    uint32_t parties
+);
+
+/* zlx_barrier_finish *******************************************************/
+/**
+ *  Frees the resources of the barrier. Nobody must be waiting on it.
+ */
+ZLX_API void ZLX_CALL zlx_barrier_finish
+(
+    zlx_barrier_t * restrict barrier
+);
+
+/* zlx_barrier_wait *********************************************************/
+/**
+ *  Blocks until all parties reached the barrier, then starts a new phase.
+ *  @returns 1 for exactly one of the parties (the last to arrive), which
+ *      can do the serial work between phases; 0 for the others
+ */
+ZLX_API int ZLX_CALL zlx_barrier_wait
+(
+    zlx_barrier_t * restrict barrier
+);
+
+/** @} */
+
+#endif /* _ZLX_SYNC_H */
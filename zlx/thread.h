@@ -52,6 +52,26 @@ typedef struct zlx_mutex_xfc_s zlx_mutex_xfc_t;
  */
 typedef struct zlx_cond_xfc_s zlx_cond_xfc_t;
 
+/*  zlx_tls_xfc_t  */
+/**
+ *  Interface for thread-local storage operations.
+ */
+typedef struct zlx_tls_xfc_s zlx_tls_xfc_t;
+
+/*  zlx_tls_key_t  */
+/**
+ *  Thread-local storage key.
+ */
+typedef uintptr_t zlx_tls_key_t;
+
+/*  zlx_tls_dtor_t  */
+/**
+ *  Destructor for thread-local values.
+ *  It is called when a thread ends for each key where the thread has
+ *  a non-NULL value.
+ */
+typedef void (ZLX_CALL * zlx_tls_dtor_t) (void * value);
+
 /*  zlx_mth_xfc_t  */
 /**
  *  Collection of all multithreading related interfaces.
@@ -120,6 +140,21 @@ struct zlx_thread_xfc_s
             zlx_tid_t tid,
             uint8_t * ret_val_p
         );
+
+    /*  set_affinity  */
+    /**
+     *  Restricts the calling thread to run only on the given CPUs.
+     *  This may be NULL for interfaces that predate it.
+     *  @param cpus [in]
+     *      CPU indexes (see @ref topo)
+     *  @param cpu_count [in]
+     *      number of items in @a cpus
+     */
+    zlx_mth_status_t (ZLX_CALL * set_affinity)
+        (
+            unsigned int const * cpus,
+            size_t cpu_count
+        );
 };
 
 struct zlx_mutex_xfc_s
@@ -138,6 +173,11 @@ struct zlx_mutex_xfc_s
 
     /** Size of the mutex instance. */
     size_t size;
+
+    /** Optional (can be NULL); receives the description given to
+     *  zlx_mutex_create() right after the mutex is initialized.
+     *  The string must be static. */
+    void (ZLX_CALL * set_info) (zlx_mutex_t * mutex_p, char const * info);
 };
 
 struct zlx_cond_xfc_s
@@ -163,6 +203,31 @@ struct zlx_cond_xfc_s
     size_t size;
 };
 
+struct zlx_tls_xfc_s
+{
+    /** Creates a key.
+     *  @param key_p [out]
+     *      receives the key; the value of the key is NULL in all threads
+     *  @param dtor [in, opt]
+     *      destructor for the values left by ending threads
+     *  @retval ZLX_MTH_OK
+     *  @retval ZLX_MTH_NO_RES no more keys available */
+    zlx_mth_status_t (ZLX_CALL * create)
+        (
+            zlx_tls_key_t * key_p,
+            zlx_tls_dtor_t dtor
+        );
+
+    /** Deletes a key. The destructor is not called for the values left. */
+    void (ZLX_CALL * destroy) (zlx_tls_key_t key);
+
+    /** Returns the value of the key in the calling thread. */
+    void * (ZLX_CALL * get) (zlx_tls_key_t key);
+
+    /** Sets the value of the key in the calling thread. */
+    zlx_mth_status_t (ZLX_CALL * set) (zlx_tls_key_t key, void * value);
+};
+
 struct zlx_mth_xfc_s
 {
     /** Interface for thread operations. */
@@ -173,6 +238,10 @@ struct zlx_mth_xfc_s
 
     /** Interface for condition variable operations. */
     zlx_cond_xfc_t cond;
+
+    /** Interface for thread-local storage. Values are per OS thread, so
+     *  fibers running on the same worker share them. */
+    zlx_tls_xfc_t tls;
 };
 
 ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_thread_create
@@ -188,6 +257,12 @@ ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_thread_join
         uint8_t * ret_val_p
     );
 
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_thread_set_affinity
+    (
+        unsigned int const * cpus,
+        size_t cpu_count
+    );
+
 ZLX_API void ZLX_CALL zlx_nop_mutex_op (zlx_mutex_t * mutex_p);
 ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_cond_init (zlx_cond_t * cond_p);
 ZLX_API void ZLX_CALL zlx_nop_cond_op (zlx_cond_t * cond_p);
@@ -196,6 +271,18 @@ ZLX_API void ZLX_CALL zlx_nop_cond_wait
         zlx_cond_t * cond_p,
         zlx_mutex_t * mutex_p
     );
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_tls_create
+    (
+        zlx_tls_key_t * key_p,
+        zlx_tls_dtor_t dtor
+    );
+ZLX_API void ZLX_CALL zlx_nop_tls_destroy (zlx_tls_key_t key);
+ZLX_API void * ZLX_CALL zlx_nosup_tls_get (zlx_tls_key_t key);
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_nosup_tls_set
+    (
+        zlx_tls_key_t key,
+        void * value
+    );
 
 /** Dummy interface for multithreading that does not offer support for any
  *  real operations.
@@ -220,12 +307,12 @@ ZLX_API zlx_mth_xfc_t zlx_nosup_mth_xfc;
 ZLX_INLINE zlx_mutex_t * zlxi_mutex_create
 (
     zlx_ma_t * restrict ma,
-    zlx_mutex_xfc_t * restrict mx
+    zlx_mutex_xfc_t * restrict mx,
+    char const * info
 #if _DEBUG
     , char const * src
     , unsigned int line
     , char const * func
-    , char const * info
 #endif
 )
 {
@@ -235,18 +322,22 @@ ZLX_INLINE zlx_mutex_t * zlxi_mutex_create
     if (m) ma->info_set(ma, m, src, line, func, info);
 #endif
     mx->init(m);
+    if (mx->set_info) mx->set_info(m, info);
     return m;
 }
 
 /*  zlx_mutex_create  */
 #if _DEBUG
 #define zlx_mutex_create(_ma, _mx, _info) \
-    (zlxi_mutex_create((_ma), (_mx), __FILE__, __LINE__, __FUNCTION__, (_info)))
+    (zlxi_mutex_create((_ma), (_mx), (_info), __FILE__, __LINE__, __FUNCTION__))
 #else
 /**
  *  Allocates and initializes a mutex.
+ *  The static string @a _info describes the mutex; it is passed to
+ *  zlx_mutex_xfc_t#set_info and, on debug builds, to the allocator.
  */
-#define zlx_mutex_create(_ma, _mx, _info) (zlxi_mutex_create((_ma), (_mx)))
+#define zlx_mutex_create(_ma, _mx, _info) \
+    (zlxi_mutex_create((_ma), (_mx), (_info)))
 #endif
 
 /*  zlxi_mutex_destroy  */
@@ -278,7 +369,7 @@ ZLX_INLINE void zlxi_mutex_destroy
     zlx_free(ma, m, mx->size);
 }
 
-/* zlx_mutex_destroy */
+/* zlx_mutex_destroy ********************************************************/
 #if _DEBUG
 #define zlx_mutex_destroy(_mutex, _ma, _mx) \
     (zlxi_mutex_destroy((_mutex), (_ma), (_mx), \
@@ -319,7 +410,8 @@ ZLX_INLINE zlx_cond_t * zlxi_cond_create
     else ms = cx->init(cond);
     if (ms) 
     {
-        zlx_free(ma, cond, cx->size);
+        if (cond) zlx_free(ma, cond, cx->size);
+        cond = NULL;
         if (status_p) *status_p = ms;
     }
     return cond;
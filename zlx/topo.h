@@ -0,0 +1,178 @@
+#ifndef _ZLX_TOPO_H
+#define _ZLX_TOPO_H
+
+#include "base.h"
+#include "memalloc.h"
+#include "thread.h"
+
+/** @defgroup topo CPU topology
+ *  Cores, SMT siblings, shared caches and NUMA nodes of the host.
+ *
+ *  On Linux the information is read from sysfs; when that is not available
+ *  (or on other targets) cache sizes come from CPUID leaf 4 on x86 and every
+ *  CPU is reported as a separate core on node 0.
+ *  @{ */
+
+/*  zlx_topo_t  */
+/**
+ *  Topology of the host.
+ */
+typedef struct zlx_topo_s zlx_topo_t;
+
+/*  zlx_topo_cpu_t  */
+/**
+ *  Placement of one logical CPU.
+ */
+typedef struct zlx_topo_cpu_s zlx_topo_cpu_t;
+
+struct zlx_topo_cpu_s
+{
+    /** physical core: the lowest CPU among the SMT siblings of this one */
+    uint32_t core;
+
+    /** physical package (socket) */
+    uint32_t package;
+
+    /** NUMA node */
+    uint32_t node;
+
+    /** L2 cache domain: the lowest CPU sharing the L2 cache with this one */
+    uint32_t l2;
+
+    /** L3 cache domain: the lowest CPU sharing the L3 cache with this one */
+    uint32_t l3;
+};
+
+struct zlx_topo_s
+{
+    /** allocator for #cpus */
+    zlx_ma_t * ma;
+
+    /** per CPU placement, indexed by CPU number */
+    zlx_topo_cpu_t * cpus;
+
+    /** number of logical CPUs */
+    unsigned int cpu_count;
+
+    /** number of physical cores */
+    unsigned int core_count;
+
+    /** number of packages */
+    unsigned int package_count;
+
+    /** number of NUMA nodes */
+    unsigned int node_count;
+
+    /** size of the L1 data cache, in bytes (0 if unknown) */
+    uint32_t l1d_size;
+
+    /** size of the L2 cache, in bytes (0 if unknown) */
+    uint32_t l2_size;
+
+    /** size of the L3 cache, in bytes (0 if unknown) */
+    uint32_t l3_size;
+
+    /** cache line size, in bytes (0 if unknown) */
+    uint32_t line_size;
+};
+
+/** Distance between a CPU and itself */
+#define ZLX_TOPO_SAME_CPU 0
+/** Distance between SMT siblings */
+#define ZLX_TOPO_SAME_CORE 1
+/** Distance between CPUs sharing the L2 cache */
+#define ZLX_TOPO_SAME_L2 2
+/** Distance between CPUs sharing the L3 cache */
+#define ZLX_TOPO_SAME_L3 3
+/** Distance between CPUs on the same NUMA node */
+#define ZLX_TOPO_SAME_NODE 4
+/** Distance between CPUs on different NUMA nodes */
+#define ZLX_TOPO_REMOTE 5
+
+/* zlx_topo_init ************************************************************/
+/**
+ *  Discovers the topology of the host.
+ *  @retval 0 success
+ *  @retval 1 no memory
+ */
+ZLX_API int ZLX_CALL zlx_topo_init
+(
+    zlx_topo_t * restrict topo,
+    zlx_ma_t * restrict ma
+);
+
+/* zlx_topo_finish **********************************************************/
+/**
+ *  Frees the topology data.
+ */
+ZLX_API void ZLX_CALL zlx_topo_finish
+(
+    zlx_topo_t * restrict topo
+);
+
+/* zlx_topo_distance ********************************************************/
+/**
+ *  Returns how far apart two CPUs are: one of #ZLX_TOPO_SAME_CPU ...
+ *  #ZLX_TOPO_REMOTE.
+ */
+ZLX_API unsigned int ZLX_CALL zlx_topo_distance
+(
+    zlx_topo_t const * topo,
+    unsigned int a,
+    unsigned int b
+);
+
+/* zlx_topo_core_cpus *******************************************************/
+/**
+ *  Picks one CPU for each physical core, grouped by node.
+ *  Use this to place one worker per core without SMT siblings competing.
+ *  @param topo [in]
+ *      topology
+ *  @param cpus [out]
+ *      receives the CPUs; must have room for zlx_topo_t#core_count items
+ *  @returns number of CPUs stored
+ */
+ZLX_API unsigned int ZLX_CALL zlx_topo_core_cpus
+(
+    zlx_topo_t const * topo,
+    unsigned int * cpus
+);
+
+/* zlx_topo_steal_order *****************************************************/
+/**
+ *  Orders the other CPUs by distance from the given one: SMT siblings,
+ *  then CPUs sharing the L2 cache, then the L3 cache, then the node.
+ *  Work-stealing pools use this as the victim order of a worker.
+ *  @param topo [in]
+ *      topology
+ *  @param cpu [in]
+ *      CPU of the thief
+ *  @param cpus [out]
+ *      receives the CPUs; must have room for zlx_topo_t#cpu_count - 1 items
+ *  @returns number of CPUs stored
+ */
+ZLX_API unsigned int ZLX_CALL zlx_topo_steal_order
+(
+    zlx_topo_t const * topo,
+    unsigned int cpu,
+    unsigned int * cpus
+);
+
+/* zlx_os_thread_set_affinity ***********************************************/
+/**
+ *  Restricts the calling thread to the given CPUs using the OS services.
+ *  This matches zlx_thread_xfc_t#set_affinity so it can be used by
+ *  interfaces built on native threads.
+ *  @retval ZLX_MTH_OK
+ *  @retval ZLX_MTH_FAILED the OS rejected the CPU set
+ *  @retval ZLX_MTH_NO_SUP not supported on this platform
+ */
+ZLX_API zlx_mth_status_t ZLX_CALL zlx_os_thread_set_affinity
+(
+    unsigned int const * cpus,
+    size_t cpu_count
+);
+
+/** @} */
+
+#endif /* _ZLX_TOPO_H */
@@ -0,0 +1,238 @@
+#ifndef _ZLX_TWHEEL_H
+#define _ZLX_TWHEEL_H
+
+#include "base.h"
+#include "dlist.h"
+#include "evloop.h"
+
+/** @defgroup twheel Timer wheel
+ *  Hashed hierarchical timing wheel for large numbers of timeouts.
+ *
+ *  Timers are intrusive (they embed their list links) so adding and
+ *  cancelling them costs O(1) and never allocates. Time is measured in
+ *  ticks, whose meaning is up to the user; zlx_twheel_advance() moves the
+ *  wheel to a given tick and fires the timers that expired, so the wheel
+ *  can be driven explicitly (deterministic tests, simulations) or attached
+ *  to an event loop with zlx_twheel_attach().
+ *
+ *  Each level has #ZLX_TWHEEL_SLOTS slots; a timer goes to the level
+ *  given by the most significant digit where its expiry differs from the
+ *  current time. When time reaches the start of an occupied slot on a
+ *  higher level, the whole slot is moved out at once and its timers are
+ *  spread on the lower levels, so every timer is moved at most once per
+ *  level. Occupancy bitmaps let the wheel skip over empty slots.
+ *  @{ */
+
+/** Number of bits of the tick count handled by one level */
+#define ZLX_TWHEEL_LEVEL_BITS 6
+
+/** Number of slots on each level */
+#define ZLX_TWHEEL_SLOTS (1 << ZLX_TWHEEL_LEVEL_BITS)
+
+/** Number of levels (enough to cover 64-bit tick counts) */
+#define ZLX_TWHEEL_LEVELS \
+    ((64 + ZLX_TWHEEL_LEVEL_BITS - 1) / ZLX_TWHEEL_LEVEL_BITS)
+
+/** Value of zlx_twtimer_t#slot for timers not queued */
+#define ZLX_TWTIMER_IDLE UINT32_MAX
+
+/*  zlx_twheel_t  */
+/**
+ *  Timer wheel.
+ */
+typedef struct zlx_twheel_s zlx_twheel_t;
+
+/*  zlx_twtimer_t  */
+/**
+ *  Timer owned by the caller (usually embedded in the structure it guards).
+ */
+typedef struct zlx_twtimer_s zlx_twtimer_t;
+
+/*  zlx_twtimer_func_t  */
+/**
+ *  Timer callback. The timer is no longer queued when this is called so
+ *  the callback can add it again or free it.
+ */
+typedef void (ZLX_CALL * zlx_twtimer_func_t)
+    (
+        zlx_twheel_t * tw,
+        zlx_twtimer_t * timer
+    );
+
+struct zlx_twtimer_s
+{
+    /** links in the slot list */
+    zlx_np_t links;
+
+    /** expiry tick */
+    uint64_t expires;
+
+    /** callback */
+    zlx_twtimer_func_t func;
+
+    /** user context */
+    void * ctx;
+
+    /** index of the slot holding the timer or #ZLX_TWTIMER_IDLE */
+    uint32_t slot;
+};
+
+struct zlx_twheel_s
+{
+    /** slot lists, #ZLX_TWHEEL_SLOTS for each level */
+    zlx_np_t slots[ZLX_TWHEEL_LEVELS * ZLX_TWHEEL_SLOTS];
+
+    /** bitmap of non-empty slots for each level */
+    uint64_t occupied[ZLX_TWHEEL_LEVELS];
+
+    /** current tick */
+    uint64_t now;
+
+    /** number of queued timers */
+    size_t count;
+
+    /** event loop driving the wheel or NULL */
+    zlx_evloop_t * loop;
+
+    /** loop timer armed for the next tick where the wheel has work */
+    zlx_evtimer_t evtimer;
+
+    /** tick length in nanoseconds, when attached to a loop */
+    uint64_t tick_ns;
+};
+
+/* zlx_twtimer_init *********************************************************/
+/**
+ *  Initializes a timer in the idle state.
+ */
+ZLX_INLINE void zlx_twtimer_init
+(
+    zlx_twtimer_t * timer,
+    zlx_twtimer_func_t func,
+    void * ctx
+)
+{
+    timer->expires = 0;
+    timer->func = func;
+    timer->ctx = ctx;
+    timer->slot = ZLX_TWTIMER_IDLE;
+}
+
+/* zlx_twtimer_is_pending ***************************************************/
+/**
+ *  Tells whether the timer is queued in a wheel.
+ */
+ZLX_INLINE int zlx_twtimer_is_pending
+(
+    zlx_twtimer_t const * timer
+)
+{
+    return timer->slot != ZLX_TWTIMER_IDLE;
+}
+
+/* zlx_twheel_init **********************************************************/
+/**
+ *  Initializes an empty wheel.
+ *  @param tw [out]
+ *      wheel to initialize
+ *  @param now [in]
+ *      current tick
+ */
+ZLX_API void ZLX_CALL zlx_twheel_init
+(
+    zlx_twheel_t * tw,
+    uint64_t now
+);
+
+/* zlx_twheel_add ***********************************************************/
+/**
+ *  Queues a timer; if the timer is already queued it is moved.
+ *  @param tw [in, out]
+ *      wheel
+ *  @param timer [in, out]
+ *      timer initialized with zlx_twtimer_init()
+ *  @param expires [in]
+ *      expiry tick; values in the past make the timer fire on the next
+ *      call to zlx_twheel_advance()
+ */
+ZLX_API void ZLX_CALL zlx_twheel_add
+(
+    zlx_twheel_t * tw,
+    zlx_twtimer_t * timer,
+    uint64_t expires
+);
+
+/* zlx_twheel_cancel ********************************************************/
+/**
+ *  Removes a timer from the wheel; does nothing if the timer is idle.
+ *  This can be called from timer callbacks for any timer.
+ */
+ZLX_API void ZLX_CALL zlx_twheel_cancel
+(
+    zlx_twheel_t * tw,
+    zlx_twtimer_t * timer
+);
+
+/* zlx_twheel_advance *******************************************************/
+/**
+ *  Moves the wheel to the given tick and fires the expired timers, in
+ *  expiry order (timers expiring on the same tick fire in the order they
+ *  were added).
+ *  @param tw [in, out]
+ *      wheel
+ *  @param now [in]
+ *      new current tick; values in the past are treated as the current tick
+ *  @returns number of timers fired
+ */
+ZLX_API size_t ZLX_CALL zlx_twheel_advance
+(
+    zlx_twheel_t * tw,
+    uint64_t now
+);
+
+/* zlx_twheel_next_expiry ***************************************************/
+/**
+ *  Returns a lower bound for the next tick where the wheel has work to do.
+ *  The bound is exact for timers on the first level; for the others it is
+ *  the tick where their slot gets cascaded.
+ *  @returns tick or UINT64_MAX if the wheel is empty
+ */
+ZLX_API uint64_t ZLX_CALL zlx_twheel_next_expiry
+(
+    zlx_twheel_t * tw
+);
+
+/* zlx_twheel_attach ********************************************************/
+/**
+ *  Drives the wheel from an event loop.
+ *  Ticks become zlx_clock_mono_ns() / @a tick_ns; the wheel is advanced to
+ *  the current time and a loop timer is kept armed for the next expiry
+ *  so that it bounds the poll timeout of the loop.
+ *  @param tw [in, out]
+ *      wheel
+ *  @param loop [in, out]
+ *      event loop; timers must be added and cancelled on the loop thread
+ *  @param tick_ns [in]
+ *      tick length in nanoseconds
+ *  @retval ZLXF_OK
+ *  @retval ZLXF_FAILED failed to queue the loop timer
+ */
+ZLX_API zlx_file_status_t ZLX_CALL zlx_twheel_attach
+(
+    zlx_twheel_t * tw,
+    zlx_evloop_t * loop,
+    uint64_t tick_ns
+);
+
+/* zlx_twheel_detach ********************************************************/
+/**
+ *  Stops driving the wheel from its event loop.
+ */
+ZLX_API void ZLX_CALL zlx_twheel_detach
+(
+    zlx_twheel_t * tw
+);
+
+/** @} */
+
+#endif /* _ZLX_TWHEEL_H */
@@ -2,6 +2,7 @@
 #define _ZLX_WRITER_H
 
 #include "base.h"
+#include "memalloc.h"
 
 /* zlx_writer_t *************************************************************/
 /**
@@ -77,4 +78,206 @@ ZLX_API ptrdiff_t ZLX_CALL zlx_nop_write
     size_t size
 );
 
+/* zlx_dbw_t ****************************************************************/
+/**
+ *  Dynamic-buffer writer context structure.
+ *  The buffer grows as needed, so output of unknown length is written to
+ *  memory in one pass. See zlx_dbw_write().
+ */
+typedef struct zlx_dbw_s zlx_dbw_t;
+struct zlx_dbw_s
+{
+    uint8_t * data; /**< buffer; NULL until something is written */
+    size_t size; /**< number of bytes written to the buffer */
+    size_t capacity; /**< size of the buffer */
+    zlx_ma_t * ma; /**< allocator for the buffer */
+};
+
+/* zlx_dbw_init *************************************************************/
+/**
+ *  Initializes the context structure for dbw writer, with no buffer.
+ *  @returns @a dbw
+ */
+ZLX_API zlx_dbw_t * ZLX_CALL zlx_dbw_init
+(
+    zlx_dbw_t * restrict dbw,
+    zlx_ma_t * restrict ma
+);
+
+/* zlx_dbw_finish ***********************************************************/
+/**
+ *  Frees the buffer.
+ */
+ZLX_API void ZLX_CALL zlx_dbw_finish
+(
+    zlx_dbw_t * restrict dbw
+);
+
+/* zlx_dbw_write ************************************************************/
+/**
+ *  Dynamic-buffer writer processor function.
+ *  The buffer at least doubles when it grows. See #zlx_dbw_t and
+ *  #zlx_write_func_t.
+ *  @returns @a len, or -1 if the buffer cannot grow; nothing is written in
+ *      that case
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_dbw_write
+(
+    void * restrict dbw,
+    uint8_t const * restrict data,
+    size_t len
+);
+
+/* zlx_dbw_reserve **********************************************************/
+/**
+ *  Makes room for @a len more bytes, so writing them does not reallocate.
+ *  @returns 0 on success, -1 if the buffer cannot grow
+ */
+ZLX_API int ZLX_CALL zlx_dbw_reserve
+(
+    zlx_dbw_t * restrict dbw,
+    size_t len
+);
+
+/* zlx_dbw_shrink ***********************************************************/
+/**
+ *  Reallocates the buffer to the size of its content.
+ *  @returns 0 on success, -1 if the reallocation failed (the buffer is
+ *      left as it was)
+ */
+ZLX_API int ZLX_CALL zlx_dbw_shrink
+(
+    zlx_dbw_t * restrict dbw
+);
+
+/* zlx_dbw_reset ************************************************************/
+/**
+ *  Empties the buffer, keeping its memory for the next writes.
+ */
+ZLX_INLINE void zlx_dbw_reset
+(
+    zlx_dbw_t * restrict dbw
+)
+{
+    dbw->size = 0;
+}
+
+/* zlx_dbw_take *************************************************************/
+/**
+ *  Hands the buffer over to the caller, who frees it with
+ *  zlx_free(@a dbw->ma, buffer, @a capacity); the writer is left empty and
+ *  can be used again.
+ *  @param dbw [in, out]
+ *      writer
+ *  @param size [out]
+ *      number of bytes in the buffer
+ *  @param capacity [out]
+ *      size of the buffer
+ *  @returns the buffer; NULL if nothing was ever written
+ */
+ZLX_API uint8_t * ZLX_CALL zlx_dbw_take
+(
+    zlx_dbw_t * restrict dbw,
+    size_t * restrict size,
+    size_t * restrict capacity
+);
+
+/* zlx_tee_target_t *********************************************************/
+/**
+ *  Downstream writer of a fan-out writer.
+ *  See zlx_tee_target_init().
+ */
+typedef struct zlx_tee_target_s zlx_tee_target_t;
+struct zlx_tee_target_s
+{
+    zlx_write_func_t func; /**< writer function */
+    void * obj; /**< context for @a func */
+    uint8_t * buf; /**< staging buffer; NULL to forward every write */
+    size_t buf_size; /**< size of @a buf */
+    size_t buf_len; /**< amount of data staged in @a buf */
+    size_t errors; /**< number of failed writes */
+    uint8_t policy; /**< what errors do: #ZLX_TEE_FAIL, #ZLX_TEE_IGNORE or
+                      #ZLX_TEE_DETACH */
+    uint8_t detached; /**< non-zero once the target stopped getting data */
+};
+
+/* zlx_tee_t ****************************************************************/
+/**
+ *  Fan-out writer context structure.
+ *  See zlx_tee_write().
+ */
+typedef struct zlx_tee_s zlx_tee_t;
+struct zlx_tee_s
+{
+    zlx_tee_target_t * targets; /**< array of downstream writers */
+    size_t count; /**< number of targets */
+};
+
+#define ZLX_TEE_FAIL 0
+/**< a failed write to the target fails the write to the tee */
+
+#define ZLX_TEE_IGNORE 1
+/**< failed writes to the target are only counted */
+
+#define ZLX_TEE_DETACH 2
+/**< the target gets no more data after a failed write */
+
+/* zlx_tee_target_init ******************************************************/
+/**
+ *  Initializes a target for a fan-out writer.
+ *  With a staging buffer, writes are gathered and passed to @a func when the
+ *  buffer is full or on zlx_tee_flush(); writes larger than the buffer go
+ *  straight through. This cuts the calls to sinks that are costly per call.
+ *  Targets are still written synchronously, in the caller's thread: a slow
+ *  sink holds up the tee write, and so the other targets, each time its
+ *  buffer is passed on. Staging makes these stalls rarer, it does not
+ *  remove them.
+ *  @returns @a t
+ */
+ZLX_API zlx_tee_target_t * ZLX_CALL zlx_tee_target_init
+(
+    zlx_tee_target_t * restrict t,
+    zlx_write_func_t func,
+    void * obj,
+    uint8_t * buf,
+    size_t buf_size,
+    uint8_t policy
+);
+
+/* zlx_tee_init *************************************************************/
+/**
+ *  Initializes a fan-out writer over initialized targets.
+ *  @returns @a tee
+ */
+ZLX_API zlx_tee_t * ZLX_CALL zlx_tee_init
+(
+    zlx_tee_t * restrict tee,
+    zlx_tee_target_t * targets,
+    size_t count
+);
+
+/* zlx_tee_write ************************************************************/
+/**
+ *  Fan-out writer processor function: passes the data to every target, in
+ *  order. See #zlx_tee_t and #zlx_write_func_t.
+ *  @returns @a size, or -1 if a target with policy #ZLX_TEE_FAIL failed;
+ *      the other targets get the data either way
+ */
+ZLX_API ptrdiff_t ZLX_CALL zlx_tee_write
+(
+    void * restrict tee,
+    uint8_t const * restrict data,
+    size_t size
+);
+
+/* zlx_tee_flush ************************************************************/
+/**
+ *  Passes the staged data of all targets to their writers.
+ *  @returns 0 on success, -1 if a target with policy #ZLX_TEE_FAIL failed
+ */
+ZLX_API int ZLX_CALL zlx_tee_flush
+(
+    zlx_tee_t * restrict tee
+);
+
 #endif